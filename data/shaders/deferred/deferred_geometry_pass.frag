@@ -3,6 +3,7 @@
 layout (location = 0) out vec4 gPosition;
 layout (location = 1) out vec4 gNormal;
 layout (location = 2) out vec4 gAlbedo;
+layout (location = 3) out uvec2 gFeedback; // texture id and the mip it needs, see texture_streaming.h
 
 in vec2 tex_coord;
 in vec3 normal;
@@ -15,10 +16,35 @@ struct Material
 };
 uniform Material material;
 uniform sampler2D texture_sampler_0;
+uniform sampler2DArray texture_array_sampler;
+uniform bool b_texture_array; // the model's textures are layers of texture_array_sampler instead of texture_sampler_0
+uniform int texture_array_layer;
+uniform vec4 mesh_uv_rect; // atlas tile { u v width height } that tex_coord repeats, zero size if it doesn't
+uniform uint texture_feedback_id; // 0 if the texture isn't streamed
+uniform vec2 texture_feedback_size; // of mip 0 of the whole chain, which may not be resident
+
+vec4 diffuse_sample(vec2 coord, vec2 coord_dx, vec2 coord_dy)
+{
+    if(b_texture_array)
+    {
+        return textureGrad(texture_array_sampler, vec3(coord, float(texture_array_layer)), coord_dx, coord_dy);
+    }
+    return textureGrad(texture_sampler_0, coord, coord_dx, coord_dy);
+}
 
 void main()
 {
-    vec4 diffuse_texture_sample = texture(texture_sampler_0, tex_coord);
+    vec2 coord = tex_coord;
+    vec2 coord_dx = dFdx(tex_coord);
+    vec2 coord_dy = dFdy(tex_coord);
+    if(mesh_uv_rect.z > 0.f)
+    {
+        // Gradients of the unwrapped uvs, so the mip level doesn't jump at tile edges
+        coord = mesh_uv_rect.xy + fract(tex_coord) * mesh_uv_rect.zw;
+        coord_dx *= mesh_uv_rect.zw;
+        coord_dy *= mesh_uv_rect.zw;
+    }
+    vec4 diffuse_texture_sample = diffuse_sample(coord, coord_dx, coord_dy);
     if(diffuse_texture_sample.a < 0.5f)
     {
         discard;
@@ -29,4 +55,10 @@ void main()
     gNormal.rgb = normalize(normal);
     gNormal.a = material.shininess;
     gAlbedo.rgb = diffuse_texture_sample.rgb;
+
+    // Mip the hardware would pick if the whole chain were resident
+    vec2 texel_dx = coord_dx * texture_feedback_size;
+    vec2 texel_dy = coord_dy * texture_feedback_size;
+    float lod = 0.5 * log2(max(dot(texel_dx, texel_dx), dot(texel_dy, texel_dy)));
+    gFeedback = uvec2(texture_feedback_id, uint(clamp(floor(lod), 0.0, 15.0)));
 }
\ No newline at end of file
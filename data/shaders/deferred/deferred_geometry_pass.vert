@@ -9,14 +9,34 @@ out vec3 normal;
 out vec3 frag_pos;
 
 uniform mat4 matrix_model;
-uniform mat4 matrix_view;
-uniform mat4 matrix_proj_perspective;
+layout(std140) uniform view_constants // frame_constants.h
+{
+    mat4 matrix_view;
+    mat4 matrix_proj_perspective;
+    vec3 eye_position;
+};
+
+// Quantized meshes: mesh space position = pos * scale + offset (1 and 0 for float meshes)
+uniform vec3 mesh_position_scale;
+uniform vec3 mesh_position_offset;
+uniform bool b_mesh_octahedral_normal; // in_normal.xy is an octahedral encoded normal
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
-    vec4 world_position = matrix_model * vec4(pos, 1.0);
+    vec3 local_position = pos * mesh_position_scale + mesh_position_offset;
+    vec3 local_normal = b_mesh_octahedral_normal ? octahedral_decode(in_normal.xy) : in_normal;
+    vec4 world_position = matrix_model * vec4(local_position, 1.0);
     gl_Position = matrix_proj_perspective * matrix_view * world_position;
     tex_coord = in_tex_coord;
-    normal = mat3(transpose(inverse(matrix_model))) * in_normal;
+    normal = mat3(transpose(inverse(matrix_model))) * local_normal;
     frag_pos = world_position.xyz;
 }
\ No newline at end of file
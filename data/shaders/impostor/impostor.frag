@@ -0,0 +1,79 @@
+#version 330 core
+
+// Same outputs as deferred_geometry_pass.frag, reconstructed from the impostor atlases
+
+layout (location = 0) out vec4 gPosition;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAlbedo;
+layout (location = 3) out uvec2 gFeedback;
+
+in vec3 mesh_position;
+flat in vec3 mesh_eye;
+flat in vec2 frame_cell;
+flat in vec3 frame_direction;
+flat in vec3 frame_right;
+flat in vec3 frame_up;
+flat in mat3 normal_matrix;
+
+struct Material
+{
+    float specular_intensity;
+    float shininess;
+};
+uniform Material material;
+uniform mat4 matrix_model;
+layout(std140) uniform view_constants // frame_constants.h
+{
+    mat4 matrix_view;
+    mat4 matrix_proj_perspective;
+    vec3 eye_position;
+};
+uniform vec3 impostor_center;
+uniform float impostor_radius;
+uniform float impostor_grid_size;
+uniform float impostor_atlas_texel;     // 1 / atlas resolution
+uniform sampler2D albedo_atlas;
+uniform sampler2D normal_depth_atlas;
+
+void main()
+{
+    // Where the view ray crosses the plane the frame was baked on
+    vec3 ray = mesh_position - mesh_eye;
+    float facing = dot(ray, frame_direction);
+    if(facing >= 0.0)
+    {
+        discard;
+    }
+    vec3 frame_position = mesh_eye + ray * (dot(impostor_center - mesh_eye, frame_direction) / facing);
+    vec3 offset = frame_position - impostor_center;
+    vec2 local = vec2(dot(offset, frame_right), dot(offset, frame_up)) / impostor_radius;
+    if(abs(local.x) > 1.0 || abs(local.y) > 1.0)
+    {
+        discard;
+    }
+
+    // Stay half a texel inside the frame so filtering doesn't pull in the neighbouring frame
+    vec2 frame_min = frame_cell / impostor_grid_size + 0.5 * impostor_atlas_texel;
+    vec2 frame_max = (frame_cell + 1.0) / impostor_grid_size - 0.5 * impostor_atlas_texel;
+    vec2 atlas_coord = clamp((frame_cell + local * 0.5 + 0.5) / impostor_grid_size, frame_min, frame_max);
+    vec4 albedo = texture(albedo_atlas, atlas_coord);
+    if(albedo.a < 0.5)
+    {
+        discard;
+    }
+    vec4 normal_depth = texture(normal_depth_atlas, atlas_coord);
+
+    vec3 surface = frame_position + frame_direction * impostor_radius * (1.0 - 2.0 * normal_depth.a);
+    vec4 world_position = matrix_model * vec4(surface, 1.0);
+    vec4 clip_position = matrix_proj_perspective * matrix_view * world_position;
+    gl_FragDepth = clip_position.z / clip_position.w * 0.5 + 0.5;
+
+    vec3 normal = normal_matrix * normal_depth.xyz;
+    float normal_length = length(normal);
+    gPosition.rgb = world_position.xyz;
+    gPosition.a = material.specular_intensity;
+    gNormal.rgb = normal_length > 0.0 ? normal / normal_length : frame_direction;
+    gNormal.a = material.shininess;
+    gAlbedo.rgb = albedo.rgb / albedo.a;
+    gFeedback = uvec2(0u); // the atlases aren't streamed
+}
@@ -0,0 +1,76 @@
+#version 330 core
+
+// Camera facing quad over the bounding sphere of an impostor. No vertex buffers: the corner
+// comes from gl_VertexID, drawn as a 4 vertex triangle strip.
+
+uniform mat4 matrix_model;
+layout(std140) uniform view_constants // frame_constants.h
+{
+    mat4 matrix_view;
+    mat4 matrix_proj_perspective;
+    vec3 eye_position;
+};
+uniform vec3 impostor_center;       // mesh space
+uniform float impostor_radius;
+uniform float impostor_grid_size;
+
+out vec3 mesh_position;             // of the quad, mesh space
+flat out vec3 mesh_eye;
+flat out vec2 frame_cell;           // of the frame facing the eye the most
+flat out vec3 frame_direction;      // from the center towards where the frame was baked from
+flat out vec3 frame_right;
+flat out vec3 frame_up;
+flat out mat3 normal_matrix;
+
+// Octahedral map of the whole sphere with y as the pole, same as impostor.cpp
+vec2 octahedral_encode(vec3 d)
+{
+    vec3 p = d / (abs(d.x) + abs(d.y) + abs(d.z));
+    vec2 e = p.xz;
+    if(p.y < 0.0)
+    {
+        e = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return e;
+}
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Right and up of a view looking from direction towards the center, same as view_matrix_look_at
+void view_basis(vec3 direction, out vec3 right, out vec3 up)
+{
+    vec3 forward = -direction;
+    vec3 up_hint = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(forward, up_hint));
+    up = cross(right, forward);
+}
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID & 1) != 0 ? 1.0 : -1.0, (gl_VertexID & 2) != 0 ? 1.0 : -1.0);
+
+    mesh_eye = (inverse(matrix_model) * vec4(eye_position, 1.0)).xyz;
+    vec3 to_eye = mesh_eye - impostor_center;
+    float eye_distance = length(to_eye);
+    vec3 direction = to_eye / eye_distance;
+
+    frame_cell = clamp(floor((octahedral_encode(direction) * 0.5 + 0.5) * impostor_grid_size), 0.0, impostor_grid_size - 1.0);
+    frame_direction = octahedral_decode((frame_cell + 0.5) / impostor_grid_size * 2.0 - 1.0);
+    view_basis(frame_direction, frame_right, frame_up);
+    normal_matrix = mat3(transpose(inverse(matrix_model)));
+
+    // Big enough to cover the silhouette of the bounding sphere in perspective
+    float radius_squared = impostor_radius * impostor_radius;
+    float size = impostor_radius * eye_distance / sqrt(max(eye_distance * eye_distance - radius_squared, 0.0001 * radius_squared));
+    vec3 right, up;
+    view_basis(direction, right, up);
+    mesh_position = impostor_center + (right * corner.x + up * corner.y) * size;
+    gl_Position = matrix_proj_perspective * matrix_view * matrix_model * vec4(mesh_position, 1.0);
+}
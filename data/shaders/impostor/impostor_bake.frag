@@ -0,0 +1,48 @@
+#version 330 core
+
+// Draws a frame of an impostor atlas. Vertex shader is deferred_geometry_pass.vert with an
+// orthographic matrix_proj_perspective and matrix_model left as identity.
+
+layout (location = 0) out vec4 out_albedo;
+layout (location = 1) out vec4 out_normal_depth;
+
+in vec2 tex_coord;
+in vec3 normal;
+in vec3 frag_pos;
+
+uniform sampler2D texture_sampler_0;
+uniform sampler2DArray texture_array_sampler;
+uniform bool b_texture_array; // the model's textures are layers of texture_array_sampler instead of texture_sampler_0
+uniform int texture_array_layer;
+uniform vec4 mesh_uv_rect; // atlas tile { u v width height } that tex_coord repeats, zero size if it doesn't
+
+vec4 diffuse_sample(vec2 coord, vec2 coord_dx, vec2 coord_dy)
+{
+    if(b_texture_array)
+    {
+        return textureGrad(texture_array_sampler, vec3(coord, float(texture_array_layer)), coord_dx, coord_dy);
+    }
+    return textureGrad(texture_sampler_0, coord, coord_dx, coord_dy);
+}
+
+void main()
+{
+    vec4 diffuse_texture_sample;
+    if(mesh_uv_rect.z > 0.f)
+    {
+        vec2 atlas_coord = mesh_uv_rect.xy + fract(tex_coord) * mesh_uv_rect.zw;
+        diffuse_texture_sample = diffuse_sample(atlas_coord, dFdx(tex_coord) * mesh_uv_rect.zw, dFdy(tex_coord) * mesh_uv_rect.zw);
+    }
+    else
+    {
+        diffuse_texture_sample = diffuse_sample(tex_coord, dFdx(tex_coord), dFdy(tex_coord));
+    }
+    if(diffuse_texture_sample.a < 0.5f)
+    {
+        discard;
+    }
+
+    out_albedo = vec4(diffuse_texture_sample.rgb, 1.0);
+    // Orthographic depth is linear: 0 at the front of the bounding sphere, 1 at the back
+    out_normal_depth = vec4(normalize(normal), gl_FragCoord.z);
+}
@@ -6,10 +6,24 @@
 
 layout (location = 0) in vec3 pos;
 
+struct directional_light_t
+{
+    vec3        colour;
+    float       ambient_intensity;
+    vec3        direction;
+    float       diffuse_intensity;
+};
+layout(std140) uniform light_constants // frame_constants.h
+{
+    mat4 directional_light_transform; // combination of ortho projection matrix * view matrix
+    directional_light_t directional_light;
+};
+
 uniform mat4 matrix_model;
-uniform mat4 directionalLightTransform; // combination of ortho projection matrix * view matrix
+uniform vec3 mesh_position_scale; // dequantization of compact mesh positions
+uniform vec3 mesh_position_offset;
 
 void main()
 {
-    gl_Position = directionalLightTransform * matrix_model * vec4(pos, 1.0);
+    gl_Position = directional_light_transform * matrix_model * vec4(pos * mesh_position_scale + mesh_position_offset, 1.0);
 }
\ No newline at end of file
@@ -2,12 +2,16 @@
 
 in vec4 FragPos;
 
-uniform vec3 lightPos;
-uniform float farPlane;
+layout(std140) uniform omni_shadow_constants // frame_constants.h
+{
+    mat4 light_matrices[6];
+    vec3 light_position;
+    float far_plane;
+};
 
 void main()
 {
-    float distance = length(FragPos.xyz - lightPos);
-    distance = distance / farPlane;
+    float distance = length(FragPos.xyz - light_position);
+    distance = distance / far_plane;
     gl_FragDepth = distance; // overwrite the preset frag depth value
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 layout (location = 0) in vec3 pos;
 
 uniform mat4 matrix_model;
+uniform vec3 mesh_position_scale; // dequantization of compact mesh positions
+uniform vec3 mesh_position_offset;
 
 void main()
 {
-    gl_Position = matrix_model * vec4(pos, 1.0);
+    gl_Position = matrix_model * vec4(pos * mesh_position_scale + mesh_position_offset, 1.0);
 }
\ No newline at end of file
@@ -3,8 +3,12 @@
 layout (location = 0) in vec3 pos;
 
 uniform mat4 matrix_model;
-uniform mat4 matrix_view;
-uniform mat4 matrix_proj_perspective;
+layout(std140) uniform view_constants // frame_constants.h
+{
+    mat4 matrix_view;
+    mat4 matrix_proj_perspective;
+    vec3 eye_position;
+};
 
 void main()
 {
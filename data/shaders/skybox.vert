@@ -4,11 +4,15 @@ layout (location = 0) in vec3 pos;
 
 out vec3 tex_coords;
 
-uniform mat4 matrix_view;
-uniform mat4 matrix_proj_perspective;
+layout(std140) uniform view_constants // frame_constants.h
+{
+    mat4 matrix_view;
+    mat4 matrix_proj_perspective;
+    vec3 eye_position;
+};
 
 void main()
 {
     tex_coords = pos;
-    gl_Position = matrix_proj_perspective * matrix_view * vec4(pos, 1.0);
+    gl_Position = matrix_proj_perspective * mat4(mat3(matrix_view)) * vec4(pos, 1.0);
 }
\ No newline at end of file
@@ -13,6 +13,11 @@ struct display
 
     void vsync(int vsync);
 
+    /** Makes the upload context (a second OpenGL context sharing objects with the main one, see
+        gpu_upload.h) current on the calling thread, or releases it. False if there is no upload
+        context or it couldn't be made current. */
+    bool make_upload_context_current(bool b_current);
+
 private:
     
     SINGLETON(display);
@@ -10,6 +10,7 @@ SINGLETON_INIT(display)
 
 internal SDL_Window* window = nullptr;
 internal SDL_GLContext opengl_context = nullptr;
+internal SDL_GLContext upload_context = nullptr; // shares objects with opengl_context, see gpu_upload.h
 
 void display::initialize()
 {
@@ -22,7 +23,7 @@ void display::initialize()
 
     // OpenGL Context Attributes
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4); // version major
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3); // version minor
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5); // version minor, 4.5 for immutable storage and direct state access
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE); // core means not backward compatible. not using deprecated code.
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG); // allow forward compatibility
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1); // double buffering is on by default, but let's just call this anyway
@@ -90,6 +91,15 @@ void display::initialize()
     }
     console_printf("OpenGL context created.\n");
 
+    // Second context for the upload thread. Creating it makes it current, so give the main
+    // context back to this thread right after.
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    if ((upload_context = SDL_GL_CreateContext(window)) == nullptr)
+    {
+        console_printf("Failed to create the shared OpenGL upload context: %s\n", SDL_GetError());
+    }
+    SDL_GL_MakeCurrent(window, opengl_context);
+
     vsync(0);
 
     display_size_changed();
@@ -103,10 +113,23 @@ void display::swap_buffers()
 void display::clean_up()
 {
     SDL_DestroyWindow(window);
+    if (upload_context)
+    {
+        SDL_GL_DeleteContext(upload_context);
+    }
     SDL_GL_DeleteContext(opengl_context);
     SDL_Quit();
 }
 
+bool display::make_upload_context_current(bool b_current)
+{
+    if (upload_context == nullptr)
+    {
+        return false;
+    }
+    return SDL_GL_MakeCurrent(window, b_current ? upload_context : nullptr) == 0;
+}
+
 void display::vsync(int vsync)
 {
     /** This makes our Buffer Swap (SDL_GL_SwapWindow) synchronized with the monitor's
@@ -8,4 +8,7 @@ void free_file_binary(binary_file_handle_t& binary_file_to_free);
 void read_file_binary(binary_file_handle_t& mem_to_read_to, const char* file_path);
 std::string read_file_string(const char* file_path);
 void free_image(bitmap_handle_t& image_handle);
-void read_image(bitmap_handle_t& image_handle, const char* image_file_path);
\ No newline at end of file
+void read_image(bitmap_handle_t& image_handle, const char* image_file_path);
+bool write_file_binary(const char* file_path, const void* memory, u64 size);
+void unmap_file(mapped_file_handle_t& mapped_file);
+void map_file_readonly(mapped_file_handle_t& mapped_file, const char* file_path);
\ No newline at end of file
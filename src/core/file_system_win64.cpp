@@ -1,5 +1,6 @@
 #include <fstream>
 #include <SDL.h>
+#include <Windows.h>
 
 #include "file_system.h"
 #include "../stb/stb_image.h"
@@ -97,4 +98,91 @@ void read_image(bitmap_handle_t& image_handle, const char* image_file_path)
         image_handle.bit_depth = 0;
         return;
     }
+}
+
+/** Writes size bytes starting at memory to the file at file_path, overwriting the file if it
+    already exists. Returns false if the file could not be opened or fully written. */
+bool write_file_binary(const char* file_path, const void* memory, u64 size)
+{
+    SDL_RWops* binary_file_rw = SDL_RWFromFile(file_path, "wb");
+    if(binary_file_rw == nullptr)
+    {
+        console_printf("Failed to open %s for writing!\n", file_path);
+        return false;
+    }
+
+    size_t objects_written = SDL_RWwrite(binary_file_rw, memory, (size_t) size, 1);
+    SDL_RWclose(binary_file_rw);
+    if(size > 0 && objects_written != 1)
+    {
+        console_printf("Failed to write %llu bytes to %s!\n", size, file_path);
+        return false;
+    }
+    return true;
+}
+
+void unmap_file(mapped_file_handle_t& mapped_file)
+{
+    if(mapped_file.memory)
+    {
+        UnmapViewOfFile(mapped_file.memory);
+    }
+    if(mapped_file.os_mapping)
+    {
+        CloseHandle((HANDLE) mapped_file.os_mapping);
+    }
+    if(mapped_file.os_file)
+    {
+        CloseHandle((HANDLE) mapped_file.os_file);
+    }
+    mapped_file.memory = nullptr;
+    mapped_file.os_mapping = nullptr;
+    mapped_file.os_file = nullptr;
+    mapped_file.size = 0;
+}
+
+/** Maps the file at file_path into the address space of the process as a read-only view.
+    Pages are only read from disk when they are first touched, so mapping a large file is
+    cheap and the file content is never copied into a separate allocation. On failure
+    mapped_file.memory is left as nullptr. */
+void map_file_readonly(mapped_file_handle_t& mapped_file, const char* file_path)
+{
+    if(mapped_file.memory)
+    {
+        console_printf("WARNING: Mapped File Handle already points to a mapped file. Unmapping first...\n");
+        unmap_file(mapped_file);
+    }
+
+    HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    mapped_file.os_file = (void*) file;
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        unmap_file(mapped_file); // can't map an empty file
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr)
+    {
+        console_printf("Failed to create file mapping for %s!\n", file_path);
+        unmap_file(mapped_file);
+        return;
+    }
+    mapped_file.os_mapping = (void*) mapping;
+
+    mapped_file.memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(mapped_file.memory == nullptr)
+    {
+        console_printf("Failed to map view of file %s!\n", file_path);
+        unmap_file(mapped_file);
+        return;
+    }
+    mapped_file.size = (u64) file_size.QuadPart;
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../gamedefine.h"
+
+/**
+    Non-cryptographic hashing of memory blocks. Used to fingerprint source assets so
+    that cooked data can be invalidated when the source changes.
+*/
+
+#define HASH_FNV1A64_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define HASH_FNV1A64_PRIME 0x100000001b3ULL
+
+/** 64-bit FNV-1a hash of size bytes starting at memory. Pass the result of a previous call
+    as seed to continue hashing across multiple blocks of memory. */
+inline u64 hash_fnv1a64(const void* memory, u64 size, u64 seed = HASH_FNV1A64_OFFSET_BASIS)
+{
+    const u8* bytes = (const u8*) memory;
+    u64 hash = seed;
+    for(u64 i = 0; i < size; ++i)
+    {
+        hash ^= (u64) bytes[i];
+        hash *= HASH_FNV1A64_PRIME;
+    }
+    return hash;
+}
@@ -0,0 +1,313 @@
+#include <cstring>
+#include <cstdlib>
+
+#include "json.h"
+
+#define JSON_MAX_DEPTH 128
+
+struct json_reader_t
+{
+    const char* p;
+    const char* end;
+    u32         depth;
+};
+
+internal void json_skip_whitespace(json_reader_t& reader)
+{
+    while(reader.p < reader.end && (*reader.p == ' ' || *reader.p == '\t' || *reader.p == '\n' || *reader.p == '\r'))
+    {
+        ++reader.p;
+    }
+}
+
+internal bool json_expect(json_reader_t& reader, const char* literal)
+{
+    size_t length = strlen(literal);
+    if((size_t) (reader.end - reader.p) < length || memcmp(reader.p, literal, length) != 0)
+    {
+        return false;
+    }
+    reader.p += length;
+    return true;
+}
+
+internal void json_append_utf8(std::string& string, u32 codepoint)
+{
+    if(codepoint < 0x80)
+    {
+        string += (char) codepoint;
+    }
+    else if(codepoint < 0x800)
+    {
+        string += (char) (0xc0 | (codepoint >> 6));
+        string += (char) (0x80 | (codepoint & 0x3f));
+    }
+    else if(codepoint < 0x10000)
+    {
+        string += (char) (0xe0 | (codepoint >> 12));
+        string += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        string += (char) (0x80 | (codepoint & 0x3f));
+    }
+    else
+    {
+        string += (char) (0xf0 | (codepoint >> 18));
+        string += (char) (0x80 | ((codepoint >> 12) & 0x3f));
+        string += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        string += (char) (0x80 | (codepoint & 0x3f));
+    }
+}
+
+internal bool json_parse_hex4(json_reader_t& reader, u32& out_value)
+{
+    if(reader.end - reader.p < 4)
+    {
+        return false;
+    }
+    out_value = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        char c = *reader.p++;
+        u32 digit;
+        if(c >= '0' && c <= '9') digit = c - '0';
+        else if(c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        out_value = (out_value << 4) | digit;
+    }
+    return true;
+}
+
+/** reader.p is just past the opening quote */
+internal bool json_parse_string(json_reader_t& reader, std::string& out_string)
+{
+    out_string.clear();
+    while(reader.p < reader.end)
+    {
+        char c = *reader.p++;
+        if(c == '"')
+        {
+            return true;
+        }
+        if(c != '\\')
+        {
+            out_string += c;
+            continue;
+        }
+        if(reader.p >= reader.end)
+        {
+            return false;
+        }
+        char escaped = *reader.p++;
+        switch(escaped)
+        {
+            case '"': out_string += '"'; break;
+            case '\\': out_string += '\\'; break;
+            case '/': out_string += '/'; break;
+            case 'b': out_string += '\b'; break;
+            case 'f': out_string += '\f'; break;
+            case 'n': out_string += '\n'; break;
+            case 'r': out_string += '\r'; break;
+            case 't': out_string += '\t'; break;
+            case 'u':
+            {
+                u32 codepoint;
+                if(!json_parse_hex4(reader, codepoint))
+                {
+                    return false;
+                }
+                // Surrogate pair
+                if(codepoint >= 0xd800 && codepoint < 0xdc00 && json_expect(reader, "\\u"))
+                {
+                    u32 low;
+                    if(!json_parse_hex4(reader, low))
+                    {
+                        return false;
+                    }
+                    codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                json_append_utf8(out_string, codepoint);
+            } break;
+            default: return false;
+        }
+    }
+    return false;
+}
+
+internal bool json_parse_value(json_reader_t& reader, json_value_t& out_value)
+{
+    json_skip_whitespace(reader);
+    if(reader.p >= reader.end || reader.depth > JSON_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    char c = *reader.p;
+    if(c == '{')
+    {
+        ++reader.p;
+        ++reader.depth;
+        out_value.type = JSON_OBJECT;
+        json_skip_whitespace(reader);
+        if(reader.p < reader.end && *reader.p == '}')
+        {
+            ++reader.p;
+            --reader.depth;
+            return true;
+        }
+        for(;;)
+        {
+            json_skip_whitespace(reader);
+            if(reader.p >= reader.end || *reader.p != '"')
+            {
+                return false;
+            }
+            ++reader.p;
+            out_value.keys.emplace_back();
+            if(!json_parse_string(reader, out_value.keys.back()))
+            {
+                return false;
+            }
+            json_skip_whitespace(reader);
+            if(!json_expect(reader, ":"))
+            {
+                return false;
+            }
+            out_value.elements.emplace_back();
+            if(!json_parse_value(reader, out_value.elements.back()))
+            {
+                return false;
+            }
+            json_skip_whitespace(reader);
+            if(json_expect(reader, ","))
+            {
+                continue;
+            }
+            if(json_expect(reader, "}"))
+            {
+                --reader.depth;
+                return true;
+            }
+            return false;
+        }
+    }
+    if(c == '[')
+    {
+        ++reader.p;
+        ++reader.depth;
+        out_value.type = JSON_ARRAY;
+        json_skip_whitespace(reader);
+        if(reader.p < reader.end && *reader.p == ']')
+        {
+            ++reader.p;
+            --reader.depth;
+            return true;
+        }
+        for(;;)
+        {
+            out_value.elements.emplace_back();
+            if(!json_parse_value(reader, out_value.elements.back()))
+            {
+                return false;
+            }
+            json_skip_whitespace(reader);
+            if(json_expect(reader, ","))
+            {
+                continue;
+            }
+            if(json_expect(reader, "]"))
+            {
+                --reader.depth;
+                return true;
+            }
+            return false;
+        }
+    }
+    if(c == '"')
+    {
+        ++reader.p;
+        out_value.type = JSON_STRING;
+        return json_parse_string(reader, out_value.string);
+    }
+    if(json_expect(reader, "true"))
+    {
+        out_value.type = JSON_BOOL;
+        out_value.b_value = true;
+        return true;
+    }
+    if(json_expect(reader, "false"))
+    {
+        out_value.type = JSON_BOOL;
+        out_value.b_value = false;
+        return true;
+    }
+    if(json_expect(reader, "null"))
+    {
+        out_value.type = JSON_NULL;
+        return true;
+    }
+    if(c == '-' || (c >= '0' && c <= '9'))
+    {
+        // strtod needs a terminated string, and numbers are short
+        char number_text[64];
+        size_t length = 0;
+        while(reader.p < reader.end && length < sizeof(number_text) - 1
+              && (strchr("+-.eE", *reader.p) || (*reader.p >= '0' && *reader.p <= '9')))
+        {
+            number_text[length++] = *reader.p++;
+        }
+        number_text[length] = '\0';
+        char* number_end;
+        out_value.type = JSON_NUMBER;
+        out_value.number = strtod(number_text, &number_end);
+        return number_end == number_text + length;
+    }
+    return false;
+}
+
+bool json_parse(json_value_t& out_value, const char* text, u64 length)
+{
+    out_value = json_value_t();
+    json_reader_t reader = { text, text + length, 0 };
+    if(!json_parse_value(reader, out_value))
+    {
+        out_value = json_value_t();
+        return false;
+    }
+    return true;
+}
+
+const json_value_t* json_value_t::find(const char* key) const
+{
+    if(type != JSON_OBJECT)
+    {
+        return nullptr;
+    }
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        if(keys[i] == key)
+        {
+            return &elements[i];
+        }
+    }
+    return nullptr;
+}
+
+const json_value_t* json_value_t::at(size_t index) const
+{
+    return type == JSON_ARRAY && index < elements.size() ? &elements[index] : nullptr;
+}
+
+double json_number(const json_value_t* value, double fallback)
+{
+    return value && value->type == JSON_NUMBER ? value->number : fallback;
+}
+
+bool json_bool(const json_value_t* value, bool fallback)
+{
+    return value && value->type == JSON_BOOL ? value->b_value : fallback;
+}
+
+const char* json_string(const json_value_t* value, const char* fallback)
+{
+    return value && value->type == JSON_STRING ? value->string.c_str() : fallback;
+}
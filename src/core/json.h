@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+
+/**
+    Minimal JSON reader. Parses a whole document into a tree of json_value_t, for small
+    documents like glTF headers - not for streaming big data.
+    Strings are unescaped (\uXXXX becomes UTF-8). Numbers are stored as doubles.
+*/
+
+enum json_type_t : u8
+{
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+struct json_value_t
+{
+    json_type_t                 type = JSON_NULL;
+    bool                        b_value = false;
+    double                      number = 0.0;
+    std::string                 string;
+    std::vector<json_value_t>   elements;   // of an array, or the values of an object
+    std::vector<std::string>    keys;       // of an object, same order as elements
+
+    /** Member of an object, nullptr if there is no such key or this isn't an object */
+    const json_value_t* find(const char* key) const;
+
+    /** Element of an array, nullptr if index is out of range or this isn't an array */
+    const json_value_t* at(size_t index) const;
+
+    size_t size() const { return elements.size(); }
+};
+
+/** Parses length bytes of text. Returns false and leaves out_value as JSON_NULL on a syntax error. */
+bool json_parse(json_value_t& out_value, const char* text, u64 length);
+
+/** Helpers that return fallback if value is nullptr or of another type. */
+double json_number(const json_value_t* value, double fallback = 0.0);
+bool json_bool(const json_value_t* value, bool fallback = false);
+const char* json_string(const json_value_t* value, const char* fallback = "");
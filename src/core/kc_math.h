@@ -25,6 +25,7 @@ INTRO & PURPOSE:
         - Methods to create projection matrices
         - Method to create view matrix
         - Spherical linear interpolation & vector linear interpolation
+        - Wide (SSE) vectors & quaternions that hold 4 values each in SoA form
 
 STANDARDS:
     Positive X axis is forward vector. Positive Y axis is up vector. Positive Z
@@ -38,6 +39,7 @@ STANDARDS:
 #define _INCLUDE_KC_MATH_H_
 
 #include <cstdlib>
+#include <xmmintrin.h>
 
 #define WORLD_FORWARD_VECTOR make_vec3(1.f,0.f,0.f)
 #define WORLD_BACKWARD_VECTOR (-WORLD_FORWARD_VECTOR)
@@ -199,6 +201,26 @@ struct quaternion
     float z = 0.f; 
 };
 
+/** - Wide Vectors & Quaternions -
+    4 vec3s or quaternions in SoA form, one SSE register per component, for running the same
+    operation over many values at once (e.g. every joint of a skeleton). Lane i of x, y, z
+    (and w) together make up value i.
+*/
+struct vec3_wide
+{
+    __m128 x;
+    __m128 y;
+    __m128 z;
+};
+
+struct quaternion_wide
+{
+    __m128 w;
+    __m128 x;
+    __m128 y;
+    __m128 z;
+};
+
 /**
 
     Constructors and identity consturctors
@@ -423,6 +445,26 @@ inline mat4 make_mat4(quaternion q);
 inline quaternion slerp(const quaternion from, const quaternion to, const float ratio);
 
 
+/**
+
+    Wide Operations
+
+*/
+/** Loads 4 values from SoA float arrays (e.g. x points to 4 x components). Doesn't need alignment. */
+inline vec3_wide load_vec3_wide(const float* x, const float* y, const float* z);
+inline quaternion_wide load_quaternion_wide(const float* w, const float* x, const float* y, const float* z);
+inline void store(vec3_wide a, float* x, float* y, float* z);
+inline void store(quaternion_wide a, float* w, float* x, float* y, float* z);
+
+inline vec3_wide lerp(vec3_wide from, vec3_wide to, __m128 ratio);
+inline __m128 dot(quaternion_wide a, quaternion_wide b);
+inline quaternion_wide normalize(quaternion_wide a);
+
+/** Normalized lerp on the shorter arc for each lane. Close to slerp when from and to are
+    close together (e.g. neighbouring animation keys) and a lot cheaper. */
+inline quaternion_wide nlerp(quaternion_wide from, quaternion_wide to, __m128 ratio);
+
+
 /**
 
     Other Operations
@@ -1142,6 +1184,88 @@ inline quaternion slerp(const quaternion from, const quaternion to, const float
     return d_raised_t * start;
 }
 
+/**
+
+    Wide Operations
+
+*/
+inline vec3_wide load_vec3_wide(const float* x, const float* y, const float* z)
+{
+    vec3_wide ret = { _mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z) };
+    return ret;
+}
+
+inline quaternion_wide load_quaternion_wide(const float* w, const float* x, const float* y, const float* z)
+{
+    quaternion_wide ret = { _mm_loadu_ps(w), _mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z) };
+    return ret;
+}
+
+inline void store(vec3_wide a, float* x, float* y, float* z)
+{
+    _mm_storeu_ps(x, a.x);
+    _mm_storeu_ps(y, a.y);
+    _mm_storeu_ps(z, a.z);
+}
+
+inline void store(quaternion_wide a, float* w, float* x, float* y, float* z)
+{
+    _mm_storeu_ps(w, a.w);
+    _mm_storeu_ps(x, a.x);
+    _mm_storeu_ps(y, a.y);
+    _mm_storeu_ps(z, a.z);
+}
+
+inline vec3_wide lerp(vec3_wide from, vec3_wide to, __m128 ratio)
+{
+    vec3_wide ret;
+    ret.x = _mm_add_ps(from.x, _mm_mul_ps(ratio, _mm_sub_ps(to.x, from.x)));
+    ret.y = _mm_add_ps(from.y, _mm_mul_ps(ratio, _mm_sub_ps(to.y, from.y)));
+    ret.z = _mm_add_ps(from.z, _mm_mul_ps(ratio, _mm_sub_ps(to.z, from.z)));
+    return ret;
+}
+
+inline __m128 dot(quaternion_wide a, quaternion_wide b)
+{
+    __m128 ret = _mm_mul_ps(a.w, b.w);
+    ret = _mm_add_ps(ret, _mm_mul_ps(a.x, b.x));
+    ret = _mm_add_ps(ret, _mm_mul_ps(a.y, b.y));
+    ret = _mm_add_ps(ret, _mm_mul_ps(a.z, b.z));
+    return ret;
+}
+
+inline quaternion_wide normalize(quaternion_wide a)
+{
+    // Reciprocal square root estimate refined with one Newton-Raphson step (~22 bits)
+    __m128 length_squared = dot(a, a);
+    __m128 estimate = _mm_rsqrt_ps(length_squared);
+    __m128 half_length_squared = _mm_mul_ps(length_squared, _mm_set1_ps(0.5f));
+    __m128 inverse_length = _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                       _mm_mul_ps(half_length_squared, _mm_mul_ps(estimate, estimate))));
+    quaternion_wide ret;
+    ret.w = _mm_mul_ps(a.w, inverse_length);
+    ret.x = _mm_mul_ps(a.x, inverse_length);
+    ret.y = _mm_mul_ps(a.y, inverse_length);
+    ret.z = _mm_mul_ps(a.z, inverse_length);
+    return ret;
+}
+
+inline quaternion_wide nlerp(quaternion_wide from, quaternion_wide to, __m128 ratio)
+{
+    // Flip the sign of to where it is on the longer arc
+    __m128 sign = _mm_and_ps(dot(from, to), _mm_set1_ps(-0.f));
+    to.w = _mm_xor_ps(to.w, sign);
+    to.x = _mm_xor_ps(to.x, sign);
+    to.y = _mm_xor_ps(to.y, sign);
+    to.z = _mm_xor_ps(to.z, sign);
+    quaternion_wide ret;
+    ret.w = _mm_add_ps(from.w, _mm_mul_ps(ratio, _mm_sub_ps(to.w, from.w)));
+    ret.x = _mm_add_ps(from.x, _mm_mul_ps(ratio, _mm_sub_ps(to.x, from.x)));
+    ret.y = _mm_add_ps(from.y, _mm_mul_ps(ratio, _mm_sub_ps(to.y, from.y)));
+    ret.z = _mm_add_ps(from.z, _mm_mul_ps(ratio, _mm_sub_ps(to.z, from.z)));
+    return normalize(ret);
+}
+
 /**
     
     Other Operations
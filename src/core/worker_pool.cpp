@@ -0,0 +1,133 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+
+#include "worker_pool.h"
+
+internal std::vector<std::thread>   workers;
+internal std::deque<worker_job_t>   job_queue;
+internal std::mutex                 job_queue_mutex;
+internal std::condition_variable    job_queue_condition;
+internal bool                       b_workers_should_exit = false;
+
+internal void worker_thread_main()
+{
+    for(;;)
+    {
+        worker_job_t job;
+        {
+            std::unique_lock<std::mutex> lock(job_queue_mutex);
+            job_queue_condition.wait(lock, []{ return b_workers_should_exit || !job_queue.empty(); });
+            if(b_workers_should_exit && job_queue.empty())
+            {
+                return;
+            }
+            job = std::move(job_queue.front());
+            job_queue.pop_front();
+        }
+        job();
+    }
+}
+
+void worker_pool_initialize()
+{
+    if(!workers.empty())
+    {
+        return;
+    }
+
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    u32 worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+    b_workers_should_exit = false;
+    for(u32 i = 0; i < worker_count; ++i)
+    {
+        workers.emplace_back(worker_thread_main);
+    }
+}
+
+void worker_pool_clean_up()
+{
+    {
+        std::lock_guard<std::mutex> lock(job_queue_mutex);
+        b_workers_should_exit = true;
+    }
+    job_queue_condition.notify_all();
+    for(std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+u32 worker_pool_thread_count()
+{
+    return (u32) workers.size();
+}
+
+void worker_pool_submit(worker_job_t job)
+{
+    {
+        std::lock_guard<std::mutex> lock(job_queue_mutex);
+        job_queue.push_back(std::move(job));
+    }
+    job_queue_condition.notify_one();
+}
+
+/** Shared between the thread calling worker_pool_parallel_for and its helper jobs. Helpers that
+    only get to run after all the work is done still hold a reference, so this can outlive the
+    call to worker_pool_parallel_for. */
+struct parallel_for_state_t
+{
+    std::function<void(u32)>    job;
+    u32                         count = 0;
+    std::atomic<u32>            next_index { 0 };
+    std::atomic<u32>            completed_count { 0 };
+    std::mutex                  done_mutex;
+    std::condition_variable     done_condition;
+};
+
+internal void parallel_for_run_items(parallel_for_state_t& state)
+{
+    for(;;)
+    {
+        u32 index = state.next_index.fetch_add(1);
+        if(index >= state.count)
+        {
+            return;
+        }
+        state.job(index);
+        if(state.completed_count.fetch_add(1) + 1 == state.count)
+        {
+            std::lock_guard<std::mutex> lock(state.done_mutex);
+            state.done_condition.notify_all();
+        }
+    }
+}
+
+void worker_pool_parallel_for(u32 count, const std::function<void(u32)>& job)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    std::shared_ptr<parallel_for_state_t> state = std::make_shared<parallel_for_state_t>();
+    state->job = job;
+    state->count = count;
+
+    u32 helper_count = count - 1 < worker_pool_thread_count() ? count - 1 : worker_pool_thread_count();
+    for(u32 i = 0; i < helper_count; ++i)
+    {
+        worker_pool_submit([state]() { parallel_for_run_items(*state); });
+    }
+
+    // The calling thread works too instead of just waiting, so nested calls from workers can't deadlock
+    parallel_for_run_items(*state);
+
+    std::unique_lock<std::mutex> lock(state->done_mutex);
+    state->done_condition.wait(lock, [&state]{ return state->completed_count.load() == state->count; });
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include "../gamedefine.h"
+
+/**
+    WORKER POOL
+
+    A fixed set of worker threads (one less than the number of hardware threads) that
+    pull jobs off a shared queue. Only use this for CPU work - worker threads have no
+    OpenGL context, so GL calls must stay on the main thread. console_printf is fine.
+
+    worker_pool_initialize must be called before any other worker_pool function.
+*/
+
+typedef std::function<void()> worker_job_t;
+
+void worker_pool_initialize();
+
+void worker_pool_clean_up();
+
+/** Number of worker threads in the pool (not counting the main thread). */
+u32 worker_pool_thread_count();
+
+/** Queues a job to be run on any worker thread and returns immediately. */
+void worker_pool_submit(worker_job_t job);
+
+/** Calls job(i) for every i in [0, count) spread across the worker threads and the calling
+    thread. Blocks until every call has returned. Safe to call from a worker thread. */
+void worker_pool_parallel_for(u32 count, const std::function<void(u32)>& job);
@@ -16,6 +16,16 @@
 #include "commands.h"
 #include "../debugging/profiling/profiler.h"
 #include "debug_drawer.h"
+#include "../renderer/mesh_arena.h"
+#include "../renderer/mesh_group.h"
+#include "../renderer/model_streamer.h"
+#include "../renderer/render_manager.h"
+#include "../renderer/skinned_mesh.h"
+#include "../renderer/texture.h"
+#include "../renderer/texture_residency.h"
+#include "../renderer/texture_array.h"
+#include "../renderer/texture_streaming.h"
+#include "../renderer/gpu_upload.h"
 
 internal std::map<std::string, console_command_meta_t> con_commands; // association of console command strings to their actual commands
 
@@ -304,6 +314,21 @@ void cmd_add(float x, float y)
 //    b_is_game_running = false;
 //}
 
+void cmd_lod_error(float max_error_pixels)
+{
+    render_manager::get_instance()->lod_max_error_pixels = max_error_pixels;
+}
+
+void cmd_lod_shadow_error(float max_error_pixels)
+{
+    render_manager::get_instance()->lod_shadow_max_error_pixels = max_error_pixels;
+}
+
+void cmd_impostor_distance(float distance)
+{
+    render_manager::get_instance()->impostor_distance = distance;
+}
+
 void cmd_help()
 {
     console_print("Commands in commmands.cpp\n");
@@ -413,6 +438,25 @@ void console_register_commands()
     ADD_COMMAND_ONEARG("profiler", profiler_set_level, int);
     ADD_COMMAND_ONEARG("debug", debug_set_debug_level, int);
     ADD_COMMAND_NOARG("toggle_debug_pointlights", debug_toggle_debug_pointlights);
+    ADD_COMMAND_NOARG("mesh_arena", mesh_arena_print_stats);
+    ADD_COMMAND_NOARG("mesh_arena_compact", mesh_arena_compact);
+    ADD_COMMAND_ONEARG("mesh_vertex_layout", mesh_group_set_vertex_layout, int);
+    ADD_COMMAND_ONEARG("lod_error", cmd_lod_error, float);
+    ADD_COMMAND_ONEARG("lod_shadow_error", cmd_lod_shadow_error, float);
+    ADD_COMMAND_ONEARG("cluster_culling", mesh_group_set_cluster_culling, int);
+    ADD_COMMAND_NOARG("cluster_stats", mesh_group_print_cluster_stats);
+    ADD_COMMAND_ONEARG("stream_budget", model_streamer_set_budget, float);
+    ADD_COMMAND_ONEARG("obj_import", model_streamer_set_obj_mode, int);
+    ADD_COMMAND_ONEARG("mesh_merge", model_streamer_set_merge_meshes, int);
+    ADD_COMMAND_ONEARG("skinned_load", skinned_mesh_load_command, std::string);
+    ADD_COMMAND_ONEARG("skinned_benchmark", skinned_mesh_benchmark, int);
+    ADD_COMMAND_ONEARG("impostor_distance", cmd_impostor_distance, float);
+    ADD_COMMAND_ONEARG("texture_compression", texture_set_compression, int);
+    ADD_COMMAND_ONEARG("texture_budget", texture_residency_set_budget, float);
+    ADD_COMMAND_NOARG("texture_report", texture_residency_report);
+    ADD_COMMAND_ONEARG("texture_arrays", texture_array_set_enabled, int);
+    ADD_COMMAND_ONEARG("texture_streaming", texture_streaming_set_enabled, int);
+    ADD_COMMAND_ONEARG("gpu_upload", gpu_upload_set_enabled, int);
 //    ADD_COMMAND_NOARG("togglewireframe", cmd_wireframe);
 //
 //    ADD_COMMAND_NOARG("camstats", cmd_print_camera_properties);
@@ -1,5 +1,6 @@
 #include <string>
 #include <vector>
+#include <mutex>
 #include <SDL.h>
 #include <GL/glew.h>
 
@@ -79,6 +80,7 @@ internal char        console_messages[CONSOLE_MAX_PRINT_MSGS] = {};
 internal u16      console_messages_read_cursor = 0;
 internal u16      console_messages_write_cursor = 0;
 internal bool        console_b_messages_dirty = false;
+internal std::mutex  console_messages_mutex; // console_print can be called from worker threads
 
 // Text visuals
 internal tta_font_t*   console_font_handle;
@@ -158,6 +160,8 @@ void console_print(const char* message)
     printf(message);
 #endif
 
+    std::lock_guard<std::mutex> lock(console_messages_mutex);
+
     // commands get con_printed when returned
     int i = 0;
     while(*(message + i) != '\0')
@@ -261,6 +265,7 @@ void console_toggle()
 
 void console_update_messages()
 {
+    std::lock_guard<std::mutex> lock(console_messages_mutex);
     if(console_b_messages_dirty)
     {
         int msg_iterator = console_messages_read_cursor - 1;
@@ -381,26 +386,26 @@ void console_render(shader_t* ui_shader, shader_t* text_shader)
 
     // render console
     shader_t::gl_use_shader(*ui_shader);
-        ui_shader->gl_bind_1i("b_use_colour", true);
-        ui_shader->gl_bind_matrix4fv("matrix_model", 1, con_transform.ptr());
-        ui_shader->gl_bind_matrix4fv("matrix_proj_orthographic", 1, matrix_projection_ortho.ptr());
+        ui_shader->gl_bind_1i(UNIFORM("b_use_colour"), true);
+        ui_shader->gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, con_transform.ptr());
+        ui_shader->gl_bind_matrix4fv(UNIFORM("matrix_proj_orthographic"), 1, matrix_projection_ortho.ptr());
         glBindVertexArray(console_background_vao_id);
-            ui_shader->gl_bind_4f("ui_element_colour", 0.1f, 0.1f, 0.1f, 0.7f);
+            ui_shader->gl_bind_4f(UNIFORM("ui_element_colour"), 0.1f, 0.1f, 0.1f, 0.7f);
             glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(console_line_vao_id);
-            ui_shader->gl_bind_4f("ui_element_colour", 0.8f, 0.8f, 0.8f, 1.f);
+            ui_shader->gl_bind_4f(UNIFORM("ui_element_colour"), 0.8f, 0.8f, 0.8f, 1.f);
             glDrawArrays(GL_LINES, 0, 2);
         glBindVertexArray(0);
 
     shader_t::gl_use_shader(*text_shader);
         // RENDER CONSOLE TEXT
-        text_shader->gl_bind_matrix4fv("matrix_proj_orthographic", 1, matrix_projection_ortho.ptr());
+        text_shader->gl_bind_matrix4fv(UNIFORM("matrix_proj_orthographic"), 1, matrix_projection_ortho.ptr());
         console_font_atlas.gl_use_texture();
-        text_shader->gl_bind_1i("font_atlas_sampler", 1);
+        text_shader->gl_bind_1i(UNIFORM("font_atlas_sampler"), 1);
 
         // Input text visual
-        text_shader->gl_bind_3f("text_colour", 1.f, 1.f, 1.f);
-        text_shader->gl_bind_matrix4fv("matrix_model", 1, con_transform.ptr());
+        text_shader->gl_bind_3f(UNIFORM("text_colour"), 1.f, 1.f, 1.f);
+        text_shader->gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, con_transform.ptr());
         if(console_inputtext_vao.indices_count > 0)
         {
             console_inputtext_vao.gl_render_mesh();
@@ -409,13 +414,13 @@ void console_render(shader_t* ui_shader, shader_t* text_shader)
         con_transform[3][1] -= 30.f;
 
         // Messages text visual
-        text_shader->gl_bind_3f("text_colour", 0.8f, 0.8f, 0.8f);
+        text_shader->gl_bind_3f(UNIFORM("text_colour"), 0.8f, 0.8f, 0.8f);
         for(int i = 0; i < CONSOLE_ROWS_MAX; ++i)
         {
             mesh_t m = console_messages_vaos[i];
             if(m.indices_count > 0)
             {
-                text_shader->gl_bind_matrix4fv("matrix_model", 1, con_transform.ptr());
+                text_shader->gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, con_transform.ptr());
                 con_transform[3][1] -= (float) CONSOLE_TEXT_SIZE + 3.f;
                 m.gl_render_mesh();
             }
@@ -425,6 +430,7 @@ void console_render(shader_t* ui_shader, shader_t* text_shader)
 
 void console_scroll_up()
 {
+    std::lock_guard<std::mutex> lock(console_messages_mutex);
     int temp_cursor = console_messages_read_cursor - 1;
     char c = console_messages[temp_cursor];
     if(c == '\n')
@@ -455,6 +461,7 @@ void console_scroll_up()
 
 void console_scroll_down()
 {
+    std::lock_guard<std::mutex> lock(console_messages_mutex);
     if(console_messages_read_cursor != console_messages_write_cursor)
     {
         int temp_cursor = console_messages_read_cursor;
@@ -12,6 +12,7 @@ void console_toggle();
 void console_update();
 void console_render(shader_t* ui_shader, shader_t* text_shader);
 
+/** console_print and console_printf can be called from any thread. */
 void console_print(const char* message);
 void console_printf(const char* fmt, ...);
 void console_command(char* text_command);
@@ -3,7 +3,6 @@
 #include "../renderer/mesh.h"
 #include "../renderer/light.h"
 #include "../renderer/shader.h"
-#include "../renderer/camera.h"
 
 internal int debugger_level = 0;
 int debug_drawer_get_level()
@@ -96,13 +95,13 @@ void debug_render_sphere(shader_t& shader, float x, float y, float z, float radi
     mat4 sphere_transform = identity_mat4();
     sphere_transform *= translation_matrix(x, y, z);
     sphere_transform *= scale_matrix(radius, radius, radius);
-    shader.gl_bind_matrix4fv("matrix_model", 1, sphere_transform.ptr());
+    shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, sphere_transform.ptr());
     debug_sphere_mesh.gl_render_mesh(GL_LINES);
     sphere_transform *= rotation_matrix(make_quaternion_deg(90.f, make_vec3(1.f, 0.f, 0.f)));
-    shader.gl_bind_matrix4fv("matrix_model", 1, sphere_transform.ptr());
+    shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, sphere_transform.ptr());
     debug_sphere_mesh.gl_render_mesh(GL_LINES);
     sphere_transform *= rotation_matrix(make_quaternion_deg(90.f, make_vec3(0.f, 0.f, 1.f)));
-    shader.gl_bind_matrix4fv("matrix_model", 1, sphere_transform.ptr());
+    shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, sphere_transform.ptr());
     debug_sphere_mesh.gl_render_mesh(GL_LINES);
 }
 
@@ -117,7 +116,7 @@ void debug_render_cone(shader_t& shader,
     cone_transform *= rotation_matrix(rot);
     cone_transform *= scale_matrix(base_radius, height, base_radius);
 
-    shader.gl_bind_matrix4fv("matrix_model", 1, cone_transform.ptr());
+    shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, cone_transform.ptr());
     debug_cone_mesh.gl_render_mesh(GL_LINES);
 }
 
@@ -129,21 +128,21 @@ void debug_render_line()
 void debug_render_pointlight(shader_t& shader, point_light_t& plight)
 {
     float att_radius = plight.get_radius() / 2.5f;
-    shader.gl_bind_4f("frag_colour", 1.f, 1.f, 1.f, 1.f);
+    shader.gl_bind_4f(UNIFORM("frag_colour"), 1.f, 1.f, 1.f, 1.f);
     debug_render_sphere(shader, plight.position.x, plight.position.y, plight.position.z, att_radius);
-    shader.gl_bind_4f("frag_colour", 1.f, 1.f, 0.f, 1.f);
+    shader.gl_bind_4f(UNIFORM("frag_colour"), 1.f, 1.f, 0.f, 1.f);
     debug_render_sphere(shader, plight.position.x, plight.position.y, plight.position.z, 0.05f);
 }
 
 void debug_render_spotlight(shader_t& shader, point_light_t& slight)
 {
     float att_radius = slight.get_radius();
-    shader.gl_bind_4f("frag_colour", 1.f, 1.f, 1.f, 1.f);
+    shader.gl_bind_4f(UNIFORM("frag_colour"), 1.f, 1.f, 1.f, 1.f);
     float base_radius = att_radius * tanf(acosf(slight.cosine_cutoff()));
     float height = att_radius / slight.cosine_cutoff();
     debug_render_cone(shader, slight.position.x, slight.position.y, slight.position.z,
                       height, base_radius, direction_to_orientation(slight.get_direction()));
-    shader.gl_bind_4f("frag_colour", 1.f, 1.f, 0.f, 1.f);
+    shader.gl_bind_4f(UNIFORM("frag_colour"), 1.f, 1.f, 0.f, 1.f);
     debug_render_sphere(shader, slight.position.x, slight.position.y, slight.position.z, 0.05f);
 }
 
@@ -153,7 +152,7 @@ void debug_initialize()
     debug_cone_mesh = create_cone_mesh(0.f, 0.f, 0.f, 1.f, 1.f);
 }
 
-void debug_render(shader_t& debug_shader, camera_t camera)
+void debug_render(shader_t& debug_shader)
 {
     if(!debugger_level)
     {
@@ -161,8 +160,6 @@ void debug_render(shader_t& debug_shader, camera_t camera)
     }
 
     shader_t::gl_use_shader(debug_shader);
-        debug_shader.gl_bind_matrix4fv("matrix_view", 1, camera.matrix_view.ptr());
-        debug_shader.gl_bind_matrix4fv("matrix_proj_perspective", 1, camera.matrix_perspective.ptr());
 
         if(1 <= debugger_level)
         {
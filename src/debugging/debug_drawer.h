@@ -4,7 +4,6 @@
 
 struct quaternion;
 struct mesh_t;
-struct camera_t;
 struct shader_t;
 struct point_light_t;
 
@@ -25,7 +24,7 @@ void debug_render_cone(shader_t& shader,
 void debug_render_line();
 void debug_render_pointlight(shader_t& shader, point_light_t& plight);
 void debug_initialize();
-void debug_render(shader_t& debug_shader, camera_t camera);
+void debug_render(shader_t& debug_shader);
 void debug_set_pointlights(point_light_t* point_lights_array, u32 count);
 void debug_toggle_debug_pointlights();
 void debug_set_debug_level(int level);
\ No newline at end of file
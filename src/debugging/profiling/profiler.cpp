@@ -66,11 +66,11 @@ void profiler_render(shader_t* ui_shader, shader_t* text_shader)
         mat4& matrix_projection_ortho = render_manager::get_instance()->matrix_projection_ortho;
 
         shader_t::gl_use_shader(*text_shader);
-            text_shader->gl_bind_matrix4fv("matrix_proj_orthographic", 1, matrix_projection_ortho.ptr());
+            text_shader->gl_bind_matrix4fv(UNIFORM("matrix_proj_orthographic"), 1, matrix_projection_ortho.ptr());
             perf_font_atlas.gl_use_texture();
-            text_shader->gl_bind_1i("font_atlas_sampler", 1);
-            text_shader->gl_bind_3f("text_colour", 1.f, 1.f, 1.f);
-            text_shader->gl_bind_matrix4fv("matrix_model", 1, perf_frametime_transform.ptr());
+            text_shader->gl_bind_1i(UNIFORM("font_atlas_sampler"), 1);
+            text_shader->gl_bind_3f(UNIFORM("text_colour"), 1.f, 1.f, 1.f);
+            text_shader->gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, perf_frametime_transform.ptr());
             if(perf_frametime_vao.indices_count > 0)
             {
                 perf_frametime_vao.gl_render_mesh();
@@ -1,7 +1,6 @@
 /** XNGINE
 
 TODO:
-    - Reference count texture resources
     - BUG console command bug - commands get cut off when entered - could be a memory bug?
     - kc_truetypeassembler.h
         - clean up - allocate all memory on init and deallocate all memory on clean up
@@ -15,7 +14,7 @@ TODO:
         - for dynamic objects, render the shadow map on-top of the existing shadow map e.g. add more dark spots
 
 Backlog:
-    - Resource manager / load resources asynchronously so the game isn't frozen while loading?
+    - Resource manager (models load asynchronously through renderer/model_streamer, the rest doesn't yet)
     - Memory management / custom memory allocator / replace all mallocs and callocs
     - Baked shadow maps for static lights?
     - Remove all STL usage
@@ -71,12 +70,15 @@ BUILD MODES
 */
 #include "gamedefine.h"
 #include "core/timer.h"
+#include "core/worker_pool.h"
 #include "debugging/console.h"
 #include "debugging/profiling/profiler.h"
 #include "debugging/debug_drawer.h"
 #include "core/display.h"
 #include "core/input.h"
 #include "renderer/render_manager.h"
+#include "renderer/model_streamer.h"
+#include "renderer/gpu_upload.h"
 #include "runtime/game_state.h"
 #include "renderer/texture.h"
 #include "core/file_system.h"
@@ -124,8 +126,14 @@ int main(int argc, char* argv[]) // Our main entry point MUST be in this form wh
     i_render_manager->gs = &i_game_state;
     i_input_manager->gs = &i_game_state;
 
+    worker_pool_initialize(); // before the renderer, which decodes the skybox on it
     i_window_manager->initialize(); // e.g. Qt, SDL
-    i_render_manager->initialize(); // OpenGL
+    if (!i_render_manager->initialize()) // OpenGL
+    {
+        worker_pool_clean_up();
+        i_window_manager->clean_up();
+        return 1;
+    }
     i_input_manager->initialize(); // e.g. Qt, SDL
 
     stbi_set_flip_vertically_on_load(true);
@@ -161,10 +169,13 @@ int main(int argc, char* argv[]) // Our main entry point MUST be in this form wh
             i_game_state.update();
         }
 
+        gpu_upload_update(); // publishes what the upload thread finished before the streamer uploads more
+        model_streamer_update();
         i_render_manager->render();
         i_window_manager->swap_buffers();
     }
 
+    worker_pool_clean_up();
     i_render_manager->clean_up();
     i_window_manager->clean_up();
 
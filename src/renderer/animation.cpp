@@ -0,0 +1,134 @@
+#include <vector>
+#include <cmath>
+
+#include "animation.h"
+
+/** Index of the last key at or before time, and how far time is towards the key after it */
+internal u32 animation_find_key(const std::vector<float>& times, float time, float& out_ratio)
+{
+    out_ratio = 0.f;
+    if(times.size() < 2 || time <= times[0])
+    {
+        return 0;
+    }
+    u32 last = (u32) times.size() - 1;
+    if(time >= times[last])
+    {
+        return last;
+    }
+    // Binary search for the first key after time
+    u32 low = 0;
+    u32 high = last;
+    while(high - low > 1)
+    {
+        u32 middle = (low + high) / 2;
+        if(times[middle] <= time)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    float span = times[high] - times[low];
+    out_ratio = span > 0.f ? (time - times[low]) / span : 0.f;
+    return low;
+}
+
+internal vec3 animation_sample_vec3(const std::vector<float>& times, const std::vector<vec3>& keys, float time)
+{
+    float ratio;
+    u32 key = animation_find_key(times, time, ratio);
+    if(ratio == 0.f)
+    {
+        return keys[key];
+    }
+    const vec3& a = keys[key];
+    const vec3& b = keys[key + 1];
+    return make_vec3(a.x + (b.x - a.x) * ratio, a.y + (b.y - a.y) * ratio, a.z + (b.z - a.z) * ratio);
+}
+
+internal quaternion animation_sample_rotation(const std::vector<float>& times, const std::vector<quaternion>& keys, float time)
+{
+    float ratio;
+    u32 key = animation_find_key(times, time, ratio);
+    if(ratio == 0.f)
+    {
+        return keys[key];
+    }
+    const quaternion& a = keys[key];
+    quaternion b = keys[key + 1];
+    if(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z < 0.f)
+    {
+        b = make_quaternion(-b.w, -b.x, -b.y, -b.z);
+    }
+    quaternion q = make_quaternion(a.w + (b.w - a.w) * ratio, a.x + (b.x - a.x) * ratio,
+                                   a.y + (b.y - a.y) * ratio, a.z + (b.z - a.z) * ratio);
+    float length = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    return length > 0.f ? make_quaternion(q.w / length, q.x / length, q.y / length, q.z / length) : a;
+}
+
+void animation_sample(const animation_clip_t& clip, float time, joint_pose_t* pose)
+{
+    if(clip.duration > 0.f)
+    {
+        time = fmodf(time, clip.duration);
+        time = time < 0.f ? time + clip.duration : time;
+    }
+    animation_sample_at(clip, time, pose);
+}
+
+void animation_sample_at(const animation_clip_t& clip, float clip_time, joint_pose_t* pose)
+{
+    float time = clip_time;
+    for(const animation_track_t& track : clip.tracks)
+    {
+        joint_pose_t& joint = pose[track.joint];
+        if(!track.translations.empty())
+        {
+            joint.translation = animation_sample_vec3(track.translation_times, track.translations, time);
+        }
+        if(!track.rotations.empty())
+        {
+            joint.rotation = animation_sample_rotation(track.rotation_times, track.rotations, time);
+        }
+        if(!track.scales.empty())
+        {
+            joint.scale = animation_sample_vec3(track.scale_times, track.scales, time);
+        }
+    }
+}
+
+mat4 animation_pose_matrix(const joint_pose_t& pose)
+{
+    const quaternion& q = pose.rotation;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    mat4 m;
+    m[0][0] = (1.f - 2.f * (yy + zz)) * pose.scale.x;
+    m[0][1] = (2.f * (xy + wz)) * pose.scale.x;
+    m[0][2] = (2.f * (xz - wy)) * pose.scale.x;
+    m[1][0] = (2.f * (xy - wz)) * pose.scale.y;
+    m[1][1] = (1.f - 2.f * (xx + zz)) * pose.scale.y;
+    m[1][2] = (2.f * (yz + wx)) * pose.scale.y;
+    m[2][0] = (2.f * (xz + wy)) * pose.scale.z;
+    m[2][1] = (2.f * (yz - wx)) * pose.scale.z;
+    m[2][2] = (1.f - 2.f * (xx + yy)) * pose.scale.z;
+    m[3][0] = pose.translation.x;
+    m[3][1] = pose.translation.y;
+    m[3][2] = pose.translation.z;
+    m[3][3] = 1.f;
+    return m;
+}
+
+void animation_model_matrices(const skeleton_t& skeleton, const joint_pose_t* pose, mat4* out_matrices)
+{
+    for(size_t joint = 0; joint < skeleton.parents.size(); ++joint)
+    {
+        mat4 local = animation_pose_matrix(pose[joint]);
+        i32 parent = skeleton.parents[joint];
+        out_matrices[joint] = parent >= 0 ? out_matrices[parent] * local : local;
+    }
+}
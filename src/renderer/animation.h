@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+
+/**
+    ANIMATION - skeletons and keyframed animation clips
+
+    A skeleton is a flat array of joints with every parent before its children, so a pose can
+    be turned into model space matrices in one pass from the front. Joints are the nodes of the
+    imported scene; the bones a mesh is skinned to are a subset of them (see skinned_mesh.h).
+
+    A clip has a track per animated joint with separate translation, rotation, and scale keys
+    (they usually have different key times). Joints without a track keep their rest pose.
+    Rotations are blended with normalized lerp on the shorter arc, which is close enough to
+    slerp at animation key rates and a lot cheaper.
+
+    CPU only and thread safe (sampling doesn't touch the clip). Clips are played compressed
+    (see animation_compressed.h); this is the format they are imported and compressed from.
+*/
+
+struct joint_pose_t
+{
+    vec3        translation = { 0.f, 0.f, 0.f };
+    quaternion  rotation = identity_quaternion();
+    vec3        scale = { 1.f, 1.f, 1.f };
+};
+
+struct skeleton_t
+{
+    std::vector<std::string>    joint_names;
+    std::vector<i32>            parents;        // -1 for roots, always less than the joint index
+    std::vector<joint_pose_t>   rest_pose;      // local transform of every joint when nothing animates it
+};
+
+struct animation_track_t
+{
+    u32                     joint = 0;
+    std::vector<float>      translation_times;  // seconds, increasing
+    std::vector<vec3>       translations;
+    std::vector<float>      rotation_times;
+    std::vector<quaternion> rotations;
+    std::vector<float>      scale_times;
+    std::vector<vec3>       scales;
+};
+
+struct animation_clip_t
+{
+    std::string                     name;
+    float                           duration = 0.f;     // seconds
+    std::vector<animation_track_t>  tracks;
+};
+
+/** Samples clip at time seconds (wrapped into the clip) into pose, which has a local pose per
+    joint of the skeleton and must start out as the rest pose. */
+void animation_sample(const animation_clip_t& clip, float time, joint_pose_t* pose);
+
+/** Like animation_sample but clip_time isn't wrapped, so the end of the clip can be sampled.
+    Times outside the clip hold the first or last keys. */
+void animation_sample_at(const animation_clip_t& clip, float clip_time, joint_pose_t* pose);
+
+/** Local transform matrix (translation * rotation * scale) of a joint pose */
+mat4 animation_pose_matrix(const joint_pose_t& pose);
+
+/** Model space matrix of every joint of skeleton in pose. out_matrices has a matrix per joint. */
+void animation_model_matrices(const skeleton_t& skeleton, const joint_pose_t* pose, mat4* out_matrices);
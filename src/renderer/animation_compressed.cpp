@@ -0,0 +1,534 @@
+#include <vector>
+#include <cmath>
+
+#include "animation_compressed.h"
+
+#define ANIMATION_MAX_FRAMES 65535  // key frame numbers are u16
+
+/** Value of a channel at one frame. w x y z for rotations, x y z for translations and scales. */
+struct animation_channel_value_t
+{
+    float v[4];
+};
+
+internal u32 animation_channel_components(u8 kind)
+{
+    return kind == ANIMATION_CHANNEL_ROTATION ? 4 : 3;
+}
+
+internal animation_channel_value_t animation_channel_value(const joint_pose_t& pose, u8 kind)
+{
+    animation_channel_value_t value = {};
+    switch(kind)
+    {
+        case ANIMATION_CHANNEL_TRANSLATION:
+        {
+            value.v[0] = pose.translation.x;
+            value.v[1] = pose.translation.y;
+            value.v[2] = pose.translation.z;
+        } break;
+        case ANIMATION_CHANNEL_ROTATION:
+        {
+            value.v[0] = pose.rotation.w;
+            value.v[1] = pose.rotation.x;
+            value.v[2] = pose.rotation.y;
+            value.v[3] = pose.rotation.z;
+        } break;
+        case ANIMATION_CHANNEL_SCALE:
+        {
+            value.v[0] = pose.scale.x;
+            value.v[1] = pose.scale.y;
+            value.v[2] = pose.scale.z;
+        } break;
+    }
+    return value;
+}
+
+/** Same interpolation as animation_sample_compressed: lerp, or nlerp on the shorter arc for rotations */
+internal animation_channel_value_t animation_channel_interpolate(const animation_channel_value_t& a,
+                                                                 const animation_channel_value_t& b,
+                                                                 float ratio, u8 kind)
+{
+    animation_channel_value_t value = {};
+    if(kind != ANIMATION_CHANNEL_ROTATION)
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            value.v[i] = a.v[i] + ratio * (b.v[i] - a.v[i]);
+        }
+        return value;
+    }
+    float sign = a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3] < 0.f ? -1.f : 1.f;
+    float length_squared = 0.f;
+    for(int i = 0; i < 4; ++i)
+    {
+        value.v[i] = a.v[i] + ratio * (b.v[i] * sign - a.v[i]);
+        length_squared += value.v[i] * value.v[i];
+    }
+    float inverse_length = length_squared > 0.f ? 1.f / sqrtf(length_squared) : 0.f;
+    for(int i = 0; i < 4; ++i)
+    {
+        value.v[i] *= inverse_length;
+    }
+    return value;
+}
+
+internal bool animation_channel_within_error(const animation_channel_value_t& a,
+                                             const animation_channel_value_t& b,
+                                             u8 kind, const animation_compression_settings_t& settings)
+{
+    if(kind == ANIMATION_CHANNEL_ROTATION)
+    {
+        // Angle from the chord between the quaternions. acos of their dot can't tell apart
+        // angles under ~1e-3 radians in float.
+        float sign = a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3] < 0.f ? -1.f : 1.f;
+        float chord_squared = 0.f;
+        for(int i = 0; i < 4; ++i)
+        {
+            float d = a.v[i] - b.v[i] * sign;
+            chord_squared += d * d;
+        }
+        float half_chord = min(0.5f * sqrtf(chord_squared), 1.f);
+        return 4.f * asinf(half_chord) <= settings.rotation_error;
+    }
+    float tolerance = kind == ANIMATION_CHANNEL_TRANSLATION ? settings.translation_error : settings.scale_error;
+    for(int i = 0; i < 3; ++i)
+    {
+        if(abs(a.v[i] - b.v[i]) > tolerance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+internal u16 animation_quantize(float value, float minimum, float extent)
+{
+    if(extent <= 0.f)
+    {
+        return 0;
+    }
+    float normalized = clamp((value - minimum) / extent, 0.f, 1.f);
+    return (u16) (normalized * 65535.f + 0.5f);
+}
+
+internal float animation_dequantize(u16 value, float minimum, float extent)
+{
+    return minimum + (float) value * (1.f / 65535.f) * extent;
+}
+
+/** Compresses one channel of one joint from its value at every frame */
+internal void animation_compress_channel(std::vector<animation_channel_value_t>& frames,
+                                         u8 kind,
+                                         const animation_compression_settings_t& settings,
+                                         animation_compressed_clip_t& clip,
+                                         animation_channel_t& channel,
+                                         animation_compression_stats_t& stats)
+{
+    u32 components = animation_channel_components(kind);
+    channel.kind = kind;
+    if(kind == ANIMATION_CHANNEL_ROTATION)
+    {
+        // Keep neighbouring frames on the same hemisphere so the keys interpolate the short way
+        for(size_t f = 1; f < frames.size(); ++f)
+        {
+            const float* a = frames[f - 1].v;
+            float* b = frames[f].v;
+            if(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.f)
+            {
+                for(u32 i = 0; i < 4; ++i)
+                {
+                    b[i] = -b[i];
+                }
+            }
+        }
+    }
+
+    bool b_constant = true;
+    for(size_t f = 1; f < frames.size() && b_constant; ++f)
+    {
+        b_constant = animation_channel_within_error(frames[0], frames[f], kind, settings);
+    }
+    if(b_constant)
+    {
+        for(u32 i = 0; i < components; ++i)
+        {
+            channel.minimum[i] = frames[0].v[i];
+        }
+        channel.keys_count = 0;
+        ++stats.constant_channels;
+        return;
+    }
+
+    // Quantize every frame, then keyframe reduce against the dequantized values
+    std::vector<u16> quantized(frames.size() * components);
+    std::vector<animation_channel_value_t> dequantized(frames.size());
+    if(kind == ANIMATION_CHANNEL_ROTATION)
+    {
+        for(u32 i = 0; i < 4; ++i)
+        {
+            channel.minimum[i] = -1.f;
+        }
+    }
+    else
+    {
+        for(u32 i = 0; i < 3; ++i)
+        {
+            float low = frames[0].v[i];
+            float high = frames[0].v[i];
+            for(const animation_channel_value_t& frame : frames)
+            {
+                low = min(low, frame.v[i]);
+                high = max(high, frame.v[i]);
+            }
+            channel.minimum[i] = low;
+            channel.extent[i] = high - low;
+        }
+    }
+    for(size_t f = 0; f < frames.size(); ++f)
+    {
+        for(u32 i = 0; i < components; ++i)
+        {
+            float extent = kind == ANIMATION_CHANNEL_ROTATION ? 2.f : channel.extent[i];
+            quantized[f * components + i] = animation_quantize(frames[f].v[i], channel.minimum[i], extent);
+            dequantized[f].v[i] = animation_dequantize(quantized[f * components + i], channel.minimum[i], extent);
+        }
+    }
+
+    // Greedy: extend each key span as far as interpolating across it stays within the error bound
+    std::vector<u16> keys;
+    u32 last = (u32) frames.size() - 1;
+    u32 start = 0;
+    keys.push_back(0);
+    while(start < last)
+    {
+        u32 end = start + 1;
+        for(u32 candidate = end + 1; candidate <= last; ++candidate)
+        {
+            bool b_within_error = true;
+            for(u32 f = start + 1; f < candidate && b_within_error; ++f)
+            {
+                float ratio = (float) (f - start) / (float) (candidate - start);
+                animation_channel_value_t value = animation_channel_interpolate(dequantized[start], dequantized[candidate], ratio, kind);
+                b_within_error = animation_channel_within_error(value, frames[f], kind, settings);
+            }
+            if(!b_within_error)
+            {
+                break;
+            }
+            end = candidate;
+        }
+        keys.push_back((u16) end);
+        start = end;
+    }
+
+    channel.data_offset = (u32) clip.data.size();
+    channel.keys_count = (u16) keys.size();
+    clip.data.insert(clip.data.end(), keys.begin(), keys.end());
+    for(u16 key : keys)
+    {
+        for(u32 i = 0; i < components; ++i)
+        {
+            clip.data.push_back(quantized[key * components + i]);
+        }
+    }
+    ++stats.animated_channels;
+    stats.frames += (u32) frames.size();
+    stats.keys += (u32) keys.size();
+}
+
+/** Clips are usually baked at a fixed rate. Resampling at that rate puts a frame on every
+    source key, so interpolating the frames is exactly interpolating the source. */
+internal float animation_source_sample_rate(const animation_clip_t& clip)
+{
+    float shortest_interval = 0.f;
+    auto check_times = [&shortest_interval](const std::vector<float>& times)
+    {
+        for(size_t k = 1; k < times.size(); ++k)
+        {
+            float interval = times[k] - times[k - 1];
+            if(interval > 0.f && (shortest_interval == 0.f || interval < shortest_interval))
+            {
+                shortest_interval = interval;
+            }
+        }
+    };
+    for(const animation_track_t& track : clip.tracks)
+    {
+        check_times(track.translation_times);
+        check_times(track.rotation_times);
+        check_times(track.scale_times);
+    }
+    if(shortest_interval == 0.f)
+    {
+        return ANIMATION_SAMPLE_RATE;
+    }
+    // Round to a whole rate so frames don't drift off keys like 1/30 that aren't exact in float
+    float rate = floorf(1.f / shortest_interval + 0.5f);
+    return clamp(rate, 1.f, ANIMATION_MAX_SAMPLE_RATE);
+}
+
+void animation_compress(const skeleton_t& skeleton,
+                        const animation_clip_t& clip,
+                        const animation_compression_settings_t& settings,
+                        animation_compressed_clip_t& out_clip,
+                        animation_compression_stats_t* stats)
+{
+    u32 joints_count = (u32) skeleton.parents.size();
+    out_clip = animation_compressed_clip_t();
+    out_clip.name = clip.name;
+    out_clip.duration = max(clip.duration, 0.f);
+    out_clip.sample_rate = animation_source_sample_rate(clip);
+    out_clip.frames_count = (u32) ceilf(out_clip.duration * out_clip.sample_rate - 0.001f) + 1;
+    out_clip.frames_count = min(max(out_clip.frames_count, 1u), (u32) ANIMATION_MAX_FRAMES);
+    out_clip.joints_count = joints_count;
+    out_clip.channels.resize(joints_count * 3);
+
+    // Resample the whole clip, frame by frame
+    std::vector<joint_pose_t> poses((size_t) out_clip.frames_count * joints_count);
+    for(u32 f = 0; f < out_clip.frames_count; ++f)
+    {
+        joint_pose_t* pose = &poses[(size_t) f * joints_count];
+        for(u32 j = 0; j < joints_count; ++j)
+        {
+            pose[j] = skeleton.rest_pose[j];
+        }
+        animation_sample_at(clip, min((float) f / out_clip.sample_rate, out_clip.duration), pose);
+    }
+
+    animation_compression_stats_t clip_stats;
+    std::vector<animation_channel_value_t> frames(out_clip.frames_count);
+    for(u32 j = 0; j < joints_count; ++j)
+    {
+        for(u8 kind = ANIMATION_CHANNEL_TRANSLATION; kind <= ANIMATION_CHANNEL_SCALE; ++kind)
+        {
+            for(u32 f = 0; f < out_clip.frames_count; ++f)
+            {
+                frames[f] = animation_channel_value(poses[(size_t) f * joints_count + j], kind);
+            }
+            animation_compress_channel(frames, kind, settings, out_clip, out_clip.channels[j * 3 + kind], clip_stats);
+        }
+    }
+    out_clip.data.shrink_to_fit();
+
+    if(stats)
+    {
+        for(const animation_track_t& track : clip.tracks)
+        {
+            clip_stats.source_bytes += (u32) (track.translation_times.size() + track.rotation_times.size() + track.scale_times.size()) * sizeof(float);
+            clip_stats.source_bytes += (u32) (track.translations.size() + track.scales.size()) * sizeof(vec3);
+            clip_stats.source_bytes += (u32) track.rotations.size() * sizeof(quaternion);
+        }
+        clip_stats.compressed_bytes = (u32) (out_clip.channels.size() * sizeof(animation_channel_t) + out_clip.data.size() * sizeof(u16));
+        *stats = clip_stats;
+    }
+}
+
+/** Values of channel at the keys around frame and how far frame is between them */
+internal void animation_decode_channel(const animation_compressed_clip_t& clip,
+                                       const animation_channel_t& channel,
+                                       float frame,
+                                       float* a, float* b, float& ratio)
+{
+    u32 components = animation_channel_components(channel.kind);
+    if(channel.keys_count == 0)
+    {
+        for(u32 i = 0; i < components; ++i)
+        {
+            a[i] = channel.minimum[i];
+            b[i] = channel.minimum[i];
+        }
+        ratio = 0.f;
+        return;
+    }
+
+    // Binary search for the last key at or before frame
+    const u16* key_frames = &clip.data[channel.data_offset];
+    const u16* key_values = key_frames + channel.keys_count;
+    u32 low = 0;
+    u32 high = channel.keys_count - 1u;
+    while(low < high)
+    {
+        u32 middle = (low + high + 1) / 2;
+        if((float) key_frames[middle] <= frame)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    u32 next = min(low + 1, channel.keys_count - 1u);
+    float span = (float) key_frames[next] - (float) key_frames[low];
+    ratio = span > 0.f ? (frame - (float) key_frames[low]) / span : 0.f;
+
+    const u16* value_a = key_values + low * components;
+    const u16* value_b = key_values + next * components;
+    if(channel.kind == ANIMATION_CHANNEL_ROTATION)
+    {
+        for(u32 i = 0; i < 4; ++i)
+        {
+            a[i] = animation_dequantize(value_a[i], -1.f, 2.f);
+            b[i] = animation_dequantize(value_b[i], -1.f, 2.f);
+        }
+    }
+    else
+    {
+        for(u32 i = 0; i < 3; ++i)
+        {
+            a[i] = animation_dequantize(value_a[i], channel.minimum[i], channel.extent[i]);
+            b[i] = animation_dequantize(value_b[i], channel.minimum[i], channel.extent[i]);
+        }
+    }
+}
+
+void animation_sample_compressed(const animation_compressed_clip_t& clip, float time, animation_soa_joints_t* pose)
+{
+    if(clip.duration > 0.f)
+    {
+        time = fmodf(time, clip.duration);
+        time = time < 0.f ? time + clip.duration : time;
+    }
+    float frame = min(max(time * clip.sample_rate, 0.f), (float) (clip.frames_count - 1));
+
+    // Keys around frame for 4 joints in SoA, then interpolated 4 at a time
+    float translation_a[3][ANIMATION_SOA_WIDTH], translation_b[3][ANIMATION_SOA_WIDTH], translation_ratio[ANIMATION_SOA_WIDTH];
+    float rotation_a[4][ANIMATION_SOA_WIDTH], rotation_b[4][ANIMATION_SOA_WIDTH], rotation_ratio[ANIMATION_SOA_WIDTH];
+    float scale_a[3][ANIMATION_SOA_WIDTH], scale_b[3][ANIMATION_SOA_WIDTH], scale_ratio[ANIMATION_SOA_WIDTH];
+    u32 groups_count = animation_soa_count(clip.joints_count);
+    for(u32 group = 0; group < groups_count; ++group)
+    {
+        for(u32 lane = 0; lane < ANIMATION_SOA_WIDTH; ++lane)
+        {
+            u32 joint = group * ANIMATION_SOA_WIDTH + lane;
+            float a[4], b[4];
+            if(joint < clip.joints_count)
+            {
+                const animation_channel_t* channels = &clip.channels[joint * 3];
+                animation_decode_channel(clip, channels[ANIMATION_CHANNEL_TRANSLATION], frame, a, b, translation_ratio[lane]);
+                for(u32 i = 0; i < 3; ++i)
+                {
+                    translation_a[i][lane] = a[i];
+                    translation_b[i][lane] = b[i];
+                }
+                animation_decode_channel(clip, channels[ANIMATION_CHANNEL_ROTATION], frame, a, b, rotation_ratio[lane]);
+                for(u32 i = 0; i < 4; ++i)
+                {
+                    rotation_a[i][lane] = a[i];
+                    rotation_b[i][lane] = b[i];
+                }
+                animation_decode_channel(clip, channels[ANIMATION_CHANNEL_SCALE], frame, a, b, scale_ratio[lane]);
+                for(u32 i = 0; i < 3; ++i)
+                {
+                    scale_a[i][lane] = a[i];
+                    scale_b[i][lane] = b[i];
+                }
+            }
+            else
+            {
+                for(u32 i = 0; i < 3; ++i)
+                {
+                    translation_a[i][lane] = translation_b[i][lane] = 0.f;
+                    scale_a[i][lane] = scale_b[i][lane] = 1.f;
+                }
+                for(u32 i = 0; i < 4; ++i)
+                {
+                    rotation_a[i][lane] = rotation_b[i][lane] = i == 0 ? 1.f : 0.f;
+                }
+                translation_ratio[lane] = rotation_ratio[lane] = scale_ratio[lane] = 0.f;
+            }
+        }
+
+        animation_soa_joints_t& joints = pose[group];
+        joints.translation = lerp(load_vec3_wide(translation_a[0], translation_a[1], translation_a[2]),
+                                  load_vec3_wide(translation_b[0], translation_b[1], translation_b[2]),
+                                  _mm_loadu_ps(translation_ratio));
+        joints.rotation = nlerp(load_quaternion_wide(rotation_a[0], rotation_a[1], rotation_a[2], rotation_a[3]),
+                                load_quaternion_wide(rotation_b[0], rotation_b[1], rotation_b[2], rotation_b[3]),
+                                _mm_loadu_ps(rotation_ratio));
+        joints.scale = lerp(load_vec3_wide(scale_a[0], scale_a[1], scale_a[2]),
+                            load_vec3_wide(scale_b[0], scale_b[1], scale_b[2]),
+                            _mm_loadu_ps(scale_ratio));
+    }
+}
+
+void animation_blend(const animation_soa_joints_t* a, const animation_soa_joints_t* b, u32 count, float weight, animation_soa_joints_t* out)
+{
+    __m128 ratio = _mm_set1_ps(weight);
+    for(u32 i = 0; i < count; ++i)
+    {
+        animation_soa_joints_t blended;
+        blended.translation = lerp(a[i].translation, b[i].translation, ratio);
+        blended.rotation = nlerp(a[i].rotation, b[i].rotation, ratio);
+        blended.scale = lerp(a[i].scale, b[i].scale, ratio);
+        out[i] = blended;
+    }
+}
+
+void animation_model_matrices(const skeleton_t& skeleton, const animation_soa_joints_t* pose, mat4* out_matrices)
+{
+    u32 joints_count = (u32) skeleton.parents.size();
+    u32 groups_count = animation_soa_count(joints_count);
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 two = _mm_set1_ps(2.f);
+    for(u32 group = 0; group < groups_count; ++group)
+    {
+        // Local TRS matrices of 4 joints (same as animation_pose_matrix)
+        const animation_soa_joints_t& joints = pose[group];
+        const quaternion_wide& q = joints.rotation;
+        __m128 xx = _mm_mul_ps(q.x, q.x), yy = _mm_mul_ps(q.y, q.y), zz = _mm_mul_ps(q.z, q.z);
+        __m128 xy = _mm_mul_ps(q.x, q.y), xz = _mm_mul_ps(q.x, q.z), yz = _mm_mul_ps(q.y, q.z);
+        __m128 wx = _mm_mul_ps(q.w, q.x), wy = _mm_mul_ps(q.w, q.y), wz = _mm_mul_ps(q.w, q.z);
+        float local[12][ANIMATION_SOA_WIDTH];   // columns 0 1 2 (xyz each), then the translation
+        _mm_storeu_ps(local[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), joints.scale.x));
+        _mm_storeu_ps(local[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), joints.scale.x));
+        _mm_storeu_ps(local[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), joints.scale.x));
+        _mm_storeu_ps(local[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), joints.scale.y));
+        _mm_storeu_ps(local[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), joints.scale.y));
+        _mm_storeu_ps(local[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), joints.scale.y));
+        _mm_storeu_ps(local[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), joints.scale.z));
+        _mm_storeu_ps(local[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), joints.scale.z));
+        _mm_storeu_ps(local[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), joints.scale.z));
+        _mm_storeu_ps(local[9], joints.translation.x);
+        _mm_storeu_ps(local[10], joints.translation.y);
+        _mm_storeu_ps(local[11], joints.translation.z);
+
+        // Parents come first, so their model matrices are done. parent * local one column at a time.
+        for(u32 lane = 0; lane < ANIMATION_SOA_WIDTH; ++lane)
+        {
+            u32 joint = group * ANIMATION_SOA_WIDTH + lane;
+            if(joint >= joints_count)
+            {
+                break;
+            }
+            mat4& out = out_matrices[joint];
+            i32 parent = skeleton.parents[joint];
+            if(parent < 0)
+            {
+                for(int col = 0; col < 4; ++col)
+                {
+                    out[col][0] = local[col * 3 + 0][lane];
+                    out[col][1] = local[col * 3 + 1][lane];
+                    out[col][2] = local[col * 3 + 2][lane];
+                    out[col][3] = col == 3 ? 1.f : 0.f;
+                }
+                continue;
+            }
+            const mat4& parent_matrix = out_matrices[parent];
+            __m128 parent_columns[4] = { _mm_loadu_ps(&parent_matrix[0][0]), _mm_loadu_ps(&parent_matrix[1][0]),
+                                         _mm_loadu_ps(&parent_matrix[2][0]), _mm_loadu_ps(&parent_matrix[3][0]) };
+            for(int col = 0; col < 4; ++col)
+            {
+                __m128 column = _mm_mul_ps(parent_columns[0], _mm_set1_ps(local[col * 3 + 0][lane]));
+                column = _mm_add_ps(column, _mm_mul_ps(parent_columns[1], _mm_set1_ps(local[col * 3 + 1][lane])));
+                column = _mm_add_ps(column, _mm_mul_ps(parent_columns[2], _mm_set1_ps(local[col * 3 + 2][lane])));
+                if(col == 3)
+                {
+                    column = _mm_add_ps(column, parent_columns[3]);
+                }
+                _mm_storeu_ps(&out[col][0], column);
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+#include "animation.h"
+
+/**
+    ANIMATION COMPRESSED - quantized, keyframe reduced clips sampled 4 joints at a time
+
+    animation_compress resamples an imported clip (animation.h) at the rate of its closest
+    keys (at most ANIMATION_MAX_SAMPLE_RATE), so frames land on the keys of clips baked at a
+    fixed rate, and stores every joint as 3 channels (translation, rotation, scale):
+        -   Channels that stay within the error bound of their first frame are constant and
+            keep a single full precision value.
+        -   Other channels are quantized to 16 bits per component (translation and scale over
+            the range of the channel, rotations as snorm16 on one hemisphere) and keyframe
+            reduced: a frame is only kept as a key if lerping (nlerp for rotations) between
+            the keys around it would be further than the error bound from the source at any
+            frame in between.
+    The errors are bounded per joint in its local space. Keys of a clip are in one contiguous
+    array of u16 (frame numbers and then values per channel), so a clip is a couple of small
+    allocations no matter how many joints it has.
+
+    Poses are SoA: animation_soa_joints_t holds 4 joints, one SSE register per component
+    (kc_math vec3_wide / quaternion_wide). Sampling decodes the keys around the sample time
+    and interpolates 4 joints per instruction, blending and the conversion to model space
+    matrices are SIMD too. Everything here is thread safe, so many characters can be posed on
+    the worker pool at once with a scratch pose per thread.
+*/
+
+#define ANIMATION_SAMPLE_RATE 30.f              // frames per second clips without keys are resampled at
+#define ANIMATION_MAX_SAMPLE_RATE 120.f         // resample rate limit for clips with closely spaced keys
+#define ANIMATION_SOA_WIDTH 4                   // joints per animation_soa_joints_t
+
+struct animation_compression_settings_t
+{
+    float translation_error = 0.0005f;          // units, per component
+    float rotation_error = 0.001f;              // radians
+    float scale_error = 0.0005f;                // per component
+};
+
+enum animation_channel_kind_t : u8
+{
+    ANIMATION_CHANNEL_TRANSLATION,
+    ANIMATION_CHANNEL_ROTATION,
+    ANIMATION_CHANNEL_SCALE
+};
+
+struct animation_channel_t
+{
+    u32     data_offset = 0;                    // into animation_compressed_clip_t::data
+    u16     keys_count = 0;                     // 0 if the channel is constant
+    u8      kind = ANIMATION_CHANNEL_TRANSLATION;
+    u8      pad = 0;
+    float   minimum[4] = {};                    // constant value (w x y z for rotations), or the range
+    float   extent[3] = {};                     // of quantized translations and scales
+};
+
+struct animation_compressed_clip_t
+{
+    std::string                         name;
+    float                               duration = 0.f;     // seconds
+    float                               sample_rate = ANIMATION_SAMPLE_RATE;
+    u32                                 frames_count = 0;
+    u32                                 joints_count = 0;
+    std::vector<animation_channel_t>    channels;           // 3 per joint: translation, rotation, scale
+    std::vector<u16>                    data;               // per animated channel: key frames then key values
+};
+
+/** 4 joints of a pose. Joints past the end of the skeleton are padding with the identity pose. */
+struct animation_soa_joints_t
+{
+    vec3_wide           translation;
+    quaternion_wide     rotation;
+    vec3_wide           scale;
+};
+
+struct animation_compression_stats_t
+{
+    u32     source_bytes = 0;
+    u32     compressed_bytes = 0;
+    u32     constant_channels = 0;
+    u32     animated_channels = 0;
+    u32     frames = 0;             // of every animated channel together
+    u32     keys = 0;               // kept of those frames
+};
+
+/** Number of animation_soa_joints_t a pose of joints_count joints needs */
+inline u32 animation_soa_count(u32 joints_count)
+{
+    return (joints_count + ANIMATION_SOA_WIDTH - 1) / ANIMATION_SOA_WIDTH;
+}
+
+/** Compresses clip for skeleton into out_clip. stats is optional. */
+void animation_compress(const skeleton_t& skeleton,
+                        const animation_clip_t& clip,
+                        const animation_compression_settings_t& settings,
+                        animation_compressed_clip_t& out_clip,
+                        animation_compression_stats_t* stats = nullptr);
+
+/** Samples clip at time seconds (wrapped into the clip) into pose, which has
+    animation_soa_count(clip.joints_count) entries. Every joint is written. */
+void animation_sample_compressed(const animation_compressed_clip_t& clip, float time, animation_soa_joints_t* pose);
+
+/** Blends pose a towards pose b by weight (0 is a, 1 is b) into out, which may be a or b.
+    count is the number of animation_soa_joints_t. */
+void animation_blend(const animation_soa_joints_t* a, const animation_soa_joints_t* b, u32 count, float weight, animation_soa_joints_t* out);
+
+/** Model space matrix of every joint of skeleton in pose. out_matrices has a matrix per joint. */
+void animation_model_matrices(const skeleton_t& skeleton, const animation_soa_joints_t* pose, mat4* out_matrices);
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <GL/glew.h>
+
+#include "frame_constants.h"
+
+static_assert(sizeof(view_constants_t) == 144, "view_constants_t must match the std140 view_constants block");
+static_assert(sizeof(light_constants_t) == 96, "light_constants_t must match the std140 light_constants block");
+static_assert(sizeof(omni_shadow_constants_t) == 400, "omni_shadow_constants_t must match the std140 omni_shadow_constants block");
+
+struct frame_constants_block_t
+{
+    const char* name;
+    u32         binding;
+};
+
+internal const frame_constants_block_t frame_constants_blocks[] = {
+    { "view_constants", FRAME_CONSTANTS_VIEW_BINDING },
+    { "light_constants", FRAME_CONSTANTS_LIGHT_BINDING },
+    { "omni_shadow_constants", FRAME_CONSTANTS_OMNI_SHADOW_BINDING },
+};
+
+internal u32 view_buffer = 0;
+internal u32 light_buffer = 0;
+internal u32 omni_shadow_buffer = 0;
+internal u32 omni_shadow_capacity = 0;      // slices
+internal u32 omni_shadow_stride = 0;        // bytes between slices, a multiple of the offset alignment
+
+internal u32 frame_constants_create_buffer(GLsizeiptr size)
+{
+    u32 buffer = 0;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    return buffer;
+}
+
+void frame_constants_initialize()
+{
+    if(view_buffer)
+    {
+        return;
+    }
+
+    GLint offset_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    omni_shadow_stride = ((u32) sizeof(omni_shadow_constants_t) + offset_alignment - 1) / offset_alignment * offset_alignment;
+
+    view_buffer = frame_constants_create_buffer(sizeof(view_constants_t));
+    light_buffer = frame_constants_create_buffer(sizeof(light_constants_t));
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_VIEW_BINDING, view_buffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_LIGHT_BINDING, light_buffer);
+}
+
+void frame_constants_clean_up()
+{
+    glDeleteBuffers(1, &view_buffer);
+    glDeleteBuffers(1, &light_buffer);
+    glDeleteBuffers(1, &omni_shadow_buffer);
+    view_buffer = 0;
+    light_buffer = 0;
+    omni_shadow_buffer = 0;
+    omni_shadow_capacity = 0;
+}
+
+void frame_constants_bind_blocks(u32 id_shader_program)
+{
+    for(const frame_constants_block_t& block : frame_constants_blocks)
+    {
+        GLuint block_index = glGetUniformBlockIndex(id_shader_program, block.name);
+        if(block_index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(id_shader_program, block_index, block.binding);
+        }
+    }
+}
+
+void frame_constants_update_view(const view_constants_t& view)
+{
+    glNamedBufferSubData(view_buffer, 0, sizeof(view_constants_t), &view);
+}
+
+void frame_constants_update_lights(const light_constants_t& lights)
+{
+    glNamedBufferSubData(light_buffer, 0, sizeof(light_constants_t), &lights);
+}
+
+void frame_constants_update_omni_shadows(const omni_shadow_constants_t* shadows, u32 count)
+{
+    if(count > omni_shadow_capacity)
+    {
+        // Immutable storage can't be resized, the slices are all rewritten below anyway
+        glDeleteBuffers(1, &omni_shadow_buffer);
+        omni_shadow_capacity = count;
+        omni_shadow_buffer = frame_constants_create_buffer((GLsizeiptr) omni_shadow_stride * omni_shadow_capacity);
+    }
+    for(u32 shadow_index = 0; shadow_index < count; ++shadow_index)
+    {
+        glNamedBufferSubData(omni_shadow_buffer, (GLintptr) omni_shadow_stride * shadow_index,
+                             sizeof(omni_shadow_constants_t), &shadows[shadow_index]);
+    }
+}
+
+void frame_constants_bind_omni_shadow(u32 index)
+{
+    if(index < omni_shadow_capacity)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_OMNI_SHADOW_BINDING, omni_shadow_buffer,
+                          (GLintptr) omni_shadow_stride * index, sizeof(omni_shadow_constants_t));
+    }
+}
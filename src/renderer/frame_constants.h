@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+
+/**
+    FRAME CONSTANTS - std140 uniform blocks shared by every shader
+
+    The camera, the directional light, and the omni shadow transforms are the same for every
+    draw of a pass, so instead of binding them as uniforms on each shader they live in uniform
+    buffers that render_manager fills once a frame, before the shadow passes:
+
+        view_constants          binding 0   view and projection matrices, eye position
+        light_constants         binding 1   directional light and its shadow transform
+        omni_shadow_constants   binding 2   cube face transforms, position, and far plane of
+                                            the light whose shadow is being drawn
+
+    A shader uses a block by declaring it with the same members as the mirror struct below, e.g.
+
+        layout(std140) uniform view_constants
+        {
+            mat4 matrix_view;
+            mat4 matrix_proj_perspective;
+            vec3 eye_position;
+        };
+
+    and shader_t points the block at its binding after linking (frame_constants_bind_blocks),
+    so no shader has to set anything. Every omni shadow gets its own slice of one buffer; the
+    omni shadow pass selects the slice of the light it draws with frame_constants_bind_omni_shadow.
+
+    Passes that draw from another view (the impostor bake) overwrite view_constants with theirs;
+    the next frame_constants_update_view puts the camera back.
+*/
+
+#define FRAME_CONSTANTS_VIEW_BINDING 0
+#define FRAME_CONSTANTS_LIGHT_BINDING 1
+#define FRAME_CONSTANTS_OMNI_SHADOW_BINDING 2
+
+/** Mirror of the view_constants block */
+struct view_constants_t
+{
+    mat4    matrix_view;
+    mat4    matrix_proj_perspective;
+    vec3    eye_position;               // world space
+    float   padding = 0.f;
+};
+
+/** Mirror of directional_light_t in the light_constants block, ordered so std140 packs it */
+struct directional_light_constants_t
+{
+    vec3    colour;
+    float   ambient_intensity = 0.f;
+    vec3    direction;
+    float   diffuse_intensity = 0.f;
+};
+
+/** Mirror of the light_constants block */
+struct light_constants_t
+{
+    mat4                            directional_light_transform;   // ortho projection * view of the directional light
+    directional_light_constants_t   directional_light;
+};
+
+/** Mirror of the omni_shadow_constants block */
+struct omni_shadow_constants_t
+{
+    mat4    light_matrices[6];          // projection * view of each cube face
+    vec3    light_position;
+    float   far_plane = 0.f;
+};
+
+/** Creates the buffers and binds them. Needs a GL context. */
+void frame_constants_initialize();
+
+void frame_constants_clean_up();
+
+/** Points the blocks a linked program declares at their bindings */
+void frame_constants_bind_blocks(u32 id_shader_program);
+
+void frame_constants_update_view(const view_constants_t& view);
+
+void frame_constants_update_lights(const light_constants_t& lights);
+
+/** One slice per omni shadow map, the buffer grows if there are more than last time */
+void frame_constants_update_omni_shadows(const omni_shadow_constants_t* shadows, u32 count);
+
+/** Binds the slice of shadow index to omni_shadow_constants */
+void frame_constants_bind_omni_shadow(u32 index);
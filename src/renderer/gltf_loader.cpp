@@ -0,0 +1,823 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+
+#include "gltf_loader.h"
+#include "mesh_merge.h"
+#include "../core/json.h"
+#include "../core/kc_math.h"
+#include "../core/file_system.h"
+#include "../debugging/console.h"
+
+#define GLTF_GLB_MAGIC          0x46546c67  // 'glTF'
+#define GLTF_GLB_CHUNK_JSON     0x4e4f534a  // 'JSON'
+#define GLTF_GLB_CHUNK_BIN      0x004e4942  // 'BIN\0'
+#define GLTF_MAX_NODE_DEPTH     64          // glTF forbids cycles, this catches broken files that have them
+
+enum gltf_primitive_mode_t
+{
+    GLTF_MODE_POINTS = 0,
+    GLTF_MODE_LINES = 1,
+    GLTF_MODE_LINE_LOOP = 2,
+    GLTF_MODE_LINE_STRIP = 3,
+    GLTF_MODE_TRIANGLES = 4,
+    GLTF_MODE_TRIANGLE_STRIP = 5,
+    GLTF_MODE_TRIANGLE_FAN = 6
+};
+
+struct gltf_buffer_t
+{
+    const u8*   data = nullptr;
+    u64         size = 0;
+};
+
+struct gltf_buffer_view_t
+{
+    const u8*   data = nullptr;
+    u64         size = 0;
+    u32         stride = 0;             // 0 if the elements are tightly packed
+    bool        b_uploaded = false;     // has a range in the GPU buffer
+    u64         gpu_offset = 0;
+};
+
+/** An accessor resolved down to the mapped memory it reads */
+struct gltf_accessor_t
+{
+    const u8*   data = nullptr;         // first element
+    u32         view = 0;
+    u64         offset_in_view = 0;
+    u32         count = 0;
+    u32         components = 0;
+    GLenum      component_type = GL_FLOAT;  // glTF component types are the GL enums
+    u32         component_size = 4;
+    bool        b_normalized = false;
+    u32         stride = 0;             // bytes between elements
+    bool        b_bounds = false;
+    float       min[3] = { 0.f, 0.f, 0.f };
+    float       max[3] = { 0.f, 0.f, 0.f };
+};
+
+struct gltf_context_t
+{
+    gltf_model_t*                   model = nullptr;
+    const char*                     file_name = nullptr;
+    std::string                     directory;
+    json_value_t                    document;
+    std::vector<gltf_buffer_t>      buffers;
+    std::vector<gltf_buffer_view_t> views;
+    u32                             default_material = 0;
+    gltf_load_stats_t               stats;
+};
+
+internal std::string gltf_directory(const char* file_name)
+{
+    std::string directory = file_name;
+    size_t separator = directory.find_last_of("/\\");
+    return separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
+}
+
+/** URIs in glTF are percent encoded, e.g. spaces are %20 */
+internal std::string gltf_decode_uri(const char* uri)
+{
+    std::string decoded;
+    for(const char* c = uri; *c; ++c)
+    {
+        if(c[0] == '%' && isxdigit((u8) c[1]) && isxdigit((u8) c[2]))
+        {
+            char hex[3] = { c[1], c[2], '\0' };
+            decoded += (char) strtol(hex, nullptr, 16);
+            c += 2;
+        }
+        else
+        {
+            decoded += *c;
+        }
+    }
+    return decoded;
+}
+
+internal bool gltf_map(gltf_context_t& context, const std::string& path, gltf_buffer_t& out_buffer)
+{
+    mapped_file_handle_t file;
+    map_file_readonly(file, path.c_str());
+    if(file.memory == nullptr)
+    {
+        console_printf("glTF: couldn't open '%s'\n", path.c_str());
+        return false;
+    }
+    context.model->files.push_back(file);
+    out_buffer.data = (const u8*) file.memory;
+    out_buffer.size = file.size;
+    return true;
+}
+
+/** An index into one of the arrays of the document, (size_t) -1 if value isn't one */
+internal size_t gltf_index(const json_value_t* value)
+{
+    double index = json_number(value, -1.0);
+    return index >= 0.0 ? (size_t) index : (size_t) -1;
+}
+
+internal u32 gltf_component_size(GLenum component_type)
+{
+    switch(component_type)
+    {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+    }
+    return 0;
+}
+
+internal u32 gltf_type_components(const char* type)
+{
+    if(strcmp(type, "SCALAR") == 0) return 1;
+    if(strcmp(type, "VEC2") == 0) return 2;
+    if(strcmp(type, "VEC3") == 0) return 3;
+    if(strcmp(type, "VEC4") == 0) return 4;
+    return 0; // matrices aren't used by anything we read
+}
+
+/** Integer components of normalized accessors map to [0, 1] or [-1, 1] */
+internal float gltf_normalize(double value, GLenum component_type, bool b_normalized)
+{
+    if(!b_normalized)
+    {
+        return (float) value;
+    }
+    switch(component_type)
+    {
+        case GL_BYTE: return max((float) value / 127.f, -1.f);
+        case GL_UNSIGNED_BYTE: return (float) value / 255.f;
+        case GL_SHORT: return max((float) value / 32767.f, -1.f);
+        case GL_UNSIGNED_SHORT: return (float) value / 65535.f;
+    }
+    return (float) value;
+}
+
+internal float gltf_read_float(const gltf_accessor_t& accessor, u32 element, u32 component)
+{
+    const u8* p = accessor.data + (size_t) element * accessor.stride + (size_t) component * accessor.component_size;
+    switch(accessor.component_type)
+    {
+        case GL_FLOAT: { float v; memcpy(&v, p, sizeof(v)); return v; }
+        case GL_BYTE: return gltf_normalize((double) (i8) *p, GL_BYTE, accessor.b_normalized);
+        case GL_UNSIGNED_BYTE: return gltf_normalize((double) *p, GL_UNSIGNED_BYTE, accessor.b_normalized);
+        case GL_SHORT: { i16 v; memcpy(&v, p, sizeof(v)); return gltf_normalize((double) v, GL_SHORT, accessor.b_normalized); }
+        case GL_UNSIGNED_SHORT: { u16 v; memcpy(&v, p, sizeof(v)); return gltf_normalize((double) v, GL_UNSIGNED_SHORT, accessor.b_normalized); }
+        case GL_UNSIGNED_INT: { u32 v; memcpy(&v, p, sizeof(v)); return (float) v; }
+    }
+    return 0.f;
+}
+
+internal u32 gltf_read_index(const gltf_accessor_t& accessor, u32 element)
+{
+    const u8* p = accessor.data + (size_t) element * accessor.stride;
+    switch(accessor.component_type)
+    {
+        case GL_UNSIGNED_BYTE: return *p;
+        case GL_UNSIGNED_SHORT: { u16 v; memcpy(&v, p, sizeof(v)); return v; }
+        case GL_UNSIGNED_INT: { u32 v; memcpy(&v, p, sizeof(v)); return v; }
+    }
+    return 0;
+}
+
+/** Resolves and bounds checks an accessor. Returns false for sparse accessors and accessors
+    without a buffer view, which only the CPU path could handle, and for broken ones. */
+internal bool gltf_get_accessor(const gltf_context_t& context, const json_value_t* index, gltf_accessor_t& out_accessor)
+{
+    const json_value_t* accessors = context.document.find("accessors");
+    const json_value_t* accessor = index && accessors ? accessors->at(gltf_index(index)) : nullptr;
+    if(accessor == nullptr || accessor->find("sparse"))
+    {
+        return false;
+    }
+    double view_index = json_number(accessor->find("bufferView"), -1.0);
+    if(view_index < 0.0 || view_index >= (double) context.views.size())
+    {
+        return false;
+    }
+
+    gltf_accessor_t& a = out_accessor;
+    const gltf_buffer_view_t& view = context.views[(size_t) view_index];
+    a.view = (u32) view_index;
+    a.offset_in_view = (u64) json_number(accessor->find("byteOffset"), 0.0);
+    a.count = (u32) json_number(accessor->find("count"), 0.0);
+    a.components = gltf_type_components(json_string(accessor->find("type")));
+    a.component_type = (GLenum) json_number(accessor->find("componentType"), 0.0);
+    a.component_size = gltf_component_size(a.component_type);
+    a.b_normalized = json_bool(accessor->find("normalized"));
+    if(a.components == 0 || a.component_size == 0)
+    {
+        return false;
+    }
+    u32 element_size = a.components * a.component_size;
+    a.stride = view.stride ? view.stride : element_size;
+    if(a.count > 0 && a.offset_in_view + (u64) a.stride * (a.count - 1) + element_size > view.size)
+    {
+        return false;
+    }
+    a.data = view.data + a.offset_in_view;
+
+    const json_value_t* min_values = accessor->find("min");
+    const json_value_t* max_values = accessor->find("max");
+    a.b_bounds = min_values && max_values && min_values->size() >= 3 && max_values->size() >= 3;
+    for(u32 axis = 0; a.b_bounds && axis < 3; ++axis)
+    {
+        a.min[axis] = gltf_normalize(json_number(min_values->at(axis)), a.component_type, a.b_normalized);
+        a.max[axis] = gltf_normalize(json_number(max_values->at(axis)), a.component_type, a.b_normalized);
+    }
+    return true;
+}
+
+internal mat4 gltf_node_matrix(const json_value_t& node)
+{
+    const json_value_t* matrix = node.find("matrix");
+    if(matrix && matrix->size() == 16)
+    {
+        mat4 m; // glTF matrices are column major like ours
+        for(int col = 0; col < 4; ++col)
+        {
+            for(int row = 0; row < 4; ++row)
+            {
+                m[col][row] = (float) json_number(matrix->at(col * 4 + row));
+            }
+        }
+        return m;
+    }
+
+    const json_value_t* t = node.find("translation");
+    const json_value_t* r = node.find("rotation");
+    const json_value_t* s = node.find("scale");
+    mat4 m = identity_mat4();
+    if(t && t->size() == 3)
+    {
+        m = translation_matrix((float) json_number(t->at(0)), (float) json_number(t->at(1)), (float) json_number(t->at(2)));
+    }
+    if(r && r->size() == 4)
+    {
+        // glTF stores quaternions as x y z w
+        quaternion q = make_quaternion((float) json_number(r->at(3), 1.0), (float) json_number(r->at(0)),
+                                       (float) json_number(r->at(1)), (float) json_number(r->at(2)));
+        m = m * rotation_matrix(normalize(q));
+    }
+    if(s && s->size() == 3)
+    {
+        m = m * scale_matrix((float) json_number(s->at(0), 1.0), (float) json_number(s->at(1), 1.0), (float) json_number(s->at(2), 1.0));
+    }
+    return m;
+}
+
+/** True if m only translates and scales uniformly by a positive amount, which the position
+    scale and offset of a mesh can do without touching normals or winding */
+internal bool gltf_is_translate_scale(const mat4& m, float& out_scale)
+{
+    float scale = m[0][0];
+    float tolerance = 1e-5f * fabsf(scale);
+    if(scale <= 0.f || fabsf(m[1][1] - scale) > tolerance || fabsf(m[2][2] - scale) > tolerance)
+    {
+        return false;
+    }
+    for(int col = 0; col < 3; ++col)
+    {
+        for(int row = 0; row < 3; ++row)
+        {
+            if(row != col && fabsf(m[col][row]) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    out_scale = scale;
+    return true;
+}
+
+/** Offset of the view in the GPU buffer. Views get a range the first time a mesh needs them. */
+internal u64 gltf_upload_view(gltf_context_t& context, u32 view_index)
+{
+    gltf_buffer_view_t& view = context.views[view_index];
+    if(!view.b_uploaded)
+    {
+        gltf_model_t& model = *context.model;
+        view.gpu_offset = (model.gpu_buffer_size + GLTF_BUFFER_ALIGNMENT - 1) & ~(u64) (GLTF_BUFFER_ALIGNMENT - 1);
+        view.b_uploaded = true;
+        model.gpu_buffer_size = view.gpu_offset + view.size;
+
+        gltf_upload_range_t range;
+        range.source = view.data;
+        range.gpu_offset = view.gpu_offset;
+        range.size = view.size;
+        model.upload_ranges.push_back(range);
+    }
+    return view.gpu_offset;
+}
+
+internal mesh_attribute_layout_t gltf_attribute_layout(gltf_context_t& context, const gltf_accessor_t& accessor)
+{
+    mesh_attribute_layout_t layout;
+    layout.components = (u8) accessor.components;
+    layout.type = accessor.component_type;
+    layout.b_normalized = accessor.b_normalized;
+    layout.stride = accessor.stride;
+    layout.offset = gltf_upload_view(context, accessor.view) + accessor.offset_in_view;
+    return layout;
+}
+
+internal bool gltf_is_aligned(const gltf_accessor_t& accessor)
+{
+    return accessor.offset_in_view % accessor.component_size == 0 && accessor.stride % accessor.component_size == 0;
+}
+
+/** Reads the primitive on the CPU into an interleaved mesh in the space of matrix, like an
+    Assimp import would. Returns false for primitives that aren't triangles. */
+internal bool gltf_convert_primitive(const gltf_context_t& context,
+                                     const json_value_t& primitive,
+                                     const mat4& matrix,
+                                     mesh_buffers_t& out_mesh)
+{
+    const json_value_t* attributes = primitive.find("attributes");
+    gltf_accessor_t positions, normals, texcoords, indices;
+    if(!attributes || !gltf_get_accessor(context, attributes->find("POSITION"), positions) || positions.components != 3)
+    {
+        return false;
+    }
+    bool b_normals = gltf_get_accessor(context, attributes->find("NORMAL"), normals) && normals.components == 3 && normals.count == positions.count;
+    bool b_texcoords = gltf_get_accessor(context, attributes->find("TEXCOORD_0"), texcoords) && texcoords.components == 2 && texcoords.count == positions.count;
+    bool b_indexed = primitive.find("indices") != nullptr;
+    if(b_indexed && (!gltf_get_accessor(context, primitive.find("indices"), indices) || indices.components != 1))
+    {
+        return false;
+    }
+
+    // Triangle lists out of whatever the primitive is made of
+    u32 corners_count = b_indexed ? indices.count : positions.count;
+    std::vector<u32> corners(corners_count);
+    for(u32 i = 0; i < corners_count; ++i)
+    {
+        corners[i] = b_indexed ? gltf_read_index(indices, i) : i;
+        if(corners[i] >= positions.count)
+        {
+            return false;
+        }
+    }
+    std::vector<u32>& triangles = out_mesh.indices;
+    triangles.clear();
+    int mode = (int) json_number(primitive.find("mode"), GLTF_MODE_TRIANGLES);
+    if(mode == GLTF_MODE_TRIANGLES)
+    {
+        triangles.assign(corners.begin(), corners.begin() + corners_count / 3 * 3);
+    }
+    else if(mode == GLTF_MODE_TRIANGLE_STRIP)
+    {
+        for(u32 i = 2; i < corners_count; ++i)
+        {
+            bool b_odd = (i & 1) != 0;
+            triangles.push_back(corners[i - 2]);
+            triangles.push_back(corners[b_odd ? i : i - 1]);
+            triangles.push_back(corners[b_odd ? i - 1 : i]);
+        }
+    }
+    else if(mode == GLTF_MODE_TRIANGLE_FAN)
+    {
+        for(u32 i = 2; i < corners_count; ++i)
+        {
+            triangles.push_back(corners[i - 1]);
+            triangles.push_back(corners[i]);
+            triangles.push_back(corners[0]);
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    // Read in mesh space, the node matrix is baked in at the end like the merge does for Assimp
+    // nodes. Flat normals need a vertex per triangle corner.
+    u32 vertices_count = b_normals ? positions.count : (u32) triangles.size();
+    std::vector<float>& vertices = out_mesh.vertices;
+    vertices.assign((size_t) vertices_count * 8, 0.f);
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        u32 source = b_normals ? v : triangles[v];
+        float* out = &vertices[(size_t) v * 8];
+        for(u32 axis = 0; axis < 3; ++axis)
+        {
+            out[axis] = gltf_read_float(positions, source, axis);
+        }
+        if(b_texcoords)
+        {
+            out[3] = gltf_read_float(texcoords, source, 0);
+            out[4] = gltf_read_float(texcoords, source, 1);
+        }
+        if(b_normals)
+        {
+            for(u32 axis = 0; axis < 3; ++axis)
+            {
+                out[5 + axis] = gltf_read_float(normals, source, axis);
+            }
+        }
+    }
+    if(!b_normals)
+    {
+        for(u32 v = 0; v < vertices_count; v += 3)
+        {
+            float* p0 = &vertices[(size_t) v * 8];
+            float* p1 = p0 + 8;
+            float* p2 = p1 + 8;
+            vec3 face_normal = cross(make_vec3(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]),
+                                     make_vec3(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]));
+            float length = magnitude(face_normal);
+            face_normal = length > 0.f ? face_normal / length : face_normal;
+            for(float* corner : { p0, p1, p2 })
+            {
+                corner[5] = face_normal.x;
+                corner[6] = face_normal.y;
+                corner[7] = face_normal.z;
+            }
+        }
+        for(u32 v = 0; v < vertices_count; ++v)
+        {
+            triangles[v] = v;
+        }
+    }
+    mesh_merge_transform(out_mesh, matrix);
+    return !triangles.empty();
+}
+
+/** The direct path hands the index buffer to the GPU as is, so an index past the vertex
+    accessor would fetch other meshes' data or past the end of the model buffer. */
+internal bool gltf_are_indices_in_range(const gltf_accessor_t& indices, u32 vertices_count)
+{
+    for(u32 i = 0; i < indices.count; ++i)
+    {
+        if(gltf_read_index(indices, i) >= vertices_count)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Adds one primitive drawn with the world matrix of its node, straight from the buffer if
+    it can be, converted otherwise */
+internal void gltf_add_primitive(gltf_context_t& context, const json_value_t& primitive, const mat4& matrix)
+{
+    gltf_model_t& model = *context.model;
+    double material = json_number(primitive.find("material"), -1.0);
+    u32 material_index = material >= 0.0 && material < (double) context.default_material ? (u32) material : context.default_material;
+    ++context.stats.primitives_count;
+
+    const json_value_t* attributes = primitive.find("attributes");
+    gltf_accessor_t positions, normals, texcoords, indices;
+    float scale = 1.f;
+    bool b_direct = attributes
+        && json_number(primitive.find("mode"), GLTF_MODE_TRIANGLES) == GLTF_MODE_TRIANGLES
+        && gltf_is_translate_scale(matrix, scale)
+        && gltf_get_accessor(context, attributes->find("POSITION"), positions) && positions.components == 3
+        && gltf_get_accessor(context, attributes->find("NORMAL"), normals) && normals.components == 3 && normals.count == positions.count
+        && gltf_get_accessor(context, primitive.find("indices"), indices) && indices.components == 1
+        && indices.component_type != GL_BYTE && indices.component_type != GL_SHORT && indices.component_type != GL_FLOAT
+        && indices.stride == indices.component_size && indices.count % 3 == 0
+        && gltf_is_aligned(positions) && gltf_is_aligned(normals) && gltf_is_aligned(indices)
+        && gltf_are_indices_in_range(indices, positions.count);
+    bool b_texcoords = attributes && attributes->find("TEXCOORD_0");
+    if(b_direct && b_texcoords)
+    {
+        b_direct = gltf_get_accessor(context, attributes->find("TEXCOORD_0"), texcoords)
+                   && texcoords.components == 2 && texcoords.count == positions.count && gltf_is_aligned(texcoords);
+    }
+
+    if(!b_direct)
+    {
+        mesh_buffers_t converted;
+        if(gltf_convert_primitive(context, primitive, matrix, converted))
+        {
+            converted.material_index = material_index;
+            model.converted_meshes.push_back(std::move(converted));
+            ++context.stats.converted_count;
+        }
+        else
+        {
+            ++context.stats.skipped_count;
+        }
+        return;
+    }
+
+    gltf_mesh_t mesh;
+    mesh.material_index = material_index;
+    mesh_buffer_layout_t& layout = mesh.layout;
+    layout.position = gltf_attribute_layout(context, positions);
+    layout.normal = gltf_attribute_layout(context, normals);
+    if(b_texcoords)
+    {
+        layout.texcoord = gltf_attribute_layout(context, texcoords);
+    }
+    layout.index_type = indices.component_type;
+    layout.index_offset = gltf_upload_view(context, indices.view) + indices.offset_in_view;
+    layout.indices_count = indices.count;
+
+    // POSITION must have min and max, but don't trust every exporter with that
+    if(!positions.b_bounds && positions.count > 0)
+    {
+        for(u32 axis = 0; axis < 3; ++axis)
+        {
+            positions.min[axis] = positions.max[axis] = gltf_read_float(positions, 0, axis);
+        }
+        for(u32 i = 1; i < positions.count; ++i)
+        {
+            for(u32 axis = 0; axis < 3; ++axis)
+            {
+                float p = gltf_read_float(positions, i, axis);
+                positions.min[axis] = min(positions.min[axis], p);
+                positions.max[axis] = max(positions.max[axis], p);
+            }
+        }
+    }
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        layout.position_scale[axis] = scale;
+        layout.position_offset[axis] = matrix[3][axis];
+        layout.bounds_min[axis] = positions.min[axis];
+        layout.bounds_max[axis] = positions.max[axis];
+    }
+    model.meshes.push_back(mesh);
+}
+
+internal void gltf_visit_node(gltf_context_t& context, size_t node_index, const mat4& parent_matrix, u32 depth)
+{
+    const json_value_t* nodes = context.document.find("nodes");
+    const json_value_t* node = nodes ? nodes->at(node_index) : nullptr;
+    if(node == nullptr || depth > GLTF_MAX_NODE_DEPTH)
+    {
+        return;
+    }
+    mat4 matrix = parent_matrix * gltf_node_matrix(*node);
+
+    const json_value_t* meshes = context.document.find("meshes");
+    const json_value_t* mesh = meshes && node->find("mesh") ? meshes->at(gltf_index(node->find("mesh"))) : nullptr;
+    const json_value_t* primitives = mesh ? mesh->find("primitives") : nullptr;
+    for(size_t i = 0; primitives && i < primitives->size(); ++i)
+    {
+        gltf_add_primitive(context, *primitives->at(i), matrix);
+    }
+
+    const json_value_t* children = node->find("children");
+    for(size_t i = 0; children && i < children->size(); ++i)
+    {
+        gltf_visit_node(context, gltf_index(children->at(i)), matrix, depth + 1);
+    }
+}
+
+/** Base color texture path of every material. Embedded images get a made up path so that
+    textures stay deduplicated by path. */
+internal void gltf_load_materials(gltf_context_t& context)
+{
+    gltf_model_t& model = *context.model;
+    const json_value_t* materials = context.document.find("materials");
+    const json_value_t* textures = context.document.find("textures");
+    const json_value_t* images = context.document.find("images");
+    context.default_material = materials ? (u32) materials->size() : 0;
+    model.texture_paths.assign(context.default_material + 1, std::string());
+
+    for(u32 i = 0; i < context.default_material; ++i)
+    {
+        const json_value_t* pbr = materials->at(i)->find("pbrMetallicRoughness");
+        const json_value_t* base_color = pbr ? pbr->find("baseColorTexture") : nullptr;
+        const json_value_t* texture = base_color && textures ? textures->at(gltf_index(base_color->find("index"))) : nullptr;
+        size_t image_index = texture ? gltf_index(texture->find("source")) : (size_t) -1;
+        const json_value_t* image = images ? images->at(image_index) : nullptr;
+        if(image == nullptr)
+        {
+            continue;
+        }
+
+        const char* uri = json_string(image->find("uri"), nullptr);
+        double view_index = json_number(image->find("bufferView"), -1.0);
+        if(uri && strncmp(uri, "data:", 5) == 0)
+        {
+            console_printf("glTF: image %u of '%s' is a data URI, which isn't supported\n", (u32) image_index, context.file_name);
+        }
+        else if(uri)
+        {
+            model.texture_paths[i] = context.directory + gltf_decode_uri(uri);
+        }
+        else if(view_index >= 0.0 && view_index < (double) context.views.size())
+        {
+            std::string path = std::string(context.file_name) + "#image" + std::to_string(image_index);
+            model.texture_paths[i] = path;
+            bool b_known = false;
+            for(const gltf_embedded_image_t& embedded : model.embedded_images)
+            {
+                b_known |= embedded.path == path;
+            }
+            if(!b_known)
+            {
+                gltf_embedded_image_t embedded;
+                embedded.path = path;
+                embedded.memory = context.views[(size_t) view_index].data;
+                embedded.size = context.views[(size_t) view_index].size;
+                model.embedded_images.push_back(embedded);
+            }
+        }
+    }
+}
+
+bool gltf_load(gltf_model_t& model, const char* file_name, gltf_load_stats_t* out_stats)
+{
+    gltf_close(model);
+    model = gltf_model_t();
+    gltf_context_t context;
+    context.model = &model;
+    context.file_name = file_name;
+    context.directory = gltf_directory(file_name);
+
+    gltf_buffer_t file;
+    if(!gltf_map(context, file_name, file))
+    {
+        return false;
+    }
+
+    // GLB is a header, a JSON chunk, and an optional binary chunk, each chunk 4 byte aligned
+    const char* json_text = (const char*) file.data;
+    u64 json_length = file.size;
+    gltf_buffer_t glb_binary;
+    u32 header[3] = {};
+    if(file.size >= sizeof(header))
+    {
+        memcpy(header, file.data, sizeof(header));
+    }
+    if(header[0] == GLTF_GLB_MAGIC)
+    {
+        u64 length = min((u64) header[2], file.size);
+        u64 chunk = 12;
+        json_text = nullptr;
+        while(chunk + 8 <= length)
+        {
+            u32 chunk_header[2];
+            memcpy(chunk_header, file.data + chunk, sizeof(chunk_header));
+            u64 chunk_length = min((u64) chunk_header[0], length - chunk - 8);
+            if(chunk_header[1] == GLTF_GLB_CHUNK_JSON && json_text == nullptr)
+            {
+                json_text = (const char*) file.data + chunk + 8;
+                json_length = chunk_length;
+            }
+            else if(chunk_header[1] == GLTF_GLB_CHUNK_BIN && glb_binary.data == nullptr)
+            {
+                glb_binary.data = file.data + chunk + 8;
+                glb_binary.size = chunk_length;
+            }
+            chunk += 8 + ((chunk_length + 3) & ~(u64) 3);
+        }
+        if(json_text == nullptr || header[1] != 2)
+        {
+            console_printf("glTF: '%s' isn't a version 2 GLB file\n", file_name);
+            gltf_close(model);
+            return false;
+        }
+    }
+
+    if(!json_parse(context.document, json_text, json_length) || context.document.type != JSON_OBJECT)
+    {
+        console_printf("glTF: '%s' has broken JSON\n", file_name);
+        gltf_close(model);
+        return false;
+    }
+    const json_value_t* required = context.document.find("extensionsRequired");
+    for(size_t i = 0; required && i < required->size(); ++i)
+    {
+        if(strcmp(json_string(required->at(i)), "KHR_mesh_quantization") != 0)
+        {
+            console_printf("glTF: '%s' requires %s, which isn't supported\n", file_name, json_string(required->at(i)));
+            gltf_close(model);
+            return false;
+        }
+    }
+
+    // Map every buffer, then resolve the buffer views into them
+    const json_value_t* buffers = context.document.find("buffers");
+    for(size_t i = 0; buffers && i < buffers->size(); ++i)
+    {
+        const json_value_t& buffer = *buffers->at(i);
+        const char* uri = json_string(buffer.find("uri"), nullptr);
+        gltf_buffer_t mapped;
+        if(uri == nullptr)
+        {
+            mapped = glb_binary; // the GLB binary chunk
+        }
+        else if(strncmp(uri, "data:", 5) == 0)
+        {
+            console_printf("glTF: buffer %u of '%s' is a data URI, which isn't supported\n", (u32) i, file_name);
+            gltf_close(model);
+            return false;
+        }
+        else if(!gltf_map(context, context.directory + gltf_decode_uri(uri), mapped))
+        {
+            gltf_close(model);
+            return false;
+        }
+        u64 length = (u64) json_number(buffer.find("byteLength"), 0.0);
+        if(mapped.size < length)
+        {
+            console_printf("glTF: buffer %u of '%s' is shorter than its byteLength\n", (u32) i, file_name);
+            gltf_close(model);
+            return false;
+        }
+        mapped.size = length;
+        context.buffers.push_back(mapped);
+    }
+
+    const json_value_t* views = context.document.find("bufferViews");
+    for(size_t i = 0; views && i < views->size(); ++i)
+    {
+        const json_value_t& view = *views->at(i);
+        double buffer_index = json_number(view.find("buffer"), -1.0);
+        u64 offset = (u64) json_number(view.find("byteOffset"), 0.0);
+        u64 length = (u64) json_number(view.find("byteLength"), 0.0);
+        gltf_buffer_view_t resolved;
+        if(buffer_index >= 0.0 && buffer_index < (double) context.buffers.size()
+           && offset + length <= context.buffers[(size_t) buffer_index].size)
+        {
+            resolved.data = context.buffers[(size_t) buffer_index].data + offset;
+            resolved.size = length;
+            resolved.stride = (u32) json_number(view.find("byteStride"), 0.0);
+        }
+        context.views.push_back(resolved); // a broken view is empty and fails every accessor that uses it
+    }
+
+    gltf_load_materials(context);
+
+    // Default scene, or every root node if the file has no scenes
+    const json_value_t* scenes = context.document.find("scenes");
+    const json_value_t* scene = scenes ? scenes->at((size_t) json_number(context.document.find("scene"), 0.0)) : nullptr;
+    const json_value_t* nodes = context.document.find("nodes");
+    mat4 identity = identity_mat4();
+    if(scene)
+    {
+        const json_value_t* scene_nodes = scene->find("nodes");
+        for(size_t i = 0; scene_nodes && i < scene_nodes->size(); ++i)
+        {
+            gltf_visit_node(context, gltf_index(scene_nodes->at(i)), identity, 0);
+        }
+    }
+    else if(nodes)
+    {
+        std::vector<bool> b_child(nodes->size(), false);
+        for(size_t i = 0; i < nodes->size(); ++i)
+        {
+            const json_value_t* children = nodes->at(i)->find("children");
+            for(size_t j = 0; children && j < children->size(); ++j)
+            {
+                size_t child = gltf_index(children->at(j));
+                if(child < b_child.size())
+                {
+                    b_child[child] = true;
+                }
+            }
+        }
+        for(size_t i = 0; i < nodes->size(); ++i)
+        {
+            if(!b_child[i])
+            {
+                gltf_visit_node(context, i, identity, 0);
+            }
+        }
+    }
+
+    // Touch every page that is going to be uploaded, so that reading the file happens here and
+    // not while the main thread copies the ranges into the GPU buffer
+    volatile u8 page_sum = 0;
+    for(const gltf_upload_range_t& range : model.upload_ranges)
+    {
+        for(u64 offset = 0; offset < range.size; offset += 4096)
+        {
+            page_sum += range.source[offset];
+        }
+    }
+    for(const gltf_embedded_image_t& image : model.embedded_images)
+    {
+        for(u64 offset = 0; offset < image.size; offset += 4096)
+        {
+            page_sum += image.memory[offset];
+        }
+    }
+
+    if(out_stats)
+    {
+        *out_stats = context.stats;
+    }
+    return true;
+}
+
+void gltf_close(gltf_model_t& model)
+{
+    for(mapped_file_handle_t& file : model.files)
+    {
+        unmap_file(file);
+    }
+    model.files.clear();
+    model.upload_ranges.clear();
+    model.embedded_images.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "../runtime/memory_handle.h"
+#include "mesh.h"
+
+/**
+    GLTF LOADER - glTF 2.0 (.gltf with .bin files, or .glb) import without vertex conversion
+
+    glTF buffers are already laid out the way the GPU reads them, so instead of unpacking every
+    vertex into mesh_buffers_t like the Assimp and OBJ imports do, the binary buffers are memory
+    mapped and the buffer views that meshes use are uploaded as they are into one GPU buffer per
+    model. Every primitive becomes a mesh_t that points its VAO at its accessors in that buffer
+    (see mesh_t::gl_create_mesh_from_buffer), so loading costs about as much as reading the file.
+
+    The node hierarchy of the default scene is flattened. A primitive drawn by several nodes
+    shares its vertices between all of them. The node transform of a primitive ends up in the
+    position scale and offset of its mesh, which only works for a translation and a uniform
+    positive scale. Primitives that can't be drawn straight from the buffer get converted on the
+    CPU into mesh_buffers_t instead, like any other import:
+        -   nodes that rotate, mirror, or scale non uniformly
+        -   triangle strips and fans, or primitives without indices
+        -   primitives without normals (they get flat normals, as glTF asks for)
+        -   sparse accessors and unaligned accessors
+    Points and lines are skipped.
+
+    Materials get the base color texture of their PBR material. Textures are either files next
+    to the model or images embedded in a buffer view. Material count is followed by a default
+    material without a texture, for primitives that don't have a material.
+
+    Models that use extensions we can't ignore (extensionsRequired other than
+    KHR_mesh_quantization) or base64 data URIs for buffers fail to load. CPU only and thread
+    safe; the mappings stay open until gltf_close.
+*/
+
+#define GLTF_BUFFER_ALIGNMENT 16    // of every buffer view in the GPU buffer, enough for any accessor
+
+/** Bytes of a mapped buffer view that go to gpu_offset in the GPU buffer of the model */
+struct gltf_upload_range_t
+{
+    const u8*   source = nullptr;
+    u64         gpu_offset = 0;
+    u64         size = 0;
+};
+
+/** A primitive that is drawn straight out of the GPU buffer */
+struct gltf_mesh_t
+{
+    mesh_buffer_layout_t    layout;
+    u32                     material_index = 0;
+};
+
+/** An image stored in a buffer view instead of in its own file. path is the made up texture
+    path the materials refer to it by. */
+struct gltf_embedded_image_t
+{
+    std::string     path;
+    const u8*       memory = nullptr;
+    u64             size = 0;
+};
+
+struct gltf_model_t
+{
+    std::vector<mapped_file_handle_t>   files;                  // the model file and its .bin files
+    u64                                 gpu_buffer_size = 0;
+    std::vector<gltf_upload_range_t>    upload_ranges;          // fill the GPU buffer
+    std::vector<gltf_mesh_t>            meshes;                 // draw from the GPU buffer
+    std::vector<mesh_buffers_t>         converted_meshes;       // have to be uploaded like imported meshes
+    std::vector<std::string>            texture_paths;          // per material, empty if it has no texture
+    std::vector<gltf_embedded_image_t>  embedded_images;
+};
+
+struct gltf_load_stats_t
+{
+    u32 primitives_count = 0;   // drawn by the scene, counting every node that draws one
+    u32 converted_count = 0;
+    u32 skipped_count = 0;      // points, lines, and broken primitives
+};
+
+/** Loads the glTF or GLB file at file_name. Texture paths are resolved relative to the model.
+    Returns false (and prints why) if the file can't be used. */
+bool gltf_load(gltf_model_t& model, const char* file_name, gltf_load_stats_t* out_stats = nullptr);
+
+/** Unmaps the files of model. Upload ranges and embedded images point into them. */
+void gltf_close(gltf_model_t& model);
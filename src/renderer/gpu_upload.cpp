@@ -0,0 +1,183 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <GL/glew.h>
+
+#include "gpu_upload.h"
+#include "../core/display.h"
+#include "../debugging/console.h"
+
+#define GPU_UPLOAD_CLEAN_UP_WAIT_NANOSECONDS 1000000000ull
+
+struct gpu_upload_t
+{
+    gpu_upload_job_t    job;
+    gpu_upload_ready_t  on_ready;
+    u32                 result = 0;
+    GLsync              fence = nullptr;
+};
+
+enum gpu_upload_thread_state_t
+{
+    GPU_UPLOAD_THREAD_STOPPED,
+    GPU_UPLOAD_THREAD_STARTING,
+    GPU_UPLOAD_THREAD_RUNNING
+};
+
+internal std::thread                upload_thread;
+internal std::mutex                 upload_mutex;
+internal std::condition_variable    upload_condition;
+internal std::deque<gpu_upload_t>   queued_uploads;     // waiting for the upload thread
+internal std::deque<gpu_upload_t>   fenced_uploads;     // run, the GPU might still be on them
+internal gpu_upload_thread_state_t  thread_state = GPU_UPLOAD_THREAD_STOPPED;
+internal bool                       b_quit = false;
+
+// Main thread only
+internal bool                       b_enabled = true;
+internal u32                        uploads_in_flight = 0;
+
+internal void gpu_upload_thread_main()
+{
+    bool b_context = display::get_instance()->make_upload_context_current(true);
+    {
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        thread_state = b_context ? GPU_UPLOAD_THREAD_RUNNING : GPU_UPLOAD_THREAD_STOPPED;
+    }
+    upload_condition.notify_all();
+    if(!b_context)
+    {
+        return;
+    }
+
+    for(;;)
+    {
+        gpu_upload_t upload;
+        {
+            std::unique_lock<std::mutex> lock(upload_mutex);
+            upload_condition.wait(lock, []() { return b_quit || !queued_uploads.empty(); });
+            if(queued_uploads.empty())
+            {
+                break;
+            }
+            upload = std::move(queued_uploads.front());
+            queued_uploads.pop_front();
+        }
+
+        upload.result = upload.job();
+        upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush(); // the fence only signals once it reaches the GPU, the main thread won't flush this context
+
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        fenced_uploads.push_back(std::move(upload));
+    }
+    display::get_instance()->make_upload_context_current(false);
+}
+
+void gpu_upload_initialize()
+{
+    if(thread_state != GPU_UPLOAD_THREAD_STOPPED)
+    {
+        return;
+    }
+
+    b_quit = false;
+    thread_state = GPU_UPLOAD_THREAD_STARTING;
+    upload_thread = std::thread(gpu_upload_thread_main);
+
+    // Jobs can't be queued before the thread knows whether it has a context
+    std::unique_lock<std::mutex> lock(upload_mutex);
+    upload_condition.wait(lock, []() { return thread_state != GPU_UPLOAD_THREAD_STARTING; });
+    if(thread_state == GPU_UPLOAD_THREAD_STOPPED)
+    {
+        lock.unlock();
+        upload_thread.join();
+        console_printf("WARNING: No shared OpenGL context, uploads stay on the main thread\n");
+    }
+}
+
+void gpu_upload_clean_up()
+{
+    if(thread_state != GPU_UPLOAD_THREAD_RUNNING)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        b_quit = true;
+    }
+    upload_condition.notify_all();
+    upload_thread.join();
+    thread_state = GPU_UPLOAD_THREAD_STOPPED;
+
+    for(gpu_upload_t& upload : fenced_uploads)
+    {
+        glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GPU_UPLOAD_CLEAN_UP_WAIT_NANOSECONDS);
+        glDeleteSync(upload.fence);
+    }
+    fenced_uploads.clear();
+    uploads_in_flight = 0;
+}
+
+void gpu_upload_set_enabled(int enabled)
+{
+    b_enabled = enabled != 0;
+    console_printf("Uploads %s\n", gpu_upload_is_enabled() ? "run on the upload thread"
+                                 : b_enabled ? "stay on the main thread, there is no upload thread" : "run on the main thread");
+}
+
+bool gpu_upload_is_enabled()
+{
+    return b_enabled && thread_state == GPU_UPLOAD_THREAD_RUNNING;
+}
+
+void gpu_upload_submit(gpu_upload_job_t job, gpu_upload_ready_t on_ready)
+{
+    if(!gpu_upload_is_enabled())
+    {
+        on_ready(job()); // same context, the GL calls that use it are ordered after the job's
+        return;
+    }
+
+    gpu_upload_t upload;
+    upload.job = std::move(job);
+    upload.on_ready = std::move(on_ready);
+    ++uploads_in_flight;
+    {
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        queued_uploads.push_back(std::move(upload));
+    }
+    upload_condition.notify_one();
+}
+
+void gpu_upload_update()
+{
+    for(;;)
+    {
+        gpu_upload_t upload;
+        {
+            std::lock_guard<std::mutex> lock(upload_mutex);
+            if(fenced_uploads.empty())
+            {
+                return;
+            }
+            // Jobs are fenced in order, so nothing after an unsignaled fence is done either
+            GLenum status = glClientWaitSync(fenced_uploads.front().fence, 0, 0);
+            if(status == GL_TIMEOUT_EXPIRED)
+            {
+                return;
+            }
+            upload = std::move(fenced_uploads.front());
+            fenced_uploads.pop_front();
+        }
+        glDeleteSync(upload.fence);
+        --uploads_in_flight;
+        upload.on_ready(upload.result); // outside the lock, it can submit more jobs
+    }
+}
+
+u32 gpu_upload_in_flight()
+{
+    return uploads_in_flight;
+}
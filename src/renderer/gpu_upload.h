@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+#include "../gamedefine.h"
+
+/**
+    GPU UPLOAD - background thread with its own GL context for filling buffers and textures
+
+    display::initialize creates a second OpenGL context that shares objects (buffers, textures,
+    sync objects) with the main one, and the upload thread makes it current. Big uploads, like
+    the buffers of a glTF model or the mips of a texture, are handed to that thread as jobs, so
+    the driver copies them off the main thread instead of stalling render_manager::render.
+
+    Every job is fenced on the upload thread once it has run. gpu_upload_update polls the fences
+    on the main thread and calls the on_ready of each job whose fence signaled, in submit order,
+    with what the job returned (e.g. the texture it created). Only then may the main thread draw
+    with the objects the job filled.
+
+    Container objects (VAOs, framebuffers) aren't shared between contexts, so jobs must not
+    create them: VAOs are still made on the main thread, in on_ready. The upload context has its
+    own GL state, nothing bound on the main thread is bound there. The texture upload ring
+    (texture_upload.h) is main thread only, so jobs upload from client memory.
+
+    Without a shared context, or while it's turned off, jobs run on the main thread right away
+    and on_ready is called before gpu_upload_submit returns.
+*/
+
+/** Runs on the upload thread with the upload context current. Returns a GL object name for
+    on_ready, or 0. */
+typedef std::function<u32()> gpu_upload_job_t;
+
+/** Runs on the main thread once the GPU has finished the job */
+typedef std::function<void(u32)> gpu_upload_ready_t;
+
+/** Starts the upload thread, after GLEW is initialized. */
+void gpu_upload_initialize();
+
+/** Finishes the jobs queued on the upload thread and stops it. The on_ready of jobs that
+    weren't published yet are dropped. */
+void gpu_upload_clean_up();
+
+/** Console command. Off, new jobs run on the main thread. */
+void gpu_upload_set_enabled(int enabled);
+
+bool gpu_upload_is_enabled();
+
+void gpu_upload_submit(gpu_upload_job_t job, gpu_upload_ready_t on_ready);
+
+/** Main thread, once per frame: calls on_ready of the jobs the GPU has finished. */
+void gpu_upload_update();
+
+/** Jobs submitted whose on_ready hasn't been called yet */
+u32 gpu_upload_in_flight();
@@ -0,0 +1,228 @@
+#include <cmath>
+
+#include "impostor.h"
+#include "mesh_group.h"
+#include "shader.h"
+#include "frame_constants.h"
+#include "../core/timer.h"
+#include "../debugging/console.h"
+#include <GL/glew.h>
+
+internal shader_t bake_shader;
+internal shader_t impostor_shader;
+internal u32 empty_vao = 0;    // core profile draws need a VAO bound even without vertex buffers
+
+/** Octahedral map of the whole sphere with y as the pole, same as impostor.vert */
+internal vec3 impostor_octahedral_decode(float u, float v)
+{
+    vec3 n = make_vec3(u, 1.f - abs(u) - abs(v), v);
+    float t = max(-n.y, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.z += n.z >= 0.f ? -t : t;
+    return normalize(n);
+}
+
+/** Direction of the frame at cell x y, from the center towards where it is seen from */
+internal vec3 impostor_frame_direction(u32 x, u32 y, u32 grid_size)
+{
+    float u = ((float) x + 0.5f) / (float) grid_size * 2.f - 1.f;
+    float v = ((float) y + 0.5f) / (float) grid_size * 2.f - 1.f;
+    return impostor_octahedral_decode(u, v);
+}
+
+internal u32 impostor_create_atlas(GLint internal_format, GLenum type, u32 size)
+{
+    u32 id_texture;
+    glGenTextures(1, &id_texture);
+    glBindTexture(GL_TEXTURE_2D, id_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, size, size, 0, GL_RGBA, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, IMPOSTOR_MAX_MIP_LEVEL);
+    return id_texture;
+}
+
+void impostor_initialize()
+{
+    shader_t::gl_load_shader_program_from_file(bake_shader, "shaders/deferred/deferred_geometry_pass.vert", "shaders/impostor/impostor_bake.frag");
+    shader_t::gl_load_shader_program_from_file(impostor_shader, "shaders/impostor/impostor.vert", "shaders/impostor/impostor.frag");
+    glGenVertexArrays(1, &empty_vao);
+}
+
+bool impostor_bake(impostor_t& impostor, mesh_group_t& group)
+{
+    // Bounding sphere of the group from the bounding spheres of its meshes
+    vec3 bounds_min = make_vec3(1e30f, 1e30f, 1e30f);
+    vec3 bounds_max = make_vec3(-1e30f, -1e30f, -1e30f);
+    bool b_has_bounds = false;
+    for(const mesh_t& mesh : group.meshes)
+    {
+        if(mesh.indices_count == 0 || mesh.bounds_radius <= 0.f)
+        {
+            continue;
+        }
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            bounds_min[axis] = min(bounds_min[axis], mesh.bounds_center[axis] - mesh.bounds_radius);
+            bounds_max[axis] = max(bounds_max[axis], mesh.bounds_center[axis] + mesh.bounds_radius);
+        }
+        b_has_bounds = true;
+    }
+    if(!b_has_bounds)
+    {
+        return false;
+    }
+    vec3 center = (bounds_min + bounds_max) * 0.5f;
+    float radius = 0.f;
+    for(const mesh_t& mesh : group.meshes)
+    {
+        if(mesh.indices_count > 0 && mesh.bounds_radius > 0.f)
+        {
+            vec3 mesh_center = make_vec3(mesh.bounds_center[0], mesh.bounds_center[1], mesh.bounds_center[2]);
+            radius = max(radius, magnitude(mesh_center - center) + mesh.bounds_radius);
+        }
+    }
+
+    i64 start_ticks = timer::get_ticks();
+    impostor_delete(impostor);
+    impostor.grid_size = IMPOSTOR_GRID_SIZE;
+    impostor.frame_resolution = IMPOSTOR_FRAME_RESOLUTION;
+    impostor.center[0] = center.x;
+    impostor.center[1] = center.y;
+    impostor.center[2] = center.z;
+    impostor.radius = radius;
+    u32 atlas_size = impostor.grid_size * impostor.frame_resolution;
+    impostor.id_albedo_texture = impostor_create_atlas(GL_RGBA8, GL_UNSIGNED_BYTE, atlas_size);
+    impostor.id_normal_depth_texture = impostor_create_atlas(GL_RGBA16F, GL_FLOAT, atlas_size);
+
+    u32 id_fbo, id_depth_rbo;
+    glGenFramebuffers(1, &id_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, id_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor.id_albedo_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, impostor.id_normal_depth_texture, 0);
+    u32 color_attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, color_attachments);
+    glGenRenderbuffers(1, &id_depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, id_depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, atlas_size, atlas_size);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, id_depth_rbo);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        console_printf("Impostor framebuffer is incomplete\n");
+    }
+
+    float clear_color[4] = { 0.f, 0.f, 0.f, 0.f };
+    float clear_depth = 1.f;
+    glClearBufferfv(GL_COLOR, 0, clear_color);
+    glClearBufferfv(GL_COLOR, 1, clear_color);
+    glClearBufferfv(GL_DEPTH, 0, &clear_depth);
+    glEnable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // Each frame is an orthographic view of the bounding sphere from 2 radii out, so depth goes
+    // from the front of the sphere (radius away) to the back (3 radii away).
+    shader_t::gl_use_shader(bake_shader);
+    mat4 matrix_model = identity_mat4();
+    view_constants_t frame_view;
+    frame_view.matrix_proj_perspective = projection_matrix_orthographic(-radius, radius, -radius, radius, radius, 3.f * radius);
+    bake_shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, matrix_model.ptr());
+    bake_shader.gl_bind_1i(UNIFORM("texture_sampler_0"), 1);
+    bake_shader.gl_bind_1i(UNIFORM("texture_array_sampler"), 2);
+    for(u32 y = 0; y < impostor.grid_size; ++y)
+    {
+        for(u32 x = 0; x < impostor.grid_size; ++x)
+        {
+            glViewport(x * impostor.frame_resolution, y * impostor.frame_resolution, impostor.frame_resolution, impostor.frame_resolution);
+            vec3 direction = impostor_frame_direction(x, y, impostor.grid_size);
+            vec3 up_hint = abs(direction.y) > 0.999f ? make_vec3(0.f, 0.f, 1.f) : make_vec3(0.f, 1.f, 0.f);
+            frame_view.eye_position = center + direction * (2.f * radius);
+            frame_view.matrix_view = view_matrix_look_at(frame_view.eye_position, center, up_hint);
+            frame_constants_update_view(frame_view);
+            group.render(bake_shader);
+        }
+    }
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &id_depth_rbo);
+    glDeleteFramebuffers(1, &id_fbo);
+
+    glBindTexture(GL_TEXTURE_2D, impostor.id_albedo_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, impostor.id_normal_depth_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    console_printf("baked %ux%u impostor (%u px frames) in %f seconds\n", impostor.grid_size, impostor.grid_size,
+                   impostor.frame_resolution, (float) (timer::get_ticks() - start_ticks) / (float) timer::counter_frequency());
+    return true;
+}
+
+bool impostor_is_beyond(const impostor_t& impostor, const mat4& matrix_model, vec3 eye_position, float distance)
+{
+    if(impostor.grid_size == 0)
+    {
+        return false;
+    }
+    float model_scale = 0.f;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        model_scale = max(model_scale, magnitude(make_vec3(matrix_model[axis].x, matrix_model[axis].y, matrix_model[axis].z)));
+    }
+    const float* c = impostor.center;
+    vec3 world_center = make_vec3(matrix_model[0].x*c[0] + matrix_model[1].x*c[1] + matrix_model[2].x*c[2] + matrix_model[3].x,
+                                  matrix_model[0].y*c[0] + matrix_model[1].y*c[1] + matrix_model[2].y*c[2] + matrix_model[3].y,
+                                  matrix_model[0].z*c[0] + matrix_model[1].z*c[1] + matrix_model[2].z*c[2] + matrix_model[3].z);
+    return magnitude(world_center - eye_position) - impostor.radius * model_scale > distance;
+}
+
+void impostor_render(const impostor_t& impostor,
+                     const mat4& matrix_model,
+                     float specular_intensity,
+                     float shininess)
+{
+    shader_t::gl_use_shader(impostor_shader);
+    impostor_shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, matrix_model.ptr());
+    impostor_shader.gl_bind_3f(UNIFORM("impostor_center"), impostor.center[0], impostor.center[1], impostor.center[2]);
+    impostor_shader.gl_bind_1f(UNIFORM("impostor_radius"), impostor.radius);
+    impostor_shader.gl_bind_1f(UNIFORM("impostor_grid_size"), (float) impostor.grid_size);
+    impostor_shader.gl_bind_1f(UNIFORM("impostor_atlas_texel"), 1.f / (float) (impostor.grid_size * impostor.frame_resolution));
+    impostor_shader.gl_bind_1f(UNIFORM("material.specular_intensity"), specular_intensity);
+    impostor_shader.gl_bind_1f(UNIFORM("material.shininess"), shininess);
+    impostor_shader.gl_bind_1i(UNIFORM("albedo_atlas"), 1);
+    impostor_shader.gl_bind_1i(UNIFORM("normal_depth_atlas"), 2);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, impostor.id_normal_depth_texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, impostor.id_albedo_texture);
+
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+void impostor_delete(impostor_t& impostor)
+{
+    if(impostor.id_albedo_texture != 0)
+    {
+        glDeleteTextures(1, &impostor.id_albedo_texture);
+    }
+    if(impostor.id_normal_depth_texture != 0)
+    {
+        glDeleteTextures(1, &impostor.id_normal_depth_texture);
+    }
+    impostor = impostor_t();
+}
+
+void impostor_clean_up()
+{
+    shader_t::gl_delete_shader(bake_shader);
+    shader_t::gl_delete_shader(impostor_shader);
+    if(empty_vao != 0)
+    {
+        glDeleteVertexArrays(1, &empty_vao);
+        empty_vao = 0;
+    }
+}
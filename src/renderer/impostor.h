@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+
+struct mesh_group_t;
+
+/**
+    IMPOSTOR - octahedral impostors for mesh groups seen from far away
+
+    impostor_bake renders a mesh group from IMPOSTOR_GRID_SIZE x IMPOSTOR_GRID_SIZE directions
+    around its bounding sphere into two atlases with a frame per direction:
+        albedo          RGBA8, alpha is coverage
+        normal_depth    RGBA16F, mesh space normal and the depth of the surface (0 at the
+                        front of the bounding sphere, 1 at the back)
+    The directions are the centers of the cells of an octahedral map of the whole sphere, so
+    the frames are spread evenly and the frame for any view direction is found by octahedral
+    encoding it. Each frame is an orthographic view of the bounding sphere.
+
+    impostor_render draws one camera facing quad over the bounding sphere with the frame
+    closest to the view direction. Every fragment intersects its view ray with the plane of
+    that frame, reads albedo, normal, and depth there, and writes the same G-buffer outputs
+    as deferred_geometry_pass.frag (world position, world normal, albedo, material) and
+    gl_FragDepth from the reconstructed surface, so tiled lighting and depth testing treat the
+    impostor like the mesh it stands in for.
+
+    Baking draws each frame by writing its view into view_constants (frame_constants.h), so it
+    has to happen before render_manager fills them for the frame. Baking happens on the main
+    thread once the mesh group is fully resident. Impostors aren't
+    drawn into shadow maps; the mesh group keeps casting shadows with its coarsest LODs.
+*/
+
+#define IMPOSTOR_GRID_SIZE 8                // frames per side of the octahedral atlas
+#define IMPOSTOR_FRAME_RESOLUTION 128       // texels per side of each frame
+#define IMPOSTOR_MAX_MIP_LEVEL 3            // mips beyond this would blend neighbouring frames together
+
+struct impostor_t
+{
+    u32     id_albedo_texture = 0;
+    u32     id_normal_depth_texture = 0;
+    u32     grid_size = 0;                      // 0 until baked
+    u32     frame_resolution = 0;
+    float   center[3] = { 0.f, 0.f, 0.f };      // mesh space bounding sphere of the mesh group
+    float   radius = 0.f;
+};
+
+/** Loads the bake and draw shaders. */
+void impostor_initialize();
+
+/** Renders group into the atlases of impostor. The group must be fully resident. Returns false
+    if the group has nothing to bake. Changes the bound framebuffer and viewport. */
+bool impostor_bake(impostor_t& impostor, mesh_group_t& group);
+
+/** True if the bounding sphere of impostor under matrix_model is entirely further than
+    distance from eye_position. */
+bool impostor_is_beyond(const impostor_t& impostor, const mat4& matrix_model, vec3 eye_position, float distance);
+
+/** Draws impostor into the G-buffer from the view in view_constants. Uses its own shader, so
+    whatever shader was in use has to be bound again afterwards. */
+void impostor_render(const impostor_t& impostor,
+                     const mat4& matrix_model,
+                     float specular_intensity,
+                     float shininess);
+
+/** Deletes the atlases. The impostor can be baked again afterwards. */
+void impostor_delete(impostor_t& impostor);
+
+/** Deletes the shaders. */
+void impostor_clean_up();
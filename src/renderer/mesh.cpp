@@ -1,6 +1,51 @@
+#include <cmath>
 #include "mesh.h"
+#include "mesh_arena.h"
+#include "mesh_quantize.h"
 #include "../debugging/console.h"
 
+internal size_t mesh_index_size(GLenum index_type)
+{
+    return index_type == GL_UNSIGNED_BYTE ? sizeof(u8) : index_type == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+}
+
+/** Bytes per vertex of a dynamic mesh. Normals are only read when there are uvs. */
+internal u32 mesh_dynamic_stride_bytes(const mesh_vertex_format_t& format)
+{
+    u32 floats = format.vertex_attrib_size;
+    if(format.texture_attrib_size)
+    {
+        floats += format.texture_attrib_size + format.normal_attrib_size;
+    }
+    return sizeof(float) * floats;
+}
+
+/** Immutable buffer that fits at least size_bytes, written with glNamedBufferSubData.
+    capacity is set to its actual size. */
+internal u32 gl_create_dynamic_buffer(u32& capacity, u32 size_bytes, const void* data)
+{
+    capacity = MESH_DYNAMIC_MIN_CAPACITY;
+    while(capacity < size_bytes)
+    {
+        capacity *= 2;
+    }
+    u32 buffer;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if(data && size_bytes > 0)
+    {
+        glNamedBufferSubData(buffer, 0, size_bytes, data);
+    }
+    return buffer;
+}
+
+/** Points the VAO of a dynamic mesh at its current VBO and IBO */
+internal void gl_bind_dynamic_buffers(const mesh_t& mesh)
+{
+    glVertexArrayVertexBuffer(mesh.id_vao, 0, mesh.id_vbo, 0, mesh_dynamic_stride_bytes(mesh.format));
+    glVertexArrayElementBuffer(mesh.id_vao, mesh.id_ibo);
+}
+
 void mesh_t::gl_create_mesh(mesh_t& mesh,
                             float* vertices,
                             u32* indices,
@@ -11,61 +56,205 @@ void mesh_t::gl_create_mesh(mesh_t& mesh,
                             u8 normal_attrib_size,
                             GLenum draw_usage)
 {
-    u8 stride = 0;
-    if(texture_attrib_size)
+    // Need to store to index_count because we need the count of indices when we are drawing in mesh_t::render_mesh
+    mesh.indices_count = indices_array_count;
+
+    // Static meshes are suballocated from the shared arena for their vertex format
+    if(draw_usage == GL_STATIC_DRAW && indices_array_count > 0)
     {
-        stride += vertex_attrib_size + texture_attrib_size;
-        if(normal_attrib_size)
-        {
-            stride += normal_attrib_size;
-        }
+        mesh_vertex_format_t format;
+        format.vertex_attrib_size = vertex_attrib_size;
+        format.texture_attrib_size = texture_attrib_size;
+        format.normal_attrib_size = texture_attrib_size ? normal_attrib_size : 0;
+        gl_create_mesh(mesh, vertices, indices, vertices_array_count, indices_array_count, format);
+        return;
     }
 
-    // Need to store to index_count because we need the count of indices when we are drawing in mesh_t::render_mesh
-    mesh.indices_count = indices_array_count;
+    // Dynamic meshes own an immutable VBO and IBO that gl_rebind_buffer_objects writes into, so
+    // set the format up once and only swap buffers in the VAO when they have to grow
+    mesh.format = mesh_vertex_format_t();
+    mesh.format.vertex_attrib_size = vertex_attrib_size;
+    mesh.format.texture_attrib_size = texture_attrib_size;
+    mesh.format.normal_attrib_size = texture_attrib_size ? normal_attrib_size : 0;
+    mesh.lods_count = 1;
+    mesh.lods[0].first_index = 0;
+    mesh.lods[0].indices_count = indices_array_count;
+    mesh.lods[0].error = 0.f;
 
-    glGenVertexArrays(1, &mesh.id_vao); // Defining some space in the GPU for a vertex array and giving you the vao ID
-    glBindVertexArray(mesh.id_vao); // Binding a VAO means we are currently operating on that VAO
-    // Indentation is to indicate that we are now working within the bound VAO
-    glGenBuffers(1, &mesh.id_vbo); // Creating a buffer object inside the bound VAO and returning the ID
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.id_vbo); // Bind VBO to operate on that VBO
-    /* Connect the vertices data to the actual gl array buffer for this VBO. We need to pass in the size of the data we are passing as well.
-    GL_STATIC_DRAW (as opposed to GL_DYNAMIC_DRAW) means we won't be changing these data values in the array.
-    The vertices array does not need to exist anymore after this call because that data will now be stored in the VAO on the GPU. */
-    glBufferData(GL_ARRAY_BUFFER, 4 /*bytes cuz float*/ * vertices_array_count, vertices, draw_usage);
-    /* Index is location in VAO of the attribute we are creating this pointer for.
-    Size is number of values we are passing in (e.g. size is 3 if x y z).
-    Normalized is normalizing the values.
-    Stride is the number of values to skip after getting the values we need.
+    glCreateVertexArrays(1, &mesh.id_vao);
+    /* Attribute location, number of floats (e.g. 3 if x y z), and offset in bytes from the start of
+    the vertex. Every attribute reads from binding 0, which is the VBO with a stride of the whole vertex:
         for example, you could have vertices and colors in the same array
         [ Ax, Ay, Az,  Ar, Ag, Ab,  Bx, By, Bz,  Br, Bg, Bb ]
-            use          stride        use          stride
-        In this case, the stride would be 3 because we need to skip 3 values (the color values) to reach the next vertex data.
-    Apparently the last parameter is the offset? */
-    glVertexAttribPointer(0, vertex_attrib_size, GL_FLOAT, GL_FALSE, sizeof(float) * stride, 0); // vertex pointer
-    glEnableVertexAttribArray(0); // Enabling location in VAO for the attribute
+        the stride would be 6 floats and the color offset 3 floats. */
+    glVertexArrayAttribFormat(mesh.id_vao, 0, vertex_attrib_size, GL_FLOAT, GL_FALSE, 0); // vertex
+    glVertexArrayAttribBinding(mesh.id_vao, 0, 0);
+    glEnableVertexArrayAttrib(mesh.id_vao, 0);
     if(texture_attrib_size > 0)
     {
-        glVertexAttribPointer(1, texture_attrib_size, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * vertex_attrib_size)); // uv coord pointer
-        glEnableVertexAttribArray(1);
+        glVertexArrayAttribFormat(mesh.id_vao, 1, texture_attrib_size, GL_FLOAT, GL_FALSE, sizeof(float) * vertex_attrib_size); // uv coord
+        glVertexArrayAttribBinding(mesh.id_vao, 1, 0);
+        glEnableVertexArrayAttrib(mesh.id_vao, 1);
         if(normal_attrib_size > 0)
         {
-            glVertexAttribPointer(2, normal_attrib_size, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * (vertex_attrib_size + texture_attrib_size))); // normal pointer
-            glEnableVertexAttribArray(2);
+            glVertexArrayAttribFormat(mesh.id_vao, 2, normal_attrib_size, GL_FLOAT, GL_FALSE, sizeof(float) * (vertex_attrib_size + texture_attrib_size)); // normal
+            glVertexArrayAttribBinding(mesh.id_vao, 2, 0);
+            glEnableVertexArrayAttrib(mesh.id_vao, 2);
         }
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the VBO
 
-    // Index Buffer Object
-    glGenBuffers(1, &mesh.id_ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.id_ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 /*bytes cuz uint32*/ * indices_array_count, indices, draw_usage);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0); // Unbind the VAO;
+    mesh.id_vbo = gl_create_dynamic_buffer(mesh.vbo_capacity, sizeof(float) * vertices_array_count, vertices);
+    mesh.id_ibo = gl_create_dynamic_buffer(mesh.ibo_capacity, sizeof(u32) * indices_array_count, indices);
+    gl_bind_dynamic_buffers(mesh);
+}
+
+void mesh_t::gl_create_mesh(mesh_t& mesh,
+                            const float* vertices,
+                            const u32* indices,
+                            u32 vertices_array_count,
+                            u32 indices_array_count,
+                            mesh_vertex_format_t format,
+                            const mesh_lod_t* lods,
+                            u32 lods_count,
+                            const mesh_cluster_t* clusters,
+                            u32 clusters_count)
+{
+    u32 floats_per_vertex = format.vertex_attrib_size + format.texture_attrib_size + format.normal_attrib_size;
+    u32 vertices_count = vertices_array_count / floats_per_vertex;
+
+    mesh.format = format;
+    if(lods && lods_count > 0)
+    {
+        mesh.lods_count = lods_count < MESH_MAX_LODS ? lods_count : MESH_MAX_LODS;
+        for(u32 i = 0; i < mesh.lods_count; ++i)
+        {
+            mesh.lods[i] = lods[i];
+        }
+    }
+    else
+    {
+        mesh.lods_count = 1;
+        mesh.lods[0].first_index = 0;
+        mesh.lods[0].indices_count = indices_array_count;
+        mesh.lods[0].error = 0.f;
+    }
+    mesh.indices_count = mesh.lods[0].indices_count;
+    mesh.clusters.assign(clusters, clusters + (clusters ? clusters_count : 0));
+    if(indices_array_count == 0)
+    {
+        return;
+    }
+
+    // Bounding sphere around the center of the bounding box, for LOD selection
+    if(format.vertex_attrib_size == 3 && vertices_count > 0)
+    {
+        float bounds_min[3] = { vertices[0], vertices[1], vertices[2] };
+        float bounds_max[3] = { vertices[0], vertices[1], vertices[2] };
+        for(u32 i = 1; i < vertices_count; ++i)
+        {
+            const float* p = vertices + (size_t) i * floats_per_vertex;
+            for(u32 axis = 0; axis < 3; ++axis)
+            {
+                bounds_min[axis] = p[axis] < bounds_min[axis] ? p[axis] : bounds_min[axis];
+                bounds_max[axis] = p[axis] > bounds_max[axis] ? p[axis] : bounds_max[axis];
+            }
+        }
+        float radius_squared = 0.f;
+        for(u32 axis = 0; axis < 3; ++axis)
+        {
+            mesh.bounds_center[axis] = 0.5f * (bounds_min[axis] + bounds_max[axis]);
+        }
+        for(u32 i = 0; i < vertices_count; ++i)
+        {
+            const float* p = vertices + (size_t) i * floats_per_vertex;
+            float dx = p[0] - mesh.bounds_center[0];
+            float dy = p[1] - mesh.bounds_center[1];
+            float dz = p[2] - mesh.bounds_center[2];
+            float d = dx*dx + dy*dy + dz*dz;
+            radius_squared = d > radius_squared ? d : radius_squared;
+        }
+        mesh.bounds_radius = sqrtf(radius_squared);
+    }
+
+    if(mesh_vertex_format_is_float32(format))
+    {
+        mesh.arena_allocation = mesh_arena_allocate(format, vertices, vertices_count, indices, indices_array_count);
+    }
+    else
+    {
+        std::vector<u8> vertex_data;
+        mesh_quantize_vertices(vertex_data, mesh.position_scale, mesh.position_offset, format, vertices, vertices_count);
+        mesh.arena_allocation = mesh_arena_allocate(format, vertex_data.data(), vertices_count, indices, indices_array_count);
+    }
+    mesh.id_vao = mesh_arena_get_vao(mesh.arena_allocation);
+    mesh.id_depth_vao = mesh_arena_get_depth_vao(mesh.arena_allocation);
+}
+
+/** Every attribute gets the binding of its own location, since each has its own offset and
+    stride into the buffer */
+internal void gl_set_vertex_attribute(GLuint vao, GLuint location, u32 buffer, const mesh_attribute_layout_t& attribute)
+{
+    if(attribute.components == 0)
+    {
+        glDisableVertexArrayAttrib(vao, location);
+        return;
+    }
+    glVertexArrayVertexBuffer(vao, location, buffer, (GLintptr) attribute.offset, (GLsizei) attribute.stride);
+    glVertexArrayAttribFormat(vao, location, attribute.components, attribute.type, attribute.b_normalized ? GL_TRUE : GL_FALSE, 0);
+    glVertexArrayAttribBinding(vao, location, location);
+    glEnableVertexArrayAttrib(vao, location);
+}
+
+void mesh_t::gl_create_mesh_from_buffer(mesh_t& mesh, u32 buffer, const mesh_buffer_layout_t& layout)
+{
+    mesh.format = mesh_vertex_format_t();
+    mesh.index_type = layout.index_type;
+    mesh.index_offset = layout.index_offset;
+    mesh.indices_count = layout.indices_count;
+    mesh.lods_count = 1;
+    mesh.lods[0].first_index = 0;
+    mesh.lods[0].indices_count = layout.indices_count;
+    mesh.lods[0].error = 0.f;
+    mesh.clusters.clear();
+
+    // Bounding sphere around the mesh space bounding box
+    float radius_squared = 0.f;
+    for(u32 axis = 0; axis < 3; ++axis)
+    {
+        mesh.position_scale[axis] = layout.position_scale[axis];
+        mesh.position_offset[axis] = layout.position_offset[axis];
+        float a = layout.bounds_min[axis] * layout.position_scale[axis] + layout.position_offset[axis];
+        float b = layout.bounds_max[axis] * layout.position_scale[axis] + layout.position_offset[axis];
+        mesh.bounds_center[axis] = 0.5f * (a + b);
+        radius_squared += 0.25f * (b - a) * (b - a);
+    }
+    mesh.bounds_radius = sqrtf(radius_squared);
+
+    glCreateVertexArrays(1, &mesh.id_vao);
+    gl_set_vertex_attribute(mesh.id_vao, 0, buffer, layout.position);
+    gl_set_vertex_attribute(mesh.id_vao, 1, buffer, layout.texcoord);
+    gl_set_vertex_attribute(mesh.id_vao, 2, buffer, layout.normal);
+    glVertexArrayElementBuffer(mesh.id_vao, buffer);
+
+    glCreateVertexArrays(1, &mesh.id_depth_vao);
+    gl_set_vertex_attribute(mesh.id_depth_vao, 0, buffer, layout.position);
+    glVertexArrayElementBuffer(mesh.id_depth_vao, buffer);
 }
 
 void mesh_t::gl_delete_mesh(mesh_t& mesh)
 {
+    if (mesh.arena_allocation != 0)
+    {
+        mesh_arena_free(mesh.arena_allocation);
+        mesh.arena_allocation = 0;
+        mesh.id_vao = 0; // shared with the rest of the arena, don't delete
+        mesh.id_depth_vao = 0;
+    }
+    if (mesh.id_depth_vao != 0)
+    {
+        glDeleteVertexArrays(1, &mesh.id_depth_vao);
+        mesh.id_depth_vao = 0;
+    }
     if (mesh.id_ibo != 0)
     {
         glDeleteBuffers(1, &mesh.id_ibo);
@@ -83,6 +272,9 @@ void mesh_t::gl_delete_mesh(mesh_t& mesh)
     }
 
     mesh.indices_count = 0;
+    mesh.vbo_capacity = 0;
+    mesh.ibo_capacity = 0;
+    mesh.clusters.clear();
 }
 
 void mesh_t::gl_render_mesh(GLenum render_mode) const
@@ -93,19 +285,71 @@ void mesh_t::gl_render_mesh(GLenum render_mode) const
         return;
     }
 
-    // Bind VAO, bind VBO, draw elements(indexed draw)
+    // Every VAO has its index buffer attached, so binding it is all a draw needs
     glBindVertexArray(id_vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id_ibo);
-            glDrawElements(render_mode, indices_count, GL_UNSIGNED_INT, nullptr);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        gl_draw_elements(render_mode);
     glBindVertexArray(0);
 }
 
+void mesh_t::gl_draw_elements(GLenum render_mode, u32 lod) const
+{
+    if (arena_allocation != 0)
+    {
+        const mesh_arena_allocation_t& allocation = mesh_arena_get_allocation(arena_allocation);
+        const mesh_lod_t& mesh_lod = lods[lod < lods_count ? lod : lods_count - 1];
+        size_t index_size = allocation.index_type == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+        size_t offset = 4 * (size_t) allocation.first_index_word + index_size * mesh_lod.first_index;
+        glDrawElementsBaseVertex(render_mode, mesh_lod.indices_count, allocation.index_type,
+                                 (void*) offset, (GLint) allocation.base_vertex);
+    }
+    else
+    {
+        const mesh_lod_t& mesh_lod = lods[lod < lods_count ? lod : lods_count - 1];
+        size_t offset = (size_t) index_offset + mesh_index_size(index_type) * mesh_lod.first_index;
+        glDrawElements(render_mode, mesh_lod.indices_count, index_type, (void*) offset);
+    }
+}
+
+void mesh_t::gl_draw_index_ranges(const u32* first_indices,
+                                  const i32* indices_counts,
+                                  u32 ranges_count,
+                                  GLenum render_mode) const
+{
+    if(ranges_count == 0)
+    {
+        return;
+    }
+
+    local_persist std::vector<void*> offsets;
+    local_persist std::vector<GLint> base_vertices;
+    offsets.resize(ranges_count);
+    base_vertices.resize(ranges_count);
+    if (arena_allocation != 0)
+    {
+        const mesh_arena_allocation_t& allocation = mesh_arena_get_allocation(arena_allocation);
+        size_t index_size = allocation.index_type == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+        for(u32 i = 0; i < ranges_count; ++i)
+        {
+            offsets[i] = (void*)(4 * (size_t) allocation.first_index_word + index_size * first_indices[i]);
+            base_vertices[i] = (GLint) allocation.base_vertex;
+        }
+        glMultiDrawElementsBaseVertex(render_mode, (GLsizei*) indices_counts, allocation.index_type, offsets.data(),
+                                      (GLsizei) ranges_count, base_vertices.data());
+    }
+    else
+    {
+        for(u32 i = 0; i < ranges_count; ++i)
+        {
+            offsets[i] = (void*)((size_t) index_offset + mesh_index_size(index_type) * first_indices[i]);
+        }
+        glMultiDrawElements(render_mode, indices_counts, index_type, offsets.data(), (GLsizei) ranges_count);
+    }
+}
+
 void mesh_t::gl_rebind_buffer_objects(float* vertices,
                                       u32* indices,
                                       u32 vertices_array_count,
-                                      u32 indices_array_count,
-                                      GLenum draw_usage)
+                                      u32 indices_array_count)
 {
     if(id_vbo == 0 || id_ibo == 0)
     {
@@ -113,11 +357,31 @@ void mesh_t::gl_rebind_buffer_objects(float* vertices,
     }
 
     indices_count = indices_array_count;
-    glBindVertexArray(id_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, id_vbo);
-            glBufferData(GL_ARRAY_BUFFER, 4 * vertices_array_count, vertices, draw_usage);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id_ibo);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * indices_array_count, indices, draw_usage);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-}
\ No newline at end of file
+    lods[0].indices_count = indices_array_count;
+
+    // Storage is immutable: write into it when the data fits, otherwise replace the buffer
+    u32 vertices_bytes = sizeof(float) * vertices_array_count;
+    u32 indices_bytes = sizeof(u32) * indices_array_count;
+    if(vertices_bytes > vbo_capacity || indices_bytes > ibo_capacity)
+    {
+        if(vertices_bytes > vbo_capacity)
+        {
+            glDeleteBuffers(1, &id_vbo);
+            id_vbo = gl_create_dynamic_buffer(vbo_capacity, vertices_bytes, nullptr);
+        }
+        if(indices_bytes > ibo_capacity)
+        {
+            glDeleteBuffers(1, &id_ibo);
+            id_ibo = gl_create_dynamic_buffer(ibo_capacity, indices_bytes, nullptr);
+        }
+        gl_bind_dynamic_buffers(*this);
+    }
+    if(vertices_bytes > 0)
+    {
+        glNamedBufferSubData(id_vbo, 0, vertices_bytes, vertices);
+    }
+    if(indices_bytes > 0)
+    {
+        glNamedBufferSubData(id_ibo, 0, indices_bytes, indices);
+    }
+}
@@ -1,23 +1,161 @@
 #pragma once
 
+#include <vector>
 #include "../gamedefine.h"
 #include "GL/glew.h"
 
+#define MESH_MAX_LODS 4
+#define MESH_DYNAMIC_MIN_CAPACITY 256   // bytes, smallest VBO or IBO a dynamic mesh allocates
+
+/** A level of detail of a mesh: a range of its index buffer. Every LOD shares the vertices
+    of the full detail mesh (LOD 0). */
+struct mesh_lod_t
+{
+    u32     first_index = 0;    // in indices from the start of the mesh's index buffer
+    u32     indices_count = 0;
+    float   error = 0.f;        // max distance of a collapsed vertex from this LOD's surface, summed over the chain from LOD 0, mesh space units
+};
+
+/** A cluster of up to MESH_CLUSTER_MAX_TRIANGLES triangles of LOD 0 that gets culled as a whole
+    (see mesh_cluster.h). Laid out like a std430 struct, so an array of clusters can be put in a
+    shader storage buffer as is. */
+struct mesh_cluster_t
+{
+    float   center[3] = { 0.f, 0.f, 0.f };      // mesh space bounding sphere
+    float   radius = 0.f;
+    float   cone_axis[3] = { 0.f, 0.f, 0.f };   // every triangle normal is within the cone angle of the axis
+    float   cone_cos = 0.f;                     // cos of the cone angle, 0 if the cluster can't be backface culled
+    float   cone_sin = 0.f;
+    u32     first_index = 0;                    // in indices from the start of the mesh's index buffer
+    u32     indices_count = 0;
+    u32     pad = 0;
+};
+
+/** CPU side interleaved vertex buffer and index buffer of a mesh that hasn't been uploaded
+    to the GPU yet. Vertices are laid out as { x y z u v nx ny nz }
+    If lods_count is 0 all of indices is LOD 0, otherwise indices holds every LOD back to back. */
+struct mesh_buffers_t
+{
+    std::vector<float>  vertices;
+    std::vector<u32>    indices;
+    u32                 material_index = 0;
+    mesh_lod_t          lods[MESH_MAX_LODS];
+    u32                 lods_count = 0;
+    std::vector<mesh_cluster_t> clusters;   // of LOD 0, empty if the mesh isn't clustered
+    float               uv_rect[4] = { 0.f, 0.f, 0.f, 0.f }; // atlas tile { u v width height } the uvs wrap in, zero size if they don't
+};
+
+/** How each vertex attribute of a static mesh is stored on the GPU. The float layout is the
+    { x y z u v nx ny nz } layout of mesh_buffers_t, 32 bytes per vertex. The compact layouts
+    are 16 bytes per vertex:
+        MESH_POSITION_UNORM16   positions normalized to the mesh bounds, 16 bits per axis
+        MESH_POSITION_FLOAT16   half float positions normalized to the mesh bounds
+        MESH_TEXCOORD_FLOAT16   half float uvs
+        MESH_NORMAL_OCT16       octahedral encoded normals, two 16 bit snorm values
+    Quantized positions are turned back into mesh space in the vertex shader with
+    mesh_t::position_scale and mesh_t::position_offset. */
+enum mesh_position_encoding_t : u8
+{
+    MESH_POSITION_FLOAT32,
+    MESH_POSITION_UNORM16,
+    MESH_POSITION_FLOAT16
+};
+
+enum mesh_texcoord_encoding_t : u8
+{
+    MESH_TEXCOORD_FLOAT32,
+    MESH_TEXCOORD_FLOAT16
+};
+
+enum mesh_normal_encoding_t : u8
+{
+    MESH_NORMAL_FLOAT32,
+    MESH_NORMAL_OCT16
+};
+
+/** Attribute sizes are the number of float components in the source vertices. They stay the
+    same when an attribute is encoded (e.g. an octahedral normal still has normal_attrib_size 3). */
+struct mesh_vertex_format_t
+{
+    u8 vertex_attrib_size = 3;
+    u8 texture_attrib_size = 2;
+    u8 normal_attrib_size = 3;
+    u8 position_encoding = MESH_POSITION_FLOAT32;
+    u8 texture_encoding = MESH_TEXCOORD_FLOAT32;
+    u8 normal_encoding = MESH_NORMAL_FLOAT32;
+};
+
+/** Where one vertex attribute of a mesh is in a GPU buffer that already holds the mesh in its
+    final layout. components is 0 if the mesh doesn't have the attribute. */
+struct mesh_attribute_layout_t
+{
+    u8      components = 0;
+    GLenum  type = GL_FLOAT;        // GL_FLOAT, or an integer type for quantized attributes
+    bool    b_normalized = false;   // integer values map to [0, 1] or [-1, 1]
+    u32     stride = 0;             // bytes between vertices
+    u64     offset = 0;             // bytes from the start of the buffer
+};
+
+/** A mesh that is drawn straight out of a buffer it doesn't own (e.g. the buffers of a glTF
+    model, see gltf_loader.h). Positions are turned into mesh space with position_scale and
+    position_offset like quantized positions are. */
+struct mesh_buffer_layout_t
+{
+    mesh_attribute_layout_t position;
+    mesh_attribute_layout_t texcoord;
+    mesh_attribute_layout_t normal;
+    GLenum  index_type = GL_UNSIGNED_INT;
+    u64     index_offset = 0;       // bytes from the start of the buffer
+    u32     indices_count = 0;
+    float   position_scale[3] = { 1.f, 1.f, 1.f };
+    float   position_offset[3] = { 0.f, 0.f, 0.f };
+    float   bounds_min[3] = { 0.f, 0.f, 0.f };  // of the stored positions, before scale and offset
+    float   bounds_max[3] = { 0.f, 0.f, 0.f };
+};
+
 /** Stores mesh { VAO, VBO, IBO } info. Handle for VAO on GPU memory
  *  Holds the ID for the VAO, VBO, IBO in the GPU memory
+ *  Static meshes are suballocated from a shared mesh arena (see mesh_arena.h) instead. They
+ *  don't own their buffers: id_vbo and id_ibo are 0 and id_vao is the VAO shared by every
+ *  mesh with the same vertex format.
+ *  Meshes created with gl_create_mesh_from_buffer own their VAO but not the buffer it points
+ *  into, so id_vbo and id_ibo are 0 for them as well.
+ *  Dynamic meshes own an immutable VBO and IBO of vbo_capacity and ibo_capacity bytes. Updates
+ *  are written into them, and only replace them (twice the size) when they don't fit anymore.
+ *  id_depth_vao reads positions only, for passes that only write depth. Arena meshes get the
+ *  tightly packed position stream of their arena, meshes drawn from a buffer get a second VAO
+ *  with just their position accessor, and other meshes have none (0, draw with id_vao).
 */
 struct mesh_t
 {
     u32  id_vao          = 0;
     u32  id_vbo          = 0;
     u32  id_ibo          = 0;
-    u32  indices_count   = 0;
+    u32  id_depth_vao    = 0;    // position only, 0 if the mesh has none
+    u32  indices_count   = 0;    // of LOD 0
+    u32  arena_allocation = 0; // mesh arena allocation id, 0 if this mesh owns its buffers
+    u32  vbo_capacity    = 0;    // bytes, of dynamic meshes
+    u32  ibo_capacity    = 0;
+    GLenum index_type    = GL_UNSIGNED_INT; // of meshes outside the arena
+    u64  index_offset    = 0;    // bytes into the index buffer, of meshes outside the arena
+    mesh_vertex_format_t format;
+    float position_scale[3] = { 1.f, 1.f, 1.f };   // mesh space position = stored position * scale + offset
+    float position_offset[3] = { 0.f, 0.f, 0.f };
+    float bounds_center[3] = { 0.f, 0.f, 0.f };     // mesh space bounding sphere
+    float bounds_radius = 0.f;
+    mesh_lod_t lods[MESH_MAX_LODS];                 // lods[0] is the full mesh
+    u32  lods_count      = 1;
+    std::vector<mesh_cluster_t> clusters;           // cover lods[0] in order, empty if not clustered
+    float uv_rect[4] = { 0.f, 0.f, 0.f, 0.f };      // atlas tile the uvs wrap in, see mesh_buffers_t
 
     /** Create a mesh_t with the given vertices and indices.
     vertex_attrib_size: vertex coords size (e.g. 3 if x y z)
     texture_attrib_size: texture coords size (e.g. 2 if u v)
     draw_usage: affects optimization; GL_STATIC_DRAW buffer data
-    only set once, GL_DYNAMIC_DRAW if buffer modified repeatedly */
+    only set once, GL_DYNAMIC_DRAW if buffer modified repeatedly.
+    GL_STATIC_DRAW meshes go into the mesh arena and can't be
+    updated with gl_rebind_buffer_objects. Other meshes get their
+    own buffers, which can be created empty (nullptr, count 0). */
     static void gl_create_mesh(mesh_t& mesh,
                                float* vertices,
                                u32* indices,
@@ -28,6 +166,27 @@ struct mesh_t
                                u8 normal_attrib_size = 3,
                                GLenum draw_usage = GL_STATIC_DRAW);
 
+    /** Create a static mesh_t that stores its vertices in the given format. vertices are
+        always floats laid out by the attribute sizes of format and get encoded on upload.
+        Meshes with 65536 vertices or fewer get 16 bit indices.
+        lods: where each LOD is in indices (see mesh_buffers_t). nullptr if indices is only LOD 0.
+        clusters: the clusters of LOD 0, nullptr if the mesh isn't clustered. */
+    static void gl_create_mesh(mesh_t& mesh,
+                               const float* vertices,
+                               const u32* indices,
+                               u32 vertices_array_count,
+                               u32 indices_array_count,
+                               mesh_vertex_format_t format,
+                               const mesh_lod_t* lods = nullptr,
+                               u32 lods_count = 0,
+                               const mesh_cluster_t* clusters = nullptr,
+                               u32 clusters_count = 0);
+
+    /** Create a static mesh_t that draws from buffer as laid out by layout, without copying or
+        converting anything. Creates a VAO with buffer bound as both the vertex and the index
+        buffer; buffer must outlive the mesh. */
+    static void gl_create_mesh_from_buffer(mesh_t& mesh, u32 buffer, const mesh_buffer_layout_t& layout);
+
     /** Clearing GPU memory: glDeleteBuffers and glDeleteVertexArrays deletes the buffer
         object and vertex array object off the GPU memory. */
     static void gl_delete_mesh(mesh_t& mesh);
@@ -36,10 +195,21 @@ struct mesh_t
         before calling gl_render_mesh */
     void gl_render_mesh(GLenum render_mode = GL_TRIANGLES) const;
 
-    /** Overwrite existing buffer data */
+    /** Draws elements without binding or unbinding the VAO. id_vao must already be bound.
+        Use this to draw many meshes that share a VAO with a single bind. */
+    void gl_draw_elements(GLenum render_mode = GL_TRIANGLES, u32 lod = 0) const;
+
+    /** Like gl_draw_elements but only draws the given index ranges, all in one multi draw.
+        first_indices are in indices from the start of the mesh's index buffer. */
+    void gl_draw_index_ranges(const u32* first_indices,
+                              const i32* indices_counts,
+                              u32 ranges_count,
+                              GLenum render_mode = GL_TRIANGLES) const;
+
+    /** Overwrite existing buffer data of a dynamic mesh. The buffers are only reallocated when
+        the data doesn't fit in them. */
     void gl_rebind_buffer_objects(float* vertices,
                                   u32* indices,
                                   u32 vertices_array_count,
-                                  u32 indices_array_count,
-                                  GLenum draw_usage = GL_DYNAMIC_DRAW);
+                                  u32 indices_array_count);
 };
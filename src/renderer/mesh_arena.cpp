@@ -0,0 +1,487 @@
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "mesh_arena.h"
+#include "mesh_quantize.h"
+#include "../debugging/console.h"
+
+#define MESH_ARENA_INITIAL_VERTICES (1 << 16)
+#define MESH_ARENA_INITIAL_INDEX_WORDS (1 << 18)
+#define MESH_ARENA_INDEX_WORD_BYTES 4
+
+/** A contiguous run of elements (vertices or index words) in an arena buffer */
+struct arena_range_t
+{
+    u32 offset;
+    u32 count;
+};
+
+/** First-fit free list allocator of ranges in [0, capacity). free_ranges is kept sorted by
+    offset and adjacent free ranges are always merged. */
+struct arena_range_allocator_t
+{
+    u32 capacity = 0;
+    std::vector<arena_range_t> free_ranges;
+
+    bool allocate(u32 count, u32& out_offset)
+    {
+        for(size_t i = 0; i < free_ranges.size(); ++i)
+        {
+            arena_range_t& range = free_ranges[i];
+            if(range.count >= count)
+            {
+                out_offset = range.offset;
+                range.offset += count;
+                range.count -= count;
+                if(range.count == 0)
+                {
+                    free_ranges.erase(free_ranges.begin() + i);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void free(u32 offset, u32 count)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        auto insert_at = std::lower_bound(free_ranges.begin(), free_ranges.end(), offset,
+                                          [](const arena_range_t& r, u32 o) { return r.offset < o; });
+        size_t i = insert_at - free_ranges.begin();
+        free_ranges.insert(insert_at, { offset, count });
+        // merge with next
+        if(i + 1 < free_ranges.size() && free_ranges[i].offset + free_ranges[i].count == free_ranges[i + 1].offset)
+        {
+            free_ranges[i].count += free_ranges[i + 1].count;
+            free_ranges.erase(free_ranges.begin() + i + 1);
+        }
+        // merge with previous
+        if(i > 0 && free_ranges[i - 1].offset + free_ranges[i - 1].count == free_ranges[i].offset)
+        {
+            free_ranges[i - 1].count += free_ranges[i].count;
+            free_ranges.erase(free_ranges.begin() + i);
+        }
+    }
+
+    void grow(u32 new_capacity)
+    {
+        u32 old_capacity = capacity;
+        capacity = new_capacity;
+        free(old_capacity, new_capacity - old_capacity);
+    }
+
+    u32 free_count() const
+    {
+        u32 total = 0;
+        for(const arena_range_t& range : free_ranges)
+        {
+            total += range.count;
+        }
+        return total;
+    }
+};
+
+struct mesh_arena_t
+{
+    mesh_vertex_format_t    format;
+    u32                     stride_bytes = 0;
+    u32                     position_bytes = 0;     // per vertex in id_position_vbo
+    u32                     id_vao = 0;
+    u32                     id_vbo = 0;
+    u32                     id_ibo = 0;
+    u32                     id_depth_vao = 0;       // position only, shares id_ibo
+    u32                     id_position_vbo = 0;    // positions of id_vbo again, tightly packed
+    arena_range_allocator_t vertex_ranges;
+    arena_range_allocator_t index_ranges;   // in 4 byte index words
+};
+
+internal std::vector<mesh_arena_t>              arenas;
+internal std::vector<mesh_arena_allocation_t>   allocations;            // allocation id is index + 1
+internal std::vector<u32>                       free_allocation_slots;
+
+internal bool vertex_format_equal(mesh_vertex_format_t a, mesh_vertex_format_t b)
+{
+    return a.vertex_attrib_size == b.vertex_attrib_size
+        && a.texture_attrib_size == b.texture_attrib_size
+        && a.normal_attrib_size == b.normal_attrib_size
+        && a.position_encoding == b.position_encoding
+        && a.texture_encoding == b.texture_encoding
+        && a.normal_encoding == b.normal_encoding;
+}
+
+/** Points the arena VAO at the current arena buffers. Attribute formats never change, only
+    the buffer bindings do when the arena grows or gets compacted. */
+internal void arena_bind_buffers_to_vao(mesh_arena_t& arena)
+{
+    glVertexArrayVertexBuffer(arena.id_vao, 0, arena.id_vbo, 0, arena.stride_bytes);
+    glVertexArrayElementBuffer(arena.id_vao, arena.id_ibo);
+    glVertexArrayVertexBuffer(arena.id_depth_vao, 0, arena.id_position_vbo, 0, arena.position_bytes);
+    glVertexArrayElementBuffer(arena.id_depth_vao, arena.id_ibo);
+}
+
+internal void arena_set_position_format(u32 vao, mesh_vertex_format_t format)
+{
+    switch(format.position_encoding)
+    {
+        case MESH_POSITION_UNORM16: glVertexArrayAttribFormat(vao, 0, format.vertex_attrib_size, GL_UNSIGNED_SHORT, GL_TRUE, 0); break;
+        case MESH_POSITION_FLOAT16: glVertexArrayAttribFormat(vao, 0, format.vertex_attrib_size, GL_HALF_FLOAT, GL_FALSE, 0); break;
+        default:                    glVertexArrayAttribFormat(vao, 0, format.vertex_attrib_size, GL_FLOAT, GL_FALSE, 0);
+    }
+    glVertexArrayAttribBinding(vao, 0, 0);
+    glEnableVertexArrayAttrib(vao, 0);
+}
+
+internal u32 arena_find_or_create(mesh_vertex_format_t format)
+{
+    for(u32 i = 0; i < arenas.size(); ++i)
+    {
+        if(vertex_format_equal(arenas[i].format, format))
+        {
+            return i;
+        }
+    }
+
+    mesh_arena_t arena;
+    arena.format = format;
+    arena.stride_bytes = mesh_vertex_format_stride_bytes(format);
+    arena.position_bytes = mesh_vertex_format_position_bytes(format);
+
+    u32 texcoord_offset = mesh_vertex_format_position_bytes(format);
+    u32 normal_offset = texcoord_offset + mesh_vertex_format_texcoord_bytes(format);
+
+    // Same attribute locations as mesh_t::gl_create_mesh: 0 position, 1 uv, 2 normal
+    glCreateVertexArrays(1, &arena.id_vao);
+    arena_set_position_format(arena.id_vao, format);
+    if(format.texture_attrib_size > 0)
+    {
+        GLenum texcoord_type = format.texture_encoding == MESH_TEXCOORD_FLOAT16 ? GL_HALF_FLOAT : GL_FLOAT;
+        glVertexArrayAttribFormat(arena.id_vao, 1, format.texture_attrib_size, texcoord_type, GL_FALSE, texcoord_offset);
+        glVertexArrayAttribBinding(arena.id_vao, 1, 0);
+        glEnableVertexArrayAttrib(arena.id_vao, 1);
+    }
+    if(format.normal_attrib_size > 0)
+    {
+        if(format.normal_encoding == MESH_NORMAL_OCT16)
+        {
+            // Only x y come from the buffer, the vertex shader decodes the octahedral normal
+            glVertexArrayAttribFormat(arena.id_vao, 2, 2, GL_SHORT, GL_TRUE, normal_offset);
+        }
+        else
+        {
+            glVertexArrayAttribFormat(arena.id_vao, 2, format.normal_attrib_size, GL_FLOAT, GL_FALSE, normal_offset);
+        }
+        glVertexArrayAttribBinding(arena.id_vao, 2, 0);
+        glEnableVertexArrayAttrib(arena.id_vao, 2);
+    }
+
+    glCreateVertexArrays(1, &arena.id_depth_vao);
+    arena_set_position_format(arena.id_depth_vao, format);
+
+    arenas.push_back(arena);
+    return (u32) arenas.size() - 1;
+}
+
+/** Immutable buffer of size_bytes that allocations are written into with glNamedBufferSubData.
+    Arenas never resize a buffer, they create a bigger one and copy into it. */
+internal u32 arena_create_buffer(GLsizeiptr size_bytes)
+{
+    u32 buffer;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    return buffer;
+}
+
+/** Creates a new buffer of new_size_bytes and copies the first copy_size_bytes of old_buffer
+    into it. Deletes old_buffer. */
+internal u32 arena_reallocate_buffer(u32 old_buffer, GLsizeiptr copy_size_bytes, GLsizeiptr new_size_bytes)
+{
+    u32 new_buffer = arena_create_buffer(new_size_bytes);
+    if(old_buffer != 0)
+    {
+        glCopyNamedBufferSubData(old_buffer, new_buffer, 0, 0, copy_size_bytes);
+        glDeleteBuffers(1, &old_buffer);
+    }
+    return new_buffer;
+}
+
+internal void arena_grow_vertices(mesh_arena_t& arena, u32 min_free_count)
+{
+    u32 old_capacity = arena.vertex_ranges.capacity;
+    u32 new_capacity = std::max(old_capacity * 2, old_capacity + min_free_count);
+    new_capacity = std::max(new_capacity, (u32) MESH_ARENA_INITIAL_VERTICES);
+    arena.id_vbo = arena_reallocate_buffer(arena.id_vbo,
+                                           (GLsizeiptr) old_capacity * arena.stride_bytes,
+                                           (GLsizeiptr) new_capacity * arena.stride_bytes);
+    arena.id_position_vbo = arena_reallocate_buffer(arena.id_position_vbo,
+                                                    (GLsizeiptr) old_capacity * arena.position_bytes,
+                                                    (GLsizeiptr) new_capacity * arena.position_bytes);
+    arena.vertex_ranges.grow(new_capacity);
+    arena_bind_buffers_to_vao(arena);
+}
+
+internal void arena_grow_indices(mesh_arena_t& arena, u32 min_free_count)
+{
+    u32 old_capacity = arena.index_ranges.capacity;
+    u32 new_capacity = std::max(old_capacity * 2, old_capacity + min_free_count);
+    new_capacity = std::max(new_capacity, (u32) MESH_ARENA_INITIAL_INDEX_WORDS);
+    arena.id_ibo = arena_reallocate_buffer(arena.id_ibo,
+                                           (GLsizeiptr) old_capacity * MESH_ARENA_INDEX_WORD_BYTES,
+                                           (GLsizeiptr) new_capacity * MESH_ARENA_INDEX_WORD_BYTES);
+    arena.index_ranges.grow(new_capacity);
+    arena_bind_buffers_to_vao(arena);
+}
+
+internal void arena_compact(u32 arena_index)
+{
+    mesh_arena_t& arena = arenas[arena_index];
+    if(arena.id_vbo == 0 || arena.id_ibo == 0)
+    {
+        return;
+    }
+
+    std::vector<mesh_arena_allocation_t*> live;
+    for(mesh_arena_allocation_t& allocation : allocations)
+    {
+        if(allocation.b_live && allocation.arena_index == arena_index)
+        {
+            live.push_back(&allocation);
+        }
+    }
+
+    // Ranges can't be moved within the same buffer because source and destination may overlap,
+    // so pack them into fresh buffers of the same capacity instead.
+    u32 new_vbo = arena_create_buffer((GLsizeiptr) arena.vertex_ranges.capacity * arena.stride_bytes);
+    u32 new_position_vbo = arena_create_buffer((GLsizeiptr) arena.vertex_ranges.capacity * arena.position_bytes);
+    u32 new_ibo = arena_create_buffer((GLsizeiptr) arena.index_ranges.capacity * MESH_ARENA_INDEX_WORD_BYTES);
+    std::sort(live.begin(), live.end(), [](const mesh_arena_allocation_t* a, const mesh_arena_allocation_t* b)
+        { return a->base_vertex < b->base_vertex; });
+    u32 vertex_cursor = 0;
+    for(mesh_arena_allocation_t* allocation : live)
+    {
+        glCopyNamedBufferSubData(arena.id_position_vbo, new_position_vbo,
+                                 (GLintptr) allocation->base_vertex * arena.position_bytes,
+                                 (GLintptr) vertex_cursor * arena.position_bytes,
+                                 (GLsizeiptr) allocation->vertices_count * arena.position_bytes);
+        vertex_cursor += allocation->vertices_count;
+    }
+
+    // The position stream uses the same vertex ranges, so it was copied before base_vertex moves
+    vertex_cursor = 0;
+    for(mesh_arena_allocation_t* allocation : live)
+    {
+        glCopyNamedBufferSubData(arena.id_vbo, new_vbo,
+                                 (GLintptr) allocation->base_vertex * arena.stride_bytes,
+                                 (GLintptr) vertex_cursor * arena.stride_bytes,
+                                 (GLsizeiptr) allocation->vertices_count * arena.stride_bytes);
+        allocation->base_vertex = vertex_cursor;
+        vertex_cursor += allocation->vertices_count;
+    }
+
+    std::sort(live.begin(), live.end(), [](const mesh_arena_allocation_t* a, const mesh_arena_allocation_t* b)
+        { return a->first_index_word < b->first_index_word; });
+    u32 index_cursor = 0;
+    for(mesh_arena_allocation_t* allocation : live)
+    {
+        glCopyNamedBufferSubData(arena.id_ibo, new_ibo,
+                                 (GLintptr) allocation->first_index_word * MESH_ARENA_INDEX_WORD_BYTES,
+                                 (GLintptr) index_cursor * MESH_ARENA_INDEX_WORD_BYTES,
+                                 (GLsizeiptr) allocation->index_words_count * MESH_ARENA_INDEX_WORD_BYTES);
+        allocation->first_index_word = index_cursor;
+        index_cursor += allocation->index_words_count;
+    }
+
+    glDeleteBuffers(1, &arena.id_vbo);
+    glDeleteBuffers(1, &arena.id_position_vbo);
+    glDeleteBuffers(1, &arena.id_ibo);
+    arena.id_vbo = new_vbo;
+    arena.id_position_vbo = new_position_vbo;
+    arena.id_ibo = new_ibo;
+
+    arena.vertex_ranges.free_ranges.clear();
+    arena.vertex_ranges.free(vertex_cursor, arena.vertex_ranges.capacity - vertex_cursor);
+    arena.index_ranges.free_ranges.clear();
+    arena.index_ranges.free(index_cursor, arena.index_ranges.capacity - index_cursor);
+
+    arena_bind_buffers_to_vao(arena);
+}
+
+u32 mesh_arena_allocate(mesh_vertex_format_t format,
+                        const void* vertex_data,
+                        u32 vertices_count,
+                        const u32* indices,
+                        u32 indices_count)
+{
+    u32 arena_index = arena_find_or_create(format);
+    mesh_arena_t& arena = arenas[arena_index];
+
+    // Indices are relative to this mesh, so small meshes fit in 16 bits regardless of the arena size
+    std::vector<u16> narrow_indices;
+    GLenum index_type = GL_UNSIGNED_INT;
+    const void* index_data = indices;
+    u32 index_data_bytes = indices_count * sizeof(u32);
+    if(vertices_count <= 0x10000)
+    {
+        narrow_indices.resize(indices_count);
+        for(u32 i = 0; i < indices_count; ++i)
+        {
+            narrow_indices[i] = (u16) indices[i];
+        }
+        index_type = GL_UNSIGNED_SHORT;
+        index_data = narrow_indices.data();
+        index_data_bytes = indices_count * sizeof(u16);
+    }
+    u32 index_words_count = (index_data_bytes + MESH_ARENA_INDEX_WORD_BYTES - 1) / MESH_ARENA_INDEX_WORD_BYTES;
+
+    u32 base_vertex = 0;
+    if(!arena.vertex_ranges.allocate(vertices_count, base_vertex))
+    {
+        if(arena.vertex_ranges.free_count() >= vertices_count)
+        {
+            arena_compact(arena_index);
+        }
+        if(!arena.vertex_ranges.allocate(vertices_count, base_vertex))
+        {
+            arena_grow_vertices(arena, vertices_count);
+            arena.vertex_ranges.allocate(vertices_count, base_vertex);
+        }
+    }
+    u32 first_index_word = 0;
+    if(!arena.index_ranges.allocate(index_words_count, first_index_word))
+    {
+        if(arena.index_ranges.free_count() >= index_words_count)
+        {
+            arena_compact(arena_index);
+        }
+        if(!arena.index_ranges.allocate(index_words_count, first_index_word))
+        {
+            arena_grow_indices(arena, index_words_count);
+            arena.index_ranges.allocate(index_words_count, first_index_word);
+        }
+    }
+
+    // Positions lead every encoded vertex, so the position stream is the start of each vertex
+    local_persist std::vector<u8> positions;
+    positions.resize((size_t) vertices_count * arena.position_bytes);
+    for(u32 i = 0; i < vertices_count; ++i)
+    {
+        memcpy(&positions[(size_t) i * arena.position_bytes],
+               (const u8*) vertex_data + (size_t) i * arena.stride_bytes, arena.position_bytes);
+    }
+
+    // Written through the buffer names, so no binding (and no VAO's element array binding) changes
+    glNamedBufferSubData(arena.id_vbo, (GLintptr) base_vertex * arena.stride_bytes,
+                         (GLsizeiptr) vertices_count * arena.stride_bytes, vertex_data);
+    glNamedBufferSubData(arena.id_position_vbo, (GLintptr) base_vertex * arena.position_bytes,
+                         (GLsizeiptr) vertices_count * arena.position_bytes, positions.data());
+    glNamedBufferSubData(arena.id_ibo, (GLintptr) first_index_word * MESH_ARENA_INDEX_WORD_BYTES,
+                         (GLsizeiptr) index_data_bytes, index_data);
+
+    mesh_arena_allocation_t allocation;
+    allocation.arena_index = arena_index;
+    allocation.base_vertex = base_vertex;
+    allocation.vertices_count = vertices_count;
+    allocation.first_index_word = first_index_word;
+    allocation.index_words_count = index_words_count;
+    allocation.indices_count = indices_count;
+    allocation.index_type = index_type;
+    allocation.b_live = true;
+
+    if(!free_allocation_slots.empty())
+    {
+        u32 slot = free_allocation_slots.back();
+        free_allocation_slots.pop_back();
+        allocations[slot] = allocation;
+        return slot + 1;
+    }
+    allocations.push_back(allocation);
+    return (u32) allocations.size();
+}
+
+void mesh_arena_free(u32 allocation_id)
+{
+    if(allocation_id == 0 || allocation_id > allocations.size() || !allocations[allocation_id - 1].b_live)
+    {
+        console_printf("WARNING: Attempting to free mesh arena allocation %d which isn't live!\n", allocation_id);
+        return;
+    }
+
+    mesh_arena_allocation_t& allocation = allocations[allocation_id - 1];
+    mesh_arena_t& arena = arenas[allocation.arena_index];
+    arena.vertex_ranges.free(allocation.base_vertex, allocation.vertices_count);
+    arena.index_ranges.free(allocation.first_index_word, allocation.index_words_count);
+    allocation.b_live = false;
+    free_allocation_slots.push_back(allocation_id - 1);
+}
+
+const mesh_arena_allocation_t& mesh_arena_get_allocation(u32 allocation_id)
+{
+    ASSERT(allocation_id > 0 && allocation_id <= allocations.size())
+    return allocations[allocation_id - 1];
+}
+
+u32 mesh_arena_get_vao(u32 allocation_id)
+{
+    return arenas[mesh_arena_get_allocation(allocation_id).arena_index].id_vao;
+}
+
+u32 mesh_arena_get_depth_vao(u32 allocation_id)
+{
+    return arenas[mesh_arena_get_allocation(allocation_id).arena_index].id_depth_vao;
+}
+
+void mesh_arena_compact()
+{
+    for(u32 i = 0; i < arenas.size(); ++i)
+    {
+        arena_compact(i);
+    }
+}
+
+void mesh_arena_print_stats()
+{
+    for(u32 i = 0; i < arenas.size(); ++i)
+    {
+        const mesh_arena_t& arena = arenas[i];
+        u32 live_count = 0;
+        for(const mesh_arena_allocation_t& allocation : allocations)
+        {
+            if(allocation.b_live && allocation.arena_index == i)
+            {
+                ++live_count;
+            }
+        }
+        u32 vertices_free = arena.vertex_ranges.free_count();
+        u32 index_words_free = arena.index_ranges.free_count();
+        u32 vertices_used = arena.vertex_ranges.capacity - vertices_free;
+        u32 index_words_used = arena.index_ranges.capacity - index_words_free;
+        console_printf("mesh arena %d (%d/%d/%d, encoding %d/%d/%d, %d bytes per vertex): %d meshes\n",
+                       i, arena.format.vertex_attrib_size, arena.format.texture_attrib_size, arena.format.normal_attrib_size,
+                       arena.format.position_encoding, arena.format.texture_encoding, arena.format.normal_encoding,
+                       arena.stride_bytes, live_count);
+        console_printf("    vertices %d/%d used (%d KB + %d KB position stream, %d free blocks), index words %d/%d used (%d KB, %d free blocks)\n",
+                       vertices_used, arena.vertex_ranges.capacity, (vertices_used * arena.stride_bytes) / 1024,
+                       (vertices_used * arena.position_bytes) / 1024,
+                       (u32) arena.vertex_ranges.free_ranges.size(),
+                       index_words_used, arena.index_ranges.capacity, (index_words_used * MESH_ARENA_INDEX_WORD_BYTES) / 1024,
+                       (u32) arena.index_ranges.free_ranges.size());
+    }
+}
+
+void mesh_arena_clean_up()
+{
+    for(mesh_arena_t& arena : arenas)
+    {
+        glDeleteVertexArrays(1, &arena.id_vao);
+        glDeleteVertexArrays(1, &arena.id_depth_vao);
+        glDeleteBuffers(1, &arena.id_vbo);
+        glDeleteBuffers(1, &arena.id_position_vbo);
+        glDeleteBuffers(1, &arena.id_ibo);
+    }
+    arenas.clear();
+    allocations.clear();
+    free_allocation_slots.clear();
+}
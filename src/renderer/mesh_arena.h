@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "GL/glew.h"
+#include "mesh.h"
+
+/**
+    MESH ARENA - shared GPU vertex and index buffers for static meshes
+
+    Static meshes don't own a VAO, VBO and IBO. Every static mesh suballocates a range of
+    vertices and a range of indices out of the arena for its vertex format, and all meshes
+    in one arena are drawn through the single VAO of that arena with glDrawElementsBaseVertex.
+    Drawing many meshes of the same format then only needs one VAO bind.
+
+    Indices stay relative to the first vertex of their mesh; base_vertex is added at draw time.
+    Because of that, a mesh with 65536 vertices or fewer stores 16 bit indices even in a big arena.
+    The index buffer is allocated in 4 byte words, so 16 bit index ranges pack two indices per
+    word and every range starts on a 4 byte boundary no matter the index type.
+    Freed ranges go on a free list and get reused. When an allocation doesn't fit anywhere but
+    the arena has enough free space in total, the arena is compacted first, otherwise it grows.
+
+    Every arena also keeps the positions of its vertices a second time in a tightly packed
+    position only buffer (same vertex ranges, same encoding) with its own VAO, so depth only
+    passes like the shadow maps fetch 8 or 12 bytes per vertex instead of the whole vertex.
+
+    Allocations are referred to by id (0 is never a valid id) instead of by offsets, because
+    compaction moves ranges around. Look the offsets up with mesh_arena_get_allocation when drawing.
+*/
+
+struct mesh_arena_allocation_t
+{
+    u32 arena_index     = 0;
+    u32 base_vertex     = 0;    // first vertex of this allocation in the arena vertex buffer
+    u32 vertices_count  = 0;    // number of vertices (not floats)
+    u32 first_index_word = 0;   // first 4 byte word of this allocation in the arena index buffer
+    u32 index_words_count = 0;
+    u32 indices_count   = 0;
+    GLenum index_type   = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    bool b_live         = false;
+};
+
+/** Uploads the vertices and indices into the arena for the given vertex format (creating the
+    arena if it doesn't exist yet). vertex_data must already be encoded in that format (see
+    mesh_quantize.h). Indices are narrowed to 16 bits when vertices_count allows it. Returns
+    the allocation id. */
+u32 mesh_arena_allocate(mesh_vertex_format_t format,
+                        const void* vertex_data,
+                        u32 vertices_count,
+                        const u32* indices,
+                        u32 indices_count);
+
+/** Returns the ranges of this allocation to the free list of its arena. */
+void mesh_arena_free(u32 allocation_id);
+
+const mesh_arena_allocation_t& mesh_arena_get_allocation(u32 allocation_id);
+
+/** VAO shared by every allocation in the same arena as allocation_id. */
+u32 mesh_arena_get_vao(u32 allocation_id);
+
+/** Position only VAO of the arena of allocation_id, for depth only passes. Same index buffer
+    and base vertices as mesh_arena_get_vao. */
+u32 mesh_arena_get_depth_vao(u32 allocation_id);
+
+/** Packs the live ranges of every arena together so that all free space is in one block
+    at the end of each buffer. */
+void mesh_arena_compact();
+
+/** Prints the capacity, usage, and fragmentation of every arena to the console. */
+void mesh_arena_print_stats();
+
+void mesh_arena_clean_up();
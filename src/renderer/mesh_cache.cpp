@@ -0,0 +1,308 @@
+#include <cstring>
+#include "mesh_cache.h"
+#include "../core/hash.h"
+#include "../core/file_system.h"
+
+internal const u32 MESH_CACHE_FLOATS_PER_VERTEX = 8;
+
+std::string mesh_cache_path(const char* source_path)
+{
+    return std::string(source_path) + MESH_CACHE_FILE_EXTENSION;
+}
+
+internal u64 mesh_cache_align8(u64 offset)
+{
+    return (offset + 7) & ~((u64) 7);
+}
+
+internal bool mesh_cache_is_obj(const char* source_path)
+{
+    size_t length = strlen(source_path);
+    return length >= 4 && (strcmp(source_path + length - 4, ".obj") == 0 || strcmp(source_path + length - 4, ".OBJ") == 0);
+}
+
+/** Folds the .mtl files an .obj names into hash, so editing a material (e.g. its texture paths)
+    invalidates the cache too. Libraries are looked up next to the .obj, like the importers do. */
+internal u64 mesh_cache_hash_material_libraries(const char* source_path, const char* source, u64 source_size, u64 hash)
+{
+    std::string source_directory = source_path;
+    source_directory = source_directory.substr(0, source_directory.find_last_of("/\\") + 1); // npos + 1 is 0
+
+    const char* end = source + source_size;
+    for(const char* line = source; line < end;)
+    {
+        const char* line_end = (const char*) memchr(line, '\n', end - line);
+        line_end = line_end ? line_end : end;
+        const char* p = line;
+        while(p < line_end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        if(line_end - p > 7 && memcmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+        {
+            // Same as obj_parser: the rest of the line is the library name
+            const char* name_begin = p + 7;
+            const char* name_end = line_end;
+            while(name_begin < name_end && (*name_begin == ' ' || *name_begin == '\t'))
+            {
+                ++name_begin;
+            }
+            while(name_end > name_begin && (name_end[-1] == ' ' || name_end[-1] == '\t' || name_end[-1] == '\r'))
+            {
+                --name_end;
+            }
+            std::string library_path = source_directory + std::string(name_begin, name_end - name_begin);
+            hash = hash_fnv1a64(library_path.c_str(), library_path.size(), hash);
+
+            mapped_file_handle_t library_file;
+            map_file_readonly(library_file, library_path.c_str());
+            u8 b_found = library_file.memory != nullptr;
+            hash = hash_fnv1a64(&b_found, sizeof(b_found), hash); // a library showing up later changes the hash too
+            if(b_found)
+            {
+                hash = hash_fnv1a64(library_file.memory, library_file.size, hash);
+                unmap_file(library_file);
+            }
+        }
+        line = line_end + 1;
+    }
+    return hash;
+}
+
+u64 mesh_cache_hash_source(const char* source_path)
+{
+    mapped_file_handle_t source_file;
+    map_file_readonly(source_file, source_path);
+    if(source_file.memory == nullptr)
+    {
+        return 0;
+    }
+    u64 hash = hash_fnv1a64(source_file.memory, source_file.size);
+    if(mesh_cache_is_obj(source_path))
+    {
+        hash = mesh_cache_hash_material_libraries(source_path, (const char*) source_file.memory, source_file.size, hash);
+    }
+    unmap_file(source_file);
+    return hash;
+}
+
+/** True if count elements of element_size starting offset elements into [region_begin, region_end)
+    stay inside it. Written so that no sum can overflow. */
+internal bool mesh_cache_range_fits(u64 offset, u64 count, u64 element_size, u64 region_begin, u64 region_end)
+{
+    u64 capacity = (region_end - region_begin) / element_size;
+    return offset <= capacity && count <= capacity - offset;
+}
+
+/** The cache is handed to GL and the model streamer as is, so a truncated or corrupt file must
+    not point anywhere outside the mapping. */
+internal bool mesh_cache_is_layout_valid(const mesh_cache_header_t* header, const u8* base)
+{
+    if(header->mesh_table_offset < sizeof(mesh_cache_header_t)
+        || header->material_table_offset < header->mesh_table_offset
+        || header->strings_offset < header->material_table_offset
+        || header->vertex_blob_offset < header->strings_offset
+        || header->index_blob_offset < header->vertex_blob_offset
+        || header->cluster_blob_offset < header->index_blob_offset
+        || header->file_size < header->cluster_blob_offset
+        || !mesh_cache_range_fits(0, header->mesh_count, sizeof(mesh_cache_mesh_entry_t), header->mesh_table_offset, header->material_table_offset)
+        || !mesh_cache_range_fits(0, header->material_count, sizeof(mesh_cache_material_entry_t), header->material_table_offset, header->strings_offset))
+    {
+        return false;
+    }
+
+    const mesh_cache_material_entry_t* material_table = (const mesh_cache_material_entry_t*) (base + header->material_table_offset);
+    for(u32 i = 0; i < header->material_count; ++i)
+    {
+        const mesh_cache_material_entry_t& material = material_table[i];
+        if(!mesh_cache_range_fits(material.texture_path_offset, material.texture_path_length, 1, header->strings_offset, header->vertex_blob_offset))
+        {
+            return false;
+        }
+    }
+
+    const mesh_cache_mesh_entry_t* mesh_table = (const mesh_cache_mesh_entry_t*) (base + header->mesh_table_offset);
+    for(u32 i = 0; i < header->mesh_count; ++i)
+    {
+        const mesh_cache_mesh_entry_t& entry = mesh_table[i];
+        if(!mesh_cache_range_fits(entry.vertex_offset, entry.vertices_count, sizeof(float), header->vertex_blob_offset, header->index_blob_offset)
+            || !mesh_cache_range_fits(entry.index_offset, entry.indices_count, sizeof(u32), header->index_blob_offset, header->cluster_blob_offset)
+            || !mesh_cache_range_fits(entry.cluster_offset, entry.clusters_count, sizeof(mesh_cluster_t), header->cluster_blob_offset, header->file_size)
+            || entry.lods_count > MESH_MAX_LODS
+            || (entry.material_index >= header->material_count && header->material_count > 0))
+        {
+            return false;
+        }
+        for(u32 lod = 0; lod < entry.lods_count; ++lod)
+        {
+            if(!mesh_cache_range_fits(entry.lods[lod].first_index, entry.lods[lod].indices_count, 1, 0, entry.indices_count))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+mesh_cache_status_t mesh_cache_open(mesh_cache_t& cache, const char* source_path, u64 source_hash, u32 importer_flags)
+{
+    if(source_hash == 0)
+    {
+        return MESH_CACHE_MISSING;
+    }
+
+    std::string cache_path = mesh_cache_path(source_path);
+    map_file_readonly(cache.file, cache_path.c_str());
+    if(cache.file.memory == nullptr)
+    {
+        return MESH_CACHE_MISSING;
+    }
+
+    const u8* base = (const u8*) cache.file.memory;
+    const mesh_cache_header_t* header = (const mesh_cache_header_t*) base;
+    if(cache.file.size < sizeof(mesh_cache_header_t)
+        || header->magic != MESH_CACHE_MAGIC
+        || header->version != MESH_CACHE_VERSION
+        || header->source_hash != source_hash
+        || header->importer_flags != importer_flags
+        || header->floats_per_vertex != MESH_CACHE_FLOATS_PER_VERTEX
+        || header->file_size != cache.file.size
+        || !mesh_cache_is_layout_valid(header, base))
+    {
+        unmap_file(cache.file);
+        return MESH_CACHE_STALE;
+    }
+
+    cache.header = header;
+    cache.mesh_table = (const mesh_cache_mesh_entry_t*) (base + header->mesh_table_offset);
+    cache.material_table = (const mesh_cache_material_entry_t*) (base + header->material_table_offset);
+    cache.strings = (const char*) (base + header->strings_offset);
+    cache.vertex_blob = (const float*) (base + header->vertex_blob_offset);
+    cache.index_blob = (const u32*) (base + header->index_blob_offset);
+    cache.cluster_blob = (const mesh_cluster_t*) (base + header->cluster_blob_offset);
+    return MESH_CACHE_OK;
+}
+
+void mesh_cache_close(mesh_cache_t& cache)
+{
+    if(cache.file.memory)
+    {
+        unmap_file(cache.file);
+    }
+    cache = mesh_cache_t();
+}
+
+u64 mesh_cache_write(const char* source_path,
+                     u64 source_hash,
+                     u32 importer_flags,
+                     const std::vector<mesh_buffers_t>& meshes,
+                     const std::vector<std::string>& texture_paths)
+{
+    if(source_hash == 0)
+    {
+        return 0;
+    }
+
+    // Lay out the file
+    mesh_cache_header_t header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.source_hash = source_hash;
+    header.importer_flags = importer_flags;
+    header.mesh_count = (u32) meshes.size();
+    header.material_count = (u32) texture_paths.size();
+    header.floats_per_vertex = MESH_CACHE_FLOATS_PER_VERTEX;
+
+    u64 strings_size = 0;
+    for(const std::string& path : texture_paths)
+    {
+        strings_size += path.empty() ? 0 : path.size() + 1;
+    }
+    u64 vertex_blob_count = 0;
+    u64 index_blob_count = 0;
+    u64 cluster_blob_count = 0;
+    for(const mesh_buffers_t& mesh : meshes)
+    {
+        vertex_blob_count += mesh.vertices.size();
+        index_blob_count += mesh.indices.size();
+        cluster_blob_count += mesh.clusters.size();
+    }
+
+    header.mesh_table_offset = mesh_cache_align8(sizeof(mesh_cache_header_t));
+    header.material_table_offset = mesh_cache_align8(header.mesh_table_offset + sizeof(mesh_cache_mesh_entry_t) * header.mesh_count);
+    header.strings_offset = mesh_cache_align8(header.material_table_offset + sizeof(mesh_cache_material_entry_t) * header.material_count);
+    header.vertex_blob_offset = mesh_cache_align8(header.strings_offset + strings_size);
+    header.index_blob_offset = mesh_cache_align8(header.vertex_blob_offset + sizeof(float) * vertex_blob_count);
+    header.cluster_blob_offset = mesh_cache_align8(header.index_blob_offset + sizeof(u32) * index_blob_count);
+    header.file_size = header.cluster_blob_offset + sizeof(mesh_cluster_t) * cluster_blob_count;
+
+    u8* file_memory = (u8*) calloc(1, header.file_size);
+    if(file_memory == nullptr)
+    {
+        return 0;
+    }
+    memcpy(file_memory, &header, sizeof(header));
+
+    // Meshes and blobs
+    mesh_cache_mesh_entry_t* mesh_table = (mesh_cache_mesh_entry_t*) (file_memory + header.mesh_table_offset);
+    float* vertex_blob = (float*) (file_memory + header.vertex_blob_offset);
+    u32* index_blob = (u32*) (file_memory + header.index_blob_offset);
+    mesh_cluster_t* cluster_blob = (mesh_cluster_t*) (file_memory + header.cluster_blob_offset);
+    u64 vertex_cursor = 0;
+    u64 index_cursor = 0;
+    u64 cluster_cursor = 0;
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        const mesh_buffers_t& mesh = meshes[i];
+        mesh_cache_mesh_entry_t& entry = mesh_table[i];
+        entry.vertex_offset = vertex_cursor;
+        entry.index_offset = index_cursor;
+        entry.vertices_count = (u32) mesh.vertices.size();
+        entry.indices_count = (u32) mesh.indices.size();
+        entry.material_index = mesh.material_index;
+        entry.lods_count = mesh.lods_count;
+        for(u32 lod = 0; lod < mesh.lods_count; ++lod)
+        {
+            entry.lods[lod] = mesh.lods[lod];
+        }
+        entry.cluster_offset = cluster_cursor;
+        entry.clusters_count = (u32) mesh.clusters.size();
+        memcpy(entry.uv_rect, mesh.uv_rect, sizeof(entry.uv_rect));
+        if(!mesh.vertices.empty())
+        {
+            memcpy(vertex_blob + vertex_cursor, mesh.vertices.data(), sizeof(float) * mesh.vertices.size());
+        }
+        if(!mesh.indices.empty())
+        {
+            memcpy(index_blob + index_cursor, mesh.indices.data(), sizeof(u32) * mesh.indices.size());
+        }
+        if(!mesh.clusters.empty())
+        {
+            memcpy(cluster_blob + cluster_cursor, mesh.clusters.data(), sizeof(mesh_cluster_t) * mesh.clusters.size());
+        }
+        vertex_cursor += mesh.vertices.size();
+        index_cursor += mesh.indices.size();
+        cluster_cursor += mesh.clusters.size();
+    }
+
+    // Materials and texture paths
+    mesh_cache_material_entry_t* material_table = (mesh_cache_material_entry_t*) (file_memory + header.material_table_offset);
+    char* strings = (char*) (file_memory + header.strings_offset);
+    u32 string_cursor = 0;
+    for(size_t i = 0; i < texture_paths.size(); ++i)
+    {
+        const std::string& path = texture_paths[i];
+        material_table[i].texture_path_offset = string_cursor;
+        material_table[i].texture_path_length = (u32) path.size();
+        if(!path.empty())
+        {
+            memcpy(strings + string_cursor, path.c_str(), path.size() + 1);
+            string_cursor += (u32) path.size() + 1;
+        }
+    }
+
+    std::string cache_path = mesh_cache_path(source_path);
+    bool b_written = write_file_binary(cache_path.c_str(), file_memory, header.file_size);
+    free(file_memory);
+    return b_written ? header.file_size : 0;
+}
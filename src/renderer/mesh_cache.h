@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "mesh.h"
+#include "../runtime/memory_handle.h"
+
+/**
+    COOKED MESH CACHE
+
+    After a model is imported through Assimp the converted vertex and index buffers are
+    written next to the source file as <source path>.meshcache. On later runs the cache
+    file is memory mapped and the blobs are handed straight to mesh_t::gl_create_mesh,
+    so there is no parsing or conversion at all on a warm start. See model_streamer.h.
+
+    The cache is invalidated when the hash of the source file (and of the .mtl libraries of an
+    .obj), the importer flags, or MESH_CACHE_VERSION changes. A cache whose tables point
+    outside the file is treated as stale. Bump MESH_CACHE_VERSION whenever the layout of the file
+    or the conversion done by the model streamer changes.
+
+    File layout (all offsets are in bytes from the start of the file):
+        mesh_cache_header_t
+        mesh_cache_mesh_entry_t     [mesh_count]
+        mesh_cache_material_entry_t [material_count]
+        texture path strings (null terminated)
+        vertex blob (float)
+        index blob (u32, the LODs of each mesh back to back)
+        cluster blob (mesh_cluster_t)
+*/
+
+#define MESH_CACHE_MAGIC 0x4d474e58 // 'XNGM'
+#define MESH_CACHE_VERSION 6
+#define MESH_CACHE_FILE_EXTENSION ".meshcache"
+
+struct mesh_cache_header_t
+{
+    u32 magic;
+    u32 version;
+    u64 source_hash;
+    u32 importer_flags;
+    u32 mesh_count;
+    u32 material_count;
+    u32 floats_per_vertex;
+    u64 mesh_table_offset;
+    u64 material_table_offset;
+    u64 strings_offset;
+    u64 vertex_blob_offset;
+    u64 index_blob_offset;
+    u64 cluster_blob_offset;
+    u64 file_size;
+};
+
+struct mesh_cache_mesh_entry_t
+{
+    u64 vertex_offset;      // in floats from the start of the vertex blob
+    u64 index_offset;       // in indices from the start of the index blob
+    u32 vertices_count;     // number of floats
+    u32 indices_count;      // of every LOD together
+    u32 material_index;
+    u32 lods_count;
+    mesh_lod_t lods[MESH_MAX_LODS];
+    u64 cluster_offset;     // in clusters from the start of the cluster blob
+    u32 clusters_count;
+    u32 pad;
+    float uv_rect[4];
+};
+
+struct mesh_cache_material_entry_t
+{
+    u32 texture_path_offset; // in bytes from strings_offset
+    u32 texture_path_length; // 0 if the material has no diffuse texture
+};
+
+/** A mapped cache file. The tables and blobs point straight into the mapping, so they stay
+    valid until mesh_cache_close. */
+struct mesh_cache_t
+{
+    mapped_file_handle_t                file;
+    const mesh_cache_header_t*          header = nullptr;
+    const mesh_cache_mesh_entry_t*      mesh_table = nullptr;
+    const mesh_cache_material_entry_t*  material_table = nullptr;
+    const char*                         strings = nullptr;
+    const float*                        vertex_blob = nullptr;
+    const u32*                          index_blob = nullptr;
+    const mesh_cluster_t*               cluster_blob = nullptr;
+};
+
+enum mesh_cache_status_t
+{
+    MESH_CACHE_OK,
+    MESH_CACHE_MISSING,
+    MESH_CACHE_STALE
+};
+
+/** Hash of the source model file, with the material libraries it names folded in. Returns 0
+    if the file couldn't be read. */
+u64 mesh_cache_hash_source(const char* source_path);
+
+std::string mesh_cache_path(const char* source_path);
+
+/** Maps the cache of source_path if there is a valid one for the given source hash and
+    importer flags. Nothing is mapped unless MESH_CACHE_OK is returned. Doesn't touch GL or the
+    console, so it can run on a worker thread. */
+mesh_cache_status_t mesh_cache_open(mesh_cache_t& cache, const char* source_path, u64 source_hash, u32 importer_flags);
+
+void mesh_cache_close(mesh_cache_t& cache);
+
+/** Writes the cache file for source_path. texture_paths has one entry per material
+    (empty string if the material has no diffuse texture). Returns the size of the file
+    written, or 0 if it couldn't be written. Can run on a worker thread. */
+u64 mesh_cache_write(const char* source_path,
+                     u64 source_hash,
+                     u32 importer_flags,
+                     const std::vector<mesh_buffers_t>& meshes,
+                     const std::vector<std::string>& texture_paths);
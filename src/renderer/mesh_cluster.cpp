@@ -0,0 +1,351 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include "mesh_cluster.h"
+#include "mesh_optimizer.h"
+#include "../core/kc_math.h"
+
+/**
+    Clusters are grown greedily, the way meshlet builders usually do it: start from the first
+    unclustered triangle (in vertex cache order) and keep adding the neighbouring triangle that
+    adds the fewest new vertices, then the one closest to the cluster's centroid that faces the
+    same way as the cluster. A cluster ends when it's full or none of its neighbours fit.
+
+    Neighbours are found through positions instead of vertex indices, so that triangles across
+    a uv or normal seam (and every face of a flat shaded voxel mesh) still count as connected.
+*/
+
+internal vec3 cluster_position(const float* vertices, u32 vertex, u32 floats_per_vertex)
+{
+    const float* p = vertices + (size_t) vertex * floats_per_vertex;
+    return make_vec3(p[0], p[1], p[2]);
+}
+
+/** Ids that are the same for every vertex at the same position */
+internal void cluster_weld_positions(std::vector<u32>& out_position_ids, const float* vertices, u32 vertices_count, u32 floats_per_vertex)
+{
+    std::vector<u32> sorted(vertices_count);
+    for(u32 i = 0; i < vertices_count; ++i)
+    {
+        sorted[i] = i;
+    }
+    std::sort(sorted.begin(), sorted.end(), [vertices, floats_per_vertex](u32 a, u32 b)
+    {
+        return memcmp(vertices + (size_t) a * floats_per_vertex, vertices + (size_t) b * floats_per_vertex, 3 * sizeof(float)) < 0;
+    });
+
+    out_position_ids.resize(vertices_count);
+    for(u32 i = 0; i < vertices_count; ++i)
+    {
+        u32 v = sorted[i];
+        bool b_same_as_previous = i > 0 && memcmp(vertices + (size_t) v * floats_per_vertex,
+                                                  vertices + (size_t) sorted[i - 1] * floats_per_vertex, 3 * sizeof(float)) == 0;
+        out_position_ids[v] = b_same_as_previous ? out_position_ids[sorted[i - 1]] : v;
+    }
+}
+
+internal void cluster_compute_bounds(mesh_cluster_t& cluster,
+                                     const std::vector<u32>& triangles,
+                                     const u32* indices,
+                                     const float* vertices,
+                                     u32 floats_per_vertex,
+                                     const std::vector<vec3>& triangle_normals)
+{
+    // Bounding sphere around the center of the bounding box
+    vec3 bounds_min = cluster_position(vertices, indices[triangles[0] * 3], floats_per_vertex);
+    vec3 bounds_max = bounds_min;
+    for(u32 triangle : triangles)
+    {
+        for(u32 k = 0; k < 3; ++k)
+        {
+            vec3 p = cluster_position(vertices, indices[triangle * 3 + k], floats_per_vertex);
+            bounds_min = make_vec3(min(bounds_min.x, p.x), min(bounds_min.y, p.y), min(bounds_min.z, p.z));
+            bounds_max = make_vec3(max(bounds_max.x, p.x), max(bounds_max.y, p.y), max(bounds_max.z, p.z));
+        }
+    }
+    vec3 center = (bounds_min + bounds_max) * 0.5f;
+    float radius = 0.f;
+    for(u32 triangle : triangles)
+    {
+        for(u32 k = 0; k < 3; ++k)
+        {
+            radius = max(radius, magnitude(cluster_position(vertices, indices[triangle * 3 + k], floats_per_vertex) - center));
+        }
+    }
+
+    // Normal cone around the average normal. Degenerate triangles have no normal and can't be seen anyway.
+    vec3 normal_sum = make_vec3(0.f, 0.f, 0.f);
+    for(u32 triangle : triangles)
+    {
+        normal_sum += triangle_normals[triangle];
+    }
+    float normal_sum_length = magnitude(normal_sum);
+    vec3 axis = normal_sum_length > 0.f ? normal_sum / normal_sum_length : make_vec3(0.f, 0.f, 1.f);
+    float cone_cos = 1.f;
+    for(u32 triangle : triangles)
+    {
+        const vec3& n = triangle_normals[triangle];
+        if(n.x != 0.f || n.y != 0.f || n.z != 0.f)
+        {
+            cone_cos = min(cone_cos, dot(n, axis));
+        }
+    }
+    if(normal_sum_length <= 0.f || cone_cos < MESH_CLUSTER_MIN_CONE_COS)
+    {
+        cone_cos = 0.f;
+    }
+
+    cluster.center[0] = center.x;
+    cluster.center[1] = center.y;
+    cluster.center[2] = center.z;
+    cluster.radius = radius;
+    cluster.cone_axis[0] = axis.x;
+    cluster.cone_axis[1] = axis.y;
+    cluster.cone_axis[2] = axis.z;
+    cluster.cone_cos = cone_cos;
+    cluster.cone_sin = cone_cos > 0.f ? sqrtf(max(0.f, 1.f - cone_cos * cone_cos)) : 1.f;
+}
+
+void mesh_build_clusters(mesh_buffers_t& mesh)
+{
+    const u32 floats_per_vertex = 8;
+    const u32 vertices_count = (u32) mesh.vertices.size() / floats_per_vertex;
+    const u32 triangles_count = (u32) mesh.indices.size() / 3;
+    const u32* indices = mesh.indices.data();
+    const float* vertices = mesh.vertices.data();
+
+    mesh.clusters.clear();
+    if(triangles_count == 0)
+    {
+        return;
+    }
+
+    std::vector<vec3> triangle_normals(triangles_count);
+    std::vector<vec3> triangle_centroids(triangles_count);
+    for(u32 t = 0; t < triangles_count; ++t)
+    {
+        vec3 a = cluster_position(vertices, indices[t * 3 + 0], floats_per_vertex);
+        vec3 b = cluster_position(vertices, indices[t * 3 + 1], floats_per_vertex);
+        vec3 c = cluster_position(vertices, indices[t * 3 + 2], floats_per_vertex);
+        vec3 n = cross(b - a, c - a);
+        float length = magnitude(n);
+        triangle_normals[t] = length > 0.f ? n / length : make_vec3(0.f, 0.f, 0.f);
+        triangle_centroids[t] = (a + b + c) / 3.f;
+    }
+
+    // Triangles around each position
+    std::vector<u32> position_ids;
+    cluster_weld_positions(position_ids, vertices, vertices_count, floats_per_vertex);
+    std::vector<u32> adjacency_offsets(vertices_count + 1, 0);
+    for(u32 i = 0; i < triangles_count * 3; ++i)
+    {
+        ++adjacency_offsets[position_ids[indices[i]] + 1];
+    }
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    std::vector<u32> adjacency(triangles_count * 3);
+    {
+        std::vector<u32> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for(u32 i = 0; i < triangles_count * 3; ++i)
+        {
+            adjacency[cursor[position_ids[indices[i]]]++] = i / 3;
+        }
+    }
+
+    // Grow clusters
+    std::vector<u8> triangle_used(triangles_count, 0);
+    std::vector<u32> vertex_in_cluster(vertices_count, ~0u);        // cluster number the vertex was last added to
+    std::vector<u32> triangle_in_candidates(triangles_count, ~0u);  // cluster number it was last a candidate of
+    std::vector<u32> clustered_triangles;
+    std::vector<u32> cluster_offsets;
+    std::vector<u32> candidates;
+    clustered_triangles.reserve(triangles_count);
+
+    u32 seed = 0;
+    for(u32 cluster_number = 0; ; ++cluster_number)
+    {
+        while(seed < triangles_count && triangle_used[seed])
+        {
+            ++seed;
+        }
+        if(seed == triangles_count)
+        {
+            break;
+        }
+
+        cluster_offsets.push_back((u32) clustered_triangles.size());
+        candidates.clear();
+        u32 cluster_triangles_count = 0;
+        u32 cluster_vertices_count = 0;
+        vec3 normal_sum = make_vec3(0.f, 0.f, 0.f);
+        vec3 centroid_sum = make_vec3(0.f, 0.f, 0.f);
+
+        u32 next = seed;
+        while(next != ~0u)
+        {
+            triangle_used[next] = 1;
+            clustered_triangles.push_back(next);
+            ++cluster_triangles_count;
+            normal_sum += triangle_normals[next];
+            centroid_sum += triangle_centroids[next];
+            for(u32 k = 0; k < 3; ++k)
+            {
+                u32 v = indices[next * 3 + k];
+                if(vertex_in_cluster[v] != cluster_number)
+                {
+                    vertex_in_cluster[v] = cluster_number;
+                    ++cluster_vertices_count;
+                }
+                u32 p = position_ids[v];
+                for(u32 a = adjacency_offsets[p]; a < adjacency_offsets[p + 1]; ++a)
+                {
+                    u32 t = adjacency[a];
+                    if(!triangle_used[t] && triangle_in_candidates[t] != cluster_number)
+                    {
+                        triangle_in_candidates[t] = cluster_number;
+                        candidates.push_back(t);
+                    }
+                }
+            }
+            if(cluster_triangles_count == MESH_CLUSTER_MAX_TRIANGLES)
+            {
+                break;
+            }
+
+            vec3 centroid = centroid_sum / (float) cluster_triangles_count;
+            float normal_sum_length = magnitude(normal_sum);
+            vec3 axis = normal_sum_length > 0.f ? normal_sum / normal_sum_length : make_vec3(0.f, 0.f, 0.f);
+
+            next = ~0u;
+            u32 best_new_vertices = 4;
+            float best_score = FLT_MAX;
+            u32 kept = 0;
+            for(u32 c = 0; c < (u32) candidates.size(); ++c)
+            {
+                u32 t = candidates[c];
+                if(triangle_used[t])
+                {
+                    continue;
+                }
+                candidates[kept++] = t;
+
+                u32 a = indices[t * 3 + 0];
+                u32 b = indices[t * 3 + 1];
+                u32 d = indices[t * 3 + 2];
+                u32 new_vertices = (vertex_in_cluster[a] != cluster_number)
+                                 + (vertex_in_cluster[b] != cluster_number && b != a)
+                                 + (vertex_in_cluster[d] != cluster_number && d != a && d != b);
+                if(cluster_vertices_count + new_vertices > MESH_CLUSTER_MAX_VERTICES || new_vertices > best_new_vertices)
+                {
+                    continue;
+                }
+                float score = magnitude(triangle_centroids[t] - centroid)
+                            * (1.f + MESH_CLUSTER_CONE_WEIGHT * (1.f - dot(triangle_normals[t], axis)));
+                if(new_vertices < best_new_vertices || score < best_score)
+                {
+                    next = t;
+                    best_new_vertices = new_vertices;
+                    best_score = score;
+                }
+            }
+            candidates.resize(kept);
+        }
+    }
+    cluster_offsets.push_back(triangles_count);
+
+    // Bounds of each cluster, then order the clusters so that the ones facing out of the mesh draw
+    // first, which is what mesh_optimize_overdraw did for the whole mesh before
+    u32 clusters_count = (u32) cluster_offsets.size() - 1;
+    std::vector<mesh_cluster_t> clusters(clusters_count);
+    std::vector<u32> cluster_triangles;
+    vec3 mesh_centroid = make_vec3(0.f, 0.f, 0.f);
+    for(u32 t = 0; t < triangles_count; ++t)
+    {
+        mesh_centroid += triangle_centroids[t] / (float) triangles_count;
+    }
+    std::vector<float> sort_keys(clusters_count);
+    for(u32 c = 0; c < clusters_count; ++c)
+    {
+        cluster_triangles.assign(clustered_triangles.begin() + cluster_offsets[c], clustered_triangles.begin() + cluster_offsets[c + 1]);
+        cluster_compute_bounds(clusters[c], cluster_triangles, indices, vertices, floats_per_vertex, triangle_normals);
+        vec3 to_cluster = make_vec3(clusters[c].center[0], clusters[c].center[1], clusters[c].center[2]) - mesh_centroid;
+        sort_keys[c] = dot(to_cluster, make_vec3(clusters[c].cone_axis[0], clusters[c].cone_axis[1], clusters[c].cone_axis[2]));
+    }
+    std::vector<u32> cluster_order(clusters_count);
+    for(u32 c = 0; c < clusters_count; ++c)
+    {
+        cluster_order[c] = c;
+    }
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&sort_keys](u32 a, u32 b)
+    {
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    // Rewrite the index buffer cluster by cluster. Sorting a cluster's triangles by their old
+    // position keeps the vertex cache order they were in.
+    std::vector<u32> clustered_indices;
+    clustered_indices.reserve(mesh.indices.size());
+    mesh.clusters.reserve(clusters_count);
+    for(u32 c : cluster_order)
+    {
+        std::sort(clustered_triangles.begin() + cluster_offsets[c], clustered_triangles.begin() + cluster_offsets[c + 1]);
+        mesh_cluster_t cluster = clusters[c];
+        cluster.first_index = (u32) clustered_indices.size();
+        for(u32 i = cluster_offsets[c]; i < cluster_offsets[c + 1]; ++i)
+        {
+            u32 t = clustered_triangles[i];
+            clustered_indices.push_back(indices[t * 3 + 0]);
+            clustered_indices.push_back(indices[t * 3 + 1]);
+            clustered_indices.push_back(indices[t * 3 + 2]);
+        }
+        cluster.indices_count = (u32) clustered_indices.size() - cluster.first_index;
+        mesh.clusters.push_back(cluster);
+    }
+    mesh.indices.swap(clustered_indices);
+
+    // Vertices are fetched in a new order now
+    mesh_optimize_vertex_fetch(mesh, floats_per_vertex);
+}
+
+bool mesh_cluster_is_backfacing(const mesh_cluster_t& cluster, const float eye_position[3])
+{
+    if(cluster.cone_cos <= 0.f)
+    {
+        return false;
+    }
+
+    // Every triangle faces away if the most eye facing normal in the cone is still at less than
+    // 90 degrees to the direction to every point of the bounding sphere:
+    // |v| cos(angle between v and axis + cone angle) >= radius
+    vec3 v = make_vec3(cluster.center[0] - eye_position[0], cluster.center[1] - eye_position[1], cluster.center[2] - eye_position[2]);
+    float distance = magnitude(v);
+    if(distance <= cluster.radius)
+    {
+        return false;
+    }
+    float cos_v = dot(v, make_vec3(cluster.cone_axis[0], cluster.cone_axis[1], cluster.cone_axis[2])) / distance;
+    float sin_v = sqrtf(max(0.f, 1.f - cos_v * cos_v));
+    return distance * (cos_v * cluster.cone_cos - sin_v * cluster.cone_sin) >= cluster.radius;
+}
+
+bool mesh_cluster_is_backfacing_orthographic(const mesh_cluster_t& cluster, const float view_direction[3])
+{
+    if(cluster.cone_cos <= 0.f)
+    {
+        return false;
+    }
+
+    vec3 d = make_vec3(view_direction[0], view_direction[1], view_direction[2]);
+    float length = magnitude(d);
+    if(length <= 0.f)
+    {
+        return false;
+    }
+    float cos_d = dot(d, make_vec3(cluster.cone_axis[0], cluster.cone_axis[1], cluster.cone_axis[2])) / length;
+    float sin_d = sqrtf(max(0.f, 1.f - cos_d * cos_d));
+    return cos_d * cluster.cone_cos - sin_d * cluster.cone_sin > 0.f;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    MESH CLUSTER - splitting meshes into small clusters (meshlets) that get culled as a whole
+
+    LOD 0 of a mesh is cut into clusters of up to MESH_CLUSTER_MAX_TRIANGLES connected triangles
+    and its index buffer is reordered so that every cluster is one contiguous index range. Each
+    cluster gets a bounding sphere and a normal cone, so at draw time a cluster can be skipped
+    if its sphere is outside the view frustum or if every one of its triangles faces away.
+
+    The limits are the usual meshlet sizes (they fit a mesh shader or compute workgroup) so the
+    same clusters can be culled on the GPU later.
+
+    CPU only and thread safe.
+*/
+
+#define MESH_CLUSTER_MAX_TRIANGLES 124
+#define MESH_CLUSTER_MAX_VERTICES 64
+#define MESH_CLUSTER_CONE_WEIGHT 2.f        // how much growing a cluster prefers triangles facing its way over closer ones
+#define MESH_CLUSTER_MIN_CONE_COS 0.1f      // clusters with a wider normal cone than this are never backface culled
+
+/** Clusters the indices of an interleaved { x y z u v nx ny nz } mesh into mesh.clusters.
+    Triangles keep their vertex cache order within a cluster. Run after mesh_optimize and
+    before mesh_generate_lods (coarser LODs aren't clustered). */
+void mesh_build_clusters(mesh_buffers_t& mesh);
+
+/** True if every triangle of cluster faces away from a mesh space eye position. */
+bool mesh_cluster_is_backfacing(const mesh_cluster_t& cluster, const float eye_position[3]);
+
+/** True if every triangle of cluster faces away from a mesh space view direction (orthographic
+    views). view_direction points from the eye into the scene and doesn't need to be normalized. */
+bool mesh_cluster_is_backfacing_orthographic(const mesh_cluster_t& cluster, const float view_direction[3]);
@@ -1,163 +1,425 @@
 #include "mesh_group.h"
+#include "mesh_cluster.h"
+#include "model_streamer.h"
 #include "texture.h"
+#include "texture_streaming.h"
+#include "shader.h"
 #include "../core/kc_math.h"
-#include "../core/timer.h"
 #include "../debugging/console.h"
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
-void mesh_group_t::render()
+internal mesh_vertex_layout_t model_vertex_layout = MESH_LAYOUT_UNORM16;
+
+mesh_vertex_format_t mesh_group_get_vertex_format()
 {
-    for(size_t i = 0; i < meshes.size(); ++i)
+    mesh_vertex_format_t format;
+    if(model_vertex_layout != MESH_LAYOUT_FLOAT32)
     {
-        u16 mat_index = mesh_to_texture[i];
-        if(mat_index < textures.size() && textures[mat_index].texture_id != 0)
-        {
-            textures[mat_index].gl_use_texture();
-        }
+        format.position_encoding = model_vertex_layout == MESH_LAYOUT_FLOAT16 ? MESH_POSITION_FLOAT16 : MESH_POSITION_UNORM16;
+        format.texture_encoding = MESH_TEXCOORD_FLOAT16;
+        format.normal_encoding = MESH_NORMAL_OCT16;
+    }
+    return format;
+}
 
-        meshes[i].gl_render_mesh();
+void mesh_group_set_vertex_layout(int layout)
+{
+    if(layout < MESH_LAYOUT_FLOAT32 || layout > MESH_LAYOUT_FLOAT16)
+    {
+        console_printf("Vertex layouts: 0 float32, 1 unorm16 positions, 2 half positions\n");
+        return;
     }
+    model_vertex_layout = (mesh_vertex_layout_t) layout;
+    console_printf("Models loaded from now on use vertex layout %d (%d bytes per vertex)\n",
+                   layout, layout == MESH_LAYOUT_FLOAT32 ? 32 : 16);
 }
 
-void mesh_group_t::clear()
+void mesh_group_build_texture_arrays(mesh_group_t& group)
 {
-    for(size_t i = 0; i < meshes.size(); ++i)
+    // Arrays are fixed copies, streamed textures have to stay 2D textures to get their mips
+    if(!texture_array_is_enabled() || texture_streaming_is_enabled() || group.textures.empty() || !group.texture_arrays.empty())
     {
-        mesh_t::gl_delete_mesh(meshes[i]);
+        return;
     }
-    for(size_t i = 0; i < textures.size(); ++i)
+    if(!texture_array_build(group.texture_arrays, group.material_layers, group.textures))
     {
-        texture_t::gl_delete(textures[i]);
+        group.material_layers.clear();
+        return;
     }
+    if(group.texture_arrays.empty())
+    {
+        group.material_layers.clear();
+        return; // no material has a texture
+    }
+
+    console_printf("%u materials in %u texture arrays\n", (u32) group.material_layers.size(), (u32) group.texture_arrays.size());
+
+    // The arrays are copies, the 2D textures can go back to the residency manager
+    for(texture_t& texture : group.textures)
+    {
+        if(texture.texture_id != 0)
+        {
+            texture_t::gl_delete(texture);
+        }
+    }
+    group.textures.clear();
 }
 
-void mesh_group_t::assimp_load(const char* file_name)
+/** Culling state of a mesh_view_t for one mesh group, all in the mesh space of the group so
+    that mesh and cluster bounds can be tested without transforming them */
+struct mesh_group_culling_t
 {
-    timer::timestamp();
-
-    Assimp::Importer importer;
-    /*  NOTE: To create smooth normals respecting edges sharper than a given angle,
-        use importer.SetPropertyFloat("PP_GSN_MAX_SMOOTHING_ANGLE", 90) along with
-        aiProcess_GenSmoothNormals flag. https://github.com/assimp/assimp/issues/1713
-
-        aiProcess_GenSmoothNormals
-        This flag may not be specified together with #aiProcess_GenNormals. There's
-        a importer property, #AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE which allows you to
-        specify an angle maximum for the normal smoothing algorithm. Normals exceeding
-        this limit are not smoothed, resulting in a 'hard' seam between two faces.
-        Using a decent angle here (e.g. 80 degrees) results in very good visual
-        appearance. To create smooth normals respecting edges sharper than a given angle,
-        use importer.SetPropertyFloat("PP_GSN_MAX_SMOOTHING_ANGLE", 90) along with
-        aiProcess_GenSmoothNormals flag. https://github.com/assimp/assimp/issues/1713
-
-        aiProcess_JoinIdenticalVertices
-        is compulsory for indexed drawing. This still works with flat shaded geometry
-        because it only joins vertices that are identical in both position and normal.
-        e.g. a flat shaded cube will have 24 vertices after joining because each side
-        of the cube will have 4 unique vertices and the vertices at the corners will
-        not be shared by multiple faces of the cube because they will have different
-        normals even though their positions are the same.
-    */
-    const aiScene* scene = importer.ReadFile(file_name,
-                                             aiProcess_Triangulate
-                                             |aiProcess_GenNormals
-                                             |aiProcess_JoinIdenticalVertices
-    );
-    if(!scene)
-    {
-        console_printf("Model '%s' failed to load: %s\n", file_name, importer.GetErrorString());
-        return;
-    }
-    console_printf("took %f seconds to Importer::ReadFile\n", timer::timestamp());
+    vec4    frustum_planes[6];      // normalized, inside is dot(plane.xyz, p) + plane.w >= 0
+    bool    b_frustum = false;
+    float   eye[3];                 // mesh space eye position, or view direction if b_orthographic
+    bool    b_orthographic = false;
+    vec3    world_eye;
+    float   max_distance = 0.f;
+    float   model_scale = 1.f;
+};
+
+struct mesh_group_cluster_stats_t
+{
+    u64 meshes_culled = 0;
+    u64 clusters_drawn = 0;
+    u64 clusters_frustum_culled = 0;
+    u64 clusters_backface_culled = 0;
+    u64 draw_ranges = 0;
+};
+
+internal bool b_cluster_culling = true;
+internal mesh_group_cluster_stats_t cluster_stats;
+
+void mesh_group_set_cluster_culling(int enabled)
+{
+    b_cluster_culling = enabled != 0;
+    console_printf("Cluster culling %s\n", b_cluster_culling ? "on" : "off");
+}
 
-    meshes.resize(scene->mNumMeshes);
-    mesh_to_texture.resize(scene->mNumMeshes);
-    textures.resize(scene->mNumMaterials);
+void mesh_group_print_cluster_stats()
+{
+    u64 clusters_total = cluster_stats.clusters_drawn + cluster_stats.clusters_frustum_culled + cluster_stats.clusters_backface_culled;
+    console_printf("meshes culled: %llu\n", cluster_stats.meshes_culled);
+    console_printf("clusters drawn: %llu / %llu in %llu draw ranges\n", cluster_stats.clusters_drawn, clusters_total, cluster_stats.draw_ranges);
+    console_printf("clusters frustum culled: %llu, backface culled: %llu\n",
+                   cluster_stats.clusters_frustum_culled, cluster_stats.clusters_backface_culled);
+    cluster_stats = mesh_group_cluster_stats_t();
+}
 
-    console_printf("took %f seconds to resize 3 vectors\n", timer::timestamp());
+internal vec3 transform_point(const mat4& m, const float p[3])
+{
+    return make_vec3(m[0].x*p[0] + m[1].x*p[1] + m[2].x*p[2] + m[3].x,
+                     m[0].y*p[0] + m[1].y*p[1] + m[2].y*p[2] + m[3].y,
+                     m[0].z*p[0] + m[1].z*p[1] + m[2].z*p[2] + m[3].z);
+}
 
-    // Unpack meshes
-    for(size_t i = 0; i < scene->mNumMeshes; ++i)
+/** Inverse of the upper 3x3 of an affine model matrix, so points and directions can be brought
+    into mesh space. Returns false if the matrix is singular. */
+internal bool inverse_3x3(const mat4& m, mat3& out_inverse)
+{
+    float a = m[0].x, b = m[1].x, c = m[2].x;
+    float d = m[0].y, e = m[1].y, f = m[2].y;
+    float g = m[0].z, h = m[1].z, i = m[2].z;
+    float cofactor_a = e*i - f*h;
+    float cofactor_b = f*g - d*i;
+    float cofactor_c = d*h - e*g;
+    float determinant = a*cofactor_a + b*cofactor_b + c*cofactor_c;
+    if(determinant == 0.f)
     {
-        assimp_load_mesh_helper(i, scene->mMeshes[i]);
+        return false;
     }
+    float r = 1.f / determinant;
+    out_inverse[0] = make_vec3(cofactor_a * r, cofactor_b * r, cofactor_c * r);
+    out_inverse[1] = make_vec3((c*h - b*i) * r, (a*i - c*g) * r, (b*g - a*h) * r);
+    out_inverse[2] = make_vec3((b*f - c*e) * r, (c*d - a*f) * r, (a*e - b*d) * r);
+    return true;
+}
+
+internal void mesh_group_setup_culling(mesh_group_culling_t& culling, const mesh_view_t& view, float model_scale)
+{
+    culling.model_scale = model_scale;
+    culling.world_eye = view.eye_position;
+    culling.max_distance = view.max_distance;
+    culling.b_orthographic = view.b_orthographic;
 
-    console_printf("took %f seconds to unpack all the meshes\n", timer::timestamp());
+    // Planes of the frustum of view_projection * model are the mesh space frustum planes
+    mat4 matrix_view_projection = view.matrix_view_projection;
+    mat4 m = matrix_view_projection * view.matrix_model;
+    vec4 rows[4];
+    for(int row = 0; row < 4; ++row)
+    {
+        rows[row] = make_vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+    }
+    culling.b_frustum = view.b_frustum_cull;
+    for(int plane = 0; plane < 6; ++plane)
+    {
+        vec4 p = (plane & 1) ? rows[3] - rows[plane / 2] : rows[3] + rows[plane / 2];
+        float length = magnitude(make_vec3(p.x, p.y, p.z));
+        culling.frustum_planes[plane] = length > 0.f ? p / length : p;
+    }
 
-    // Load diffuse textures
-    for(size_t i = 0; i < scene->mNumMaterials; ++i)
+    mat3 inverse_model;
+    bool b_invertible = inverse_3x3(view.matrix_model, inverse_model);
+    vec3 eye;
+    if(view.b_orthographic)
     {
-        aiMaterial* mat = scene->mMaterials[i];
-        if(mat->GetTextureCount(aiTextureType_DIFFUSE))
+        // The view direction is the one direction that stays put in x and y in clip space, and goes
+        // deeper in z. Taking it from the mesh space matrix brings it into mesh space too.
+        vec3 x_row = make_vec3(rows[0].x, rows[0].y, rows[0].z);
+        vec3 y_row = make_vec3(rows[1].x, rows[1].y, rows[1].z);
+        vec3 z_row = make_vec3(rows[2].x, rows[2].y, rows[2].z);
+        eye = cross(x_row, y_row);
+        eye = dot(eye, z_row) < 0.f ? -eye : eye;
+    }
+    else
+    {
+        vec3 translation = make_vec3(view.matrix_model[3].x, view.matrix_model[3].y, view.matrix_model[3].z);
+        eye = inverse_model * (view.eye_position - translation);
+    }
+    if(!b_invertible)
+    {
+        eye = make_vec3(0.f, 0.f, 0.f); // nothing gets backface culled
+        culling.b_orthographic = true;
+    }
+    culling.eye[0] = eye.x;
+    culling.eye[1] = eye.y;
+    culling.eye[2] = eye.z;
+}
+
+/** True if the mesh space sphere is outside the view */
+internal bool mesh_group_cull_sphere(const mesh_group_culling_t& culling, const mat4& matrix_model, const float center[3], float radius)
+{
+    if(culling.b_frustum)
+    {
+        vec3 c = make_vec3(center[0], center[1], center[2]);
+        for(int plane = 0; plane < 6; ++plane)
         {
-            aiString path;
-            if(mat->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+            const vec4& p = culling.frustum_planes[plane];
+            if(p.x * c.x + p.y * c.y + p.z * c.z + p.w < -radius)
             {
-                int idx = (int)std::string(path.data).find_last_of("\\");
-                std::string texture_file_name = std::string(path.data).substr(idx+1);
-                std::string model_file_directory = std::string(file_name);
-                idx = max((int)model_file_directory.find_last_of("/"), (int)model_file_directory.find_last_of("\\"));
-                model_file_directory = model_file_directory.substr(0, idx + 1);
-
-                std::string tex_path = model_file_directory + texture_file_name;
-                texture_t::gl_create_from_file(textures[i], tex_path.c_str());
+                return true;
             }
         }
     }
+    if(culling.max_distance > 0.f)
+    {
+        float distance = magnitude(transform_point(matrix_model, center) - culling.world_eye);
+        if(distance - radius * culling.model_scale > culling.max_distance)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+internal u32 mesh_group_select_lod(const mesh_t& mesh, const mesh_view_t& view, float model_scale)
+{
+    if(mesh.lods_count <= 1 || view.pixels_per_unit <= 0.f || mesh.bounds_radius <= 0.f)
+    {
+        return 0;
+    }
+
+    float radius = mesh.bounds_radius * model_scale;
+    float projected_radius = radius * view.pixels_per_unit;
+    if(!view.b_orthographic)
+    {
+        float distance = magnitude(transform_point(view.matrix_model, mesh.bounds_center) - view.eye_position) - radius;
+        if(distance <= 0.f)
+        {
+            return 0; // inside the bounds
+        }
+        projected_radius /= distance;
+    }
 
-    console_printf("took %f seconds to load all the textures\n", timer::timestamp());
+    for(u32 lod = mesh.lods_count - 1; lod > 0; --lod)
+    {
+        float relative_error = mesh.lods[lod].error / mesh.bounds_radius;
+        if(relative_error * projected_radius <= view.max_error_pixels)
+        {
+            return lod;
+        }
+    }
+    return 0;
 }
 
-void mesh_group_t::assimp_load_mesh_helper(size_t mesh_index, aiMesh* mesh_node)
+/** Draws the clusters of LOD 0 of mesh that survive culling. Clusters next to each other in the
+    index buffer get merged into one range, and all the ranges go out in one multi draw. */
+internal void mesh_group_draw_clusters(const mesh_t& mesh, const mesh_group_culling_t& culling, const mat4& matrix_model)
 {
-    const u8 vb_entries_per_vertex = 8;
-    std::vector<float> vb(mesh_node->mNumVertices * vb_entries_per_vertex);
-    std::vector<u32> ib(mesh_node->mNumFaces * mesh_node->mFaces[0].mNumIndices);
-    if(mesh_node->mTextureCoords[0])
+    local_persist std::vector<u32> first_indices;
+    local_persist std::vector<i32> indices_counts;
+    first_indices.clear();
+    indices_counts.clear();
+
+    for(const mesh_cluster_t& cluster : mesh.clusters)
     {
-        for(size_t i = 0; i < mesh_node->mNumVertices; ++i)
+        if(mesh_group_cull_sphere(culling, matrix_model, cluster.center, cluster.radius))
+        {
+            ++cluster_stats.clusters_frustum_culled;
+            continue;
+        }
+        bool b_backfacing = culling.b_orthographic
+            ? mesh_cluster_is_backfacing_orthographic(cluster, culling.eye)
+            : mesh_cluster_is_backfacing(cluster, culling.eye);
+        if(b_backfacing)
+        {
+            ++cluster_stats.clusters_backface_culled;
+            continue;
+        }
+
+        ++cluster_stats.clusters_drawn;
+        if(!first_indices.empty() && first_indices.back() + (u32) indices_counts.back() == cluster.first_index)
         {
-            // mNormals and mVertices are both mNumVertices in size
-            size_t v_start_index = i * vb_entries_per_vertex;
-            vb[v_start_index] = mesh_node->mVertices[i].x;
-            vb[v_start_index + 1] = mesh_node->mVertices[i].y;
-            vb[v_start_index + 2] = mesh_node->mVertices[i].z;
-            vb[v_start_index + 3] = mesh_node->mTextureCoords[0][i].x;
-            vb[v_start_index + 4] = mesh_node->mTextureCoords[0][i].y;
-            vb[v_start_index + 5] = mesh_node->mNormals[i].x;
-            vb[v_start_index + 6] = mesh_node->mNormals[i].y;
-            vb[v_start_index + 7] = mesh_node->mNormals[i].z;
+            indices_counts.back() += (i32) cluster.indices_count;
+        }
+        else
+        {
+            first_indices.push_back(cluster.first_index);
+            indices_counts.push_back((i32) cluster.indices_count);
         }
     }
-    else
+
+    cluster_stats.draw_ranges += first_indices.size();
+    mesh.gl_draw_index_ranges(first_indices.data(), indices_counts.data(), (u32) first_indices.size());
+}
+
+void mesh_group_t::render(shader_t& shader, const mesh_view_t* view)
+{
+    // Largest axis scale of the model matrix, so that the LOD error and bounds are never underestimated
+    float model_scale = 0.f;
+    mesh_group_culling_t culling;
+    if(view)
     {
-        for(size_t i = 0; i < mesh_node->mNumVertices; ++i)
+        const mat4& m = view->matrix_model;
+        for(int axis = 0; axis < 3; ++axis)
         {
-            size_t v_start_index = i * vb_entries_per_vertex;
-            vb[v_start_index] = mesh_node->mVertices[i].x;
-            vb[v_start_index + 1] = mesh_node->mVertices[i].y;
-            vb[v_start_index + 2] = mesh_node->mVertices[i].z;
-            vb[v_start_index + 3] = 0.f;
-            vb[v_start_index + 4] = 0.f;
-            vb[v_start_index + 5] = mesh_node->mNormals[i].x;
-            vb[v_start_index + 6] = mesh_node->mNormals[i].y;
-            vb[v_start_index + 7] = mesh_node->mNormals[i].z;
+            model_scale = max(model_scale, magnitude(make_vec3(m[axis].x, m[axis].y, m[axis].z)));
         }
+        mesh_group_setup_culling(culling, *view, model_scale);
     }
 
-    for(size_t i = 0; i < mesh_node->mNumFaces; ++i)
+    i32 position_scale_location = shader.get_cached_uniform_location(UNIFORM("mesh_position_scale"));
+    i32 position_offset_location = shader.get_cached_uniform_location(UNIFORM("mesh_position_offset"));
+    i32 octahedral_normal_location = shader.get_cached_uniform_location(UNIFORM("b_mesh_octahedral_normal"));
+    i32 uv_rect_location = shader.get_cached_uniform_location(UNIFORM("mesh_uv_rect"));
+    i32 texture_array_location = shader.get_cached_uniform_location(UNIFORM("b_texture_array"));
+    i32 texture_layer_location = shader.get_cached_uniform_location(UNIFORM("texture_array_layer"));
+    bool b_texture_arrays = !texture_arrays.empty() && texture_layer_location >= 0;
+    if(texture_array_location >= 0)
     {
-        aiFace face = mesh_node->mFaces[i];
-        for(size_t j = 0; j < face.mNumIndices; ++j)
+        glUniform1i(texture_array_location, b_texture_arrays);
+    }
+    u16 bound_array = TEXTURE_ARRAY_NONE;
+    i32 bound_layer = -1;
+    texture_feedback_uniforms_t feedback_uniforms = texture_streaming_feedback_uniforms(shader);
+    if(b_texture_arrays)
+    {
+        texture_streaming_set_feedback(feedback_uniforms, nullptr);
+    }
+
+    // Meshes with the same vertex format share an arena VAO, so the VAO only gets rebound when
+    // the format changes and each mesh is just a base vertex draw.
+    u32 bound_vao = 0;
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        const mesh_t& mesh = meshes[i];
+        if(mesh.indices_count == 0)
+        {
+            continue;
+        }
+
+        u32 lod = 0;
+        if(view)
+        {
+            if(b_cluster_culling && mesh.bounds_radius > 0.f
+               && mesh_group_cull_sphere(culling, view->matrix_model, mesh.bounds_center, mesh.bounds_radius))
+            {
+                ++cluster_stats.meshes_culled;
+                continue;
+            }
+            lod = mesh_group_select_lod(mesh, *view, model_scale);
+        }
+
+        bool b_depth_only = view && view->b_depth_only;
+        u16 mat_index = mesh_to_texture[i];
+        if(!b_depth_only && b_texture_arrays)
+        {
+            // Meshes with the texture in the same array only change the layer uniform
+            if(mat_index < material_layers.size() && material_layers[mat_index].array_index != TEXTURE_ARRAY_NONE)
+            {
+                const texture_array_layer_t& layer = material_layers[mat_index];
+                if(layer.array_index != bound_array)
+                {
+                    glActiveTexture(GL_TEXTURE2);
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_arrays[layer.array_index]);
+                    bound_array = layer.array_index;
+                }
+                if((i32) layer.layer != bound_layer)
+                {
+                    glUniform1i(texture_layer_location, layer.layer);
+                    bound_layer = layer.layer;
+                }
+            }
+        }
+        else if(!b_depth_only && mat_index < textures.size() && textures[mat_index].texture_id != 0)
+        {
+            textures[mat_index].gl_use_texture();
+            texture_streaming_set_feedback(feedback_uniforms, &textures[mat_index]);
+        }
+
+        if(position_scale_location >= 0)
+        {
+            glUniform3fv(position_scale_location, 1, mesh.position_scale);
+            glUniform3fv(position_offset_location, 1, mesh.position_offset);
+        }
+        if(octahedral_normal_location >= 0)
+        {
+            glUniform1i(octahedral_normal_location, mesh.format.normal_encoding == MESH_NORMAL_OCT16);
+        }
+        if(uv_rect_location >= 0)
         {
-            ib[i * face.mNumIndices + j] = face.mIndices[j]; // prob sometimes not correct to index ib this way
+            glUniform4fv(uv_rect_location, 1, mesh.uv_rect);
+        }
+
+        u32 vao = b_depth_only && mesh.id_depth_vao != 0 ? mesh.id_depth_vao : mesh.id_vao;
+        if(vao != bound_vao)
+        {
+            glBindVertexArray(vao);
+            bound_vao = vao;
+        }
+        if(view && b_cluster_culling && lod == 0 && !mesh.clusters.empty())
+        {
+            mesh_group_draw_clusters(mesh, culling, view->matrix_model);
+        }
+        else
+        {
+            mesh.gl_draw_elements(GL_TRIANGLES, lod);
         }
     }
+    glBindVertexArray(0);
+}
 
-    mesh_t mesh;
-    mesh_t::gl_create_mesh(mesh, &vb[0], &ib[0], (u32)vb.size(), (u32)ib.size());
-    meshes[mesh_index] = mesh;
-    mesh_to_texture[mesh_index] = mesh_node->mMaterialIndex;
-}
\ No newline at end of file
+void mesh_group_t::clear()
+{
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        mesh_t::gl_delete_mesh(meshes[i]);
+    }
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        texture_t::gl_delete(textures[i]);
+    }
+    if(!buffers.empty())
+    {
+        glDeleteBuffers((GLsizei) buffers.size(), buffers.data());
+        buffers.clear();
+    }
+    texture_array_delete(texture_arrays);
+    material_layers.clear();
+    impostor_delete(impostor);
+}
+
+void mesh_group_t::assimp_load(const char* file_name)
+{
+    model_streamer_load(*this, file_name);
+    model_streamer_finish();
+}
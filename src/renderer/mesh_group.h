@@ -3,24 +3,84 @@
 #include <vector>
 
 #include "../gamedefine.h"
+#include "../core/kc_math.h"
 #include "mesh.h"
+#include "impostor.h"
+#include "texture_array.h"
 
 struct texture_t;
-class aiMesh;
+struct shader_t;
+struct mesh_group_t;
+
+/** Vertex layouts for the meshes of loaded models, see mesh_vertex_format_t */
+enum mesh_vertex_layout_t
+{
+    MESH_LAYOUT_FLOAT32 = 0,    // 32 bytes per vertex
+    MESH_LAYOUT_UNORM16 = 1,    // 16 bytes per vertex: unorm16 positions, half uvs, octahedral normals
+    MESH_LAYOUT_FLOAT16 = 2     // 16 bytes per vertex: half positions, half uvs, octahedral normals
+};
+
+/** Vertex format that models get stored in when they are loaded */
+mesh_vertex_format_t mesh_group_get_vertex_format();
+
+/** Console command. Takes effect for models loaded afterwards. */
+void mesh_group_set_vertex_layout(int layout);
+
+/** Copies the textures of group into texture arrays (texture_array.h) and gives back the
+    references to the 2D textures, so that render binds one texture per array instead of one
+    per mesh. Call once every texture of group is resident. Does nothing if texture arrays
+    are turned off. */
+void mesh_group_build_texture_arrays(mesh_group_t& group);
+
+/** Console commands. Culling of mesh clusters on/off, and how many clusters got drawn and
+    culled since the last time cluster_stats was called. */
+void mesh_group_set_cluster_culling(int enabled);
+void mesh_group_print_cluster_stats();
+
+/** The view a mesh_group_t is drawn from, used to pick a level of detail for every mesh and
+    to cull meshes and clusters that can't be seen.
+    The bounding sphere of each mesh is projected to get its size on screen, and a LOD's
+    error relative to that sphere then says how many pixels the LOD is off by. The coarsest
+    LOD that stays under max_error_pixels gets drawn.
+    Meshes and clusters are culled against the frustum of matrix_view_projection (or against
+    max_distance from the eye if the view has no single frustum, like a cube shadow map), and
+    clusters whose triangles all face away from the eye are skipped since GL_CULL_FACE would
+    throw every one of their triangles away anyway. */
+struct mesh_view_t
+{
+    vec3    eye_position;               // world space, unused by orthographic views
+    float   pixels_per_unit = 0.f;      // projection[1][1] * viewport height / 2. 0 always draws LOD 0
+    bool    b_orthographic = false;     // backface culls with the view direction of matrix_view_projection
+    float   max_error_pixels = 1.f;
+    mat4    matrix_model;               // of the mesh group being drawn
+    mat4    matrix_view_projection;
+    bool    b_frustum_cull = false;     // cull against matrix_view_projection
+    float   max_distance = 0.f;         // cull what is further than this from eye_position, 0 for no limit
+    bool    b_depth_only = false;       // shader only reads positions: draw through id_depth_vao, bind no textures
+    bool    b_impostors = false;        // G-buffer pass: render_scene may draw far away groups as their impostor
+};
 
 struct mesh_group_t
 {
     std::vector<mesh_t>     meshes;
     std::vector<texture_t>  textures;
     std::vector<u16>     mesh_to_texture;
+    std::vector<u32>     buffers;    // GPU buffers that meshes draw from without owning them (see gl_create_mesh_from_buffer)
+    impostor_t           impostor;   // baked once the group is resident, see impostor.h
+    std::vector<u32>     texture_arrays;     // GL_TEXTURE_2D_ARRAY objects, empty unless built by mesh_group_build_texture_arrays
+    std::vector<texture_array_layer_t>  material_layers;    // where the texture of every material is in texture_arrays
 
-    void render();
+    /** Draws every mesh with shader, which must already be in use. Sets the per mesh
+        position dequantization uniforms if shader has them. Draws LOD 0 of every mesh
+        without culling if view is nullptr.
+        If the group has texture arrays they get bound to texture unit 2 (only when the array
+        changes) and the layer goes in the texture_array_layer uniform, with b_texture_array
+        set, instead of binding a 2D texture to unit 1 for every mesh. */
+    void render(shader_t& shader, const mesh_view_t* view = nullptr);
 
     void clear();
 
+    /** Loads the model at file_name and blocks until it is fully resident. Use
+        model_streamer_load to load it in the background instead. */
     void assimp_load(const char* file_name);
-
-private:
-    void assimp_load_mesh_helper(size_t mesh_index, aiMesh* mesh_node);
-
 };
@@ -0,0 +1,115 @@
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+#include "mesh_merge.h"
+
+#define MERGE_FLOATS_PER_VERTEX 8
+
+void mesh_merge_transform(mesh_buffers_t& mesh, const mat4& transform)
+{
+    const mat4& m = transform;
+    float a = m[0][0], b = m[1][0], c = m[2][0];
+    float d = m[0][1], e = m[1][1], f = m[2][1];
+    float g = m[0][2], h = m[1][2], k = m[2][2];
+    // cofactor[col][row] is the cofactor of the element at row, col; it's the inverse transpose times the determinant
+    float cofactor[3][3] = { { e*k - f*h, f*g - d*k, d*h - e*g },
+                             { c*h - b*k, a*k - c*g, b*g - a*h },
+                             { b*f - c*e, c*d - a*f, a*e - b*d } };
+    float determinant = a*cofactor[0][0] + b*cofactor[0][1] + c*cofactor[0][2];
+
+    for(size_t i = 0; i + MERGE_FLOATS_PER_VERTEX <= mesh.vertices.size(); i += MERGE_FLOATS_PER_VERTEX)
+    {
+        float* vertex = &mesh.vertices[i];
+        float p[3] = { vertex[0], vertex[1], vertex[2] };
+        float n[3] = { vertex[5], vertex[6], vertex[7] };
+        float length_squared = 0.f;
+        for(int row = 0; row < 3; ++row)
+        {
+            vertex[row] = m[0][row] * p[0] + m[1][row] * p[1] + m[2][row] * p[2] + m[3][row];
+            vertex[5 + row] = cofactor[row][0] * n[0] + cofactor[row][1] * n[1] + cofactor[row][2] * n[2];
+            vertex[5 + row] = determinant < 0.f ? -vertex[5 + row] : vertex[5 + row];
+            length_squared += vertex[5 + row] * vertex[5 + row];
+        }
+        float length = sqrtf(length_squared);
+        for(int row = 0; row < 3; ++row)
+        {
+            vertex[5 + row] = length > 0.f ? vertex[5 + row] / length : 0.f;
+        }
+    }
+
+    if(determinant < 0.f)
+    {
+        for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            u32 swap = mesh.indices[i + 1];
+            mesh.indices[i + 1] = mesh.indices[i + 2];
+            mesh.indices[i + 2] = swap;
+        }
+    }
+}
+
+void mesh_merge_by_material(std::vector<mesh_buffers_t>& meshes, mesh_merge_stats_t* out_stats)
+{
+    mesh_merge_stats_t stats;
+    stats.meshes_before = (u32) meshes.size();
+
+    // A key is the first mesh seen with a material and tile, open_meshes has the merged mesh
+    // that its material and tile are appended to right now
+    std::vector<mesh_buffers_t> merged;
+    std::vector<const mesh_buffers_t*> keys;
+    std::vector<u32> open_meshes;
+    for(mesh_buffers_t& mesh : meshes)
+    {
+        u32 vertices_count = (u32) (mesh.vertices.size() / MERGE_FLOATS_PER_VERTEX);
+        if(vertices_count == 0 || mesh.indices.empty())
+        {
+            continue;
+        }
+
+        size_t key = 0;
+        while(key < keys.size() && (keys[key]->material_index != mesh.material_index
+                                    || memcmp(keys[key]->uv_rect, mesh.uv_rect, sizeof(mesh.uv_rect)) != 0))
+        {
+            ++key;
+        }
+        if(key == keys.size())
+        {
+            keys.push_back(&mesh);
+            open_meshes.push_back((u32) merged.size());
+            merged.push_back(mesh_buffers_t());
+            merged.back().material_index = mesh.material_index;
+            memcpy(merged.back().uv_rect, mesh.uv_rect, sizeof(mesh.uv_rect));
+        }
+
+        mesh_buffers_t* target = &merged[open_meshes[key]];
+        u32 base_vertex = (u32) (target->vertices.size() / MERGE_FLOATS_PER_VERTEX);
+        if(base_vertex > 0 && base_vertex + vertices_count > MESH_MERGE_MAX_VERTICES)
+        {
+            open_meshes[key] = (u32) merged.size();
+            merged.push_back(mesh_buffers_t());
+            merged.back().material_index = mesh.material_index;
+            memcpy(merged.back().uv_rect, mesh.uv_rect, sizeof(mesh.uv_rect));
+            target = &merged.back();
+            base_vertex = 0;
+        }
+
+        target->vertices.insert(target->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        size_t first_index = target->indices.size();
+        target->indices.insert(target->indices.end(), mesh.indices.begin(), mesh.indices.end());
+        for(size_t i = first_index; i < target->indices.size(); ++i)
+        {
+            target->indices[i] += base_vertex;
+        }
+        mesh.vertices = std::vector<float>();
+        mesh.indices = std::vector<u32>();
+    }
+
+    stats.materials_count = (u32) keys.size();
+    stats.meshes_after = (u32) merged.size();
+    meshes = std::move(merged);
+    if(out_stats)
+    {
+        *out_stats = stats;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+#include "mesh.h"
+
+/**
+    MESH MERGE - concatenating the static meshes of a model that share a material
+
+    Importers split models into many small meshes (Assimp gives sponza hundreds of aiMesh, and
+    the OBJ parser makes one per object and material), but mesh_group_t::render binds a texture
+    and draws once per mesh. Meshes with the same material (and the same wrapped atlas tile, see
+    mesh_voxel.h) are appended into one mesh at import, so draws go from one per mesh to about
+    one per material. Node transforms are baked into the vertices first (mesh_merge_transform),
+    since a merged mesh can't have a transform per part.
+
+    Merged meshes still get clustered, so culling stays about as fine grained as before; only
+    the whole mesh bounds get looser. A merged mesh stops growing at MESH_MERGE_MAX_VERTICES and
+    the rest of the material starts a new one, which keeps the LOD and cluster builds of one
+    mesh from serializing the whole import. CPU only and thread safe.
+*/
+
+#define MESH_MERGE_MAX_VERTICES (1 << 20)
+
+struct mesh_merge_stats_t
+{
+    u32 meshes_before = 0;
+    u32 meshes_after = 0;
+    u32 materials_count = 0;    // distinct material and atlas tile pairs
+};
+
+/** Transforms the vertices of an interleaved { x y z u v nx ny nz } mesh by transform. Normals
+    go through the inverse transpose and get normalized, and a mirroring transform flips the
+    winding of every triangle so front faces stay front faces. */
+void mesh_merge_transform(mesh_buffers_t& mesh, const mat4& transform);
+
+/** Replaces meshes with one mesh per material_index and uv_rect (more if one would go over
+    MESH_MERGE_MAX_VERTICES), in the order each material first shows up. Empty meshes are
+    dropped. Run before mesh_optimize, since LODs and clusters aren't carried over. */
+void mesh_merge_by_material(std::vector<mesh_buffers_t>& meshes, mesh_merge_stats_t* out_stats = nullptr);
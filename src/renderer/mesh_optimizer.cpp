@@ -0,0 +1,397 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "mesh_optimizer.h"
+#include "../core/kc_math.h"
+
+mesh_vertex_cache_stats_t mesh_analyze_vertex_cache(const u32* indices,
+                                                    u32 indices_count,
+                                                    u32 vertices_count,
+                                                    u32 cache_size)
+{
+    mesh_vertex_cache_stats_t stats;
+    stats.triangles_count = indices_count / 3;
+    stats.vertices_count = vertices_count;
+    if(indices_count == 0 || vertices_count == 0)
+    {
+        return stats;
+    }
+
+    // A vertex is in the FIFO cache if it was pushed less than cache_size misses ago
+    std::vector<u32> pushed_at(vertices_count, 0);
+    u32 timestamp = cache_size + 1;
+    for(u32 i = 0; i < indices_count; ++i)
+    {
+        u32 v = indices[i];
+        if(timestamp - pushed_at[v] > cache_size)
+        {
+            pushed_at[v] = timestamp++;
+            ++stats.cache_misses;
+        }
+    }
+
+    stats.acmr = (float) stats.cache_misses / (float) stats.triangles_count;
+    stats.atvr = (float) stats.cache_misses / (float) stats.vertices_count;
+    return stats;
+}
+
+/**
+    Linear-Speed Vertex Cache Optimisation - Tom Forsyth
+    https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+
+    Greedily emits the triangle with the highest score, where a triangle's score is the sum of
+    its vertex scores. Vertices score higher the more recently they were used (they're likely
+    still in the cache) and the fewer unemitted triangles they have left (so lone vertices
+    don't get left behind and cost a cache miss later).
+*/
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define FORSYTH_MAX_VALENCE 64
+
+internal float forsyth_cache_scores[FORSYTH_CACHE_SIZE + 1];
+internal float forsyth_valence_scores[FORSYTH_MAX_VALENCE + 1];
+
+internal bool forsyth_build_score_tables()
+{
+    for(u32 i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+    {
+        if(i < 3)
+        {
+            forsyth_cache_scores[i] = FORSYTH_LAST_TRI_SCORE; // last triangle - same score for all 3 so order doesn't matter
+        }
+        else
+        {
+            float scaler = 1.f / (float) (FORSYTH_CACHE_SIZE - 3);
+            forsyth_cache_scores[i] = powf(1.f - (float) (i - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+    forsyth_cache_scores[FORSYTH_CACHE_SIZE] = 0.f; // not in cache
+    forsyth_valence_scores[0] = 0.f;
+    for(u32 i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+    {
+        forsyth_valence_scores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float) i, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+    return true;
+}
+
+internal float forsyth_vertex_score(u32 cache_position, u32 remaining_valence)
+{
+    if(remaining_valence == 0)
+    {
+        return -1.f; // no triangles left that need this vertex
+    }
+    return forsyth_cache_scores[cache_position] + forsyth_valence_scores[min(remaining_valence, (u32) FORSYTH_MAX_VALENCE)];
+}
+
+void mesh_optimize_vertex_cache(u32* indices, u32 indices_count, u32 vertices_count)
+{
+    u32 triangles_count = indices_count / 3;
+    if(triangles_count == 0 || vertices_count == 0)
+    {
+        return;
+    }
+    local_persist bool b_score_tables_built = forsyth_build_score_tables(); // static init is thread safe
+    (void) b_score_tables_built;
+
+    // Vertex to triangle adjacency
+    std::vector<u32> valence(vertices_count, 0);
+    for(u32 i = 0; i < indices_count; ++i)
+    {
+        ++valence[indices[i]];
+    }
+    std::vector<u32> adjacency_offsets(vertices_count + 1, 0);
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + valence[v];
+    }
+    std::vector<u32> adjacency(indices_count);
+    std::vector<u32> adjacency_fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for(u32 t = 0; t < triangles_count; ++t)
+    {
+        for(u32 k = 0; k < 3; ++k)
+        {
+            u32 v = indices[t * 3 + k];
+            adjacency[adjacency_fill[v]++] = t;
+        }
+    }
+
+    std::vector<u32> remaining_valence = valence;
+    std::vector<u32> cache_position(vertices_count, FORSYTH_CACHE_SIZE);
+    std::vector<float> vertex_score(vertices_count);
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        vertex_score[v] = forsyth_vertex_score(FORSYTH_CACHE_SIZE, remaining_valence[v]);
+    }
+    std::vector<float> triangle_score(triangles_count);
+    std::vector<bool> b_triangle_emitted(triangles_count, false);
+    for(u32 t = 0; t < triangles_count; ++t)
+    {
+        triangle_score[t] = vertex_score[indices[t*3]] + vertex_score[indices[t*3+1]] + vertex_score[indices[t*3+2]];
+    }
+
+    std::vector<u32> output(indices_count);
+    u32 cache[FORSYTH_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 scan_cursor = 0; // for finding the next best triangle when nothing in the cache is adjacent
+    i64 best_triangle = -1;
+
+    for(u32 emitted = 0; emitted < triangles_count; ++emitted)
+    {
+        if(best_triangle < 0)
+        {
+            // Nothing in the cache has triangles left (e.g. we finished a disconnected piece of the
+            // mesh). Scanning every triangle for the best score here is quadratic on meshes made of
+            // many small pieces like voxel worlds, so just take the next unemitted one in input order.
+            while(b_triangle_emitted[scan_cursor])
+            {
+                ++scan_cursor;
+            }
+            best_triangle = scan_cursor;
+        }
+
+        u32 tri = (u32) best_triangle;
+        b_triangle_emitted[tri] = true;
+        const u32* tri_indices = indices + tri * 3;
+        output[emitted * 3 + 0] = tri_indices[0];
+        output[emitted * 3 + 1] = tri_indices[1];
+        output[emitted * 3 + 2] = tri_indices[2];
+
+        // Move the triangle's vertices to the front of the LRU cache
+        u32 new_cache[FORSYTH_CACHE_SIZE + 3];
+        u32 new_cache_count = 0;
+        for(u32 k = 0; k < 3; ++k)
+        {
+            u32 v = tri_indices[k];
+            new_cache[new_cache_count++] = v;
+            // remove this triangle from the vertex's adjacency list
+            u32* adj_begin = &adjacency[adjacency_offsets[v]];
+            u32* adj_end = adj_begin + remaining_valence[v];
+            u32* found = std::find(adj_begin, adj_end, tri);
+            if(found != adj_end)
+            {
+                std::swap(*found, *(adj_end - 1));
+                --remaining_valence[v];
+            }
+        }
+        for(u32 c = 0; c < cache_count; ++c)
+        {
+            u32 v = cache[c];
+            if(v != tri_indices[0] && v != tri_indices[1] && v != tri_indices[2])
+            {
+                new_cache[new_cache_count++] = v;
+            }
+        }
+
+        // Rescore everything that was or is in the cache
+        for(u32 c = 0; c < new_cache_count; ++c)
+        {
+            u32 v = new_cache[c];
+            cache_position[v] = c < FORSYTH_CACHE_SIZE ? c : FORSYTH_CACHE_SIZE;
+            float new_score = forsyth_vertex_score(cache_position[v], remaining_valence[v]);
+            float score_delta = new_score - vertex_score[v];
+            vertex_score[v] = new_score;
+            const u32* adj = &adjacency[adjacency_offsets[v]];
+            for(u32 a = 0; a < remaining_valence[v]; ++a)
+            {
+                triangle_score[adj[a]] += score_delta;
+            }
+        }
+
+        // The next triangle is the best one that uses a vertex in the cache
+        best_triangle = -1;
+        float best_score = -1.f;
+        u32 cache_limit = min(new_cache_count, (u32) FORSYTH_CACHE_SIZE);
+        for(u32 c = 0; c < cache_limit; ++c)
+        {
+            u32 v = new_cache[c];
+            const u32* adj = &adjacency[adjacency_offsets[v]];
+            for(u32 a = 0; a < remaining_valence[v]; ++a)
+            {
+                u32 t = adj[a];
+                if(triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        cache_count = min(new_cache_count, (u32) FORSYTH_CACHE_SIZE);
+        memcpy(cache, new_cache, sizeof(u32) * cache_count);
+    }
+
+    memcpy(indices, output.data(), sizeof(u32) * indices_count);
+}
+
+/**
+    Overdraw optimization based on "Fast Triangle Reordering for Vertex Locality and Reduced
+    Overdraw" - Sander, Nehab, Barczak. The cache optimized triangle order is cut into clusters at
+    points where a cluster's ACMR is no worse than the whole mesh's (times threshold) and the next
+    triangle would start fresh in the cache. Clusters are then sorted so that the ones facing away
+    from the mesh center (likely occluders) draw first.
+*/
+struct overdraw_cluster_t
+{
+    u32     first_triangle;
+    u32     triangles_count;
+    float   sort_key;
+};
+
+void mesh_optimize_overdraw(u32* indices,
+                            u32 indices_count,
+                            const float* vertices,
+                            u32 vertices_count,
+                            u32 floats_per_vertex,
+                            float threshold)
+{
+    u32 triangles_count = indices_count / 3;
+    if(triangles_count < 2 || vertices_count == 0)
+    {
+        return;
+    }
+
+    float mesh_acmr = mesh_analyze_vertex_cache(indices, indices_count, vertices_count).acmr;
+
+    // Split into clusters
+    std::vector<overdraw_cluster_t> clusters;
+    std::vector<u32> pushed_at(vertices_count, 0);
+    u32 timestamp = MESH_OPTIMIZER_CACHE_SIZE + 1;
+    u32 cluster_start = 0;
+    u32 cluster_misses = 0;
+    for(u32 t = 0; t < triangles_count; ++t)
+    {
+        u32 triangle_misses = 0;
+        for(u32 k = 0; k < 3; ++k)
+        {
+            u32 v = indices[t * 3 + k];
+            if(timestamp - pushed_at[v] > MESH_OPTIMIZER_CACHE_SIZE)
+            {
+                pushed_at[v] = timestamp++;
+                ++triangle_misses;
+            }
+        }
+
+        u32 cluster_triangles = t - cluster_start;
+        if(cluster_triangles > 0 && triangle_misses == 3
+            && (float) cluster_misses / (float) cluster_triangles <= mesh_acmr * threshold)
+        {
+            clusters.push_back({ cluster_start, cluster_triangles, 0.f });
+            cluster_start = t;
+            cluster_misses = 0;
+        }
+        cluster_misses += triangle_misses;
+    }
+    clusters.push_back({ cluster_start, triangles_count - cluster_start, 0.f });
+    if(clusters.size() < 2)
+    {
+        return;
+    }
+
+    // Mesh centroid
+    vec3 mesh_center = make_vec3(0.f, 0.f, 0.f);
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        const float* p = vertices + v * floats_per_vertex;
+        mesh_center += make_vec3(p[0], p[1], p[2]);
+    }
+    mesh_center /= (float) vertices_count;
+
+    // Sort key is how much the cluster faces away from the mesh center
+    for(overdraw_cluster_t& cluster : clusters)
+    {
+        vec3 cluster_center = make_vec3(0.f, 0.f, 0.f);
+        vec3 cluster_normal = make_vec3(0.f, 0.f, 0.f);
+        float cluster_area = 0.f;
+        for(u32 t = cluster.first_triangle; t < cluster.first_triangle + cluster.triangles_count; ++t)
+        {
+            const float* a = vertices + indices[t * 3 + 0] * floats_per_vertex;
+            const float* b = vertices + indices[t * 3 + 1] * floats_per_vertex;
+            const float* c = vertices + indices[t * 3 + 2] * floats_per_vertex;
+            vec3 pa = make_vec3(a[0], a[1], a[2]);
+            vec3 pb = make_vec3(b[0], b[1], b[2]);
+            vec3 pc = make_vec3(c[0], c[1], c[2]);
+            vec3 area_normal = cross(pb - pa, pc - pa); // length is twice the triangle area
+            float area = magnitude(area_normal);
+            cluster_center += (pa + pb + pc) * (area / 3.f);
+            cluster_normal += area_normal;
+            cluster_area += area;
+        }
+        if(cluster_area > 0.f)
+        {
+            cluster_center /= cluster_area;
+        }
+        float normal_length = magnitude(cluster_normal);
+        if(normal_length > 0.f)
+        {
+            cluster_normal /= normal_length;
+        }
+        cluster.sort_key = dot(cluster_center - mesh_center, cluster_normal);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const overdraw_cluster_t& a, const overdraw_cluster_t& b)
+        { return a.sort_key > b.sort_key; });
+
+    std::vector<u32> output(indices_count);
+    u32 cursor = 0;
+    for(const overdraw_cluster_t& cluster : clusters)
+    {
+        memcpy(&output[cursor], indices + cluster.first_triangle * 3, sizeof(u32) * cluster.triangles_count * 3);
+        cursor += cluster.triangles_count * 3;
+    }
+    memcpy(indices, output.data(), sizeof(u32) * indices_count);
+}
+
+void mesh_optimize_vertex_fetch(mesh_buffers_t& mesh, u32 floats_per_vertex)
+{
+    u32 vertices_count = (u32) mesh.vertices.size() / floats_per_vertex;
+    const u32 UNUSED = 0xffffffff;
+    std::vector<u32> remap(vertices_count, UNUSED);
+    std::vector<float> remapped_vertices(mesh.vertices.size());
+    u32 next_vertex = 0;
+    for(u32& index : mesh.indices)
+    {
+        if(remap[index] == UNUSED)
+        {
+            remap[index] = next_vertex;
+            memcpy(&remapped_vertices[next_vertex * floats_per_vertex],
+                   &mesh.vertices[index * floats_per_vertex],
+                   sizeof(float) * floats_per_vertex);
+            ++next_vertex;
+        }
+        index = remap[index];
+    }
+    // Vertices that no triangle uses get dropped
+    remapped_vertices.resize(next_vertex * floats_per_vertex);
+    mesh.vertices.swap(remapped_vertices);
+}
+
+void mesh_optimize(mesh_buffers_t& mesh,
+                   mesh_vertex_cache_stats_t* out_stats_before,
+                   mesh_vertex_cache_stats_t* out_stats_after)
+{
+    const u32 floats_per_vertex = 8;
+    u32 vertices_count = (u32) mesh.vertices.size() / floats_per_vertex;
+    u32 indices_count = (u32) mesh.indices.size();
+    if(vertices_count == 0 || indices_count == 0)
+    {
+        return;
+    }
+
+    if(out_stats_before)
+    {
+        *out_stats_before = mesh_analyze_vertex_cache(mesh.indices.data(), indices_count, vertices_count);
+    }
+
+    mesh_optimize_vertex_cache(mesh.indices.data(), indices_count, vertices_count);
+    mesh_optimize_overdraw(mesh.indices.data(), indices_count, mesh.vertices.data(), vertices_count, floats_per_vertex);
+    mesh_optimize_vertex_fetch(mesh, floats_per_vertex);
+
+    if(out_stats_after)
+    {
+        *out_stats_after = mesh_analyze_vertex_cache(mesh.indices.data(), indices_count, (u32) mesh.vertices.size() / floats_per_vertex);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    MESH OPTIMIZER - import time reordering of index and vertex buffers
+
+    Run in this order on a triangle list:
+        1. mesh_optimize_vertex_cache   reorders triangles so that vertices get reused while they
+                                        are still in the post-transform vertex cache (Forsyth)
+        2. mesh_optimize_overdraw       splits the cache optimized triangle order into clusters and
+                                        sorts the clusters so that outward facing ones draw first
+        3. mesh_optimize_vertex_fetch   reorders vertices in the order the index buffer first uses
+                                        them, so vertex fetches walk memory linearly
+
+    None of these change what gets rendered, only the order. They are CPU only and thread safe,
+    so they can run from the worker pool.
+*/
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16 // FIFO cache size used to measure ACMR/ATVR
+
+/** Post-transform vertex cache efficiency of an index buffer, measured with a FIFO cache.
+    acmr: average cache miss ratio - vertex shader invocations per triangle (0.5 is ideal, 3 is worst)
+    atvr: average transformed vertex ratio - vertex shader invocations per vertex (1 is ideal) */
+struct mesh_vertex_cache_stats_t
+{
+    u32     triangles_count = 0;
+    u32     vertices_count = 0;
+    u32     cache_misses = 0;
+    float   acmr = 0.f;
+    float   atvr = 0.f;
+};
+
+mesh_vertex_cache_stats_t mesh_analyze_vertex_cache(const u32* indices,
+                                                    u32 indices_count,
+                                                    u32 vertices_count,
+                                                    u32 cache_size = MESH_OPTIMIZER_CACHE_SIZE);
+
+void mesh_optimize_vertex_cache(u32* indices, u32 indices_count, u32 vertices_count);
+
+/** threshold: how much worse than the whole mesh (e.g. 1.05 = 5%) a cluster's ACMR may get
+    before it is allowed to end. Larger threshold means more, smaller clusters, so better
+    overdraw but worse vertex cache efficiency. */
+void mesh_optimize_overdraw(u32* indices,
+                            u32 indices_count,
+                            const float* vertices,
+                            u32 vertices_count,
+                            u32 floats_per_vertex,
+                            float threshold = 1.05f);
+
+void mesh_optimize_vertex_fetch(mesh_buffers_t& mesh, u32 floats_per_vertex);
+
+/** Runs all three optimizations on an interleaved { x y z u v nx ny nz } mesh and returns the
+    vertex cache stats from before and after. */
+void mesh_optimize(mesh_buffers_t& mesh,
+                   mesh_vertex_cache_stats_t* out_stats_before = nullptr,
+                   mesh_vertex_cache_stats_t* out_stats_after = nullptr);
@@ -0,0 +1,234 @@
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include "mesh_quantize.h"
+
+u16 float_to_half(float value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    u32 sign = (bits >> 16) & 0x8000;
+    u32 mantissa = bits & 0x007fffff;
+    i32 exponent = (i32)((bits >> 23) & 0xff) - 127 + 15;
+
+    if((bits & 0x7fffffff) > 0x7f800000)
+    {
+        return (u16)(sign | 0x7e00); // NaN
+    }
+    if(exponent >= 31)
+    {
+        return (u16)(sign | 0x7c00); // too large, infinity
+    }
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+        {
+            return (u16) sign; // too small, zero
+        }
+        // denormal half
+        mantissa |= 0x00800000;
+        u32 shift = (u32)(14 - exponent);
+        u32 half_mantissa = mantissa >> shift;
+        if((mantissa >> (shift - 1)) & 1)
+        {
+            ++half_mantissa;
+        }
+        return (u16)(sign | half_mantissa);
+    }
+
+    u32 half = sign | ((u32) exponent << 10) | (mantissa >> 13);
+    if(mantissa & 0x00001000)
+    {
+        ++half; // round to nearest, a carry into the exponent is still correct
+    }
+    return (u16) half;
+}
+
+internal i16 float_to_snorm16(float value)
+{
+    value = value < -1.f ? -1.f : (value > 1.f ? 1.f : value);
+    return (i16) lroundf(value * 32767.f);
+}
+
+void octahedral_encode_normal(float x, float y, float z, i16 out_encoded[2])
+{
+    float l1_norm = fabsf(x) + fabsf(y) + fabsf(z);
+    if(l1_norm <= 0.f)
+    {
+        out_encoded[0] = 0;
+        out_encoded[1] = 0;
+        return;
+    }
+    float ox = x / l1_norm;
+    float oy = y / l1_norm;
+    if(z < 0.f)
+    {
+        // fold the lower hemisphere over the diagonals
+        float fx = (1.f - fabsf(oy)) * (ox >= 0.f ? 1.f : -1.f);
+        float fy = (1.f - fabsf(ox)) * (oy >= 0.f ? 1.f : -1.f);
+        ox = fx;
+        oy = fy;
+    }
+    out_encoded[0] = float_to_snorm16(ox);
+    out_encoded[1] = float_to_snorm16(oy);
+}
+
+u32 mesh_vertex_format_position_bytes(mesh_vertex_format_t format)
+{
+    if(format.position_encoding == MESH_POSITION_FLOAT32)
+    {
+        return sizeof(float) * format.vertex_attrib_size;
+    }
+    return (sizeof(u16) * format.vertex_attrib_size + 3) & ~3u;
+}
+
+u32 mesh_vertex_format_texcoord_bytes(mesh_vertex_format_t format)
+{
+    if(format.texture_encoding == MESH_TEXCOORD_FLOAT32)
+    {
+        return sizeof(float) * format.texture_attrib_size;
+    }
+    return (sizeof(u16) * format.texture_attrib_size + 3) & ~3u;
+}
+
+u32 mesh_vertex_format_normal_bytes(mesh_vertex_format_t format)
+{
+    if(format.normal_attrib_size == 0)
+    {
+        return 0;
+    }
+    if(format.normal_encoding == MESH_NORMAL_FLOAT32)
+    {
+        return sizeof(float) * format.normal_attrib_size;
+    }
+    return 2 * sizeof(i16);
+}
+
+u32 mesh_vertex_format_stride_bytes(mesh_vertex_format_t format)
+{
+    return mesh_vertex_format_position_bytes(format)
+        + mesh_vertex_format_texcoord_bytes(format)
+        + mesh_vertex_format_normal_bytes(format);
+}
+
+bool mesh_vertex_format_is_float32(mesh_vertex_format_t format)
+{
+    return format.position_encoding == MESH_POSITION_FLOAT32
+        && (format.texture_attrib_size == 0 || format.texture_encoding == MESH_TEXCOORD_FLOAT32)
+        && (format.normal_attrib_size == 0 || format.normal_encoding == MESH_NORMAL_FLOAT32);
+}
+
+void mesh_quantize_vertices(std::vector<u8>& out_vertex_data,
+                            float out_position_scale[3],
+                            float out_position_offset[3],
+                            mesh_vertex_format_t format,
+                            const float* vertices,
+                            u32 vertices_count)
+{
+    const u32 position_size = format.vertex_attrib_size;
+    const u32 floats_per_vertex = format.vertex_attrib_size + format.texture_attrib_size + format.normal_attrib_size;
+    const u32 position_bytes = mesh_vertex_format_position_bytes(format);
+    const u32 texcoord_bytes = mesh_vertex_format_texcoord_bytes(format);
+    const u32 stride_bytes = mesh_vertex_format_stride_bytes(format);
+    ASSERT(position_size <= 3)
+    ASSERT(format.normal_encoding != MESH_NORMAL_OCT16 || format.normal_attrib_size == 3)
+
+    // Mesh bounds for the position dequantization transform
+    float bounds_min[3] = { 0.f, 0.f, 0.f };
+    float bounds_max[3] = { 0.f, 0.f, 0.f };
+    for(u32 axis = 0; axis < position_size && vertices_count > 0; ++axis)
+    {
+        bounds_min[axis] = FLT_MAX;
+        bounds_max[axis] = -FLT_MAX;
+        for(u32 i = 0; i < vertices_count; ++i)
+        {
+            float p = vertices[i * floats_per_vertex + axis];
+            bounds_min[axis] = p < bounds_min[axis] ? p : bounds_min[axis];
+            bounds_max[axis] = p > bounds_max[axis] ? p : bounds_max[axis];
+        }
+    }
+    for(u32 axis = 0; axis < 3; ++axis)
+    {
+        float extent = bounds_max[axis] - bounds_min[axis];
+        switch(format.position_encoding)
+        {
+            case MESH_POSITION_UNORM16: // stored [0, 1] across the bounds
+            {
+                out_position_scale[axis] = extent;
+                out_position_offset[axis] = bounds_min[axis];
+            } break;
+            case MESH_POSITION_FLOAT16: // stored [-1, 1] around the center, halves keep the most precision there
+            {
+                out_position_scale[axis] = extent > 0.f ? 0.5f * extent : 1.f;
+                out_position_offset[axis] = 0.5f * (bounds_min[axis] + bounds_max[axis]);
+            } break;
+            default:
+            {
+                out_position_scale[axis] = 1.f;
+                out_position_offset[axis] = 0.f;
+            }
+        }
+    }
+
+    out_vertex_data.assign((size_t) vertices_count * stride_bytes, 0);
+    for(u32 i = 0; i < vertices_count; ++i)
+    {
+        const float* vertex = vertices + (size_t) i * floats_per_vertex;
+        u8* out_vertex = out_vertex_data.data() + (size_t) i * stride_bytes;
+
+        // position
+        if(format.position_encoding == MESH_POSITION_FLOAT32)
+        {
+            memcpy(out_vertex, vertex, position_bytes);
+        }
+        else
+        {
+            u16* out_position = (u16*) out_vertex;
+            for(u32 axis = 0; axis < position_size; ++axis)
+            {
+                float normalized = (vertex[axis] - out_position_offset[axis]) / out_position_scale[axis];
+                if(format.position_encoding == MESH_POSITION_UNORM16)
+                {
+                    normalized = out_position_scale[axis] > 0.f ? normalized : 0.f;
+                    out_position[axis] = (u16) lroundf((normalized < 0.f ? 0.f : (normalized > 1.f ? 1.f : normalized)) * 65535.f);
+                }
+                else
+                {
+                    out_position[axis] = float_to_half(normalized);
+                }
+            }
+        }
+
+        // uv
+        const float* texcoord = vertex + format.vertex_attrib_size;
+        u8* out_texcoord = out_vertex + position_bytes;
+        if(format.texture_encoding == MESH_TEXCOORD_FLOAT32)
+        {
+            memcpy(out_texcoord, texcoord, texcoord_bytes);
+        }
+        else
+        {
+            for(u32 c = 0; c < format.texture_attrib_size; ++c)
+            {
+                ((u16*) out_texcoord)[c] = float_to_half(texcoord[c]);
+            }
+        }
+
+        // normal
+        if(format.normal_attrib_size > 0)
+        {
+            const float* normal = texcoord + format.texture_attrib_size;
+            u8* out_normal = out_texcoord + texcoord_bytes;
+            if(format.normal_encoding == MESH_NORMAL_FLOAT32)
+            {
+                memcpy(out_normal, normal, sizeof(float) * format.normal_attrib_size);
+            }
+            else
+            {
+                octahedral_encode_normal(normal[0], normal[1], normal[2], (i16*) out_normal);
+            }
+        }
+    }
+}
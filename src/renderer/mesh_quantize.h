@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    MESH QUANTIZE - encoding float vertices into the compact mesh_vertex_format_t layouts
+
+    Every encoded attribute starts on a 4 byte boundary, so a 16 bit x y z position takes
+    8 bytes (one 16 bit pad) and the compact layouts come out at 16 bytes per vertex:
+        position    8 bytes     unorm16 or half x y z + pad
+        uv          4 bytes     half u v
+        normal      4 bytes     octahedral snorm16 x y
+*/
+
+u16 float_to_half(float value);
+
+/** Encodes a unit normal onto the octahedron as two snorm16 values. */
+void octahedral_encode_normal(float x, float y, float z, i16 out_encoded[2]);
+
+u32 mesh_vertex_format_position_bytes(mesh_vertex_format_t format);
+u32 mesh_vertex_format_texcoord_bytes(mesh_vertex_format_t format);
+u32 mesh_vertex_format_normal_bytes(mesh_vertex_format_t format);
+u32 mesh_vertex_format_stride_bytes(mesh_vertex_format_t format);
+
+/** True if the format is the plain float layout and vertices can be uploaded as they are. */
+bool mesh_vertex_format_is_float32(mesh_vertex_format_t format);
+
+/** Encodes vertices_count float vertices (laid out by the attribute sizes of format) into
+    out_vertex_data. out_position_scale and out_position_offset receive the transform that
+    turns the stored positions back into mesh space: position = stored * scale + offset. */
+void mesh_quantize_vertices(std::vector<u8>& out_vertex_data,
+                            float out_position_scale[3],
+                            float out_position_offset[3],
+                            mesh_vertex_format_t format,
+                            const float* vertices,
+                            u32 vertices_count);
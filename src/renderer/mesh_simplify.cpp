@@ -0,0 +1,531 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include "mesh_simplify.h"
+#include "mesh_optimizer.h"
+#include "../core/kc_math.h"
+
+/**
+    Surface Simplification Using Quadric Error Metrics - Garland & Heckbert 1997
+    http://www.cs.cmu.edu/~garland/Papers/quadrics.pdf
+
+    Every vertex gets a quadric: the sum of the squared distance to the planes of its triangles,
+    weighted by triangle area. Collapsing vertex v onto vertex t costs Q_v(position of t). The
+    cheapest collapses are done first, a pass at a time. Within a pass the vertices around each
+    collapse are frozen so that the flip test (done with the current positions) stays valid.
+*/
+
+/** Symmetric 4x4 matrix of a sum of plane quadrics, plus the total weight so that the error
+    comes out as an average squared distance instead of growing with triangle area. */
+struct simplify_quadric_t
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double w = 0;
+};
+
+enum simplify_vertex_kind_t : u8
+{
+    SIMPLIFY_VERTEX_MANIFOLD,   // can collapse onto any neighbour
+    SIMPLIFY_VERTEX_BORDER,     // can only collapse along an open border edge
+    SIMPLIFY_VERTEX_LOCKED      // attribute seam or non-manifold, never moves
+};
+
+struct simplify_collapse_t
+{
+    u32     from;
+    u32     to;
+    float   error;
+};
+
+/** b_counts_as_area: border constraint planes are not surface, so they don't add to the total
+    weight the error gets averaged over */
+internal void quadric_add_plane(simplify_quadric_t& q, double a, double b, double c, double d, double weight, bool b_counts_as_area = true)
+{
+    q.a2 += weight * a * a; q.ab += weight * a * b; q.ac += weight * a * c; q.ad += weight * a * d;
+    q.b2 += weight * b * b; q.bc += weight * b * c; q.bd += weight * b * d;
+    q.c2 += weight * c * c; q.cd += weight * c * d;
+    q.d2 += weight * d * d;
+    q.w += b_counts_as_area ? weight : 0;
+}
+
+internal void quadric_add(simplify_quadric_t& q, const simplify_quadric_t& other)
+{
+    q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+    q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+    q.c2 += other.c2; q.cd += other.cd;
+    q.d2 += other.d2;
+    q.w += other.w;
+}
+
+internal float quadric_error(const simplify_quadric_t& q, vec3 p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double error = q.a2*x*x + 2*q.ab*x*y + 2*q.ac*x*z + 2*q.ad*x
+                 + q.b2*y*y + 2*q.bc*y*z + 2*q.bd*y
+                 + q.c2*z*z + 2*q.cd*z
+                 + q.d2;
+    error = error < 0 ? 0 : error;
+    return q.w > 0 ? (float)(error / q.w) : 0.f;
+}
+
+/** Distance from p to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5) */
+internal float simplify_point_triangle_distance(vec3 p, vec3 a, vec3 b, vec3 c)
+{
+    vec3 ab = b - a;
+    vec3 ac = c - a;
+    vec3 ap = p - a;
+    float d1 = dot(ab, ap);
+    float d2 = dot(ac, ap);
+    if(d1 <= 0.f && d2 <= 0.f)
+    {
+        return magnitude(p - a);
+    }
+    vec3 bp = p - b;
+    float d3 = dot(ab, bp);
+    float d4 = dot(ac, bp);
+    if(d3 >= 0.f && d4 <= d3)
+    {
+        return magnitude(p - b);
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    {
+        return magnitude(p - (a + ab * (d1 / (d1 - d3))));
+    }
+    vec3 cp = p - c;
+    float d5 = dot(ab, cp);
+    float d6 = dot(ac, cp);
+    if(d6 >= 0.f && d5 <= d6)
+    {
+        return magnitude(p - c);
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    {
+        return magnitude(p - (a + ac * (d2 / (d2 - d6))));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if(va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+    {
+        return magnitude(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+    }
+    float denominator = va + vb + vc;
+    if(denominator <= 0.f)
+    {
+        return magnitude(p - a); // degenerate triangle
+    }
+    return magnitude(p - (a + ab * (vb / denominator) + ac * (vc / denominator)));
+}
+
+void mesh_simplify(std::vector<u32>& out_indices,
+                   const u32* indices,
+                   u32 indices_count,
+                   const float* vertices,
+                   u32 vertices_count,
+                   u32 floats_per_vertex,
+                   u32 target_indices_count,
+                   float max_error,
+                   float* out_error)
+{
+    out_indices.assign(indices, indices + indices_count);
+    if(out_error)
+    {
+        *out_error = 0.f;
+    }
+    if(indices_count <= target_indices_count || vertices_count == 0)
+    {
+        return;
+    }
+
+    auto position = [vertices, floats_per_vertex](u32 v)
+    {
+        const float* p = vertices + (size_t) v * floats_per_vertex;
+        return make_vec3(p[0], p[1], p[2]);
+    };
+
+    std::vector<u8> kind(vertices_count, SIMPLIFY_VERTEX_MANIFOLD);
+
+    // Vertices that share a position with another vertex are on an attribute seam
+    {
+        std::vector<u32> sorted(vertices_count);
+        for(u32 i = 0; i < vertices_count; ++i)
+        {
+            sorted[i] = i;
+        }
+        std::sort(sorted.begin(), sorted.end(), [vertices, floats_per_vertex](u32 a, u32 b)
+        {
+            return memcmp(vertices + (size_t) a * floats_per_vertex, vertices + (size_t) b * floats_per_vertex, 3 * sizeof(float)) < 0;
+        });
+        for(u32 i = 1; i < vertices_count; ++i)
+        {
+            if(memcmp(vertices + (size_t) sorted[i - 1] * floats_per_vertex, vertices + (size_t) sorted[i] * floats_per_vertex, 3 * sizeof(float)) == 0)
+            {
+                kind[sorted[i - 1]] = SIMPLIFY_VERTEX_LOCKED;
+                kind[sorted[i]] = SIMPLIFY_VERTEX_LOCKED;
+            }
+        }
+    }
+
+    // Triangles around each vertex, rebuilt from out_indices after every pass
+    std::vector<u32> triangle_offsets(vertices_count + 1);
+    std::vector<u32> vertex_triangles;
+    std::vector<u32> adjacency_cursor(vertices_count);
+    auto build_adjacency = [&]()
+    {
+        u32 count = (u32) out_indices.size();
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for(u32 i = 0; i < count; ++i)
+        {
+            ++triangle_offsets[out_indices[i] + 1];
+        }
+        for(u32 v = 0; v < vertices_count; ++v)
+        {
+            triangle_offsets[v + 1] += triangle_offsets[v];
+            adjacency_cursor[v] = triangle_offsets[v];
+        }
+        vertex_triangles.resize(count);
+        for(u32 i = 0; i < count; ++i)
+        {
+            vertex_triangles[adjacency_cursor[out_indices[i]]++] = i / 3;
+        }
+    };
+
+    // Number of triangles with the directed edge a -> b
+    auto count_directed_edge = [&](u32 a, u32 b)
+    {
+        u32 count = 0;
+        for(u32 k = triangle_offsets[a]; k < triangle_offsets[a + 1]; ++k)
+        {
+            const u32* tri = &out_indices[vertex_triangles[k] * 3];
+            count += (tri[0] == a && tri[1] == b) || (tri[1] == a && tri[2] == b) || (tri[2] == a && tri[0] == b);
+        }
+        return count;
+    };
+
+    // An edge without its reverse is an open border
+    auto is_border_edge = [&](u32 a, u32 b)
+    {
+        return count_directed_edge(a, b) == 0 || count_directed_edge(b, a) == 0;
+    };
+
+    // An edge that shows up twice in the same direction is non-manifold
+    build_adjacency();
+    for(u32 i = 0; i < indices_count; i += 3)
+    {
+        for(u32 e = 0; e < 3; ++e)
+        {
+            u32 a = indices[i + e];
+            u32 b = indices[i + (e + 1) % 3];
+            if(count_directed_edge(a, b) > 1)
+            {
+                kind[a] = SIMPLIFY_VERTEX_LOCKED;
+                kind[b] = SIMPLIFY_VERTEX_LOCKED;
+            }
+        }
+    }
+
+    // Quadrics. Border edges also get a plane perpendicular to their triangle, weighted
+    // heavily, so that collapses along the border keep its shape.
+    std::vector<simplify_quadric_t> quadrics(vertices_count);
+    for(u32 i = 0; i < indices_count; i += 3)
+    {
+        u32 tri[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        vec3 p0 = position(tri[0]);
+        vec3 p1 = position(tri[1]);
+        vec3 p2 = position(tri[2]);
+        vec3 n = cross(p1 - p0, p2 - p0);
+        float double_area = magnitude(n);
+        if(double_area <= 0.f)
+        {
+            continue;
+        }
+        n /= double_area;
+        double d = -dot(n, p0);
+        for(u32 c = 0; c < 3; ++c)
+        {
+            quadric_add_plane(quadrics[tri[c]], n.x, n.y, n.z, d, 0.5 * double_area);
+        }
+
+        for(u32 e = 0; e < 3; ++e)
+        {
+            u32 a = tri[e];
+            u32 b = tri[(e + 1) % 3];
+            if(count_directed_edge(b, a) != 0)
+            {
+                continue;
+            }
+            if(kind[a] == SIMPLIFY_VERTEX_MANIFOLD)
+            {
+                kind[a] = SIMPLIFY_VERTEX_BORDER;
+            }
+            if(kind[b] == SIMPLIFY_VERTEX_MANIFOLD)
+            {
+                kind[b] = SIMPLIFY_VERTEX_BORDER;
+            }
+            vec3 edge = position(b) - position(a);
+            float edge_length = magnitude(edge);
+            if(edge_length <= 0.f)
+            {
+                continue;
+            }
+            vec3 border_normal = normalize(cross(edge, n));
+            double border_d = -dot(border_normal, position(a));
+            double weight = 10.0 * edge_length * edge_length;
+            quadric_add_plane(quadrics[a], border_normal.x, border_normal.y, border_normal.z, border_d, weight, false);
+            quadric_add_plane(quadrics[b], border_normal.x, border_normal.y, border_normal.z, border_d, weight, false);
+        }
+    }
+
+    const float max_error_squared = max_error * max_error;
+    std::vector<simplify_collapse_t> collapses;
+    std::vector<u8> frozen(vertices_count);
+    std::vector<u32> remap(vertices_count);
+    std::vector<u32> collapsed_into(vertices_count); // across every pass, for measuring the error
+    for(u32 v = 0; v < vertices_count; ++v)
+    {
+        collapsed_into[v] = v;
+    }
+
+    for(;;)
+    {
+        u32 current_count = (u32) out_indices.size();
+        if(current_count <= target_indices_count)
+        {
+            break;
+        }
+
+        if(current_count != indices_count)
+        {
+            build_adjacency();
+        }
+
+        // Cheapest allowed collapse of every edge
+        collapses.clear();
+        for(u32 i = 0; i < current_count; i += 3)
+        {
+            for(u32 e = 0; e < 3; ++e)
+            {
+                u32 a = out_indices[i + e];
+                u32 b = out_indices[i + (e + 1) % 3];
+                if(kind[a] == SIMPLIFY_VERTEX_LOCKED && kind[b] == SIMPLIFY_VERTEX_LOCKED)
+                {
+                    continue;
+                }
+                // Manifold vertices never end up on a border, so only edges touching a border vertex need the test
+                bool b_border = (kind[a] == SIMPLIFY_VERTEX_BORDER || kind[b] == SIMPLIFY_VERTEX_BORDER) && is_border_edge(a, b);
+                if(a > b && !b_border)
+                {
+                    continue; // interior edges show up twice, only take one
+                }
+                simplify_collapse_t best = { 0, 0, FLT_MAX };
+                u32 ends[2][2] = { { a, b }, { b, a } };
+                for(u32 option = 0; option < 2; ++option)
+                {
+                    u32 from = ends[option][0];
+                    u32 to = ends[option][1];
+                    if(kind[from] == SIMPLIFY_VERTEX_LOCKED || (kind[from] == SIMPLIFY_VERTEX_BORDER && !b_border))
+                    {
+                        continue;
+                    }
+                    float error = quadric_error(quadrics[from], position(to));
+                    if(error < best.error)
+                    {
+                        best = { from, to, error };
+                    }
+                }
+                if(best.error <= max_error_squared)
+                {
+                    collapses.push_back(best);
+                }
+            }
+        }
+        if(collapses.empty())
+        {
+            break;
+        }
+        // Each collapse removes about two triangles, so don't go further into the sorted list than
+        // this pass needs, and only sort that far. Later passes get to re-evaluate what's left
+        // with updated quadrics.
+        u32 triangles_to_remove = (current_count - target_indices_count) / 3 + 1;
+        size_t pass_end = min((size_t) triangles_to_remove, collapses.size() - 1);
+        auto cheaper = [](const simplify_collapse_t& x, const simplify_collapse_t& y) { return x.error < y.error; };
+        std::nth_element(collapses.begin(), collapses.begin() + pass_end, collapses.end(), cheaper);
+        std::sort(collapses.begin(), collapses.begin() + pass_end, cheaper);
+        float pass_error_limit = collapses[pass_end].error;
+        collapses.resize(pass_end + 1);
+
+        std::fill(frozen.begin(), frozen.end(), 0);
+        for(u32 v = 0; v < vertices_count; ++v)
+        {
+            remap[v] = v;
+        }
+        u32 triangles_removed = 0;
+        for(const simplify_collapse_t& collapse : collapses)
+        {
+            if(collapse.error > pass_error_limit || triangles_removed >= triangles_to_remove)
+            {
+                break;
+            }
+            if(frozen[collapse.from] || frozen[collapse.to])
+            {
+                continue;
+            }
+
+            // Reject the collapse if any remaining triangle around from would flip or degenerate
+            bool b_flips = false;
+            u32 collapsing_triangles = 0;
+            vec3 target = position(collapse.to);
+            for(u32 k = triangle_offsets[collapse.from]; k < triangle_offsets[collapse.from + 1] && !b_flips; ++k)
+            {
+                const u32* tri = &out_indices[vertex_triangles[k] * 3];
+                if(tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                {
+                    ++collapsing_triangles;
+                    continue;
+                }
+                vec3 p[3] = { position(tri[0]), position(tri[1]), position(tri[2]) };
+                vec3 normal_before = cross(p[1] - p[0], p[2] - p[0]);
+                for(u32 c = 0; c < 3; ++c)
+                {
+                    if(tri[c] == collapse.from)
+                    {
+                        p[c] = target;
+                    }
+                }
+                vec3 normal_after = cross(p[1] - p[0], p[2] - p[0]);
+                float area_before = magnitude(normal_before);
+                float area_after = magnitude(normal_after);
+                b_flips = area_after <= 1e-3f * area_before
+                    || dot(normal_before, normal_after) < 0.25f * area_before * area_after;
+            }
+            if(b_flips)
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadric_add(quadrics[collapse.to], quadrics[collapse.from]);
+            triangles_removed += collapsing_triangles;
+            collapsed_into[collapse.from] = collapse.to;
+
+            for(u32 k = triangle_offsets[collapse.from]; k < triangle_offsets[collapse.from + 1]; ++k)
+            {
+                const u32* tri = &out_indices[vertex_triangles[k] * 3];
+                frozen[tri[0]] = 1;
+                frozen[tri[1]] = 1;
+                frozen[tri[2]] = 1;
+            }
+        }
+        if(triangles_removed == 0)
+        {
+            break;
+        }
+
+        // Apply the collapses and drop triangles that became degenerate
+        u32 write = 0;
+        for(u32 i = 0; i < current_count; i += 3)
+        {
+            u32 a = remap[out_indices[i]];
+            u32 b = remap[out_indices[i + 1]];
+            u32 c = remap[out_indices[i + 2]];
+            if(a != b && b != c && c != a)
+            {
+                out_indices[write++] = a;
+                out_indices[write++] = b;
+                out_indices[write++] = c;
+            }
+        }
+        out_indices.resize(write);
+    }
+
+    if(out_error)
+    {
+        // The quadric error is an area weighted mean of squared plane distances, which says little
+        // about how far the surface actually moved. Measure it instead: every vertex that got
+        // collapsed away is compared against the simplified triangles around the vertex it
+        // ended up in, and the furthest one is the error.
+        build_adjacency();
+        float max_distance = 0.f;
+        for(u32 v = 0; v < vertices_count; ++v)
+        {
+            if(collapsed_into[v] == v)
+            {
+                continue;
+            }
+            u32 target = collapsed_into[v];
+            while(collapsed_into[target] != target)
+            {
+                target = collapsed_into[target];
+            }
+            vec3 p = position(v);
+            float distance = magnitude(p - position(target));
+            for(u32 k = triangle_offsets[target]; k < triangle_offsets[target + 1]; ++k)
+            {
+                const u32* tri = &out_indices[vertex_triangles[k] * 3];
+                distance = min(distance, simplify_point_triangle_distance(p, position(tri[0]), position(tri[1]), position(tri[2])));
+            }
+            max_distance = max(max_distance, distance);
+        }
+        *out_error = max_distance;
+    }
+}
+
+void mesh_generate_lods(mesh_buffers_t& mesh)
+{
+    const u32 floats_per_vertex = 8;
+    u32 vertices_count = (u32) mesh.vertices.size() / floats_per_vertex;
+    u32 lod0_indices_count = (u32) mesh.indices.size();
+
+    mesh.lods_count = 1;
+    mesh.lods[0].first_index = 0;
+    mesh.lods[0].indices_count = lod0_indices_count;
+    mesh.lods[0].error = 0.f;
+    if(vertices_count == 0 || lod0_indices_count == 0)
+    {
+        return;
+    }
+
+    // Error limit relative to the size of the mesh
+    vec3 bounds_min = make_vec3(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+    vec3 bounds_max = bounds_min;
+    for(u32 i = 1; i < vertices_count; ++i)
+    {
+        const float* p = &mesh.vertices[(size_t) i * floats_per_vertex];
+        bounds_min = make_vec3(min(bounds_min.x, p[0]), min(bounds_min.y, p[1]), min(bounds_min.z, p[2]));
+        bounds_max = make_vec3(max(bounds_max.x, p[0]), max(bounds_max.y, p[1]), max(bounds_max.z, p[2]));
+    }
+    float max_error = MESH_LOD_MAX_ERROR * magnitude(bounds_max - bounds_min);
+
+    // Each LOD is simplified from the previous one, which is faster and keeps the chain nested
+    std::vector<u32> lod_indices;
+    std::vector<u32> previous_lod(mesh.indices);
+    float previous_error = 0.f;
+    while(mesh.lods_count < MESH_MAX_LODS)
+    {
+        u32 previous_count = (u32) previous_lod.size();
+        u32 target_count = (u32)((float) previous_count * MESH_LOD_TRIANGLE_RATIO) / 3 * 3;
+        float error = 0.f;
+        mesh_simplify(lod_indices, previous_lod.data(), previous_count, mesh.vertices.data(), vertices_count,
+                      floats_per_vertex, target_count, max_error, &error);
+        if(lod_indices.empty() || (float) lod_indices.size() > MESH_LOD_MIN_REDUCTION * (float) previous_count)
+        {
+            break;
+        }
+
+        mesh_optimize_vertex_cache(lod_indices.data(), (u32) lod_indices.size(), vertices_count);
+
+        mesh_lod_t& lod = mesh.lods[mesh.lods_count++];
+        lod.first_index = (u32) mesh.indices.size();
+        lod.indices_count = (u32) lod_indices.size();
+        // Errors of successive simplifications add up in the worst case
+        lod.error = previous_error + error;
+        previous_error = lod.error;
+        mesh.indices.insert(mesh.indices.end(), lod_indices.begin(), lod_indices.end());
+        previous_lod.swap(lod_indices);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    MESH SIMPLIFY - quadric error mesh simplification for LOD generation
+
+    Simplification collapses edges onto one of their existing vertices (Garland & Heckbert
+    quadric error metric), so every LOD is just another index buffer into the same vertex
+    buffer as the full detail mesh. All LODs of a mesh_t live in one index allocation.
+
+    Vertices on attribute seams (same position, different uv/normal) and on non-manifold edges
+    never move, and vertices on open borders only slide along the border, so LODs don't tear.
+
+    CPU only and thread safe.
+*/
+
+#define MESH_LOD_TRIANGLE_RATIO 0.5f    // each LOD targets this fraction of the previous LOD's triangles
+#define MESH_LOD_MIN_REDUCTION 0.9f     // a LOD that keeps more than this fraction of the previous one isn't worth it
+#define MESH_LOD_MAX_ERROR 0.05f        // collapses stop at this error, relative to the mesh bounds
+
+/** Simplifies the triangle list indices down to at most target_indices_count indices, or as far
+    as possible without exceeding max_error (in mesh space units). Positions are the first three
+    floats of each vertex. max_error limits the quadric error (the area weighted RMS distance to
+    the planes a vertex gathered). out_error gets the furthest any collapsed vertex of indices
+    ended up from the simplified surface around where it went, in mesh space units. */
+void mesh_simplify(std::vector<u32>& out_indices,
+                   const u32* indices,
+                   u32 indices_count,
+                   const float* vertices,
+                   u32 vertices_count,
+                   u32 floats_per_vertex,
+                   u32 target_indices_count,
+                   float max_error,
+                   float* out_error);
+
+/** Generates up to MESH_MAX_LODS - 1 coarser LODs of an interleaved { x y z u v nx ny nz } mesh.
+    The LOD index buffers are vertex cache optimized and appended to mesh.indices, and mesh.lods
+    describes where each LOD's indices are. Run after mesh_optimize. */
+void mesh_generate_lods(mesh_buffers_t& mesh);
@@ -0,0 +1,664 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include "mesh_voxel.h"
+#include "../core/worker_pool.h"
+#include "../core/kc_math.h"
+#include "../stb/stb_image.h"
+
+#define VOXEL_FLOATS_PER_VERTEX 8
+#define VOXEL_GRID_TOLERANCE 0.01f  // in cells, how far a corner may be off the grid
+
+/** Two consecutive triangles that make up an axis aligned rectangle */
+struct voxel_quad_t
+{
+    u32     triangle = 0;       // first of the two
+    u8      axis = 0;           // of the normal
+    bool    b_positive = false; // normal points up the axis
+    float   plane = 0.f;
+    float   s0 = 0.f, s1 = 0.f; // extent along axis + 1
+    float   t0 = 0.f, t1 = 0.f; // extent along axis + 2
+    float   uvs[4][2];          // at corners (s0 t0) (s1 t0) (s0 t1) (s1 t1)
+};
+
+/** A block face: a quad that covers exactly one grid cell and shows one whole atlas tile */
+struct voxel_face_t
+{
+    i32     cell[3];            // grid coordinates of the min corner, cell[axis] is the plane
+    u8      axis = 0;
+    bool    b_positive = false;
+    u8      orientation = 0;    // tile corner at face corners 0, 1, and 2, two bits each (u, v)
+    bool    b_hidden = false;
+    u32     mesh = 0;
+    u32     triangle = 0;
+    float   tile[4];            // atlas rect { u v width height }
+};
+
+struct voxel_mesh_t
+{
+    std::vector<voxel_quad_t>   quads;
+    bool                        b_voxels = false;
+    std::vector<voxel_face_t>   faces;
+};
+
+/** Finds out if triangles triangle and triangle + 1 make up an axis aligned rectangle with a flat
+    normal, split along one of its diagonals. */
+internal bool voxel_find_quad(const mesh_buffers_t& mesh, u32 triangle, voxel_quad_t& out_quad)
+{
+    const float* v[6];
+    for(u32 k = 0; k < 6; ++k)
+    {
+        v[k] = &mesh.vertices[(size_t) mesh.indices[triangle * 3 + k] * VOXEL_FLOATS_PER_VERTEX];
+    }
+    const float* n = v[0] + 5;
+    u8 axis = fabsf(n[0]) == 1.f ? 0 : fabsf(n[1]) == 1.f ? 1 : fabsf(n[2]) == 1.f ? 2 : 3;
+    if(axis == 3)
+    {
+        return false;
+    }
+    u8 s = (axis + 1) % 3;
+    u8 t = (axis + 2) % 3;
+
+    voxel_quad_t& quad = out_quad;
+    quad.triangle = triangle;
+    quad.axis = axis;
+    quad.b_positive = n[axis] > 0.f;
+    quad.plane = v[0][axis];
+    quad.s0 = quad.s1 = v[0][s];
+    quad.t0 = quad.t1 = v[0][t];
+    for(u32 k = 0; k < 6; ++k)
+    {
+        const float* vn = v[k] + 5;
+        if(v[k][axis] != quad.plane || vn[axis] != n[axis] || vn[s] != 0.f || vn[t] != 0.f)
+        {
+            return false;
+        }
+        quad.s0 = min(quad.s0, v[k][s]);
+        quad.s1 = max(quad.s1, v[k][s]);
+        quad.t0 = min(quad.t0, v[k][t]);
+        quad.t1 = max(quad.t1, v[k][t]);
+    }
+    if(quad.s0 == quad.s1 || quad.t0 == quad.t1)
+    {
+        return false;
+    }
+
+    // Every vertex is a rectangle corner and vertices on the same corner agree on the uv
+    i32 corner_vertex[4] = { -1, -1, -1, -1 };
+    u32 corner_masks[2] = { 0, 0 };
+    for(u32 k = 0; k < 6; ++k)
+    {
+        bool b_s0 = v[k][s] == quad.s0;
+        bool b_t0 = v[k][t] == quad.t0;
+        if((!b_s0 && v[k][s] != quad.s1) || (!b_t0 && v[k][t] != quad.t1))
+        {
+            return false;
+        }
+        u32 corner = (b_s0 ? 0 : 1) + (b_t0 ? 0 : 2);
+        if(corner_vertex[corner] < 0)
+        {
+            corner_vertex[corner] = (i32) k;
+            quad.uvs[corner][0] = v[k][3];
+            quad.uvs[corner][1] = v[k][4];
+        }
+        else if(quad.uvs[corner][0] != v[k][3] || quad.uvs[corner][1] != v[k][4])
+        {
+            return false;
+        }
+        corner_masks[k / 3] |= 1u << corner;
+    }
+
+    // Each triangle covers three corners and they share a diagonal
+    for(u32 i = 0; i < 2; ++i)
+    {
+        if(corner_masks[i] != 0x7 && corner_masks[i] != 0xb && corner_masks[i] != 0xd && corner_masks[i] != 0xe)
+        {
+            return false;
+        }
+    }
+    u32 missing0 = ~corner_masks[0] & 0xf;
+    u32 missing1 = ~corner_masks[1] & 0xf;
+    if((missing0 | missing1) != 0x9 && (missing0 | missing1) != 0x6)
+    {
+        return false;
+    }
+
+    // Both triangles wind the way the normal points
+    for(u32 i = 0; i < 2; ++i)
+    {
+        const float* a = v[i * 3];
+        const float* b = v[i * 3 + 1];
+        const float* c = v[i * 3 + 2];
+        float winding = (b[s] - a[s]) * (c[t] - a[t]) - (b[t] - a[t]) * (c[s] - a[s]);
+        if((winding > 0.f) != quad.b_positive)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+internal bool voxel_snap(float x, float origin, float cell_size, i32& out_cell)
+{
+    float g = (x - origin) / cell_size;
+    float rounded = floorf(g + 0.5f);
+    if(fabsf(g - rounded) > VOXEL_GRID_TOLERANCE || fabsf(rounded) >= (float) MESH_VOXEL_GRID_LIMIT)
+    {
+        return false;
+    }
+    out_cell = (i32) rounded;
+    return true;
+}
+
+/** Turns a quad into a face if it covers one grid cell and maps a whole tile onto it, turned
+    or mirrored but not stretched or sheared */
+internal bool voxel_make_face(const voxel_quad_t& quad, const float origin[3], float cell_size, voxel_face_t& out_face)
+{
+    u8 s = (quad.axis + 1) % 3;
+    u8 t = (quad.axis + 2) % 3;
+    if(fabsf(quad.s1 - quad.s0 - cell_size) > VOXEL_GRID_TOLERANCE * cell_size
+       || fabsf(quad.t1 - quad.t0 - cell_size) > VOXEL_GRID_TOLERANCE * cell_size)
+    {
+        return false;
+    }
+    voxel_face_t& face = out_face;
+    if(!voxel_snap(quad.plane, origin[quad.axis], cell_size, face.cell[quad.axis])
+       || !voxel_snap(quad.s0, origin[s], cell_size, face.cell[s])
+       || !voxel_snap(quad.t0, origin[t], cell_size, face.cell[t]))
+    {
+        return false;
+    }
+    face.axis = quad.axis;
+    face.b_positive = quad.b_positive;
+    face.triangle = quad.triangle;
+
+    float uv_min[2] = { quad.uvs[0][0], quad.uvs[0][1] };
+    float uv_max[2] = { quad.uvs[0][0], quad.uvs[0][1] };
+    for(u32 corner = 1; corner < 4; ++corner)
+    {
+        for(u32 k = 0; k < 2; ++k)
+        {
+            uv_min[k] = min(uv_min[k], quad.uvs[corner][k]);
+            uv_max[k] = max(uv_max[k], quad.uvs[corner][k]);
+        }
+    }
+    if(uv_min[0] == uv_max[0] || uv_min[1] == uv_max[1])
+    {
+        return false;
+    }
+    face.tile[0] = uv_min[0];
+    face.tile[1] = uv_min[1];
+    face.tile[2] = uv_max[0] - uv_min[0];
+    face.tile[3] = uv_max[1] - uv_min[1];
+
+    // Tile corner (bit 0 u, bit 1 v) of every face corner
+    u32 tile_corners[4];
+    u32 seen = 0;
+    for(u32 corner = 0; corner < 4; ++corner)
+    {
+        tile_corners[corner] = 0;
+        for(u32 k = 0; k < 2; ++k)
+        {
+            float x = (quad.uvs[corner][k] - uv_min[k]) / face.tile[2 + k];
+            if(x > 0.001f && x < 0.999f)
+            {
+                return false;
+            }
+            tile_corners[corner] |= (x >= 0.5f ? 1u : 0u) << k;
+        }
+        seen |= 1u << tile_corners[corner];
+    }
+    if(seen != 0xf || (tile_corners[3] != (tile_corners[1] ^ tile_corners[2] ^ tile_corners[0])))
+    {
+        return false;
+    }
+    face.orientation = (u8) (tile_corners[0] | (tile_corners[1] << 2) | (tile_corners[2] << 4));
+    return true;
+}
+
+/** Most common quad side length, allowing for float error */
+internal float voxel_find_cell_size(const std::vector<voxel_mesh_t>& voxel_meshes)
+{
+    std::vector<float> sides;
+    for(const voxel_mesh_t& voxel_mesh : voxel_meshes)
+    {
+        for(size_t i = 0; voxel_mesh.b_voxels && i < voxel_mesh.quads.size(); ++i)
+        {
+            sides.push_back(voxel_mesh.quads[i].s1 - voxel_mesh.quads[i].s0);
+            sides.push_back(voxel_mesh.quads[i].t1 - voxel_mesh.quads[i].t0);
+        }
+    }
+    std::sort(sides.begin(), sides.end());
+    float cell_size = 0.f;
+    size_t best_run = 0;
+    for(size_t start = 0; start < sides.size();)
+    {
+        size_t end = start;
+        double sum = 0.0;
+        while(end < sides.size() && sides[end] - sides[start] <= VOXEL_GRID_TOLERANCE * sides[start])
+        {
+            sum += sides[end];
+            ++end;
+        }
+        if(end - start > best_run)
+        {
+            best_run = end - start;
+            cell_size = (float) (sum / (double) (end - start));
+        }
+        start = end;
+    }
+    return cell_size;
+}
+
+/** True if no texel of the tile gets discarded for its alpha. image is flipped so that row 0
+    is v = 0, like every texture we load. */
+internal bool voxel_tile_is_opaque(const u8* image, int width, int height, const float tile[4])
+{
+    int x0 = max((int) floorf(tile[0] * width + 0.5f), 0);
+    int y0 = max((int) floorf(tile[1] * height + 0.5f), 0);
+    int x1 = min((int) floorf((tile[0] + tile[2]) * width + 0.5f), width);
+    int y1 = min((int) floorf((tile[1] + tile[3]) * height + 0.5f), height);
+    for(int y = y0; y < y1; ++y)
+    {
+        for(int x = x0; x < x1; ++x)
+        {
+            if(image[((size_t) y * width + x) * 4 + 3] < MESH_VOXEL_ALPHA_CUTOFF)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** Marks the faces that are between two opaque blocks */
+internal u64 voxel_remove_hidden_faces(std::vector<voxel_mesh_t>& voxel_meshes,
+                                       const std::vector<mesh_buffers_t>& meshes,
+                                       const std::vector<std::string>& texture_paths)
+{
+    // Decode the textures that have an alpha channel, tiles of the others are all opaque
+    std::vector<std::vector<u8>> images(texture_paths.size());
+    std::vector<std::array<int, 2>> image_sizes(texture_paths.size());
+    std::map<std::string, u32> decoded_paths;
+    for(size_t i = 0; i < texture_paths.size(); ++i)
+    {
+        int width, height, channels;
+        const char* path = texture_paths[i].c_str();
+        if(texture_paths[i].empty() || !stbi_info(path, &width, &height, &channels) || (channels != 2 && channels != 4))
+        {
+            continue;
+        }
+        auto decoded = decoded_paths.find(texture_paths[i]);
+        if(decoded != decoded_paths.end())
+        {
+            images[i] = images[decoded->second];
+            image_sizes[i] = image_sizes[decoded->second];
+            continue;
+        }
+        stbi_set_flip_vertically_on_load_thread(1);
+        u8* pixels = stbi_load(path, &width, &height, &channels, 4);
+        if(pixels)
+        {
+            images[i].assign(pixels, pixels + (size_t) width * height * 4);
+            image_sizes[i] = { width, height };
+            stbi_image_free(pixels);
+        }
+        decoded_paths[texture_paths[i]] = (u32) i;
+    }
+
+    struct voxel_cell_t
+    {
+        u64 key;
+        voxel_face_t* face;
+        bool b_opaque;
+    };
+    std::vector<voxel_cell_t> cells;
+    std::map<std::pair<u32, std::array<float, 4>>, bool> tile_opacity;
+    for(voxel_mesh_t& voxel_mesh : voxel_meshes)
+    {
+        for(voxel_face_t& face : voxel_mesh.faces)
+        {
+            u32 material = meshes[face.mesh].material_index;
+            bool b_opaque = true;
+            if(material < images.size() && !images[material].empty())
+            {
+                std::array<float, 4> tile = { face.tile[0], face.tile[1], face.tile[2], face.tile[3] };
+                auto known = tile_opacity.find(std::make_pair(material, tile));
+                if(known == tile_opacity.end())
+                {
+                    b_opaque = voxel_tile_is_opaque(images[material].data(), image_sizes[material][0], image_sizes[material][1], face.tile);
+                    tile_opacity[std::make_pair(material, tile)] = b_opaque;
+                }
+                else
+                {
+                    b_opaque = known->second;
+                }
+            }
+
+            u8 s = (face.axis + 1) % 3;
+            u8 t = (face.axis + 2) % 3;
+            voxel_cell_t cell;
+            cell.key = ((u64) face.axis << 60)
+                       | ((u64) (face.cell[face.axis] + MESH_VOXEL_GRID_LIMIT) << 40)
+                       | ((u64) (face.cell[s] + MESH_VOXEL_GRID_LIMIT) << 20)
+                       | (u64) (face.cell[t] + MESH_VOXEL_GRID_LIMIT);
+            cell.face = &face;
+            cell.b_opaque = b_opaque;
+            cells.push_back(cell);
+        }
+    }
+
+    std::sort(cells.begin(), cells.end(), [](const voxel_cell_t& a, const voxel_cell_t& b) { return a.key < b.key; });
+    u64 hidden_count = 0;
+    for(size_t start = 0; start < cells.size();)
+    {
+        size_t end = start;
+        bool b_positive = false;
+        bool b_negative = false;
+        bool b_opaque = true;
+        while(end < cells.size() && cells[end].key == cells[start].key)
+        {
+            b_positive |= cells[end].face->b_positive;
+            b_negative |= !cells[end].face->b_positive;
+            b_opaque &= cells[end].b_opaque;
+            ++end;
+        }
+        if(b_positive && b_negative && b_opaque)
+        {
+            for(size_t i = start; i < end; ++i)
+            {
+                cells[i].face->b_hidden = true;
+            }
+            hidden_count += end - start;
+        }
+        start = end;
+    }
+    return hidden_count;
+}
+
+internal void voxel_emit_rectangle(mesh_buffers_t& out_mesh, const voxel_face_t& face, i32 s0, i32 t0, i32 width, i32 height,
+                                   const float origin[3], float cell_size)
+{
+    u8 axis = face.axis;
+    u8 s = (axis + 1) % 3;
+    u8 t = (axis + 2) % 3;
+    i32 tile_corner[3] = { face.orientation & 3, (face.orientation >> 2) & 3, (face.orientation >> 4) & 3 };
+    u32 first_vertex = (u32) (out_mesh.vertices.size() / VOXEL_FLOATS_PER_VERTEX);
+    for(u32 corner = 0; corner < 4; ++corner)
+    {
+        i32 ds = (corner & 1) ? width : 0;
+        i32 dt = (corner & 2) ? height : 0;
+        float vertex[VOXEL_FLOATS_PER_VERTEX];
+        vertex[axis] = origin[axis] + (float) face.cell[axis] * cell_size;
+        vertex[s] = origin[s] + (float) (s0 + ds) * cell_size;
+        vertex[t] = origin[t] + (float) (t0 + dt) * cell_size;
+        // uvs count tiles from the tile corner at face corner 0, in the directions the tile is turned
+        for(u32 k = 0; k < 2; ++k)
+        {
+            i32 at_origin = (tile_corner[0] >> k) & 1;
+            i32 along_s = ((tile_corner[1] >> k) & 1) - at_origin;
+            i32 along_t = ((tile_corner[2] >> k) & 1) - at_origin;
+            vertex[3 + k] = (float) (at_origin + along_s * ds + along_t * dt);
+        }
+        vertex[5 + axis] = face.b_positive ? 1.f : -1.f;
+        vertex[5 + s] = 0.f;
+        vertex[5 + t] = 0.f;
+        out_mesh.vertices.insert(out_mesh.vertices.end(), vertex, vertex + VOXEL_FLOATS_PER_VERTEX);
+    }
+    const u32 positive[6] = { 0, 1, 3, 0, 3, 2 };
+    const u32 negative[6] = { 0, 3, 1, 0, 2, 3 };
+    for(u32 k = 0; k < 6; ++k)
+    {
+        out_mesh.indices.push_back(first_vertex + (face.b_positive ? positive[k] : negative[k]));
+    }
+}
+
+/** Greedy meshing of faces that can merge (same tile, plane, direction, and orientation). faces
+    are sorted by t then s. */
+internal void voxel_merge_faces(mesh_buffers_t& out_mesh, const voxel_face_t* faces, size_t faces_count,
+                                const float origin[3], float cell_size)
+{
+    u8 s = (faces[0].axis + 1) % 3;
+    u8 t = (faces[0].axis + 2) % 3;
+    auto cell_key = [](i32 cell_s, i32 cell_t) { return ((u64) (u32) cell_s << 32) | (u64) (u32) cell_t; };
+    std::unordered_map<u64, u32> cells;
+    cells.reserve(faces_count * 2);
+    for(size_t i = 0; i < faces_count; ++i)
+    {
+        cells[cell_key(faces[i].cell[s], faces[i].cell[t])] = (u32) i;
+    }
+    std::vector<u8> b_merged(faces_count, 0);
+    auto take = [&](i32 cell_s, i32 cell_t) -> bool
+    {
+        auto found = cells.find(cell_key(cell_s, cell_t));
+        return found != cells.end() && !b_merged[found->second];
+    };
+
+    for(size_t i = 0; i < faces_count; ++i)
+    {
+        if(b_merged[i])
+        {
+            continue;
+        }
+        i32 s0 = faces[i].cell[s];
+        i32 t0 = faces[i].cell[t];
+        i32 width = 1;
+        while(take(s0 + width, t0))
+        {
+            ++width;
+        }
+        i32 height = 1;
+        for(;;)
+        {
+            bool b_row = true;
+            for(i32 ds = 0; ds < width && b_row; ++ds)
+            {
+                b_row = take(s0 + ds, t0 + height);
+            }
+            if(!b_row)
+            {
+                break;
+            }
+            ++height;
+        }
+        for(i32 dt = 0; dt < height; ++dt)
+        {
+            for(i32 ds = 0; ds < width; ++ds)
+            {
+                b_merged[cells[cell_key(s0 + ds, t0 + dt)]] = 1;
+            }
+        }
+        voxel_emit_rectangle(out_mesh, faces[i], s0, t0, width, height, origin, cell_size);
+    }
+}
+
+/** Rebuilds one voxel mesh into a mesh of the triangles that aren't faces, followed by one mesh
+    per tile */
+internal void voxel_remesh_mesh(const mesh_buffers_t& mesh, voxel_mesh_t& voxel_mesh, std::vector<mesh_buffers_t>& out_meshes,
+                                const float origin[3], float cell_size)
+{
+    std::vector<voxel_face_t>& faces = voxel_mesh.faces;
+    u32 triangles_count = (u32) mesh.indices.size() / 3;
+    std::vector<u8> b_face_triangle(triangles_count, 0);
+    for(const voxel_face_t& face : faces)
+    {
+        b_face_triangle[face.triangle] = 1;
+        b_face_triangle[face.triangle + 1] = 1;
+    }
+
+    mesh_buffers_t rest;
+    rest.material_index = mesh.material_index;
+    std::vector<u32> remap(mesh.vertices.size() / VOXEL_FLOATS_PER_VERTEX, ~0u);
+    for(u32 triangle = 0; triangle < triangles_count; ++triangle)
+    {
+        if(b_face_triangle[triangle])
+        {
+            continue;
+        }
+        for(u32 k = 0; k < 3; ++k)
+        {
+            u32 vertex = mesh.indices[triangle * 3 + k];
+            if(remap[vertex] == ~0u)
+            {
+                remap[vertex] = (u32) (rest.vertices.size() / VOXEL_FLOATS_PER_VERTEX);
+                const float* source = &mesh.vertices[(size_t) vertex * VOXEL_FLOATS_PER_VERTEX];
+                rest.vertices.insert(rest.vertices.end(), source, source + VOXEL_FLOATS_PER_VERTEX);
+            }
+            rest.indices.push_back(remap[vertex]);
+        }
+    }
+    if(!rest.indices.empty())
+    {
+        out_meshes.push_back(std::move(rest));
+    }
+
+    faces.erase(std::remove_if(faces.begin(), faces.end(), [](const voxel_face_t& face) { return face.b_hidden; }), faces.end());
+    std::sort(faces.begin(), faces.end(), [](const voxel_face_t& a, const voxel_face_t& b)
+    {
+        int tile_order = memcmp(a.tile, b.tile, sizeof(a.tile));
+        if(tile_order != 0) return tile_order < 0;
+        if(a.axis != b.axis) return a.axis < b.axis;
+        if(a.b_positive != b.b_positive) return a.b_positive < b.b_positive;
+        if(a.cell[a.axis] != b.cell[b.axis]) return a.cell[a.axis] < b.cell[b.axis];
+        if(a.orientation != b.orientation) return a.orientation < b.orientation;
+        u8 t = (a.axis + 2) % 3;
+        u8 s = (a.axis + 1) % 3;
+        if(a.cell[t] != b.cell[t]) return a.cell[t] < b.cell[t];
+        return a.cell[s] < b.cell[s];
+    });
+
+    for(size_t start = 0; start < faces.size();)
+    {
+        mesh_buffers_t tile_mesh;
+        tile_mesh.material_index = mesh.material_index;
+        memcpy(tile_mesh.uv_rect, faces[start].tile, sizeof(tile_mesh.uv_rect));
+        size_t tile_end = start;
+        while(tile_end < faces.size() && memcmp(faces[tile_end].tile, faces[start].tile, sizeof(faces[start].tile)) == 0)
+        {
+            size_t group_end = tile_end;
+            const voxel_face_t& first = faces[tile_end];
+            while(group_end < faces.size() && memcmp(faces[group_end].tile, first.tile, sizeof(first.tile)) == 0
+                  && faces[group_end].axis == first.axis && faces[group_end].b_positive == first.b_positive
+                  && faces[group_end].cell[first.axis] == first.cell[first.axis] && faces[group_end].orientation == first.orientation)
+            {
+                ++group_end;
+            }
+            voxel_merge_faces(tile_mesh, &faces[tile_end], group_end - tile_end, origin, cell_size);
+            tile_end = group_end;
+        }
+        out_meshes.push_back(std::move(tile_mesh));
+        start = tile_end;
+    }
+}
+
+bool mesh_voxel_remesh(std::vector<mesh_buffers_t>& meshes,
+                       const std::vector<std::string>& texture_paths,
+                       mesh_voxel_stats_t* out_stats)
+{
+    mesh_voxel_stats_t stats;
+    u32 meshes_count = (u32) meshes.size();
+    std::vector<voxel_mesh_t> voxel_meshes(meshes_count);
+    worker_pool_parallel_for(meshes_count, [&meshes, &voxel_meshes](u32 i)
+    {
+        const mesh_buffers_t& mesh = meshes[i];
+        voxel_mesh_t& voxel_mesh = voxel_meshes[i];
+        u32 triangles_count = (u32) mesh.indices.size() / 3;
+        if(mesh.vertices.empty() || triangles_count < 2)
+        {
+            return;
+        }
+        for(u32 triangle = 0; triangle + 1 < triangles_count;)
+        {
+            voxel_quad_t quad;
+            if(voxel_find_quad(mesh, triangle, quad))
+            {
+                voxel_mesh.quads.push_back(quad);
+                triangle += 2;
+            }
+            else
+            {
+                ++triangle;
+            }
+        }
+        voxel_mesh.b_voxels = (float) (voxel_mesh.quads.size() * 2) >= MESH_VOXEL_MIN_FACE_FRACTION * (float) triangles_count;
+    });
+
+    float cell_size = voxel_find_cell_size(voxel_meshes);
+    const voxel_quad_t* first_quad = nullptr;
+    for(const voxel_mesh_t& voxel_mesh : voxel_meshes)
+    {
+        first_quad = !first_quad && voxel_mesh.b_voxels && !voxel_mesh.quads.empty() ? &voxel_mesh.quads[0] : first_quad;
+    }
+    if(first_quad == nullptr || cell_size <= 0.f)
+    {
+        if(out_stats)
+        {
+            *out_stats = stats;
+        }
+        return false;
+    }
+
+    // The grid goes through a corner of the first face
+    float origin[3];
+    origin[first_quad->axis] = first_quad->plane;
+    origin[(first_quad->axis + 1) % 3] = first_quad->s0;
+    origin[(first_quad->axis + 2) % 3] = first_quad->t0;
+
+    worker_pool_parallel_for(meshes_count, [&voxel_meshes, &origin, cell_size](u32 i)
+    {
+        voxel_mesh_t& voxel_mesh = voxel_meshes[i];
+        for(size_t q = 0; voxel_mesh.b_voxels && q < voxel_mesh.quads.size(); ++q)
+        {
+            voxel_face_t face;
+            face.mesh = i;
+            if(voxel_make_face(voxel_mesh.quads[q], origin, cell_size, face))
+            {
+                voxel_mesh.faces.push_back(face);
+            }
+        }
+        voxel_mesh.quads = std::vector<voxel_quad_t>();
+    });
+
+    stats.cell_size = cell_size;
+    stats.hidden_faces_count = voxel_remove_hidden_faces(voxel_meshes, meshes, texture_paths);
+
+    std::vector<std::vector<mesh_buffers_t>> remeshed(meshes_count);
+    worker_pool_parallel_for(meshes_count, [&meshes, &voxel_meshes, &remeshed, &origin, cell_size](u32 i)
+    {
+        if(voxel_meshes[i].b_voxels)
+        {
+            voxel_remesh_mesh(meshes[i], voxel_meshes[i], remeshed[i], origin, cell_size);
+        }
+    });
+
+    std::vector<mesh_buffers_t> result;
+    for(u32 i = 0; i < meshes_count; ++i)
+    {
+        if(!voxel_meshes[i].b_voxels)
+        {
+            result.push_back(std::move(meshes[i]));
+            continue;
+        }
+        ++stats.voxel_meshes_count;
+        stats.triangles_before += meshes[i].indices.size() / 3;
+        for(mesh_buffers_t& remeshed_mesh : remeshed[i])
+        {
+            ++stats.meshes_count_after;
+            stats.triangles_after += remeshed_mesh.indices.size() / 3;
+            result.push_back(std::move(remeshed_mesh));
+        }
+    }
+    meshes = std::move(result);
+
+    if(out_stats)
+    {
+        *out_stats = stats;
+    }
+    return stats.voxel_meshes_count > 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    MESH VOXEL - hidden face removal and greedy remeshing of block worlds
+
+    Block worlds exported as OBJ (vokselia_spawn, minecraft_lost_empire) store every block face
+    as its own quad, including the faces buried between two blocks. This import stage finds
+    meshes made of such faces and rebuilds them with far fewer triangles:
+        1.  Consecutive triangle pairs that form an axis aligned square on a grid are block
+            faces. The grid cell size is the most common face size over every mesh. A mesh is
+            treated as voxels if at least MESH_VOXEL_MIN_FACE_FRACTION of its triangles are faces.
+        2.  Two faces in the same spot facing opposite ways belong to two neighbouring blocks
+            and can't be seen, so both are removed (across meshes too). Faces with see-through
+            texels in their tile stay, since the geometry pass discards those texels.
+        3.  The faces left are merged into rectangles with greedy meshing: faces on the same
+            plane, facing the same way, with the same material, and showing the same atlas tile
+            the same way up.
+    A merged rectangle covers several tiles, so its uvs count tiles instead of pointing into
+    the atlas: uvs run from 0 to the width and height of the rectangle in blocks, and the
+    geometry pass wraps them into the tile with fract(). The tile is per mesh (mesh_t::uv_rect),
+    so every tile of a material becomes its own mesh. Triangles of a voxel mesh that aren't
+    block faces are kept as they are in a mesh of their own.
+
+    Greedy meshing leaves T-junctions where rectangles of different sizes meet, which can show
+    as single pixel cracks. Meshes that aren't voxels are left alone. CPU only.
+*/
+
+#define MESH_VOXEL_MIN_FACE_FRACTION 0.9f   // of the triangles of a mesh that have to be block faces
+#define MESH_VOXEL_ALPHA_CUTOFF 128         // texels with less alpha get discarded by the geometry pass
+#define MESH_VOXEL_GRID_LIMIT (1 << 19)     // blocks further than this many cells from the origin aren't touched
+
+struct mesh_voxel_stats_t
+{
+    u32     voxel_meshes_count = 0;     // meshes that were remeshed
+    u32     meshes_count_after = 0;     // what they got split into
+    u64     triangles_before = 0;       // of the voxel meshes
+    u64     triangles_after = 0;
+    u64     hidden_faces_count = 0;     // faces removed because they were between two blocks
+    float   cell_size = 0.f;
+};
+
+/** Remeshes every voxel mesh of a model in place. Meshes are interleaved { x y z u v nx ny nz }
+    and haven't been optimized yet. texture_paths has the diffuse texture of every material,
+    which gets decoded to find see-through tiles. Meshes that aren't voxels keep their order
+    and stay untouched. Returns false if the model has no voxel meshes. */
+bool mesh_voxel_remesh(std::vector<mesh_buffers_t>& meshes,
+                       const std::vector<std::string>& texture_paths,
+                       mesh_voxel_stats_t* out_stats = nullptr);
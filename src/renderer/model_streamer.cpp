@@ -0,0 +1,994 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+
+#include "model_streamer.h"
+#include "mesh_group.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplify.h"
+#include "mesh_cluster.h"
+#include "mesh_voxel.h"
+#include "mesh_merge.h"
+#include "obj_parser.h"
+#include "gltf_loader.h"
+#include "texture.h"
+#include "gpu_upload.h"
+#include "../core/timer.h"
+#include "../core/worker_pool.h"
+#include "../core/file_system.h"
+#include "../core/hash.h"
+#include "../debugging/console.h"
+#include "../stb/stb_image.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+/** Post processing steps run by Assimp on import. Part of the mesh cache key, so changing
+    these flags invalidates every cooked mesh. */
+internal const u32 ASSIMP_IMPORT_FLAGS = aiProcess_Triangulate
+                                         | aiProcess_GenNormals
+                                         | aiProcess_JoinIdenticalVertices;
+
+/** Stands in for the importer flags in the mesh cache key of models loaded with the OBJ parser,
+    including the ones it couldn't read and handed to Assimp. Bump it when the OBJ parser output changes. */
+internal const u32 OBJ_PARSER_IMPORTER_FLAGS = 0x4f424a01; // 'OBJ' 1
+
+/** Mixed into the mesh cache key of models whose meshes got merged by material, so turning
+    merging on or off doesn't pick up a cache cooked the other way. */
+internal const u32 MESH_MERGE_IMPORTER_FLAGS = 0x4d524700; // 'MRG'
+
+enum model_stream_item_type_t
+{
+    MODEL_STREAM_BEGIN,     // mesh and material counts are known, resize the mesh group
+    MODEL_STREAM_BUFFER_RANGE,  // copy part of a glTF buffer view into the GPU buffer of the model
+    MODEL_STREAM_MESH,
+    MODEL_STREAM_TEXTURE
+};
+
+/** Something a worker finished that the main thread has to upload. The mesh data points into
+    model_stream_t::mesh_buffers, the mapped mesh cache, or the mapped glTF files, so it stays
+    valid until the stream is done. */
+struct model_stream_item_t
+{
+    model_stream_item_type_t type = MODEL_STREAM_BEGIN;
+    u32                     index = 0;          // mesh index, or index into unique_texture_paths
+    const float*            vertices = nullptr;
+    const u32*              indices = nullptr;
+    u32                     vertices_count = 0; // number of floats
+    u32                     indices_count = 0;
+    const mesh_lod_t*       lods = nullptr;
+    u32                     lods_count = 0;
+    const mesh_cluster_t*   clusters = nullptr;
+    u32                     clusters_count = 0;
+    u32                     material_index = 0;
+    const float*            uv_rect = nullptr;
+    const mesh_buffer_layout_t* layout = nullptr;   // of meshes drawn straight from the GPU buffer of a glTF model
+    const u8*               range_source = nullptr;
+    u64                     range_offset = 0;   // bytes into the GPU buffer
+    u64                     range_size = 0;
+    bitmap_handle_t         image;              // decoded texture, memory is nullptr if it failed to decode
+    u64                     image_hash = 0;     // hash_fnv1a64 of image.memory, hashed by the worker that decoded it
+    texture_cooked_t*       cooked = nullptr;   // cooked texture instead of image, owned by the item
+};
+
+struct model_stream_t
+{
+    mesh_group_t*   group = nullptr;
+    std::string     file_name;
+    i64             start_ticks = 0;
+    bool            b_from_cache = false;
+    bool            b_obj_parser = false;       // import with the OBJ parser instead of Assimp
+    bool            b_compare_importers = false;
+    bool            b_gltf = false;             // load with the glTF loader, don't flip its textures
+    bool            b_merge_meshes = false;     // merge meshes by material on import
+    texture_compression_t texture_compression = TEXTURE_COMPRESSION_NONE;
+
+    // Filled in by the load job before it posts MODEL_STREAM_BEGIN, read only after that
+    u32                         meshes_count = 0;
+    std::vector<std::string>    texture_paths;          // per material, empty if it has no texture
+    std::vector<std::string>    unique_texture_paths;   // every texture to decode, once each
+    std::vector<mesh_buffers_t> mesh_buffers;           // converted meshes, if the model got imported
+    mesh_cache_t                cache;                  // mapped mesh cache, if there was a valid one
+    gltf_model_t                gltf;                   // mapped glTF files, if the model is one
+
+    // Workers post, the main thread takes
+    std::mutex                          ready_mutex;
+    std::deque<model_stream_item_t>     ready_items;
+    std::atomic<u32>                    jobs_running { 0 };    // load job and texture decode jobs
+
+    // Main thread only
+    bool                                b_begun = false;
+    u32                                 gpu_buffer = 0;        // of a glTF model, owned by the mesh group
+    u32                                 meshes_resident = 0;
+    u32                                 textures_resident = 0;
+    u32                                 buffer_uploads_pending = 0;    // glTF buffer slices on the upload thread
+    u32                                 texture_uploads_pending = 0;
+    std::vector<bool>                   b_material_waiting;    // texture of the material isn't uploaded yet
+    std::vector<model_stream_item_t>    waiting_meshes;        // ready, but their texture or buffer isn't
+    i64                                 last_progress_ticks = 0;
+};
+
+internal std::vector<std::shared_ptr<model_stream_t>> active_streams;
+internal float upload_budget_ms = MODEL_STREAMER_DEFAULT_BUDGET_MS;
+internal model_streamer_obj_mode_t obj_mode = MODEL_STREAMER_OBJ_NATIVE;
+internal bool b_merge_meshes = true;
+
+internal float model_streamer_seconds_since(i64 ticks)
+{
+    return (float) (timer::get_ticks() - ticks) / (float) timer::counter_frequency();
+}
+
+internal void model_streamer_post(model_stream_t& stream, const model_stream_item_t& item)
+{
+    std::lock_guard<std::mutex> lock(stream.ready_mutex);
+    stream.ready_items.push_back(item);
+}
+
+internal void model_streamer_unpack_mesh(mesh_buffers_t& mesh_buffers, aiMesh* mesh_node)
+{
+    const u8 vb_entries_per_vertex = 8;
+    std::vector<float>& vb = mesh_buffers.vertices;
+    std::vector<u32>& ib = mesh_buffers.indices;
+    vb.resize(mesh_node->mNumVertices * vb_entries_per_vertex);
+    ib.resize(mesh_node->mNumFaces * mesh_node->mFaces[0].mNumIndices);
+    if(mesh_node->mTextureCoords[0])
+    {
+        for(size_t i = 0; i < mesh_node->mNumVertices; ++i)
+        {
+            // mNormals and mVertices are both mNumVertices in size
+            size_t v_start_index = i * vb_entries_per_vertex;
+            vb[v_start_index] = mesh_node->mVertices[i].x;
+            vb[v_start_index + 1] = mesh_node->mVertices[i].y;
+            vb[v_start_index + 2] = mesh_node->mVertices[i].z;
+            vb[v_start_index + 3] = mesh_node->mTextureCoords[0][i].x;
+            vb[v_start_index + 4] = mesh_node->mTextureCoords[0][i].y;
+            vb[v_start_index + 5] = mesh_node->mNormals[i].x;
+            vb[v_start_index + 6] = mesh_node->mNormals[i].y;
+            vb[v_start_index + 7] = mesh_node->mNormals[i].z;
+        }
+    }
+    else
+    {
+        for(size_t i = 0; i < mesh_node->mNumVertices; ++i)
+        {
+            size_t v_start_index = i * vb_entries_per_vertex;
+            vb[v_start_index] = mesh_node->mVertices[i].x;
+            vb[v_start_index + 1] = mesh_node->mVertices[i].y;
+            vb[v_start_index + 2] = mesh_node->mVertices[i].z;
+            vb[v_start_index + 3] = 0.f;
+            vb[v_start_index + 4] = 0.f;
+            vb[v_start_index + 5] = mesh_node->mNormals[i].x;
+            vb[v_start_index + 6] = mesh_node->mNormals[i].y;
+            vb[v_start_index + 7] = mesh_node->mNormals[i].z;
+        }
+    }
+
+    for(size_t i = 0; i < mesh_node->mNumFaces; ++i)
+    {
+        aiFace face = mesh_node->mFaces[i];
+        for(size_t j = 0; j < face.mNumIndices; ++j)
+        {
+            ib[i * face.mNumIndices + j] = face.mIndices[j]; // prob sometimes not correct to index ib this way
+        }
+    }
+
+    mesh_buffers.material_index = mesh_node->mMaterialIndex;
+}
+
+internal void model_streamer_collect_mesh_instances(const aiNode* node, const aiMatrix4x4& parent_transform,
+                                                   std::vector<std::pair<u32, aiMatrix4x4>>& out_instances)
+{
+    aiMatrix4x4 transform = parent_transform * node->mTransformation;
+    for(u32 i = 0; i < node->mNumMeshes; ++i)
+    {
+        out_instances.push_back(std::make_pair(node->mMeshes[i], transform));
+    }
+    for(u32 i = 0; i < node->mNumChildren; ++i)
+    {
+        model_streamer_collect_mesh_instances(node->mChildren[i], transform, out_instances);
+    }
+}
+
+/** Bakes the global transform of the node drawing each mesh into its vertices, so meshes can be
+    merged. A mesh drawn by several nodes gets a copy per extra node appended after the others.
+    Meshes no node draws are left as they are. */
+internal void model_streamer_bake_node_transforms(std::vector<mesh_buffers_t>& mesh_buffers, const aiScene* scene)
+{
+    std::vector<std::pair<u32, aiMatrix4x4>> instances;
+    model_streamer_collect_mesh_instances(scene->mRootNode, aiMatrix4x4(), instances);
+
+    // Copies come from the untransformed mesh, so they're made before anything is transformed
+    std::vector<bool> b_drawn(mesh_buffers.size(), false);
+    std::vector<bool> b_first_instance(instances.size(), false);
+    std::vector<mesh_buffers_t> copies;
+    for(size_t i = 0; i < instances.size(); ++i)
+    {
+        u32 mesh_index = instances[i].first;
+        if(mesh_index >= mesh_buffers.size())
+        {
+            continue;
+        }
+        b_first_instance[i] = !b_drawn[mesh_index];
+        b_drawn[mesh_index] = true;
+        if(!b_first_instance[i])
+        {
+            copies.push_back(mesh_buffers[mesh_index]);
+        }
+    }
+
+    size_t copy_index = 0;
+    for(size_t i = 0; i < instances.size(); ++i)
+    {
+        u32 mesh_index = instances[i].first;
+        if(mesh_index >= mesh_buffers.size())
+        {
+            continue;
+        }
+        mesh_buffers_t& mesh = b_first_instance[i] ? mesh_buffers[mesh_index] : copies[copy_index++];
+        const aiMatrix4x4& node_transform = instances[i].second;
+        if(!node_transform.IsIdentity())
+        {
+            mat4 transform;
+            for(int col = 0; col < 4; ++col)
+            {
+                for(int row = 0; row < 4; ++row)
+                {
+                    transform[col][row] = node_transform[row][col];
+                }
+            }
+            mesh_merge_transform(mesh, transform);
+        }
+    }
+    for(mesh_buffers_t& copy : copies)
+    {
+        mesh_buffers.push_back(std::move(copy));
+    }
+}
+
+/** Texture paths in model files are relative to the directory of the model file */
+internal std::string model_streamer_resolve_texture_path(const std::string& path, const char* file_name)
+{
+    int idx = (int)path.find_last_of("\\");
+    std::string texture_file_name = path.substr(idx+1);
+    std::string model_file_directory = std::string(file_name);
+    idx = max((int)model_file_directory.find_last_of("/"), (int)model_file_directory.find_last_of("\\"));
+    model_file_directory = model_file_directory.substr(0, idx + 1);
+    return model_file_directory + texture_file_name;
+}
+
+/** Diffuse texture path of every material */
+internal void model_streamer_resolve_texture_paths(std::vector<std::string>& texture_paths, const aiScene* scene, const char* file_name)
+{
+    texture_paths.resize(scene->mNumMaterials);
+    for(size_t i = 0; i < scene->mNumMaterials; ++i)
+    {
+        aiMaterial* mat = scene->mMaterials[i];
+        if(mat->GetTextureCount(aiTextureType_DIFFUSE))
+        {
+            aiString path;
+            if(mat->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+            {
+                texture_paths[i] = model_streamer_resolve_texture_path(std::string(path.data), file_name);
+            }
+        }
+    }
+}
+
+internal void model_streamer_print_conversion_stats(const std::vector<mesh_buffers_t>& mesh_buffers,
+                                                    const std::vector<mesh_vertex_cache_stats_t>& stats_before,
+                                                    const std::vector<mesh_vertex_cache_stats_t>& stats_after)
+{
+    u64 lod_triangles_count[MESH_MAX_LODS] = {};
+    for(size_t i = 0; i < mesh_buffers.size(); ++i)
+    {
+        // Meshes that couldn't be simplified any further draw their last LOD at every level after it
+        const mesh_buffers_t& buffers = mesh_buffers[i];
+        for(u32 lod = 0; lod < MESH_MAX_LODS; ++lod)
+        {
+            u32 available_lod = lod < buffers.lods_count ? lod : buffers.lods_count - 1;
+            lod_triangles_count[lod] += buffers.lods[available_lod].indices_count / 3;
+        }
+    }
+    console_printf("LOD triangles: %llu / %llu / %llu / %llu\n",
+                   lod_triangles_count[0], lod_triangles_count[1], lod_triangles_count[2], lod_triangles_count[3]);
+
+    u64 triangles_count = 0;
+    u64 vertices_before = 0;
+    u64 vertices_after = 0; // the vertex fetch pass drops vertices no index uses
+    u64 misses_before = 0;
+    u64 misses_after = 0;
+    for(size_t i = 0; i < mesh_buffers.size(); ++i)
+    {
+        triangles_count += stats_before[i].triangles_count;
+        vertices_before += stats_before[i].vertices_count;
+        vertices_after += stats_after[i].vertices_count;
+        misses_before += stats_before[i].cache_misses;
+        misses_after += stats_after[i].cache_misses;
+    }
+    if(triangles_count > 0 && vertices_before > 0 && vertices_after > 0)
+    {
+        console_printf("vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                       (float)misses_before / (float)triangles_count, (float)misses_after / (float)triangles_count,
+                       (float)misses_before / (float)vertices_before, (float)misses_after / (float)vertices_after);
+    }
+}
+
+/** Worker. Once the meshes and texture paths are known, tells the main thread to size the mesh
+    group and starts decoding every texture of the model in parallel with the meshes. */
+internal void model_streamer_begin(const std::shared_ptr<model_stream_t>& stream)
+{
+    for(const std::string& path : stream->texture_paths)
+    {
+        bool b_duplicate = path.empty();
+        for(const std::string& unique_path : stream->unique_texture_paths)
+        {
+            b_duplicate |= unique_path == path;
+        }
+        if(!b_duplicate)
+        {
+            stream->unique_texture_paths.push_back(path);
+        }
+    }
+    model_streamer_post(*stream, model_stream_item_t());
+
+    for(u32 i = 0; i < stream->unique_texture_paths.size(); ++i)
+    {
+        ++stream->jobs_running;
+        worker_pool_submit([stream, i]()
+        {
+            const char* path = stream->unique_texture_paths[i].c_str();
+            model_stream_item_t item;
+            item.type = MODEL_STREAM_TEXTURE;
+            item.index = i;
+            int width, height, bit_depth;
+            // glTF uvs start at the top left of the image, everything else at the bottom left
+            bool b_flip = !stream->b_gltf;
+            stbi_set_flip_vertically_on_load_thread(b_flip ? 1 : 0);
+            const gltf_embedded_image_t* embedded = nullptr;
+            for(const gltf_embedded_image_t& image : stream->gltf.embedded_images)
+            {
+                embedded = image.path == stream->unique_texture_paths[i] ? &image : embedded;
+            }
+            // Files are cooked through their .texcache, embedded images have no file to keep a cache next to
+            if(stream->texture_compression != TEXTURE_COMPRESSION_NONE && !embedded)
+            {
+                item.cooked = new texture_cooked_t;
+                if(!texture_cache_load(*item.cooked, path, b_flip, stream->texture_compression))
+                {
+                    console_printf("Failed to find image file at: %s\n", path);
+                    delete item.cooked;
+                    item.cooked = nullptr;
+                }
+                model_streamer_post(*stream, item);
+                --stream->jobs_running;
+                return;
+            }
+            item.image.memory = embedded
+                ? stbi_load_from_memory(embedded->memory, (int) embedded->size, &width, &height, &bit_depth, 0)
+                : stbi_load(path, &width, &height, &bit_depth, 0);
+            if(item.image.memory)
+            {
+                item.image.width = (u32) width;
+                item.image.height = (u32) height;
+                item.image.bit_depth = (u8) bit_depth;
+                item.image.size = item.image.width * item.image.height * item.image.bit_depth;
+                if(stream->texture_compression != TEXTURE_COMPRESSION_NONE)
+                {
+                    item.cooked = new texture_cooked_t;
+                    texture_cook(*item.cooked, item.image, stream->texture_compression);
+                    free_image(item.image);
+                }
+                else
+                {
+                    item.image_hash = hash_fnv1a64(item.image.memory, item.image.size);
+                }
+            }
+            else
+            {
+                console_printf("Failed to find image file at: %s\n", path);
+            }
+            model_streamer_post(*stream, item);
+            --stream->jobs_running;
+        });
+    }
+}
+
+/** Worker. Optimizes, clusters, and generates LODs for every mesh in mesh_buffers on every
+    core. Each mesh is handed to the main thread for upload as soon as it's converted, instead
+    of waiting for the whole model. Mesh i of mesh_buffers goes to mesh first_mesh_index + i of
+    the mesh group. */
+internal void model_streamer_convert_meshes(const std::shared_ptr<model_stream_t>& stream, u32 first_mesh_index)
+{
+    u32 meshes_count = (u32) stream->mesh_buffers.size();
+    i64 step_ticks = timer::get_ticks();
+    std::vector<mesh_vertex_cache_stats_t> stats_before(meshes_count);
+    std::vector<mesh_vertex_cache_stats_t> stats_after(meshes_count);
+    model_stream_t* stream_ptr = stream.get();
+    worker_pool_parallel_for(meshes_count, [stream_ptr, &stats_before, &stats_after, first_mesh_index](u32 i)
+    {
+        mesh_buffers_t& buffers = stream_ptr->mesh_buffers[i];
+        mesh_optimize(buffers, &stats_before[i], &stats_after[i]);
+        mesh_build_clusters(buffers);
+        mesh_generate_lods(buffers);
+
+        model_stream_item_t item;
+        item.type = MODEL_STREAM_MESH;
+        item.index = first_mesh_index + i;
+        item.vertices = buffers.vertices.data();
+        item.indices = buffers.indices.data();
+        item.vertices_count = (u32) buffers.vertices.size();
+        item.indices_count = (u32) buffers.indices.size();
+        item.lods = buffers.lods;
+        item.lods_count = buffers.lods_count;
+        item.clusters = buffers.clusters.data();
+        item.clusters_count = (u32) buffers.clusters.size();
+        item.material_index = buffers.material_index;
+        item.uv_rect = buffers.uv_rect;
+        model_streamer_post(*stream_ptr, item);
+    });
+    console_printf("took %f seconds to optimize and simplify all the meshes on %d threads\n",
+                   model_streamer_seconds_since(step_ticks), worker_pool_thread_count() + 1);
+    model_streamer_print_conversion_stats(stream->mesh_buffers, stats_before, stats_after);
+}
+
+/** Worker. Posts every mesh of a valid mesh cache. */
+internal void model_streamer_load_from_cache(const std::shared_ptr<model_stream_t>& stream)
+{
+    const mesh_cache_t& cache = stream->cache;
+    stream->b_from_cache = true;
+    stream->meshes_count = cache.header->mesh_count;
+    stream->texture_paths.resize(cache.header->material_count);
+    for(u32 i = 0; i < cache.header->material_count; ++i)
+    {
+        const mesh_cache_material_entry_t& material = cache.material_table[i];
+        if(material.texture_path_length > 0)
+        {
+            stream->texture_paths[i] = std::string(cache.strings + material.texture_path_offset, material.texture_path_length);
+        }
+    }
+    model_streamer_begin(stream);
+
+    for(u32 i = 0; i < cache.header->mesh_count; ++i)
+    {
+        const mesh_cache_mesh_entry_t& entry = cache.mesh_table[i];
+        model_stream_item_t item;
+        item.type = MODEL_STREAM_MESH;
+        item.index = i;
+        item.vertices = cache.vertex_blob + entry.vertex_offset;
+        item.indices = cache.index_blob + entry.index_offset;
+        item.vertices_count = entry.vertices_count;
+        item.indices_count = entry.indices_count;
+        item.lods = entry.lods;
+        item.lods_count = entry.lods_count;
+        item.clusters = cache.cluster_blob + entry.cluster_offset;
+        item.clusters_count = entry.clusters_count;
+        item.material_index = entry.material_index;
+        item.uv_rect = entry.uv_rect;
+        model_streamer_post(*stream, item);
+    }
+}
+
+/** Worker. Parses an OBJ model with the OBJ parser. If b_compare_importers, Assimp imports the
+    same file afterwards to print how long it takes in comparison. */
+internal bool model_streamer_parse_obj(const std::shared_ptr<model_stream_t>& stream)
+{
+    const char* file_name = stream->file_name.c_str();
+    i64 step_ticks = timer::get_ticks();
+    obj_parse_stats_t obj_stats;
+    if(!obj_parse(file_name, stream->mesh_buffers, stream->texture_paths, &obj_stats))
+    {
+        console_printf("OBJ parser couldn't read '%s', trying Assimp\n", file_name);
+        return false;
+    }
+    float parse_seconds = model_streamer_seconds_since(step_ticks);
+    console_printf("took %f seconds to parse OBJ on %d threads (%u chunks, %u triangles, %u vertices in %u meshes)\n",
+                   parse_seconds, worker_pool_thread_count() + 1, obj_stats.chunks_count, obj_stats.triangles_count,
+                   obj_stats.vertices_count, (u32) stream->mesh_buffers.size());
+    if(obj_stats.skipped_faces_count > 0)
+    {
+        console_printf("WARNING: skipped %u faces with missing vertices or fewer than 3 corners\n", obj_stats.skipped_faces_count);
+    }
+    for(std::string& path : stream->texture_paths)
+    {
+        if(!path.empty())
+        {
+            path = model_streamer_resolve_texture_path(path, file_name);
+        }
+    }
+
+    if(stream->b_compare_importers)
+    {
+        step_ticks = timer::get_ticks();
+        Assimp::Importer importer;
+        if(importer.ReadFile(file_name, ASSIMP_IMPORT_FLAGS))
+        {
+            float assimp_seconds = model_streamer_seconds_since(step_ticks);
+            console_printf("took %f seconds to Importer::ReadFile the same file, OBJ parser is %.1fx faster\n",
+                           assimp_seconds, parse_seconds > 0.f ? assimp_seconds / parse_seconds : 0.f);
+        }
+    }
+    return true;
+}
+
+/** Worker. Imports the model through the OBJ parser or Assimp, converts every mesh on the worker
+    pool posting each one as soon as it is done, then writes the mesh cache. */
+internal void model_streamer_import(const std::shared_ptr<model_stream_t>& stream, u64 source_hash)
+{
+    const char* file_name = stream->file_name.c_str();
+    // The cache is keyed by the importer that was asked for, so a file the OBJ parser can't read
+    // keeps the OBJ parser key even though Assimp imported it: loading it again gets the same result
+    u32 importer_flags = stream->b_obj_parser ? OBJ_PARSER_IMPORTER_FLAGS : ASSIMP_IMPORT_FLAGS;
+    bool b_assimp = !stream->b_obj_parser || !model_streamer_parse_obj(stream);
+    if(b_assimp)
+    {
+        stream->mesh_buffers.clear();
+        stream->texture_paths.clear();
+    }
+
+    i64 step_ticks = timer::get_ticks();
+    Assimp::Importer importer;
+    const aiScene* scene = nullptr;
+    /*  NOTE: To create smooth normals respecting edges sharper than a given angle,
+        use importer.SetPropertyFloat("PP_GSN_MAX_SMOOTHING_ANGLE", 90) along with
+        aiProcess_GenSmoothNormals flag. https://github.com/assimp/assimp/issues/1713
+
+        aiProcess_GenSmoothNormals
+        This flag may not be specified together with #aiProcess_GenNormals. There's
+        a importer property, #AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE which allows you to
+        specify an angle maximum for the normal smoothing algorithm. Normals exceeding
+        this limit are not smoothed, resulting in a 'hard' seam between two faces.
+        Using a decent angle here (e.g. 80 degrees) results in very good visual
+        appearance. To create smooth normals respecting edges sharper than a given angle,
+        use importer.SetPropertyFloat("PP_GSN_MAX_SMOOTHING_ANGLE", 90) along with
+        aiProcess_GenSmoothNormals flag. https://github.com/assimp/assimp/issues/1713
+
+        aiProcess_JoinIdenticalVertices
+        is compulsory for indexed drawing. This still works with flat shaded geometry
+        because it only joins vertices that are identical in both position and normal.
+        e.g. a flat shaded cube will have 24 vertices after joining because each side
+        of the cube will have 4 unique vertices and the vertices at the corners will
+        not be shared by multiple faces of the cube because they will have different
+        normals even though their positions are the same.
+    */
+    if(b_assimp)
+    {
+        scene = importer.ReadFile(file_name, ASSIMP_IMPORT_FLAGS);
+        if(!scene)
+        {
+            console_printf("Model '%s' failed to load: %s\n", file_name, importer.GetErrorString());
+            return;
+        }
+        console_printf("took %f seconds to Importer::ReadFile\n", model_streamer_seconds_since(step_ticks));
+        stream->mesh_buffers.resize(scene->mNumMeshes);
+        model_streamer_resolve_texture_paths(stream->texture_paths, scene, file_name);
+        std::vector<mesh_buffers_t>& mesh_buffers = stream->mesh_buffers;
+        worker_pool_parallel_for(scene->mNumMeshes, [&mesh_buffers, scene](u32 i)
+        {
+            model_streamer_unpack_mesh(mesh_buffers[i], scene->mMeshes[i]);
+        });
+        if(stream->b_merge_meshes)
+        {
+            model_streamer_bake_node_transforms(stream->mesh_buffers, scene);
+        }
+    }
+
+    // Block worlds lose their buried faces before anything else looks at them
+    step_ticks = timer::get_ticks();
+    mesh_voxel_stats_t voxel_stats;
+    if(mesh_voxel_remesh(stream->mesh_buffers, stream->texture_paths, &voxel_stats))
+    {
+        console_printf("took %f seconds to remesh %u voxel meshes into %u: %llu -> %llu triangles, %llu hidden faces removed\n",
+                       model_streamer_seconds_since(step_ticks), voxel_stats.voxel_meshes_count, voxel_stats.meshes_count_after,
+                       voxel_stats.triangles_before, voxel_stats.triangles_after, voxel_stats.hidden_faces_count);
+    }
+
+    if(stream->b_merge_meshes)
+    {
+        mesh_merge_stats_t merge_stats;
+        mesh_merge_by_material(stream->mesh_buffers, &merge_stats);
+        console_printf("merged meshes by material: %u draws -> %u draws (%u materials)\n",
+                       merge_stats.meshes_before, merge_stats.meshes_after, merge_stats.materials_count);
+        importer_flags ^= MESH_MERGE_IMPORTER_FLAGS;
+    }
+
+    stream->meshes_count = (u32) stream->mesh_buffers.size();
+    model_streamer_begin(stream);
+    model_streamer_convert_meshes(stream, 0);
+
+    step_ticks = timer::get_ticks();
+    u64 cache_size = mesh_cache_write(file_name, source_hash, importer_flags, stream->mesh_buffers, stream->texture_paths);
+    if(cache_size > 0)
+    {
+        console_printf("took %f seconds to write %.1f MB of mesh cache\n",
+                       model_streamer_seconds_since(step_ticks), (float) cache_size / (1024.f * 1024.f));
+    }
+}
+
+/** Worker. Loads a glTF model: the buffer views its meshes use go to the main thread in slices
+    to be copied into the GPU buffer of the model as they are, followed by the meshes that draw
+    from it. Primitives the glTF loader had to convert go through the usual mesh conversion.
+    Returns false if the model has to be imported by Assimp instead. */
+internal bool model_streamer_load_gltf(const std::shared_ptr<model_stream_t>& stream)
+{
+    const char* file_name = stream->file_name.c_str();
+    i64 step_ticks = timer::get_ticks();
+    gltf_model_t& gltf = stream->gltf;
+    gltf_load_stats_t gltf_stats;
+    if(!gltf_load(gltf, file_name, &gltf_stats))
+    {
+        console_printf("glTF loader couldn't load '%s', trying Assimp\n", file_name);
+        stream->b_gltf = false;
+        return false;
+    }
+    console_printf("took %f seconds to map and read glTF (%u primitives: %u drawn from %.1f MB of buffer views, %u converted, %u skipped)\n",
+                   model_streamer_seconds_since(step_ticks), gltf_stats.primitives_count, (u32) gltf.meshes.size(),
+                   (float) gltf.gpu_buffer_size / (1024.f * 1024.f), gltf_stats.converted_count, gltf_stats.skipped_count);
+
+    u32 direct_meshes_count = (u32) gltf.meshes.size();
+    stream->texture_paths = gltf.texture_paths;
+    stream->mesh_buffers = std::move(gltf.converted_meshes);
+    stream->meshes_count = direct_meshes_count + (u32) stream->mesh_buffers.size();
+    model_streamer_begin(stream);
+
+    // Slices keep a single big buffer view from blowing the upload budget of a frame
+    for(const gltf_upload_range_t& range : gltf.upload_ranges)
+    {
+        for(u64 offset = 0; offset < range.size; offset += MODEL_STREAMER_BUFFER_SLICE_SIZE)
+        {
+            model_stream_item_t item;
+            item.type = MODEL_STREAM_BUFFER_RANGE;
+            item.range_source = range.source + offset;
+            item.range_offset = range.gpu_offset + offset;
+            item.range_size = min(range.size - offset, (u64) MODEL_STREAMER_BUFFER_SLICE_SIZE);
+            model_streamer_post(*stream, item);
+        }
+    }
+    for(u32 i = 0; i < direct_meshes_count; ++i)
+    {
+        model_stream_item_t item;
+        item.type = MODEL_STREAM_MESH;
+        item.index = i;
+        item.layout = &gltf.meshes[i].layout;
+        item.material_index = gltf.meshes[i].material_index;
+        model_streamer_post(*stream, item);
+    }
+
+    if(!stream->mesh_buffers.empty())
+    {
+        model_streamer_convert_meshes(stream, direct_meshes_count);
+    }
+    return true;
+}
+
+void model_streamer_load(mesh_group_t& group, const char* file_name)
+{
+    std::shared_ptr<model_stream_t> stream = std::make_shared<model_stream_t>();
+    stream->group = &group;
+    stream->file_name = file_name;
+    stream->start_ticks = timer::get_ticks();
+    stream->last_progress_ticks = stream->start_ticks;
+    stream->jobs_running = 1;
+    std::string extension = stream->file_name.substr(min(stream->file_name.find_last_of('.'), stream->file_name.size()));
+    for(char& c : extension)
+    {
+        c = (char) tolower(c);
+    }
+    stream->b_obj_parser = obj_mode != MODEL_STREAMER_OBJ_ASSIMP && extension == ".obj";
+    stream->b_compare_importers = stream->b_obj_parser && obj_mode == MODEL_STREAMER_OBJ_COMPARE;
+    stream->b_gltf = extension == ".gltf" || extension == ".glb";
+    stream->b_merge_meshes = b_merge_meshes;
+    stream->texture_compression = texture_get_compression();
+    active_streams.push_back(stream);
+
+    console_printf("Streaming '%s'...\n", file_name);
+    worker_pool_submit([stream]()
+    {
+        // glTF is already what the mesh cache would store, so it skips the cache
+        if(stream->b_gltf && model_streamer_load_gltf(stream))
+        {
+            --stream->jobs_running;
+            return;
+        }
+
+        const char* file_name = stream->file_name.c_str();
+        u64 source_hash = mesh_cache_hash_source(file_name);
+        u32 merge_flags = stream->b_merge_meshes ? MESH_MERGE_IMPORTER_FLAGS : 0;
+        u32 importer_flags = (stream->b_obj_parser ? OBJ_PARSER_IMPORTER_FLAGS : ASSIMP_IMPORT_FLAGS) ^ merge_flags;
+        mesh_cache_status_t cache_status = stream->b_compare_importers
+                                           ? MESH_CACHE_MISSING // the importers only run if the cache is skipped
+                                           : mesh_cache_open(stream->cache, file_name, source_hash, importer_flags);
+        if(cache_status == MESH_CACHE_OK)
+        {
+            model_streamer_load_from_cache(stream);
+        }
+        else
+        {
+            if(cache_status == MESH_CACHE_STALE)
+            {
+                console_printf("Mesh cache of '%s' is out of date, importing again\n", file_name);
+            }
+            model_streamer_import(stream, source_hash);
+        }
+        --stream->jobs_running;
+    });
+}
+
+internal void model_streamer_upload_mesh(model_stream_t& stream, const model_stream_item_t& item)
+{
+    mesh_group_t& group = *stream.group;
+    if(item.layout)
+    {
+        mesh_t::gl_create_mesh_from_buffer(group.meshes[item.index], stream.gpu_buffer, *item.layout);
+    }
+    else
+    {
+        mesh_t::gl_create_mesh(group.meshes[item.index], item.vertices, item.indices,
+                               item.vertices_count, item.indices_count, mesh_group_get_vertex_format(),
+                               item.lods, item.lods_count, item.clusters, item.clusters_count);
+    }
+    if(item.uv_rect)
+    {
+        memcpy(group.meshes[item.index].uv_rect, item.uv_rect, sizeof(group.meshes[item.index].uv_rect));
+    }
+    group.mesh_to_texture[item.index] = (u16) item.material_index;
+    ++stream.meshes_resident;
+}
+
+/** A mesh waits for the texture of its material, and a mesh drawn from the glTF buffer for
+    every slice of that buffer to be on the GPU */
+internal bool model_streamer_mesh_waits(const model_stream_t& stream, const model_stream_item_t& item)
+{
+    return (item.material_index < stream.b_material_waiting.size() && stream.b_material_waiting[item.material_index])
+        || (item.layout && stream.buffer_uploads_pending > 0);
+}
+
+/** Meshes that were held back and can go now go to the front of the queue */
+internal void model_streamer_release_waiting_meshes(model_stream_t& stream)
+{
+    std::lock_guard<std::mutex> lock(stream.ready_mutex);
+    for(size_t i = stream.waiting_meshes.size(); i-- > 0;)
+    {
+        if(!model_streamer_mesh_waits(stream, stream.waiting_meshes[i]))
+        {
+            stream.ready_items.push_front(stream.waiting_meshes[i]);
+            stream.waiting_meshes.erase(stream.waiting_meshes.begin() + i);
+        }
+    }
+}
+
+/** Main thread. Gives the texture of unique_texture_paths[index] to every material using it. */
+internal void model_streamer_texture_ready(model_stream_t& stream, u32 index, texture_t& texture)
+{
+    mesh_group_t& group = *stream.group;
+    const std::string& path = stream.unique_texture_paths[index];
+
+    // Every material holds its own reference to the texture
+    bool b_texture_taken = false;
+    for(size_t i = 0; i < stream.texture_paths.size(); ++i)
+    {
+        if(stream.texture_paths[i] == path)
+        {
+            if(b_texture_taken)
+            {
+                texture_t::gl_share(group.textures[i], texture);
+            }
+            else
+            {
+                group.textures[i] = texture;
+            }
+            b_texture_taken = true;
+            stream.b_material_waiting[i] = false;
+        }
+    }
+    ++stream.textures_resident;
+    model_streamer_release_waiting_meshes(stream);
+}
+
+/** Main thread. Uploads one item, returns false if the stream had nothing ready. Uploads that
+    go through the upload thread only count as resident once they're published. */
+internal bool model_streamer_upload_one(const std::shared_ptr<model_stream_t>& stream_pointer)
+{
+    model_stream_t& stream = *stream_pointer;
+    model_stream_item_t item;
+    {
+        std::lock_guard<std::mutex> lock(stream.ready_mutex);
+        if(stream.ready_items.empty())
+        {
+            return false;
+        }
+        item = stream.ready_items.front();
+        stream.ready_items.pop_front();
+    }
+
+    mesh_group_t& group = *stream.group;
+    switch(item.type)
+    {
+        case MODEL_STREAM_BEGIN:
+        {
+            group.meshes.resize(stream.meshes_count);
+            group.mesh_to_texture.resize(stream.meshes_count);
+            group.textures.resize(stream.texture_paths.size());
+            stream.b_material_waiting.resize(stream.texture_paths.size());
+            for(size_t i = 0; i < stream.texture_paths.size(); ++i)
+            {
+                stream.b_material_waiting[i] = !stream.texture_paths[i].empty();
+            }
+            if(stream.gltf.gpu_buffer_size > 0)
+            {
+                // Created here, filled by the upload thread slice by slice
+                glCreateBuffers(1, &stream.gpu_buffer);
+                glNamedBufferStorage(stream.gpu_buffer, (GLsizeiptr) stream.gltf.gpu_buffer_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+                group.buffers.push_back(stream.gpu_buffer);
+            }
+            stream.b_begun = true;
+        } break;
+
+        case MODEL_STREAM_BUFFER_RANGE:
+        {
+            // The mapped glTF files stay open until the stream is done, which waits for this
+            ++stream.buffer_uploads_pending;
+            u32 gpu_buffer = stream.gpu_buffer;
+            gpu_upload_submit([gpu_buffer, item]()
+            {
+                glNamedBufferSubData(gpu_buffer, (GLintptr) item.range_offset, (GLsizeiptr) item.range_size, item.range_source);
+                return 0u;
+            },
+            [stream_pointer](u32)
+            {
+                --stream_pointer->buffer_uploads_pending;
+                model_streamer_release_waiting_meshes(*stream_pointer);
+            });
+        } break;
+
+        case MODEL_STREAM_MESH:
+        {
+            if(model_streamer_mesh_waits(stream, item))
+            {
+                stream.waiting_meshes.push_back(item);
+            }
+            else
+            {
+                model_streamer_upload_mesh(stream, item);
+            }
+        } break;
+
+        case MODEL_STREAM_TEXTURE:
+        {
+            const std::string& path = stream.unique_texture_paths[item.index];
+            u32 index = item.index;
+            ++stream.texture_uploads_pending;
+            texture_ready_t on_ready = [stream_pointer, index](texture_t& texture)
+            {
+                --stream_pointer->texture_uploads_pending;
+                model_streamer_texture_ready(*stream_pointer, index, texture);
+            };
+            if(item.cooked)
+            {
+                texture_t::gl_create_from_cooked_async(path.c_str(), item.cooked, on_ready);
+            }
+            else if(item.image.memory)
+            {
+                texture_t::gl_create_from_image_async(path.c_str(), item.image, item.image_hash, on_ready);
+            }
+            else
+            {
+                texture_t texture; // didn't decode, its materials go without
+                on_ready(texture);
+            }
+        } break;
+    }
+    return true;
+}
+
+void model_streamer_update()
+{
+    if(active_streams.empty())
+    {
+        return;
+    }
+
+    i64 frequency = timer::counter_frequency();
+    i64 start_ticks = timer::get_ticks();
+    i64 budget_ticks = (i64) ((double) upload_budget_ms * (double) frequency / 1000.0);
+    bool b_uploaded_any = false;
+    for(size_t i = 0; i < active_streams.size(); ++i)
+    {
+        while(!b_uploaded_any || timer::get_ticks() - start_ticks < budget_ticks)
+        {
+            if(!model_streamer_upload_one(active_streams[i]))
+            {
+                break;
+            }
+            b_uploaded_any = true;
+        }
+    }
+
+    i64 now_ticks = timer::get_ticks();
+    for(size_t i = 0; i < active_streams.size();)
+    {
+        model_stream_t& stream = *active_streams[i];
+
+        // The job count is checked before the queue: once it reads 0 every item has been posted
+        bool b_cpu_done = stream.jobs_running == 0;
+        bool b_queue_empty;
+        {
+            std::lock_guard<std::mutex> lock(stream.ready_mutex);
+            b_queue_empty = stream.ready_items.empty();
+        }
+
+        if(b_cpu_done && b_queue_empty && stream.buffer_uploads_pending == 0 && stream.texture_uploads_pending == 0)
+        {
+            if(stream.b_begun)
+            {
+                mesh_group_build_texture_arrays(*stream.group);
+                console_printf("'%s' fully resident after %.2f seconds (%u meshes, %u textures, %s)\n",
+                               stream.file_name.c_str(), model_streamer_seconds_since(stream.start_ticks),
+                               stream.meshes_resident, stream.textures_resident,
+                               stream.b_gltf ? "glTF" : stream.b_from_cache ? "from mesh cache" : "imported");
+            }
+            mesh_cache_close(stream.cache);
+            gltf_close(stream.gltf);
+            active_streams.erase(active_streams.begin() + i);
+            continue;
+        }
+
+        if(stream.b_begun && (float) (now_ticks - stream.last_progress_ticks) / (float) frequency >= MODEL_STREAMER_PROGRESS_INTERVAL)
+        {
+            console_printf("'%s': %u/%u meshes, %u/%u textures resident\n", stream.file_name.c_str(),
+                           stream.meshes_resident, stream.meshes_count,
+                           stream.textures_resident, (u32) stream.unique_texture_paths.size());
+            stream.last_progress_ticks = now_ticks;
+        }
+        ++i;
+    }
+}
+
+void model_streamer_finish()
+{
+    float budget_ms = upload_budget_ms;
+    upload_budget_ms = 1000000.f;
+    while(!active_streams.empty())
+    {
+        gpu_upload_update();
+        model_streamer_update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    upload_budget_ms = budget_ms;
+}
+
+bool model_streamer_is_busy()
+{
+    return !active_streams.empty();
+}
+
+void model_streamer_set_budget(float milliseconds)
+{
+    upload_budget_ms = max(milliseconds, 0.f);
+    console_printf("Model streaming upload budget is %.2f ms per frame\n", upload_budget_ms);
+}
+
+void model_streamer_set_obj_mode(int mode)
+{
+    if(mode < MODEL_STREAMER_OBJ_ASSIMP || mode > MODEL_STREAMER_OBJ_COMPARE)
+    {
+        console_printf("OBJ import: 0 Assimp, 1 OBJ parser, 2 OBJ parser and time Assimp on the same file (skips the mesh cache)\n");
+        return;
+    }
+    obj_mode = (model_streamer_obj_mode_t) mode;
+    console_printf("OBJ models loaded from now on are imported with %s\n",
+                   mode == MODEL_STREAMER_OBJ_ASSIMP ? "Assimp" : mode == MODEL_STREAMER_OBJ_NATIVE ? "the OBJ parser" : "the OBJ parser and Assimp");
+}
+
+void model_streamer_set_merge_meshes(int b_merge)
+{
+    b_merge_meshes = b_merge != 0;
+    console_printf("Models imported from now on %s their meshes by material\n", b_merge_meshes ? "merge" : "don't merge");
+}
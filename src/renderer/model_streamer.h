@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../gamedefine.h"
+
+struct mesh_group_t;
+
+/**
+    MODEL STREAMER - loading models without stalling the frame
+
+    Everything that doesn't need GL happens on the worker pool: reading the mesh cache or
+    importing the model through Assimp, converting the meshes (optimize, cluster, LODs), writing
+    the mesh cache, and decoding the textures. Each mesh and texture is handed to the main
+    thread as soon as it is ready, and model_streamer_update uploads as many of them as fit in
+    its time budget every frame. Meshes become resident one by one and get drawn as soon as they
+    are, so a big model fills in over a few frames instead of freezing the game while it loads.
+
+    Textures and glTF buffer slices are created and filled on the upload thread (gpu_upload.h),
+    so submitting them costs the frame next to nothing; they count as resident once the GPU has
+    them. Meshes get their VAOs on the main thread, since VAOs aren't shared between contexts.
+    A mesh isn't uploaded before the texture of its material (nor a glTF mesh before its whole
+    buffer), so it never shows up with the wrong texture bound or half its vertices. Load progress is printed to the console. Once the whole model is
+    resident its textures get copied into texture arrays, see mesh_group_build_texture_arrays.
+
+    OBJ models are imported by the OBJ parser (see obj_parser.h), glTF and GLB models are loaded
+    by the glTF loader (see gltf_loader.h), and every other format is imported by Assimp. glTF
+    models skip the mesh cache: their buffers get copied into a GPU buffer as they are, in slices
+    of MODEL_STREAMER_BUFFER_SLICE_SIZE, which makes glTF the fastest format to ship models in.
+
+    The mesh group must stay alive (and must not be cleared) until its load has finished, see
+    model_streamer_is_busy.
+*/
+
+#define MODEL_STREAMER_DEFAULT_BUDGET_MS 4.f
+#define MODEL_STREAMER_PROGRESS_INTERVAL 0.25f     // seconds between console progress reports
+#define MODEL_STREAMER_BUFFER_SLICE_SIZE (4 << 20)  // most bytes of glTF buffer uploaded at once
+
+enum model_streamer_obj_mode_t
+{
+    MODEL_STREAMER_OBJ_ASSIMP = 0,
+    MODEL_STREAMER_OBJ_NATIVE = 1,
+    MODEL_STREAMER_OBJ_COMPARE = 2  // OBJ parser, then times Assimp on the same file. Skips the mesh cache
+};
+
+/** Starts loading the model at file_name into group on the worker pool and returns immediately.
+    group should be empty. */
+void model_streamer_load(mesh_group_t& group, const char* file_name);
+
+/** Main thread, once per frame. Uploads ready meshes and textures until the upload budget for
+    this frame is used up. At least one mesh or texture gets uploaded per call if one is ready,
+    so a load always makes progress even when a single upload takes longer than the budget. */
+void model_streamer_update();
+
+/** Blocks until every model that is loading is fully resident. */
+void model_streamer_finish();
+
+/** True while any model is still loading. */
+bool model_streamer_is_busy();
+
+/** Console command. Milliseconds per frame that model_streamer_update may spend uploading. */
+void model_streamer_set_budget(float milliseconds);
+
+/** Console command. How OBJ models loaded afterwards get imported, see model_streamer_obj_mode_t. */
+void model_streamer_set_obj_mode(int mode);
+
+/** Console command. Whether models loaded afterwards get their meshes merged by material (see
+    mesh_merge.h). On by default. */
+void model_streamer_set_merge_meshes(int b_merge);
@@ -0,0 +1,843 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+
+#include "obj_parser.h"
+#include "../core/kc_math.h"
+#include "../core/worker_pool.h"
+#include "../core/file_system.h"
+
+#define OBJ_NONE 0xffffffff // corner without a texcoord or normal
+#define OBJ_WELD_SHARD_BITS 6
+#define OBJ_WELD_BLOCK_CORNERS (1 << 16)
+
+enum obj_line_type_t
+{
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_TEXCOORD,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE,
+    OBJ_LINE_OBJECT,    // o or g
+    OBJ_LINE_USEMTL,
+    OBJ_LINE_MTLLIB
+};
+
+/** One corner of a triangle, as 0 based indices into the attribute arrays of the whole file */
+struct obj_corner_t
+{
+    u32 position;
+    u32 texcoord;
+    u32 normal;
+};
+
+/** Consecutive triangles of a chunk that belong to the same object and material */
+struct obj_run_t
+{
+    u32 object;
+    u32 material;
+    u32 first_corner;
+    u32 corners_count;
+};
+
+struct obj_chunk_t
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    // Pass 1
+    u32 positions_count = 0;
+    u32 texcoords_count = 0;
+    u32 normals_count = 0;
+    u32 objects_count = 0;
+    bool b_has_material = false;
+    std::string last_material;                  // name of the last usemtl in this chunk
+    std::vector<std::string> material_libraries;
+
+    // Where this chunk starts, from the chunks before it
+    u32 first_position = 0;
+    u32 first_texcoord = 0;
+    u32 first_normal = 0;
+    u32 first_object = 0;
+    u32 start_material = 0;
+
+    // Pass 2
+    std::vector<obj_corner_t> corners;
+    std::vector<obj_run_t> runs;
+    u32 skipped_faces_count = 0;
+};
+
+struct obj_attributes_t
+{
+    std::vector<float> positions;   // xyz
+    std::vector<float> texcoords;   // uv
+    std::vector<float> normals;     // xyz
+};
+
+/** A run of one chunk that goes into a mesh */
+struct obj_mesh_run_t
+{
+    u32 chunk;
+    u32 run;
+};
+
+inline bool obj_is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline bool obj_is_line_end(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+internal const char* obj_skip_spaces(const char* p, const char* end)
+{
+    while(p < end && obj_is_space(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+internal const char* obj_next_line(const char* p, const char* end)
+{
+    while(p < end && *p != '\n')
+    {
+        ++p;
+    }
+    return p < end ? p + 1 : end;
+}
+
+/** p is the first non space character of a line. Advances p past the keyword. */
+internal obj_line_type_t obj_classify_line(const char*& p, const char* end)
+{
+    u64 remaining = (u64) (end - p);
+    if(remaining < 2)
+    {
+        if(remaining == 1 && (*p == 'o' || *p == 'g'))
+        {
+            ++p;
+            return OBJ_LINE_OBJECT;
+        }
+        return OBJ_LINE_OTHER;
+    }
+
+    char c0 = p[0];
+    char c1 = p[1];
+    if(c0 == 'v')
+    {
+        if(obj_is_space(c1))
+        {
+            p += 2;
+            return OBJ_LINE_POSITION;
+        }
+        if(remaining >= 3 && obj_is_space(p[2]))
+        {
+            if(c1 == 't')
+            {
+                p += 3;
+                return OBJ_LINE_TEXCOORD;
+            }
+            if(c1 == 'n')
+            {
+                p += 3;
+                return OBJ_LINE_NORMAL;
+            }
+        }
+        return OBJ_LINE_OTHER;
+    }
+    if(c0 == 'f' && obj_is_space(c1))
+    {
+        p += 2;
+        return OBJ_LINE_FACE;
+    }
+    if((c0 == 'o' || c0 == 'g') && (obj_is_space(c1) || obj_is_line_end(c1)))
+    {
+        p += 1;
+        return OBJ_LINE_OBJECT;
+    }
+    if(remaining >= 7 && obj_is_space(p[6]))
+    {
+        if(memcmp(p, "usemtl", 6) == 0)
+        {
+            p += 7;
+            return OBJ_LINE_USEMTL;
+        }
+        if(memcmp(p, "mtllib", 6) == 0)
+        {
+            p += 7;
+            return OBJ_LINE_MTLLIB;
+        }
+    }
+    return OBJ_LINE_OTHER;
+}
+
+/** The rest of the line without surrounding whitespace */
+internal std::string obj_line_argument(const char* p, const char* end)
+{
+    p = obj_skip_spaces(p, end);
+    const char* line_end = p;
+    while(line_end < end && !obj_is_line_end(*line_end))
+    {
+        ++line_end;
+    }
+    while(line_end > p && obj_is_space(*(line_end - 1)))
+    {
+        --line_end;
+    }
+    return std::string(p, line_end - p);
+}
+
+/** Faster than strtof, and doesn't depend on the locale. Good to about 7 significant digits. */
+internal const char* obj_parse_float(const char* p, const char* end, float& out_value)
+{
+    local_persist const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = obj_skip_spaces(p, end);
+    bool b_negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        b_negative = *p == '-';
+        ++p;
+    }
+
+    double value = 0.0;
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10.0 + (double) (*p - '0');
+        ++p;
+    }
+    if(p < end && *p == '.')
+    {
+        ++p;
+        int fraction_digits = 0;
+        while(p < end && *p >= '0' && *p <= '9')
+        {
+            if(fraction_digits < 22)
+            {
+                value = value * 10.0 + (double) (*p - '0');
+                ++fraction_digits;
+            }
+            ++p;
+        }
+        value /= powers_of_ten[fraction_digits];
+    }
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool b_negative_exponent = false;
+        if(p < end && (*p == '-' || *p == '+'))
+        {
+            b_negative_exponent = *p == '-';
+            ++p;
+        }
+        int exponent = 0;
+        while(p < end && *p >= '0' && *p <= '9')
+        {
+            exponent = exponent * 10 + (*p - '0');
+            ++p;
+        }
+        double scale = exponent <= 22 ? powers_of_ten[exponent] : pow(10.0, (double) exponent);
+        value = b_negative_exponent ? value / scale : value * scale;
+    }
+
+    out_value = (float) (b_negative ? -value : value);
+    return p;
+}
+
+internal const char* obj_parse_int(const char* p, const char* end, i64& out_value)
+{
+    bool b_negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        b_negative = *p == '-';
+        ++p;
+    }
+    i64 value = 0;
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    out_value = b_negative ? -value : value;
+    return p;
+}
+
+/** OBJ indices are 1 based, or relative to the end of the attribute array if negative.
+    Returns OBJ_NONE for 0 or an index outside of the attributes defined so far. */
+inline u32 obj_resolve_index(i64 index, u32 defined_count)
+{
+    i64 resolved = index > 0 ? index - 1 : (i64) defined_count + index;
+    return (index != 0 && resolved >= 0 && resolved < (i64) defined_count) ? (u32) resolved : OBJ_NONE;
+}
+
+internal void obj_count_chunk(obj_chunk_t& chunk)
+{
+    const char* end = chunk.end;
+    for(const char* line = chunk.begin; line < end; line = obj_next_line(line, end))
+    {
+        const char* p = obj_skip_spaces(line, end);
+        switch(obj_classify_line(p, end))
+        {
+            case OBJ_LINE_POSITION: ++chunk.positions_count; break;
+            case OBJ_LINE_TEXCOORD: ++chunk.texcoords_count; break;
+            case OBJ_LINE_NORMAL: ++chunk.normals_count; break;
+            case OBJ_LINE_OBJECT: ++chunk.objects_count; break;
+            case OBJ_LINE_USEMTL:
+            {
+                chunk.b_has_material = true;
+                chunk.last_material = obj_line_argument(p, end);
+            } break;
+            case OBJ_LINE_MTLLIB: chunk.material_libraries.push_back(obj_line_argument(p, end)); break;
+            default: break;
+        }
+    }
+}
+
+internal void obj_parse_chunk(obj_chunk_t& chunk,
+                              obj_attributes_t& attributes,
+                              const std::unordered_map<std::string, u32>& material_indices)
+{
+    float* positions = attributes.positions.data() + (u64) chunk.first_position * 3;
+    float* texcoords = attributes.texcoords.data() + (u64) chunk.first_texcoord * 2;
+    float* normals = attributes.normals.data() + (u64) chunk.first_normal * 3;
+    u32 positions_count = 0;
+    u32 texcoords_count = 0;
+    u32 normals_count = 0;
+    u32 object = chunk.first_object;
+    u32 material = chunk.start_material;
+
+    std::vector<obj_corner_t> polygon;
+    const char* end = chunk.end;
+    for(const char* line = chunk.begin; line < end; line = obj_next_line(line, end))
+    {
+        const char* p = obj_skip_spaces(line, end);
+        switch(obj_classify_line(p, end))
+        {
+            case OBJ_LINE_POSITION:
+            {
+                float* position = positions + (u64) positions_count * 3;
+                p = obj_parse_float(p, end, position[0]);
+                p = obj_parse_float(p, end, position[1]);
+                obj_parse_float(p, end, position[2]);
+                ++positions_count;
+            } break;
+
+            case OBJ_LINE_TEXCOORD:
+            {
+                float* texcoord = texcoords + (u64) texcoords_count * 2;
+                p = obj_parse_float(p, end, texcoord[0]);
+                obj_parse_float(p, end, texcoord[1]);
+                ++texcoords_count;
+            } break;
+
+            case OBJ_LINE_NORMAL:
+            {
+                float* normal = normals + (u64) normals_count * 3;
+                p = obj_parse_float(p, end, normal[0]);
+                p = obj_parse_float(p, end, normal[1]);
+                obj_parse_float(p, end, normal[2]);
+                ++normals_count;
+            } break;
+
+            case OBJ_LINE_FACE:
+            {
+                u32 defined_positions = chunk.first_position + positions_count;
+                u32 defined_texcoords = chunk.first_texcoord + texcoords_count;
+                u32 defined_normals = chunk.first_normal + normals_count;
+                polygon.clear();
+                bool b_valid = true;
+                for(;;)
+                {
+                    p = obj_skip_spaces(p, end);
+                    if(p >= end || obj_is_line_end(*p) || *p == '#')
+                    {
+                        break;
+                    }
+                    i64 index;
+                    obj_corner_t corner = { OBJ_NONE, OBJ_NONE, OBJ_NONE };
+                    p = obj_parse_int(p, end, index);
+                    corner.position = obj_resolve_index(index, defined_positions);
+                    if(p < end && *p == '/')
+                    {
+                        ++p;
+                        if(p < end && *p != '/')
+                        {
+                            p = obj_parse_int(p, end, index);
+                            corner.texcoord = obj_resolve_index(index, defined_texcoords);
+                        }
+                        if(p < end && *p == '/')
+                        {
+                            ++p;
+                            p = obj_parse_int(p, end, index);
+                            corner.normal = obj_resolve_index(index, defined_normals);
+                        }
+                    }
+                    while(p < end && !obj_is_space(*p) && !obj_is_line_end(*p))
+                    {
+                        ++p; // junk after the corner
+                    }
+                    b_valid &= corner.position != OBJ_NONE;
+                    polygon.push_back(corner);
+                }
+                if(!b_valid || polygon.size() < 3)
+                {
+                    ++chunk.skipped_faces_count;
+                    break;
+                }
+
+                if(chunk.runs.empty() || chunk.runs.back().object != object || chunk.runs.back().material != material)
+                {
+                    obj_run_t run = { object, material, (u32) chunk.corners.size(), 0 };
+                    chunk.runs.push_back(run);
+                }
+                for(size_t i = 1; i + 1 < polygon.size(); ++i)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i]);
+                    chunk.corners.push_back(polygon[i + 1]);
+                }
+                chunk.runs.back().corners_count = (u32) chunk.corners.size() - chunk.runs.back().first_corner;
+            } break;
+
+            case OBJ_LINE_OBJECT: ++object; break;
+
+            case OBJ_LINE_USEMTL:
+            {
+                auto found = material_indices.find(obj_line_argument(p, end));
+                material = found != material_indices.end() ? found->second : 0;
+            } break;
+
+            default: break;
+        }
+    }
+}
+
+/** Reads every newmtl and its map_Kd out of an MTL file */
+internal void obj_parse_material_library(const char* file_name,
+                                         std::unordered_map<std::string, u32>& material_indices,
+                                         std::vector<std::string>& texture_paths)
+{
+    mapped_file_handle_t file;
+    map_file_readonly(file, file_name);
+    if(file.memory == nullptr)
+    {
+        return;
+    }
+
+    const char* end = (const char*) file.memory + file.size;
+    u32 material = OBJ_NONE;
+    for(const char* line = (const char*) file.memory; line < end; line = obj_next_line(line, end))
+    {
+        const char* p = obj_skip_spaces(line, end);
+        u64 remaining = (u64) (end - p);
+        if(remaining > 7 && memcmp(p, "newmtl", 6) == 0 && obj_is_space(p[6]))
+        {
+            std::string name = obj_line_argument(p + 7, end);
+            auto found = material_indices.find(name);
+            if(found != material_indices.end())
+            {
+                material = found->second;
+            }
+            else
+            {
+                material = (u32) texture_paths.size();
+                material_indices[name] = material;
+                texture_paths.push_back(std::string());
+            }
+        }
+        else if(material != OBJ_NONE && remaining > 7 && memcmp(p, "map_Kd", 6) == 0 && obj_is_space(p[6]))
+        {
+            // Options like -bm 0.5 come before the file name, so the file name is the last argument
+            std::string argument = obj_line_argument(p + 7, end);
+            size_t last_space = argument.find_last_of(" \t");
+            texture_paths[material] = last_space == std::string::npos ? argument : argument.substr(last_space + 1);
+        }
+    }
+    unmap_file(file);
+}
+
+inline u32 obj_hash_corner(const obj_corner_t& corner)
+{
+    u32 hash = corner.position * 0x9e3779b1u;
+    hash ^= (corner.texcoord * 0x85ebca77u) + (hash << 6) + (hash >> 2);
+    hash ^= (corner.normal * 0xc2b2ae3du) + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+inline bool obj_corners_equal(const obj_corner_t& a, const obj_corner_t& b)
+{
+    return a.position == b.position && a.texcoord == b.texcoord && a.normal == b.normal;
+}
+
+/** A corner sorted into its weld shard, remembering where it came from */
+struct obj_shard_corner_t
+{
+    obj_corner_t    corner;
+    u32             corner_index;
+};
+
+/** Hash table slot of a weld shard */
+struct obj_weld_slot_t
+{
+    obj_corner_t    corner;
+    u32             vertex;     // shard local, OBJ_NONE if the slot is empty
+};
+
+/** Welds identical corners of one mesh. out_indices gets the vertex of every corner and
+    out_unique the corner each vertex was made from. Corners are split into shards by hash and
+    every shard is welded with its own hash table, in parallel if the mesh is big enough.
+    Corners are copied into shard order first so each shard reads its corners sequentially. */
+internal void obj_weld(const std::vector<obj_corner_t>& corners,
+                       std::vector<u32>& out_indices,
+                       std::vector<obj_corner_t>& out_unique)
+{
+    u32 corners_count = (u32) corners.size();
+    bool b_sharded = corners_count > OBJ_PARSER_SHARDED_WELD_CORNERS;
+    u32 shard_bits = b_sharded ? OBJ_WELD_SHARD_BITS : 0;
+    u32 shards_count = 1 << shard_bits;
+    u32 blocks_count = b_sharded ? (corners_count + OBJ_WELD_BLOCK_CORNERS - 1) / OBJ_WELD_BLOCK_CORNERS : 1;
+    u32 block_size = (corners_count + blocks_count - 1) / blocks_count;
+
+    // Hash every corner and count how many corners each block puts in each shard
+    std::vector<u32> hashes(corners_count);
+    std::vector<u32> block_shard_counts((u64) blocks_count * shards_count, 0);
+    worker_pool_parallel_for(blocks_count, [&](u32 block)
+    {
+        u32 first = block * block_size;
+        u32 last = min(first + block_size, corners_count);
+        u32* shard_counts = block_shard_counts.data() + (u64) block * shards_count;
+        for(u32 i = first; i < last; ++i)
+        {
+            hashes[i] = obj_hash_corner(corners[i]);
+            ++shard_counts[shard_bits ? hashes[i] >> (32 - shard_bits) : 0];
+        }
+    });
+
+    // Sort corners by shard, keeping their order within each shard
+    std::vector<u32> shard_first(shards_count + 1, 0);
+    std::vector<u32> block_shard_offsets((u64) blocks_count * shards_count);
+    u32 offset = 0;
+    for(u32 shard = 0; shard < shards_count; ++shard)
+    {
+        shard_first[shard] = offset;
+        for(u32 block = 0; block < blocks_count; ++block)
+        {
+            block_shard_offsets[(u64) block * shards_count + shard] = offset;
+            offset += block_shard_counts[(u64) block * shards_count + shard];
+        }
+    }
+    shard_first[shards_count] = offset;
+    std::vector<obj_shard_corner_t> shard_corners(corners_count);
+    worker_pool_parallel_for(blocks_count, [&](u32 block)
+    {
+        u32 first = block * block_size;
+        u32 last = min(first + block_size, corners_count);
+        u32* shard_offsets = block_shard_offsets.data() + (u64) block * shards_count;
+        for(u32 i = first; i < last; ++i)
+        {
+            obj_shard_corner_t& shard_corner = shard_corners[shard_offsets[shard_bits ? hashes[i] >> (32 - shard_bits) : 0]++];
+            shard_corner.corner = corners[i];
+            shard_corner.corner_index = i;
+        }
+    });
+
+    // Weld each shard on its own, giving vertices shard local ids
+    std::vector<std::vector<obj_corner_t>> shard_unique(shards_count);
+    std::vector<u32> shard_vertices(corners_count);
+    worker_pool_parallel_for(shards_count, [&](u32 shard)
+    {
+        u32 first = shard_first[shard];
+        u32 last = shard_first[shard + 1];
+        u32 table_size = 16;
+        while(table_size < (last - first) * 2)
+        {
+            table_size *= 2;
+        }
+        u32 table_mask = table_size - 1;
+        obj_weld_slot_t empty_slot = { { OBJ_NONE, OBJ_NONE, OBJ_NONE }, OBJ_NONE };
+        std::vector<obj_weld_slot_t> table(table_size, empty_slot);
+        std::vector<obj_corner_t>& unique = shard_unique[shard];
+        for(u32 i = first; i < last; ++i)
+        {
+            const obj_corner_t& corner = shard_corners[i].corner;
+            u32 slot = hashes[shard_corners[i].corner_index] & table_mask;
+            while(table[slot].vertex != OBJ_NONE && !obj_corners_equal(table[slot].corner, corner))
+            {
+                slot = (slot + 1) & table_mask;
+            }
+            if(table[slot].vertex == OBJ_NONE)
+            {
+                table[slot].corner = corner;
+                table[slot].vertex = (u32) unique.size();
+                unique.push_back(corner);
+            }
+            shard_vertices[i] = table[slot].vertex;
+        }
+    });
+
+    // Shard local ids to mesh vertex indices
+    std::vector<u32> shard_first_vertex(shards_count + 1, 0);
+    for(u32 shard = 0; shard < shards_count; ++shard)
+    {
+        shard_first_vertex[shard + 1] = shard_first_vertex[shard] + (u32) shard_unique[shard].size();
+    }
+    out_indices.resize(corners_count);
+    out_unique.resize(shard_first_vertex[shards_count]);
+    worker_pool_parallel_for(shards_count, [&](u32 shard)
+    {
+        u32 first_vertex = shard_first_vertex[shard];
+        const std::vector<obj_corner_t>& unique = shard_unique[shard];
+        memcpy(out_unique.data() + first_vertex, unique.data(), sizeof(obj_corner_t) * unique.size());
+        for(u32 i = shard_first[shard]; i < shard_first[shard + 1]; ++i)
+        {
+            out_indices[shard_corners[i].corner_index] = first_vertex + shard_vertices[i];
+        }
+    });
+}
+
+/** Gathers the runs of one mesh, welds them, and builds its interleaved vertices */
+internal void obj_build_mesh(mesh_buffers_t& mesh,
+                             const std::vector<obj_chunk_t>& chunks,
+                             const std::vector<obj_mesh_run_t>& mesh_runs,
+                             const obj_attributes_t& attributes)
+{
+    u64 corners_count = 0;
+    for(const obj_mesh_run_t& mesh_run : mesh_runs)
+    {
+        corners_count += chunks[mesh_run.chunk].runs[mesh_run.run].corners_count;
+    }
+    std::vector<obj_corner_t> corners;
+    corners.reserve(corners_count);
+    for(const obj_mesh_run_t& mesh_run : mesh_runs)
+    {
+        const obj_chunk_t& chunk = chunks[mesh_run.chunk];
+        const obj_run_t& run = chunk.runs[mesh_run.run];
+        corners.insert(corners.end(), chunk.corners.begin() + run.first_corner,
+                       chunk.corners.begin() + run.first_corner + run.corners_count);
+    }
+
+    // Flat normals for faces that don't have any. They get indices after the normals of the
+    // file, and identical ones share an index so they still weld.
+    u32 file_normals_count = (u32) (attributes.normals.size() / 3);
+    std::vector<float> face_normals;
+    std::unordered_map<u64, u32> face_normal_indices;
+    for(u64 i = 0; i < corners.size(); i += 3)
+    {
+        obj_corner_t* triangle = &corners[i];
+        if(triangle[0].normal != OBJ_NONE && triangle[1].normal != OBJ_NONE && triangle[2].normal != OBJ_NONE)
+        {
+            continue;
+        }
+        const float* a = &attributes.positions[(u64) triangle[0].position * 3];
+        const float* b = &attributes.positions[(u64) triangle[1].position * 3];
+        const float* c = &attributes.positions[(u64) triangle[2].position * 3];
+        vec3 normal = cross(make_vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]),
+                            make_vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+        float length = magnitude(normal);
+        normal = length > 0.f ? normal / length : make_vec3(0.f, 1.f, 0.f);
+
+        // Quantized key, so normals that only differ by float noise still weld
+        u64 key = ((u64) (u16) (i16) (normal.x * 32767.f))
+                  | ((u64) (u16) (i16) (normal.y * 32767.f) << 16)
+                  | ((u64) (u16) (i16) (normal.z * 32767.f) << 32);
+        auto found = face_normal_indices.find(key);
+        u32 normal_index;
+        if(found != face_normal_indices.end())
+        {
+            normal_index = found->second;
+        }
+        else
+        {
+            normal_index = file_normals_count + (u32) (face_normals.size() / 3);
+            face_normal_indices[key] = normal_index;
+            face_normals.push_back(normal.x);
+            face_normals.push_back(normal.y);
+            face_normals.push_back(normal.z);
+        }
+        for(int corner = 0; corner < 3; ++corner)
+        {
+            if(triangle[corner].normal == OBJ_NONE)
+            {
+                triangle[corner].normal = normal_index;
+            }
+        }
+    }
+
+    std::vector<obj_corner_t> unique;
+    obj_weld(corners, mesh.indices, unique);
+
+    const u32 floats_per_vertex = 8;
+    mesh.vertices.resize(unique.size() * floats_per_vertex);
+    for(size_t i = 0; i < unique.size(); ++i)
+    {
+        const obj_corner_t& corner = unique[i];
+        float* vertex = &mesh.vertices[i * floats_per_vertex];
+        const float* position = &attributes.positions[(u64) corner.position * 3];
+        vertex[0] = position[0];
+        vertex[1] = position[1];
+        vertex[2] = position[2];
+        if(corner.texcoord != OBJ_NONE)
+        {
+            vertex[3] = attributes.texcoords[(u64) corner.texcoord * 2];
+            vertex[4] = attributes.texcoords[(u64) corner.texcoord * 2 + 1];
+        }
+        else
+        {
+            vertex[3] = 0.f;
+            vertex[4] = 0.f;
+        }
+        const float* normal = corner.normal < file_normals_count
+                              ? &attributes.normals[(u64) corner.normal * 3]
+                              : &face_normals[(u64) (corner.normal - file_normals_count) * 3];
+        vertex[5] = normal[0];
+        vertex[6] = normal[1];
+        vertex[7] = normal[2];
+    }
+}
+
+bool obj_parse(const char* file_name,
+               std::vector<mesh_buffers_t>& meshes,
+               std::vector<std::string>& texture_paths,
+               obj_parse_stats_t* out_stats)
+{
+    mapped_file_handle_t file;
+    map_file_readonly(file, file_name);
+    if(file.memory == nullptr)
+    {
+        return false;
+    }
+
+    // Cut the file into chunks that end on a line break
+    std::vector<obj_chunk_t> chunks;
+    const char* file_begin = (const char*) file.memory;
+    const char* file_end = file_begin + file.size;
+    for(const char* chunk_begin = file_begin; chunk_begin < file_end;)
+    {
+        const char* chunk_end = (u64) (file_end - chunk_begin) > OBJ_PARSER_CHUNK_SIZE
+                                ? obj_next_line(chunk_begin + OBJ_PARSER_CHUNK_SIZE, file_end)
+                                : file_end;
+        obj_chunk_t chunk;
+        chunk.begin = chunk_begin;
+        chunk.end = chunk_end;
+        chunks.push_back(chunk);
+        chunk_begin = chunk_end;
+    }
+
+    // Pass 1
+    worker_pool_parallel_for((u32) chunks.size(), [&chunks](u32 i)
+    {
+        obj_count_chunk(chunks[i]);
+    });
+
+    // Materials, with the default material first like Assimp
+    std::unordered_map<std::string, u32> material_indices;
+    texture_paths.assign(1, std::string());
+    std::string file_directory = file_name;
+    file_directory = file_directory.substr(0, max((int) file_directory.find_last_of("/"), (int) file_directory.find_last_of("\\")) + 1);
+    for(const obj_chunk_t& chunk : chunks)
+    {
+        for(const std::string& library : chunk.material_libraries)
+        {
+            obj_parse_material_library((file_directory + library).c_str(), material_indices, texture_paths);
+        }
+    }
+
+    // Where every chunk starts
+    obj_attributes_t attributes;
+    u32 positions_count = 0;
+    u32 texcoords_count = 0;
+    u32 normals_count = 0;
+    u32 objects_count = 0;
+    u32 material = 0;
+    for(obj_chunk_t& chunk : chunks)
+    {
+        chunk.first_position = positions_count;
+        chunk.first_texcoord = texcoords_count;
+        chunk.first_normal = normals_count;
+        chunk.first_object = objects_count;
+        chunk.start_material = material;
+        positions_count += chunk.positions_count;
+        texcoords_count += chunk.texcoords_count;
+        normals_count += chunk.normals_count;
+        objects_count += chunk.objects_count;
+        if(chunk.b_has_material)
+        {
+            auto found = material_indices.find(chunk.last_material);
+            material = found != material_indices.end() ? found->second : 0;
+        }
+    }
+    attributes.positions.resize((u64) positions_count * 3);
+    attributes.texcoords.resize((u64) texcoords_count * 2);
+    attributes.normals.resize((u64) normals_count * 3);
+
+    // Pass 2
+    worker_pool_parallel_for((u32) chunks.size(), [&chunks, &attributes, &material_indices](u32 i)
+    {
+        obj_parse_chunk(chunks[i], attributes, material_indices);
+    });
+    unmap_file(file);
+
+    // One mesh per object and material, in the order they first show up
+    std::unordered_map<u64, u32> mesh_indices;
+    std::vector<std::vector<obj_mesh_run_t>> mesh_runs;
+    std::vector<u32> mesh_materials;
+    for(u32 chunk_index = 0; chunk_index < (u32) chunks.size(); ++chunk_index)
+    {
+        const obj_chunk_t& chunk = chunks[chunk_index];
+        for(u32 run_index = 0; run_index < (u32) chunk.runs.size(); ++run_index)
+        {
+            const obj_run_t& run = chunk.runs[run_index];
+            u64 key = ((u64) run.object << 32) | run.material;
+            auto found = mesh_indices.find(key);
+            u32 mesh_index;
+            if(found != mesh_indices.end())
+            {
+                mesh_index = found->second;
+            }
+            else
+            {
+                mesh_index = (u32) mesh_runs.size();
+                mesh_indices[key] = mesh_index;
+                mesh_runs.emplace_back();
+                mesh_materials.push_back(run.material);
+            }
+            obj_mesh_run_t mesh_run = { chunk_index, run_index };
+            mesh_runs[mesh_index].push_back(mesh_run);
+        }
+    }
+
+    meshes.clear();
+    meshes.resize(mesh_runs.size());
+    worker_pool_parallel_for((u32) meshes.size(), [&](u32 i)
+    {
+        obj_build_mesh(meshes[i], chunks, mesh_runs[i], attributes);
+        meshes[i].material_index = mesh_materials[i];
+    });
+
+    if(out_stats)
+    {
+        *out_stats = obj_parse_stats_t();
+        out_stats->chunks_count = (u32) chunks.size();
+        out_stats->positions_count = positions_count;
+        for(const obj_chunk_t& chunk : chunks)
+        {
+            out_stats->triangles_count += (u32) chunk.corners.size() / 3;
+            out_stats->skipped_faces_count += chunk.skipped_faces_count;
+        }
+        for(const mesh_buffers_t& mesh : meshes)
+        {
+            out_stats->vertices_count += (u32) mesh.vertices.size() / 8;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "mesh.h"
+
+/**
+    OBJ PARSER - native Wavefront OBJ/MTL import that skips Assimp
+
+    The OBJ file is memory mapped and cut into chunks at line boundaries, and the chunks are
+    parsed in parallel on the worker pool in two passes:
+        1.  every chunk counts its v / vt / vn lines and notes its o, g, usemtl and mtllib lines,
+            so each chunk knows where its attributes go in the shared attribute arrays and which
+            object and material its first face belongs to
+        2.  every chunk parses its attributes straight into those arrays and its faces into
+            triangles (polygons get fan triangulated) of v/vt/vn index triplets
+    Triangles are then grouped into one mesh per object and material, like Assimp does, and the
+    meshes are built in parallel. Identical v/vt/vn triplets are welded into one vertex with a
+    hash table; big meshes split the table into shards by hash so they weld on every core.
+    Faces without normals get flat face normals.
+
+    The result is what the Assimp import (aiProcess_Triangulate | aiProcess_GenNormals |
+    aiProcess_JoinIdenticalVertices) produces: interleaved { x y z u v nx ny nz } meshes ready
+    for mesh_optimize. Material 0 is a default material without a texture, followed by the
+    materials of the MTL files in the order they are defined.
+
+    CPU only and thread safe. Every format other than OBJ still goes through Assimp.
+*/
+
+#define OBJ_PARSER_CHUNK_SIZE (1 << 20)         // bytes of OBJ per parse job
+#define OBJ_PARSER_SHARDED_WELD_CORNERS (1 << 18) // meshes with more triangle corners than this weld in parallel
+
+struct obj_parse_stats_t
+{
+    u32 chunks_count = 0;
+    u32 positions_count = 0;
+    u32 triangles_count = 0;
+    u32 vertices_count = 0;         // after welding, over every mesh
+    u32 skipped_faces_count = 0;    // faces with fewer than 3 corners or out of range position indices
+};
+
+/** Parses the OBJ file at file_name and the MTL files it references into meshes.
+    texture_paths has one entry per material: the map_Kd of the material exactly as written
+    in the MTL file, or an empty string if it has none. Returns false if the file can't be read. */
+bool obj_parse(const char* file_name,
+               std::vector<mesh_buffers_t>& meshes,
+               std::vector<std::string>& texture_paths,
+               obj_parse_stats_t* out_stats = nullptr);
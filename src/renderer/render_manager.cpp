@@ -1,12 +1,22 @@
 #include "render_manager.h"
 #include <GL/glew.h>
 #include "material.h"
+#include "mesh_arena.h"
+#include "skinned_mesh.h"
+#include "impostor.h"
+#include "texture_upload.h"
+#include "texture_residency.h"
+#include "texture_streaming.h"
+#include "gpu_upload.h"
+#include "frame_constants.h"
+#include "model_streamer.h"
 #include "../runtime/game_state.h"
 #include "../stb/stb_sprintf.h"
 #include "../debugging/console.h"
 #include "../debugging/profiling/profiler.h"
 #include "../debugging/debug_drawer.h"
 #include "../core/input.h"
+#include "../core/timer.h"
 
 SINGLETON_INIT(render_manager)
 
@@ -30,22 +40,31 @@ material_t material_shiny = {4.f, 128.f };
 material_t material_dull = {0.5f, 1.f };
 
 
-void render_manager::initialize()
+bool render_manager::initialize()
 {
     // Initialize GLEW
     glewExperimental = GL_TRUE; // Enable us to access modern opengl extension features
     if (glewInit() != GLEW_OK)
     {
         printf("GLEW failed to initialize.\n");
-        // todo return false;
+        return false;
     }
     console_printf("GLEW initialized.\n");
+    if (!GLEW_VERSION_4_5)
+    {
+        // Textures, buffers and meshes are all created with immutable storage and direct state access
+        printf("The renderer requires OpenGL 4.5, which this driver doesn't support.\n");
+        return false;
+    }
 
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // alpha blending func: a * (rgb) + (1 - a) * (rgb) = final color output
     glBlendEquation(GL_FUNC_ADD);
     glEnable(GL_CULL_FACE);
 
     update_buffer_size(back_buffer_width, back_buffer_height);
+    texture_upload_initialize();
+    gpu_upload_initialize();
+    frame_constants_initialize();
     matrix_projection_ortho = projection_matrix_orthographic_2d(0.0f, (float)back_buffer_width, (float)back_buffer_height, 0.0f);
 
     std::vector<std::string> skybox_faces_paths;
@@ -57,27 +76,86 @@ void render_manager::initialize()
     skybox_faces_paths.push_back("data/textures/skyboxes/sky/skybox_nz.jpg");
     cubemap_t::gl_create_from_files(m_skybox_renderer.skybox_cubemap, skybox_faces_paths);
     m_skybox_renderer.init();
+    return true;
 }
 
 void render_manager::render()
 {
+    texture_residency_update();
+    texture_streaming_update();
+
+    // Skinned once here, then every pass draws from the skinned vertex cache
+    skinned_mesh_update(timer::delta_time);
+
+    // Impostors get baked once the model is resident. Loading another model clears the group,
+    // which deletes its impostor, so the new model gets baked too.
+    mesh_group_t& model = gs->loaded_map.mainobject.model;
+    if(impostor_distance > 0.f && model.impostor.grid_size == 0 && !model.meshes.empty() && !model_streamer_is_busy())
+    {
+        impostor_bake(model.impostor, model);
+    }
+
+    update_frame_constants();
     render_pass_directional_shadow_map();
     render_pass_omnidirectional_shadow_map();
     render_pass_main();
 }
 
+void render_manager::update_frame_constants()
+{
+    camera_t& camera = gs->m_camera;
+    temp_map_t& loaded_map = gs->loaded_map;
+
+    camera.calculate_view_matrix();
+    view_constants_t view;
+    view.matrix_view = camera.matrix_view;
+    view.matrix_proj_perspective = camera.matrix_perspective;
+    view.eye_position = camera.position;
+    frame_constants_update_view(view);
+
+    light_constants_t lights;
+    lights.directional_light_transform = directional_shadow_map.directionalLightSpaceMatrix;
+    const directional_light_t& light = loaded_map.directionallight;
+    lights.directional_light.colour = light.colour;
+    lights.directional_light.ambient_intensity = light.ambient_intensity;
+    lights.directional_light.direction = orientation_to_direction(light.orientation);
+    lights.directional_light.diffuse_intensity = light.diffuse_intensity;
+    frame_constants_update_lights(lights);
+
+    local_persist std::vector<omni_shadow_constants_t> omni_shadows;
+    omni_shadows.resize(omni_shadow_maps.size());
+    for(size_t omni_shadow_index = 0; omni_shadow_index < omni_shadow_maps.size(); ++omni_shadow_index)
+    {
+        omni_shadow_map_t& shadow_map = omni_shadow_maps[omni_shadow_index];
+        omni_shadow_constants_t& constants = omni_shadows[omni_shadow_index];
+        for(size_t face = 0; face < 6 && face < shadow_map.shadowTransforms.size(); ++face)
+        {
+            constants.light_matrices[face] = shadow_map.shadowTransforms[face];
+        }
+        constants.light_position = shadow_map.owning_light->position;
+        constants.far_plane = shadow_map.get_far_plane();
+    }
+    frame_constants_update_omni_shadows(omni_shadows.data(), (u32) omni_shadows.size());
+}
+
 void render_manager::render_pass_directional_shadow_map()
 {
     shader_t::gl_use_shader(shader_directional_shadow_map);
 
-    shader_directional_shadow_map.gl_bind_matrix4fv("directionalLightTransform", 1, directional_shadow_map.directionalLightSpaceMatrix.ptr());
     glViewport(0, 0, directional_shadow_map.SHADOW_WIDTH, directional_shadow_map.SHADOW_HEIGHT);
     glBindFramebuffer(GL_FRAMEBUFFER, directional_shadow_map.directionalShadowMapFBO);
     glClear(GL_DEPTH_BUFFER_BIT);
 
     //glCullFace(GL_FRONT);
 
-    render_scene(shader_directional_shadow_map);
+    mesh_view_t view;
+    view.pixels_per_unit = directional_shadow_map.pixels_per_unit;
+    view.b_orthographic = true;
+    view.matrix_view_projection = directional_shadow_map.directionalLightSpaceMatrix;
+    view.b_frustum_cull = true;
+    view.max_error_pixels = lod_shadow_max_error_pixels;
+    view.b_depth_only = true;
+    render_scene(shader_directional_shadow_map, view);
 
     //glCullFace(GL_BACK);
 
@@ -95,12 +173,16 @@ void render_manager::render_pass_omnidirectional_shadow_map()
         glBindFramebuffer(GL_FRAMEBUFFER, omni_shadow_maps[omniLightCount].depthCubeMapFBO);
         glClear(GL_DEPTH_BUFFER_BIT);
 
-        shader_omni_shadow_map.gl_bind_matrix4fv("lightMatrices[0]", 6, (float*) omni_shadow_maps[omniLightCount].shadowTransforms.data());
+        frame_constants_bind_omni_shadow(omniLightCount);
         vec3 lightPos = omni_shadow_maps[omniLightCount].owning_light->position;
-        shader_omni_shadow_map.gl_bind_3f("lightPos", lightPos.x, lightPos.y, lightPos.z);
-        shader_omni_shadow_map.gl_bind_1f("farPlane", omni_shadow_maps[omniLightCount].get_far_plane());
 
-        render_scene(shader_omni_shadow_map);
+        mesh_view_t view;
+        view.eye_position = lightPos;
+        view.pixels_per_unit = omni_shadow_maps[omniLightCount].pixels_per_unit;
+        view.max_error_pixels = lod_shadow_max_error_pixels;
+        view.max_distance = omni_shadow_maps[omniLightCount].get_far_plane();
+        view.b_depth_only = true;
+        render_scene(shader_omni_shadow_map, view);
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
@@ -108,7 +190,6 @@ void render_manager::render_pass_omnidirectional_shadow_map()
 
 void render_manager::render_pass_main()
 {
-    camera_t& camera = gs->m_camera;
     temp_map_t& loaded_map = gs->loaded_map;
 
     glViewport(0, 0, back_buffer_width, back_buffer_height);
@@ -126,8 +207,6 @@ void render_manager::render_pass_main()
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
-    camera.calculate_view_matrix();
-
     // 1. Geometry pass
     deferred_geometry_pass();
     // 2. Compute shader pass - Light culling, shading, composition
@@ -137,11 +216,11 @@ void render_manager::render_pass_main()
 
     copy_depth_from_gbuffer_to_defaultbuffer();
 
-    m_skybox_renderer.render(camera);
+    m_skybox_renderer.render();
 
 // ALPHA BLENDED
     glEnable(GL_BLEND);
-    debug_render(shader_simple, camera);
+    debug_render(shader_simple);
 
 // NOT DEPTH TESTED
     glDisable(GL_DEPTH_TEST);
@@ -191,20 +270,28 @@ void render_manager::deferred_geometry_pass()
 
     glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_FBO);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLuint no_feedback[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 3, no_feedback);    // integer attachment, glClear's float color doesn't apply
 
     shader_t::gl_use_shader(shader_deferred_geometry_pass);
 
-    shader_deferred_geometry_pass.gl_bind_matrix4fv("matrix_view", 1, camera.matrix_view.ptr());
-    shader_deferred_geometry_pass.gl_bind_matrix4fv("matrix_proj_perspective", 1, camera.matrix_perspective.ptr());
-    shader_deferred_geometry_pass.gl_bind_1i("texture_sampler_0", 1);
-
-    render_scene(shader_deferred_geometry_pass);
+    shader_deferred_geometry_pass.gl_bind_1i(UNIFORM("texture_sampler_0"), 1);
+    shader_deferred_geometry_pass.gl_bind_1i(UNIFORM("texture_array_sampler"), 2);
+
+    mesh_view_t view;
+    view.eye_position = camera.position;
+    view.pixels_per_unit = camera.matrix_perspective[1][1] * 0.5f * (float) back_buffer_height;
+    view.max_error_pixels = lod_max_error_pixels;
+    view.matrix_view_projection = camera.matrix_perspective * camera.matrix_view;
+    view.b_frustum_cull = true;
+    view.b_impostors = true;
+    render_scene(shader_deferred_geometry_pass, view);
+    texture_streaming_capture(g_buffer_FBO, 3, back_buffer_width, back_buffer_height);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void render_manager::deferred_lighting_and_composition_pass()
 {
-    camera_t& camera = gs->m_camera;
     temp_map_t& loaded_map = gs->loaded_map;
 
     shader_t::gl_use_shader(shader_tiled_deferred_lighting);
@@ -212,53 +299,37 @@ void render_manager::deferred_lighting_and_composition_pass()
 
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, g_position_texture);
-    shader_tiled_deferred_lighting.gl_bind_1i("gPosition", 1);
+    shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("gPosition"), 1);
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, g_normal_texture);
-    shader_tiled_deferred_lighting.gl_bind_1i("gNormal", 2);
+    shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("gNormal"), 2);
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, g_albedo_texture);
-    shader_tiled_deferred_lighting.gl_bind_1i("gAlbedo", 3);
+    shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("gAlbedo"), 3);
 
     {
         glActiveTexture(GL_TEXTURE4);
         glBindTexture(GL_TEXTURE_2D, directional_shadow_map.directionalShadowMapTexture);
-        shader_tiled_deferred_lighting.gl_bind_1i("directional_shadow_map", 4);
-        shader_tiled_deferred_lighting.gl_bind_matrix4fv("directional_light_transform", 1,
-                                                         directional_shadow_map.directionalLightSpaceMatrix.ptr());
+        shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("directional_shadow_map"), 4);
     }
     {
-        i32 omni_shadow_count = (i32) omni_shadow_maps.size();
-        shader_tiled_deferred_lighting.gl_bind_1i("omni_shadow_count", omni_shadow_count);
+        i32 omni_shadow_count = min((i32) omni_shadow_maps.size(), MAX_OMNI_SHADOWS);
+        shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("omni_shadow_count"), omni_shadow_count);
         for(i32 omni_shadow_index = 0; omni_shadow_index < omni_shadow_count; ++omni_shadow_index)
         {
             glActiveTexture(GL_TEXTURE5 + omni_shadow_index);
             glBindTexture(GL_TEXTURE_CUBE_MAP, omni_shadow_maps[omni_shadow_index].depthCubeMapTexture);
 
-            char name_buffer[128] = {'\0'};
-            stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].light_index", omni_shadow_index);
+            const omni_shadow_uniforms_t& uniforms = omni_shadow_uniforms[omni_shadow_index];
             i32 plight_address_offset = (i32)(omni_shadow_maps[omni_shadow_index].owning_light - loaded_map.pointlights.data());
-            shader_tiled_deferred_lighting.gl_bind_1i(name_buffer, plight_address_offset);
-            stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].shadow_cube", omni_shadow_index);
-            shader_tiled_deferred_lighting.gl_bind_1i(name_buffer, 5 + omni_shadow_index);
-            stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].far_plane", omni_shadow_index);
-            shader_tiled_deferred_lighting.gl_bind_1f(name_buffer, omni_shadow_maps[omni_shadow_index].get_far_plane());
+            glUniform1i(uniforms.light_index_location, plight_address_offset);
+            glUniform1i(uniforms.shadow_cube_location, 5 + omni_shadow_index);
+            glUniform1f(uniforms.far_plane_location, omni_shadow_maps[omni_shadow_index].get_far_plane());
         }
     }
 
-    shader_tiled_deferred_lighting.gl_bind_3f("camera_pos", camera.position.x, camera.position.y, camera.position.z);
-    {
-        directional_light_t light = loaded_map.directionallight;
-        shader_tiled_deferred_lighting.gl_bind_3f("directional_light.colour", light.colour.x, light.colour.y,
-                                                  light.colour.z);
-        shader_tiled_deferred_lighting.gl_bind_1f("directional_light.ambient_intensity", light.ambient_intensity);
-        shader_tiled_deferred_lighting.gl_bind_1f("directional_light.diffuse_intensity", light.diffuse_intensity);
-        vec3 direction = orientation_to_direction(light.orientation);
-        shader_tiled_deferred_lighting.gl_bind_3f("directional_light.direction", direction.x, direction.y, direction.z);
-    }
-
     std::vector<point_light_t> plights = loaded_map.pointlights;
-    shader_tiled_deferred_lighting.gl_bind_1i("point_light_count", plights.size());
+    shader_tiled_deferred_lighting.gl_bind_1i(UNIFORM("point_light_count"), plights.size());
 
     local_persist u32 lightsBuffer = 0;
     if (lightsBuffer == 0) {
@@ -271,9 +342,7 @@ void render_manager::deferred_lighting_and_composition_pass()
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
     }
 
-    shader_tiled_deferred_lighting.gl_bind_matrix4fv("projection_matrix", 1, camera.matrix_perspective.ptr());
-    shader_tiled_deferred_lighting.gl_bind_matrix4fv("view_matrix", 1, camera.matrix_view.ptr());
-    //shader_tiled_deferred_lighting.gl_bind_2f("camera_near_far", camera.nearclip, camera.farclip);
+    //shader_tiled_deferred_lighting.gl_bind_2f(UNIFORM("camera_near_far"), gs->m_camera.nearclip, gs->m_camera.farclip);
 
     const u32 COMPUTE_SHADER_TILE_GROUP_DIM = 16;
     u32 dispatch_width = (back_buffer_width + COMPUTE_SHADER_TILE_GROUP_DIM - 1) / COMPUTE_SHADER_TILE_GROUP_DIM;
@@ -321,25 +390,37 @@ void render_manager::copy_depth_from_gbuffer_to_defaultbuffer() const
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void render_manager::render_scene(shader_t& shader)
+void render_manager::render_scene(shader_t& shader, mesh_view_t view)
 {
     temp_map_t& loaded_map = gs->loaded_map;
 
     /** We could simply update the game object's position, rotation, scale fields,
         then construct the model matrix in game_render based on those fields.
     */
-    if(shader.get_cached_uniform_location("material.specular_intensity") >= 0)
+    if(shader.get_cached_uniform_location(UNIFORM("material.specular_intensity")) >= 0)
     {
-        shader.gl_bind_1f("material.specular_intensity", material_dull.specular_intensity);
-        shader.gl_bind_1f("material.shininess", material_dull.shininess);
+        shader.gl_bind_1f(UNIFORM("material.specular_intensity"), material_dull.specular_intensity);
+        shader.gl_bind_1f(UNIFORM("material.shininess"), material_dull.shininess);
     }
     mat4 matrix_model;
     matrix_model = identity_mat4();
     matrix_model *= translation_matrix(loaded_map.mainobject.pos);
     matrix_model *= rotation_matrix(loaded_map.mainobject.orient);
     matrix_model *= scale_matrix(loaded_map.mainobject.scale);
-    shader.gl_bind_matrix4fv("matrix_model", 1, matrix_model.ptr());
-    loaded_map.mainobject.model.render();
+    shader.gl_bind_matrix4fv(UNIFORM("matrix_model"), 1, matrix_model.ptr());
+    view.matrix_model = matrix_model;
+    mesh_group_t& model = loaded_map.mainobject.model;
+    if(view.b_impostors && impostor_distance > 0.f && impostor_is_beyond(model.impostor, matrix_model, view.eye_position, impostor_distance))
+    {
+        impostor_render(model.impostor, matrix_model, material_dull.specular_intensity, material_dull.shininess);
+        shader_t::gl_use_shader(shader);
+    }
+    else
+    {
+        model.render(shader, &view);
+    }
+
+    skinned_mesh_render(shader, view);
 }
 
 void render_manager::load_shaders()
@@ -347,6 +428,18 @@ void render_manager::load_shaders()
     shader_t::gl_load_shader_program_from_file(shader_deferred_geometry_pass, deferred_geometry_vs_path, deferred_geometry_fs_path);
     shader_t::gl_load_compute_shader_program_from_file(shader_tiled_deferred_lighting, deferred_tiled_cs_path);
     shader_t::gl_load_shader_program_from_file(shader_deferred_render_to_quad_pass, deferred_final_vs_path, deferred_final_fs_path);
+    for(i32 omni_shadow_index = 0; omni_shadow_index < MAX_OMNI_SHADOWS; ++omni_shadow_index)
+    {
+        // Elements of an array of structs each have their own location, so they're looked up by name once here
+        omni_shadow_uniforms_t& uniforms = omni_shadow_uniforms[omni_shadow_index];
+        char name_buffer[128] = {'\0'};
+        stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].light_index", omni_shadow_index);
+        uniforms.light_index_location = shader_tiled_deferred_lighting.get_cached_uniform_location(name_buffer);
+        stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].shadow_cube", omni_shadow_index);
+        uniforms.shadow_cube_location = shader_tiled_deferred_lighting.get_cached_uniform_location(name_buffer);
+        stbsp_snprintf(name_buffer, sizeof(name_buffer), "omni_shadows[%d].far_plane", omni_shadow_index);
+        uniforms.far_plane_location = shader_tiled_deferred_lighting.get_cached_uniform_location(name_buffer);
+    }
 
     shader_t::gl_load_shader_program_from_file(shader_directional_shadow_map, "shaders/shadow_mapping/directional_shadow_map.vert", "shaders/shadow_mapping/directional_shadow_map.frag");
     shader_t::gl_load_shader_program_from_file(shader_omni_shadow_map, "shaders/shadow_mapping/omni_shadow_map.vert", "shaders/shadow_mapping/omni_shadow_map.geom", "shaders/shadow_mapping/omni_shadow_map.frag");
@@ -355,6 +448,9 @@ void render_manager::load_shaders()
     shader_t::gl_load_shader_program_from_file(shader_text, text_vs_path, text_fs_path);
     shader_t::gl_load_shader_program_from_file(shader_ui, ui_vs_path, ui_fs_path);
     shader_t::gl_load_shader_program_from_file(shader_simple, simple_vs_path, simple_fs_path);
+
+    skinned_mesh_initialize();
+    impostor_initialize();
 }
 
 void render_manager::clean_up()
@@ -370,6 +466,15 @@ void render_manager::clean_up()
     shader_t::gl_delete_shader(shader_text);
     shader_t::gl_delete_shader(shader_ui);
     shader_t::gl_delete_shader(shader_simple);
+
+    gpu_upload_clean_up();
+    frame_constants_clean_up();
+    skinned_mesh_clean_up();
+    impostor_clean_up();
+    mesh_arena_clean_up();
+    texture_streaming_clean_up();
+    texture_residency_clean_up();
+    texture_upload_clean_up();
 }
 
 vec2i render_manager::get_buffer_size()
@@ -412,6 +517,7 @@ void render_manager::temp_create_shadow_maps()
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     mat4 lightProjection = projection_matrix_orthographic(-50.0f, 50.0f, -50.0f, 50.0f, 0.1f, 150.f);
+    directional_shadow_map.pixels_per_unit = lightProjection[1][1] * 0.5f * (float) directional_shadow_map.SHADOW_HEIGHT;
     directional_shadow_map.directionalLightSpaceMatrix = lightProjection
             //* view_matrix_look_at(-orientation_to_direction(loaded_maps[0].directionallight.orientation) + make_vec3(-47.f, 66.f, 0.f), make_vec3(-47.f, 66.f, 0.f), make_vec3(0.f,1.f,0.f)); // TODO make up 0,0,1 if light is straight up or down
             //* view_matrix_look_at(make_vec3(-2.0f, 4.0f, -1.0f), make_vec3(0.f, 0.f, 0.f), make_vec3(0.f,1.f,0.f)); // TODO make up 0,0,1 if light is straight up or down
@@ -456,6 +562,7 @@ void render_manager::temp_create_shadow_maps()
         float aspect = (float)shadow_map.CUBE_SHADOW_WIDTH/(float)shadow_map.CUBE_SHADOW_HEIGHT;
         float nearPlane = 1.0f;
         mat4 shadowProj = projection_matrix_perspective(90.f * KC_DEG2RAD, aspect, nearPlane, shadow_map.get_far_plane());
+        shadow_map.pixels_per_unit = shadowProj[1][1] * 0.5f * (float) shadow_map.CUBE_SHADOW_HEIGHT;
 
         vec3 lightPos = loaded_map.pointlights[omniLightCount].position;
         shadow_map.shadowTransforms.push_back(
@@ -502,8 +609,15 @@ void render_manager::temp_create_geometry_buffer()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g_albedo_texture, 0);
 
-    u32 color_attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, color_attachments);
+    glGenTextures(1, &g_feedback_texture);
+    glBindTexture(GL_TEXTURE_2D, g_feedback_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16UI, back_buffer_width, back_buffer_height, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, g_feedback_texture, 0);
+
+    u32 color_attachments[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(4, color_attachments);
 
     glGenRenderbuffers(1, &g_depth_RBO);
     glBindRenderbuffer(GL_RENDERBUFFER, g_depth_RBO);
@@ -519,4 +633,6 @@ void render_manager::temp_create_geometry_buffer()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    texture_streaming_initialize(back_buffer_width, back_buffer_height);
 }
@@ -6,6 +6,7 @@
 #include "light.h"
 #include "../debugging/console.h"
 #include "skybox_renderer.h"
+#include "mesh_group.h"
 
 struct game_state;
 
@@ -16,6 +17,7 @@ struct directional_shadow_map_t
     u32 directionalShadowMapTexture = 0;
     u32 directionalShadowMapFBO = 0;
     mat4 directionalLightSpaceMatrix;
+    float pixels_per_unit = 0.f; // shadow map texels per world unit, for LOD selection
 };
 
 struct omni_shadow_map_t
@@ -24,6 +26,7 @@ struct omni_shadow_map_t
     const i32 CUBE_SHADOW_HEIGHT = 1024;
     u32 depthCubeMapTexture = 0;
     u32 depthCubeMapFBO = 0;
+    float pixels_per_unit = 0.f; // cube face texels per world unit at distance 1, for LOD selection
 
     float get_far_plane() const
     {
@@ -42,6 +45,16 @@ struct omni_shadow_map_t
     std::vector<mat4> shadowTransforms;
 };
 
+#define MAX_OMNI_SHADOWS 16 // same as tiled_deferred_lighting.comp
+
+/** Locations of one element of omni_shadows in the tiled lighting shader, -1 if it's inactive */
+struct omni_shadow_uniforms_t
+{
+    i32 light_index_location = -1;
+    i32 shadow_cube_location = -1;
+    i32 far_plane_location = -1;
+};
+
 struct display_settings_t
 {
     //todo
@@ -49,7 +62,8 @@ struct display_settings_t
 
 struct render_manager
 {
-    void initialize();
+    /** Returns false if OpenGL can't be used, e.g. the driver doesn't support 4.5 */
+    bool initialize();
 
     void render();
 
@@ -73,8 +87,20 @@ struct render_manager
 
     mat4 matrix_projection_ortho;
 
+    // How many pixels of error a LOD may have on screen (or texels in a shadow map) before a
+    // more detailed LOD is drawn. Shadow maps are lower resolution and blurred, so they take more.
+    float lod_max_error_pixels = 1.f;
+    float lod_shadow_max_error_pixels = 4.f;
+
+    // Mesh groups entirely further than this from the camera are drawn as their impostor in the
+    // G-buffer pass. 0 turns impostors off.
+    float impostor_distance = 150.f;
+
 private:
 
+    // Fills the uniform blocks of frame_constants.h, before the first pass
+    void update_frame_constants();
+
     void render_pass_directional_shadow_map();
 
     void render_pass_omnidirectional_shadow_map();
@@ -83,7 +109,7 @@ private:
 
     void deferred_render_to_quad_pass();
 
-    void render_scene(shader_t& shader);
+    void render_scene(shader_t& shader, mesh_view_t view);
 
     void copy_depth_from_gbuffer_to_defaultbuffer() const;
 
@@ -110,9 +136,11 @@ private:
     u32 g_position_texture = 0;
     u32 g_normal_texture = 0;
     u32 g_albedo_texture = 0;
+    u32 g_feedback_texture = 0;     // texture streaming feedback, see texture_streaming.h
     u32 g_depth_RBO = 0;
 
     u32 tiled_deferred_shading_texture = 0;
+    omni_shadow_uniforms_t omni_shadow_uniforms[MAX_OMNI_SHADOWS];
 
     SINGLETON(render_manager)
 
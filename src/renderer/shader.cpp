@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "shader.h"
+#include "frame_constants.h"
 #include "../debugging/console.h"
 #include "../core/file_system.h"
 
@@ -43,6 +45,7 @@ void shader_t::gl_create_shader_program(shader_t& shader, const char* vertex_sha
     }
 #endif
 
+    frame_constants_bind_blocks(shader.id_shader_program);
     shader_t::cache_uniform_locations(shader);
 }
 
@@ -67,6 +70,7 @@ void shader_t::gl_create_shader_program(shader_t& shader, const char* vertex_sha
     }
 #endif
 
+    frame_constants_bind_blocks(shader.id_shader_program);
     shader_t::cache_uniform_locations(shader);
 }
 
@@ -89,6 +93,7 @@ void shader_t::gl_create_compute_shader_program(shader_t& shader, const char* co
     }
 #endif
 
+    frame_constants_bind_blocks(shader.id_shader_program);
     shader_t::cache_uniform_locations(shader);
 }
 
@@ -159,9 +164,25 @@ void shader_t::cache_uniform_locations(shader_t &shader)
     */
     for (GLint i = 0; i < number_of_uniforms; ++i)
     {
+        GLint block_index = -1;
+        glGetActiveUniformsiv(shader.id_shader_program, 1, (GLuint*) &i, GL_UNIFORM_BLOCK_INDEX, &block_index);
+        if(block_index != -1)
+        {
+            continue; // member of a uniform block (frame_constants.h), it has no location
+        }
         glGetActiveUniform(shader.id_shader_program, i, longest_uniform_name_length, &readlength, &size, &type, uniform_name);
         cache_uniform_location(shader, uniform_name);
     }
+
+    std::sort(shader.uniform_locations.begin(), shader.uniform_locations.end(),
+              [](const uniform_location_t& a, const uniform_location_t& b) { return a.hash < b.hash; });
+    for(size_t i = 1; i < shader.uniform_locations.size(); ++i)
+    {
+        if(shader.uniform_locations[i].hash == shader.uniform_locations[i - 1].hash)
+        {
+            console_printf("Warning! Two uniforms of shader id %d have the same name hash, rename one...\n", shader.id_shader_program);
+        }
+    }
 }
 
 void shader_t::cache_uniform_location(shader_t& shader, const char *uniform_name)
@@ -169,7 +190,8 @@ void shader_t::cache_uniform_location(shader_t& shader, const char *uniform_name
     i32 location = glGetUniformLocation(shader.id_shader_program, uniform_name);
     if (location != 0xffffffff)
     {
-        shader.uniform_locations[std::string(uniform_name)] = location;
+        uniform_location_t uniform = { uniform_name_hash(uniform_name), location };
+        shader.uniform_locations.push_back(uniform);
     }
     else
     {
@@ -197,147 +219,154 @@ void shader_t::gl_compile_shader(u32 program_id, const char* shader_code, GLenum
     glAttachShader(program_id, id_shader);
 }
 
-void shader_t::gl_bind_1i(const char* uniform_name, GLint v0)
+void shader_t::gl_bind_1i(uniform_id_t uniform, GLint v0)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform1i(location, v0);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_2i(const char* uniform_name, GLint v0, GLint v1)
+void shader_t::gl_bind_2i(uniform_id_t uniform, GLint v0, GLint v1)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform2i(location, v0, v1);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_3i(const char* uniform_name, GLint v0, GLint v1, GLint v2)
+void shader_t::gl_bind_3i(uniform_id_t uniform, GLint v0, GLint v1, GLint v2)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform3i(location, v0, v1, v2);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_4i(const char* uniform_name, GLint v0, GLint v1, GLint v2, GLint v3)
+void shader_t::gl_bind_4i(uniform_id_t uniform, GLint v0, GLint v1, GLint v2, GLint v3)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform4i(location, v0, v1, v2, v3);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_1f(const char* uniform_name, GLfloat v0)
+void shader_t::gl_bind_1f(uniform_id_t uniform, GLfloat v0)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform1f(location, v0);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_2f(const char* uniform_name, GLfloat v0, GLfloat v1)
+void shader_t::gl_bind_2f(uniform_id_t uniform, GLfloat v0, GLfloat v1)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform2f(location, v0, v1);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_3f(const char* uniform_name, GLfloat v0, GLfloat v1, GLfloat v2)
+void shader_t::gl_bind_3f(uniform_id_t uniform, GLfloat v0, GLfloat v1, GLfloat v2)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform3f(location, v0, v1, v2);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_4f(const char* uniform_name, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+void shader_t::gl_bind_4f(uniform_id_t uniform, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniform4f(location, v0, v1, v2, v3);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_matrix3fv(const char* uniform_name, const GLsizei count, const GLfloat* value)
+void shader_t::gl_bind_matrix3fv(uniform_id_t uniform, const GLsizei count, const GLfloat* value)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniformMatrix3fv(location, count, GL_FALSE, value);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-void shader_t::gl_bind_matrix4fv(const char* uniform_name, const GLsizei count, const GLfloat* value)
+void shader_t::gl_bind_matrix4fv(uniform_id_t uniform, const GLsizei count, const GLfloat* value)
 {
-    i32 location = get_cached_uniform_location(uniform_name);
+    i32 location = get_cached_uniform_location(uniform);
     if(location >= 0)
     {
         glUniformMatrix4fv(location, count, GL_FALSE, value);
     }
     else
     {
-        warning_uniform_not_found(uniform_name);
+        warning_uniform_not_found(uniform);
     }
 }
 
-i32 shader_t::get_cached_uniform_location(const char* uniform_name)
+i32 shader_t::get_cached_uniform_location(uniform_id_t uniform) const
 {
-    auto location_iter = uniform_locations.find(uniform_name);
-    if(location_iter != uniform_locations.end())
+    auto location_iter = std::lower_bound(uniform_locations.begin(), uniform_locations.end(), uniform.hash,
+                                          [](const uniform_location_t& cached, u32 hash) { return cached.hash < hash; });
+    if(location_iter != uniform_locations.end() && location_iter->hash == uniform.hash)
     {
-        return location_iter->second;
+        return location_iter->location;
     }
     return -1;
 }
 
-void shader_t::warning_uniform_not_found(const char* uniform_name) const
+i32 shader_t::get_cached_uniform_location(const char* uniform_name) const
+{
+    uniform_id_t uniform = { uniform_name_hash(uniform_name), uniform_name };
+    return get_cached_uniform_location(uniform);
+}
+
+void shader_t::warning_uniform_not_found(uniform_id_t uniform) const
 {
-    console_printf("Warning: Uniform '%s' doesn't exist or isn't active on shader %d.\n", uniform_name, id_shader_program);
+    console_printf("Warning: Uniform '%s' doesn't exist or isn't active on shader %d.\n", uniform.name, id_shader_program);
 }
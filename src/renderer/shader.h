@@ -1,9 +1,32 @@
 #pragma once
 
 #include "../gamedefine.h"
-#include <unordered_map>
+#include <vector>
+#include <type_traits>
 #include <GL/glew.h>
 
+/** FNV-1a of a uniform name. Use it through UNIFORM so it's computed at compile time. */
+constexpr u32 uniform_name_hash(const char* uniform_name)
+{
+    u32 hash = 2166136261u;
+    for(; *uniform_name; ++uniform_name)
+    {
+        hash = (hash ^ (u8) *uniform_name) * 16777619u;
+    }
+    return hash;
+}
+
+/** A uniform name keyed by its hash. The name is only kept for warnings. */
+struct uniform_id_t
+{
+    u32         hash;
+    const char* name;
+};
+
+/** UNIFORM("matrix_model") - the hash is a compile time constant, so binding by it doesn't hash or
+    allocate, it's a binary search over the few active uniforms of the shader. */
+#define UNIFORM(uniform_name) (uniform_id_t{ std::integral_constant<u32, uniform_name_hash(uniform_name)>::value, uniform_name })
+
 /** Handle for Shader Program stored in GPU memory */
 struct shader_t
 {
@@ -23,28 +46,38 @@ struct shader_t
 
     static void gl_create_compute_shader_program(shader_t& shader, const char* compute_shader_str);
 
-    void gl_bind_1i(const char* uniform_name, GLint v0);
-    void gl_bind_2i(const char* uniform_name, GLint v0, GLint v1);
-    void gl_bind_3i(const char* uniform_name, GLint v0, GLint v1, GLint v2);
-    void gl_bind_4i(const char* uniform_name, GLint v0, GLint v1, GLint v2, GLint v3);
-    void gl_bind_1f(const char* uniform_name, GLfloat v0);
-    void gl_bind_2f(const char* uniform_name, GLfloat v0, GLfloat v1);
-    void gl_bind_3f(const char* uniform_name, GLfloat v0, GLfloat v1, GLfloat v2);
-    void gl_bind_4f(const char* uniform_name, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
-    void gl_bind_matrix3fv(const char* uniform_name, GLsizei count, const GLfloat* value);
-    void gl_bind_matrix4fv(const char* uniform_name, GLsizei count, const GLfloat* value);
-
-    i32 get_cached_uniform_location(const char* uniform_name);
+    void gl_bind_1i(uniform_id_t uniform, GLint v0);
+    void gl_bind_2i(uniform_id_t uniform, GLint v0, GLint v1);
+    void gl_bind_3i(uniform_id_t uniform, GLint v0, GLint v1, GLint v2);
+    void gl_bind_4i(uniform_id_t uniform, GLint v0, GLint v1, GLint v2, GLint v3);
+    void gl_bind_1f(uniform_id_t uniform, GLfloat v0);
+    void gl_bind_2f(uniform_id_t uniform, GLfloat v0, GLfloat v1);
+    void gl_bind_3f(uniform_id_t uniform, GLfloat v0, GLfloat v1, GLfloat v2);
+    void gl_bind_4f(uniform_id_t uniform, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+    void gl_bind_matrix3fv(uniform_id_t uniform, GLsizei count, const GLfloat* value);
+    void gl_bind_matrix4fv(uniform_id_t uniform, GLsizei count, const GLfloat* value);
+
+    /** -1 if the uniform isn't active */
+    i32 get_cached_uniform_location(uniform_id_t uniform) const;
+
+    /** For names only known at runtime, e.g. elements of an array of structs. Hashes the name, so
+        resolve these once after loading and keep the location, not in the render loop. */
+    i32 get_cached_uniform_location(const char* uniform_name) const;
 private:
     GLuint id_shader_program = 0; // id of this shader program in GPU memory
 
-    std::unordered_map<std::string, i32> uniform_locations;
+    struct uniform_location_t
+    {
+        u32 hash;
+        i32 location;
+    };
+    std::vector<uniform_location_t> uniform_locations; // sorted by hash
 
     static void cache_uniform_locations(shader_t& shader);
 
     static void cache_uniform_location(shader_t& shader, const char* uniform_name);
 
-    void warning_uniform_not_found(const char* uniform_name) const;
+    void warning_uniform_not_found(uniform_id_t uniform) const;
 
     // Create shader on GPU and compile shader
     static void gl_compile_shader(u32 program_id, const char* shader_code, GLenum shader_type);
@@ -0,0 +1,777 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <cstring>
+#include <cmath>
+
+#include "skinned_mesh.h"
+#include "animation.h"
+#include "animation_compressed.h"
+#include "mesh_group.h"
+#include "shader.h"
+#include "texture.h"
+#include "texture_streaming.h"
+#include "../core/timer.h"
+#include "../core/worker_pool.h"
+#include "../debugging/console.h"
+#include <GL/glew.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+internal const u32 SKINNED_IMPORT_FLAGS = aiProcess_Triangulate
+                                          | aiProcess_GenNormals
+                                          | aiProcess_JoinIdenticalVertices
+                                          | aiProcess_LimitBoneWeights; // SKINNED_MESH_BONES_PER_VERTEX by default
+
+#define SKINNED_GPU_TIMER_QUERIES 4
+#define SKINNED_POSE_BATCH 16      // instances posed per worker pool job, so thousands don't mean thousands of jobs
+
+/** Bind pose vertex the way skinned_mesh_skin.comp reads it (std430, 32 bytes) */
+struct skinned_source_vertex_t
+{
+    float   position[3];
+    float   normal[3];
+    u32     bones;      // bone index per weight, 8 bits each
+    u32     weights;    // unorm8 weights that add up to 255
+};
+
+struct skinned_submesh_t
+{
+    u32 first_index = 0;
+    u32 indices_count = 0;
+    u32 material_index = 0;
+};
+
+struct skinned_model_t
+{
+    std::string                     file_name;
+    skeleton_t                      skeleton;
+    std::vector<u32>                bone_joints;        // joint that moves each bone
+    std::vector<mat4>               bone_offsets;       // mesh space to the space of the bone joint in bind pose
+    mat4                            root_inverse;       // undoes the transform of the scene root
+    std::vector<animation_compressed_clip_t> clips;    // at least one, the rest pose if the model has no animations
+    std::vector<skinned_submesh_t>  submeshes;
+    std::vector<texture_t>          textures;           // per material
+    u32                             vertices_count = 0;
+    vec3                            bounds_min;         // rest pose
+    vec3                            bounds_max;
+
+    u32                             id_source_buffer = 0;   // skinned_source_vertex_t
+    u32                             id_texcoord_vbo = 0;    // uvs don't change, so every instance shares them
+    u32                             id_ibo = 0;
+    u32                             id_bone_buffer = 0;     // bone matrices of every instance
+    u32                             id_position_vbo = 0;    // skinned vertices of every instance back to back
+    u32                             id_normal_vbo = 0;
+    u32                             id_vao = 0;
+    u32                             id_depth_vao = 0;
+    u32                             instances_capacity = 0;
+    std::vector<u32>                instances;              // in the order they are in the skinned buffers
+    std::vector<mat4>               bone_matrices;          // instances * bones, uploaded every frame
+};
+
+struct skinned_instance_t
+{
+    i32     model = -1;
+    u32     slot = 0;       // in model.instances
+    mat4    transform;
+    u32     clip = 0;
+    float   time = 0.f;
+};
+
+struct skinned_stats_t
+{
+    u32     frames = 0;
+    double  pose_seconds = 0.0;
+    u64     gpu_nanoseconds = 0;
+    u32     gpu_frames = 0;
+    u64     vertices_skinned = 0;
+    u64     vertices_drawn = 0;     // by every pass together
+};
+
+internal std::vector<skinned_model_t>       models;
+internal std::vector<skinned_instance_t>    instances;
+internal shader_t                           skin_shader;
+internal u32                                gpu_timer_queries[SKINNED_GPU_TIMER_QUERIES] = {};
+internal bool                               b_gpu_timer_pending[SKINNED_GPU_TIMER_QUERIES] = {};
+internal u32                                gpu_timer_frame = 0;
+internal skinned_stats_t                    stats;
+internal i32                                benchmark_frames_left = 0;
+
+internal mat4 skinned_convert_matrix(const aiMatrix4x4& m)
+{
+    mat4 result;
+    for(int col = 0; col < 4; ++col)
+    {
+        for(int row = 0; row < 4; ++row)
+        {
+            result[col][row] = m[row][col];
+        }
+    }
+    return result;
+}
+
+internal joint_pose_t skinned_decompose(const aiMatrix4x4& m)
+{
+    aiVector3D scaling;
+    aiQuaternion rotation;
+    aiVector3D position;
+    m.Decompose(scaling, rotation, position);
+    joint_pose_t pose;
+    pose.translation = make_vec3(position.x, position.y, position.z);
+    pose.rotation = make_quaternion(rotation.w, rotation.x, rotation.y, rotation.z);
+    pose.scale = make_vec3(scaling.x, scaling.y, scaling.z);
+    return pose;
+}
+
+/** Every node becomes a joint, parents first. mesh_joints gets the joint of the first node
+    that draws each mesh. */
+internal void skinned_collect_joints(const aiNode* node, i32 parent, skeleton_t& skeleton, std::vector<i32>& mesh_joints)
+{
+    i32 joint = (i32) skeleton.parents.size();
+    skeleton.joint_names.push_back(std::string(node->mName.C_Str()));
+    skeleton.parents.push_back(parent);
+    skeleton.rest_pose.push_back(skinned_decompose(node->mTransformation));
+    for(u32 i = 0; i < node->mNumMeshes; ++i)
+    {
+        if(node->mMeshes[i] < mesh_joints.size() && mesh_joints[node->mMeshes[i]] < 0)
+        {
+            mesh_joints[node->mMeshes[i]] = joint;
+        }
+    }
+    for(u32 i = 0; i < node->mNumChildren; ++i)
+    {
+        skinned_collect_joints(node->mChildren[i], joint, skeleton, mesh_joints);
+    }
+}
+
+/** Bone of joint, added with offset if the model doesn't have one for it yet */
+internal u32 skinned_find_bone(skinned_model_t& model, u32 joint, const mat4& offset)
+{
+    for(u32 i = 0; i < model.bone_joints.size(); ++i)
+    {
+        if(model.bone_joints[i] == joint)
+        {
+            return i;
+        }
+    }
+    model.bone_joints.push_back(joint);
+    model.bone_offsets.push_back(offset);
+    return (u32) model.bone_joints.size() - 1;
+}
+
+/** Keeps the SKINNED_MESH_BONES_PER_VERTEX heaviest weights and packs them into unorm8 */
+internal void skinned_pack_weights(skinned_source_vertex_t& vertex, const u32* bones, const float* weights, u32 count)
+{
+    float total = 0.f;
+    for(u32 i = 0; i < count; ++i)
+    {
+        total += weights[i];
+    }
+    vertex.bones = 0;
+    vertex.weights = 0;
+    u32 packed_total = 0;
+    u32 heaviest = 0;
+    for(u32 i = 0; i < count; ++i)
+    {
+        u32 weight = (u32) floorf(weights[i] / total * 255.f + 0.5f);
+        weight = min(weight, 255u - packed_total);
+        packed_total += weight;
+        vertex.bones |= (bones[i] & 0xff) << (8 * i);
+        vertex.weights |= weight << (8 * i);
+        heaviest = weights[i] > weights[heaviest] ? i : heaviest;
+    }
+    // Rounding leftovers go to the heaviest bone so the weights always add up to one
+    vertex.weights += (255u - packed_total) << (8 * heaviest);
+}
+
+internal std::string skinned_resolve_texture_path(const std::string& path, const char* file_name)
+{
+    int idx = (int)path.find_last_of("\\");
+    std::string texture_file_name = path.substr(idx+1);
+    std::string model_file_directory = std::string(file_name);
+    idx = max((int)model_file_directory.find_last_of("/"), (int)model_file_directory.find_last_of("\\"));
+    model_file_directory = model_file_directory.substr(0, idx + 1);
+    return model_file_directory + texture_file_name;
+}
+
+/** Imports and compresses every clip. Clips are only kept compressed. */
+internal void skinned_import_clips(skinned_model_t& model, const aiScene* scene)
+{
+    animation_compression_settings_t settings;
+    animation_compression_stats_t total;
+    std::map<std::string, u32> joints_by_name;
+    for(u32 i = 0; i < model.skeleton.joint_names.size(); ++i)
+    {
+        joints_by_name.emplace(model.skeleton.joint_names[i], i);
+    }
+    for(u32 a = 0; a < scene->mNumAnimations; ++a)
+    {
+        const aiAnimation* animation = scene->mAnimations[a];
+        float ticks_per_second = animation->mTicksPerSecond > 0.0 ? (float) animation->mTicksPerSecond : 25.f;
+        animation_clip_t clip;
+        clip.name = std::string(animation->mName.C_Str());
+        clip.duration = (float) animation->mDuration / ticks_per_second;
+        for(u32 c = 0; c < animation->mNumChannels; ++c)
+        {
+            const aiNodeAnim* channel = animation->mChannels[c];
+            auto joint = joints_by_name.find(std::string(channel->mNodeName.C_Str()));
+            if(joint == joints_by_name.end())
+            {
+                continue;
+            }
+            animation_track_t track;
+            track.joint = joint->second;
+            for(u32 k = 0; k < channel->mNumPositionKeys; ++k)
+            {
+                const aiVectorKey& key = channel->mPositionKeys[k];
+                track.translation_times.push_back((float) key.mTime / ticks_per_second);
+                track.translations.push_back(make_vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for(u32 k = 0; k < channel->mNumRotationKeys; ++k)
+            {
+                const aiQuatKey& key = channel->mRotationKeys[k];
+                track.rotation_times.push_back((float) key.mTime / ticks_per_second);
+                track.rotations.push_back(make_quaternion(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for(u32 k = 0; k < channel->mNumScalingKeys; ++k)
+            {
+                const aiVectorKey& key = channel->mScalingKeys[k];
+                track.scale_times.push_back((float) key.mTime / ticks_per_second);
+                track.scales.push_back(make_vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            clip.tracks.push_back(std::move(track));
+        }
+        animation_compressed_clip_t compressed;
+        animation_compression_stats_t clip_stats;
+        animation_compress(model.skeleton, clip, settings, compressed, &clip_stats);
+        model.clips.push_back(std::move(compressed));
+        total.source_bytes += clip_stats.source_bytes;
+        total.compressed_bytes += clip_stats.compressed_bytes;
+        total.constant_channels += clip_stats.constant_channels;
+        total.animated_channels += clip_stats.animated_channels;
+        total.frames += clip_stats.frames;
+        total.keys += clip_stats.keys;
+    }
+    if(model.clips.empty())
+    {
+        // A clip without tracks compresses to the rest pose, so every instance can be sampled the same way
+        animation_clip_t rest;
+        rest.name = "rest";
+        model.clips.emplace_back();
+        animation_compress(model.skeleton, rest, settings, model.clips.back());
+        return;
+    }
+    console_printf("compressed %u clips from %u KB to %u KB (%u constant and %u animated channels, %u of %u frames kept as keys)\n",
+                   (u32) model.clips.size(), total.source_bytes / 1024, total.compressed_bytes / 1024,
+                   total.constant_channels, total.animated_channels, total.keys, total.frames);
+}
+
+/** Skin matrices of every bone from the model space matrices of the joints, with the rest of
+    the scene transform taken out */
+internal void skinned_bone_matrices(const skinned_model_t& model, const mat4* joint_matrices, mat4* out_bone_matrices)
+{
+    for(size_t bone = 0; bone < model.bone_joints.size(); ++bone)
+    {
+        out_bone_matrices[bone] = model.root_inverse * joint_matrices[model.bone_joints[bone]] * model.bone_offsets[bone];
+    }
+}
+
+/** Skinned buffers have room for every instance of the model. They get skinned again before
+    they are drawn, so nothing is copied over when they grow. */
+internal void skinned_reserve_instances(skinned_model_t& model, u32 instances_count)
+{
+    if(instances_count <= model.instances_capacity)
+    {
+        return;
+    }
+    model.instances_capacity = max(instances_count, model.instances_capacity * 2);
+    GLsizeiptr skinned_size = (GLsizeiptr) model.instances_capacity * model.vertices_count * 3 * sizeof(float);
+    glDeleteBuffers(1, &model.id_position_vbo);
+    glDeleteBuffers(1, &model.id_normal_vbo);
+    glGenBuffers(1, &model.id_position_vbo);
+    glGenBuffers(1, &model.id_normal_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, model.id_position_vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, skinned_size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, model.id_normal_vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, skinned_size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+internal void skinned_create_vertex_arrays(skinned_model_t& model)
+{
+    // Same attribute locations as every other mesh: 0 position, 1 uv, 2 normal. The skinned
+    // buffers get bound per instance at draw time.
+    glGenVertexArrays(1, &model.id_vao);
+    glBindVertexArray(model.id_vao);
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(0, 0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribFormat(1, 2, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(1, 1);
+        glEnableVertexAttribArray(1);
+        glBindVertexBuffer(1, model.id_texcoord_vbo, 0, 2 * sizeof(float));
+        glVertexAttribFormat(2, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(2, 2);
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.id_ibo);
+    glBindVertexArray(0);
+
+    glGenVertexArrays(1, &model.id_depth_vao);
+    glBindVertexArray(model.id_depth_vao);
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(0, 0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.id_ibo);
+    glBindVertexArray(0);
+}
+
+void skinned_mesh_initialize()
+{
+    shader_t::gl_load_compute_shader_program_from_file(skin_shader, "shaders/skinning/skinned_mesh_skin.comp");
+    glGenQueries(SKINNED_GPU_TIMER_QUERIES, gpu_timer_queries);
+}
+
+i32 skinned_mesh_load(const char* file_name)
+{
+    i64 start_ticks = timer::get_ticks();
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(file_name, SKINNED_IMPORT_FLAGS);
+    if(!scene || !scene->mRootNode)
+    {
+        console_printf("Skinned model '%s' failed to load: %s\n", file_name, importer.GetErrorString());
+        return -1;
+    }
+
+    skinned_model_t model;
+    model.file_name = file_name;
+    std::vector<i32> mesh_joints(scene->mNumMeshes, -1);
+    skinned_collect_joints(scene->mRootNode, -1, model.skeleton, mesh_joints);
+    model.root_inverse = skinned_convert_matrix(aiMatrix4x4(scene->mRootNode->mTransformation).Inverse());
+    std::map<std::string, u32> joints_by_name;
+    for(u32 i = 0; i < model.skeleton.joint_names.size(); ++i)
+    {
+        joints_by_name.emplace(model.skeleton.joint_names[i], i);
+    }
+
+    bool b_has_bones = false;
+    std::vector<skinned_source_vertex_t> source_vertices;
+    std::vector<float> texcoords;
+    std::vector<u32> indices;
+    for(u32 m = 0; m < scene->mNumMeshes; ++m)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        if(mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
+        {
+            continue;
+        }
+        b_has_bones |= mesh->mNumBones > 0;
+
+        // Bone weights per vertex, at most SKINNED_MESH_BONES_PER_VERTEX after aiProcess_LimitBoneWeights
+        std::vector<u32> vertex_bones(mesh->mNumVertices * SKINNED_MESH_BONES_PER_VERTEX);
+        std::vector<float> vertex_weights(mesh->mNumVertices * SKINNED_MESH_BONES_PER_VERTEX);
+        std::vector<u32> vertex_weight_counts(mesh->mNumVertices, 0);
+        for(u32 b = 0; b < mesh->mNumBones; ++b)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            auto joint = joints_by_name.find(std::string(bone->mName.C_Str()));
+            if(joint == joints_by_name.end())
+            {
+                continue;
+            }
+            u32 bone_index = skinned_find_bone(model, joint->second, skinned_convert_matrix(bone->mOffsetMatrix));
+            for(u32 w = 0; w < bone->mNumWeights; ++w)
+            {
+                const aiVertexWeight& weight = bone->mWeights[w];
+                if(weight.mVertexId >= mesh->mNumVertices || weight.mWeight <= 0.f)
+                {
+                    continue;
+                }
+                u32& count = vertex_weight_counts[weight.mVertexId];
+                if(count < SKINNED_MESH_BONES_PER_VERTEX)
+                {
+                    vertex_bones[weight.mVertexId * SKINNED_MESH_BONES_PER_VERTEX + count] = bone_index;
+                    vertex_weights[weight.mVertexId * SKINNED_MESH_BONES_PER_VERTEX + count] = weight.mWeight;
+                    ++count;
+                }
+            }
+        }
+
+        // Vertices no bone moves follow the node that draws the mesh, like a rigid attachment
+        u32 node_bone = 0;
+        bool b_node_bone = false;
+        u32 first_vertex = (u32) source_vertices.size();
+        for(u32 v = 0; v < mesh->mNumVertices; ++v)
+        {
+            skinned_source_vertex_t vertex;
+            vertex.position[0] = mesh->mVertices[v].x;
+            vertex.position[1] = mesh->mVertices[v].y;
+            vertex.position[2] = mesh->mVertices[v].z;
+            vertex.normal[0] = mesh->mNormals ? mesh->mNormals[v].x : 0.f;
+            vertex.normal[1] = mesh->mNormals ? mesh->mNormals[v].y : 0.f;
+            vertex.normal[2] = mesh->mNormals ? mesh->mNormals[v].z : 1.f;
+            if(vertex_weight_counts[v] == 0)
+            {
+                if(!b_node_bone)
+                {
+                    node_bone = skinned_find_bone(model, (u32) max(mesh_joints[m], 0), identity_mat4());
+                    b_node_bone = true;
+                }
+                float one = 1.f;
+                skinned_pack_weights(vertex, &node_bone, &one, 1);
+            }
+            else
+            {
+                skinned_pack_weights(vertex, &vertex_bones[v * SKINNED_MESH_BONES_PER_VERTEX],
+                                     &vertex_weights[v * SKINNED_MESH_BONES_PER_VERTEX], vertex_weight_counts[v]);
+            }
+            source_vertices.push_back(vertex);
+            texcoords.push_back(mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][v].x : 0.f);
+            texcoords.push_back(mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][v].y : 0.f);
+        }
+
+        skinned_submesh_t submesh;
+        submesh.first_index = (u32) indices.size();
+        submesh.material_index = mesh->mMaterialIndex;
+        for(u32 f = 0; f < mesh->mNumFaces; ++f)
+        {
+            for(u32 k = 0; k < 3; ++k)
+            {
+                indices.push_back(first_vertex + mesh->mFaces[f].mIndices[k]);
+            }
+        }
+        submesh.indices_count = (u32) indices.size() - submesh.first_index;
+        model.submeshes.push_back(submesh);
+    }
+
+    if(!b_has_bones || source_vertices.empty())
+    {
+        console_printf("'%s' has no skinned meshes, load it with model_streamer_load instead\n", file_name);
+        return -1;
+    }
+    if(model.bone_joints.size() > SKINNED_MESH_MAX_BONES)
+    {
+        console_printf("'%s' has %u bones, more than the %d supported\n", file_name, (u32) model.bone_joints.size(), SKINNED_MESH_MAX_BONES);
+        return -1;
+    }
+    model.vertices_count = (u32) source_vertices.size();
+    skinned_import_clips(model, scene);
+
+    // Rest pose bounds, to space out benchmark instances
+    std::vector<mat4> joint_matrices(model.skeleton.parents.size());
+    std::vector<mat4> bone_matrices(model.bone_joints.size());
+    animation_model_matrices(model.skeleton, model.skeleton.rest_pose.data(), joint_matrices.data());
+    skinned_bone_matrices(model, joint_matrices.data(), bone_matrices.data());
+    model.bounds_min = make_vec3(1e30f, 1e30f, 1e30f);
+    model.bounds_max = make_vec3(-1e30f, -1e30f, -1e30f);
+    for(const skinned_source_vertex_t& vertex : source_vertices)
+    {
+        const mat4& skin = bone_matrices[vertex.bones & 0xff];
+        for(int row = 0; row < 3; ++row)
+        {
+            float x = skin[0][row] * vertex.position[0] + skin[1][row] * vertex.position[1] + skin[2][row] * vertex.position[2] + skin[3][row];
+            model.bounds_min[row] = min(model.bounds_min[row], x);
+            model.bounds_max[row] = max(model.bounds_max[row], x);
+        }
+    }
+
+    std::vector<std::string> texture_paths(scene->mNumMaterials);
+    for(u32 i = 0; i < scene->mNumMaterials; ++i)
+    {
+        aiString path;
+        if(scene->mMaterials[i]->GetTextureCount(aiTextureType_DIFFUSE)
+           && scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+        {
+            texture_paths[i] = skinned_resolve_texture_path(std::string(path.data), file_name);
+        }
+    }
+    texture_t::gl_create_from_file_list(model.textures, texture_paths);
+
+    glGenBuffers(1, &model.id_source_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, model.id_source_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, source_vertices.size() * sizeof(skinned_source_vertex_t), source_vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenBuffers(1, &model.id_bone_buffer);
+    glGenBuffers(1, &model.id_texcoord_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, model.id_texcoord_vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, texcoords.size() * sizeof(float), texcoords.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glGenBuffers(1, &model.id_ibo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, model.id_ibo);
+        glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(u32), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    skinned_create_vertex_arrays(model);
+
+    console_printf("took %f seconds to load skinned model '%s' (%u vertices, %u bones, %u joints, %u clips)\n",
+                   (float) (timer::get_ticks() - start_ticks) / (float) timer::counter_frequency(), file_name,
+                   model.vertices_count, (u32) model.bone_joints.size(), (u32) model.skeleton.parents.size(), (u32) model.clips.size());
+    models.push_back(std::move(model));
+    return (i32) models.size() - 1;
+}
+
+u32 skinned_mesh_add_instance(i32 model, const mat4& transform, u32 clip, float time)
+{
+    ASSERT(model >= 0 && model < (i32) models.size())
+    skinned_instance_t instance;
+    instance.model = model;
+    instance.slot = (u32) models[model].instances.size();
+    instance.transform = transform;
+    instance.clip = clip % (u32) models[model].clips.size();
+    instance.time = time;
+    instances.push_back(instance);
+    models[model].instances.push_back((u32) instances.size() - 1);
+    skinned_reserve_instances(models[model], (u32) models[model].instances.size());
+    return (u32) instances.size() - 1;
+}
+
+internal void skinned_read_gpu_timer(u32 query_index)
+{
+    if(!b_gpu_timer_pending[query_index])
+    {
+        return;
+    }
+    GLint b_available = 0;
+    glGetQueryObjectiv(gpu_timer_queries[query_index], GL_QUERY_RESULT_AVAILABLE, &b_available);
+    if(b_available)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(gpu_timer_queries[query_index], GL_QUERY_RESULT, &nanoseconds);
+        stats.gpu_nanoseconds += nanoseconds;
+        ++stats.gpu_frames;
+        b_gpu_timer_pending[query_index] = false;
+    }
+}
+
+internal void skinned_print_benchmark()
+{
+    u32 frames = max(stats.frames, 1u);
+    console_printf("skinned %u instances, %llu vertices per frame over %u frames:\n",
+                   (u32) instances.size(), stats.vertices_skinned / frames, stats.frames);
+    console_printf("    poses %.3f ms CPU on %d threads, skinning %.3f ms GPU per frame\n",
+                   stats.pose_seconds * 1000.0 / frames, worker_pool_thread_count() + 1,
+                   stats.gpu_frames > 0 ? (double) stats.gpu_nanoseconds / 1e6 / stats.gpu_frames : 0.0);
+    console_printf("    passes drew %llu skinned vertices per frame, %.1f per vertex skinned (%llu vertices not skinned again)\n",
+                   stats.vertices_drawn / frames,
+                   stats.vertices_skinned > 0 ? (double) stats.vertices_drawn / (double) stats.vertices_skinned : 0.0,
+                   (stats.vertices_drawn - min(stats.vertices_drawn, stats.vertices_skinned)) / frames);
+}
+
+void skinned_mesh_update(float delta_time)
+{
+    if(instances.empty())
+    {
+        return;
+    }
+
+    // Poses on the worker pool
+    i64 pose_ticks = timer::get_ticks();
+    for(skinned_model_t& model : models)
+    {
+        model.bone_matrices.resize(model.instances.size() * model.bone_joints.size());
+    }
+    u32 batches_count = ((u32) instances.size() + SKINNED_POSE_BATCH - 1) / SKINNED_POSE_BATCH;
+    worker_pool_parallel_for(batches_count, [delta_time](u32 batch)
+    {
+        local_persist thread_local std::vector<animation_soa_joints_t> pose;
+        local_persist thread_local std::vector<mat4> joint_matrices;
+        u32 end = min((batch + 1) * SKINNED_POSE_BATCH, (u32) instances.size());
+        for(u32 i = batch * SKINNED_POSE_BATCH; i < end; ++i)
+        {
+            skinned_instance_t& instance = instances[i];
+            skinned_model_t& model = models[instance.model];
+            instance.time += delta_time;
+            pose.resize(animation_soa_count((u32) model.skeleton.parents.size()));
+            joint_matrices.resize(model.skeleton.parents.size());
+            animation_sample_compressed(model.clips[instance.clip], instance.time, pose.data());
+            animation_model_matrices(model.skeleton, pose.data(), joint_matrices.data());
+            skinned_bone_matrices(model, joint_matrices.data(),
+                                  &model.bone_matrices[(size_t) instance.slot * model.bone_joints.size()]);
+        }
+    });
+    stats.pose_seconds += (double) (timer::get_ticks() - pose_ticks) / (double) timer::counter_frequency();
+
+    // Skinning on the GPU, timed a few frames behind so reading the timer never stalls
+    u32 query_index = gpu_timer_frame++ % SKINNED_GPU_TIMER_QUERIES;
+    skinned_read_gpu_timer(query_index);
+    bool b_time_this_frame = !b_gpu_timer_pending[query_index];
+    if(b_time_this_frame)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, gpu_timer_queries[query_index]);
+    }
+    shader_t::gl_use_shader(skin_shader);
+    i32 vertices_count_location = skin_shader.get_cached_uniform_location(UNIFORM("vertices_count"));
+    i32 bones_count_location = skin_shader.get_cached_uniform_location(UNIFORM("bones_count"));
+    for(skinned_model_t& model : models)
+    {
+        if(model.instances.empty())
+        {
+            continue;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, model.id_bone_buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, model.bone_matrices.size() * sizeof(mat4), model.bone_matrices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, model.id_source_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, model.id_bone_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, model.id_position_vbo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, model.id_normal_vbo);
+        glUniform1ui(vertices_count_location, model.vertices_count);
+        glUniform1ui(bones_count_location, (u32) model.bone_joints.size());
+        glDispatchCompute((model.vertices_count + SKINNED_MESH_WORKGROUP_SIZE - 1) / SKINNED_MESH_WORKGROUP_SIZE,
+                          (u32) model.instances.size(), 1);
+        stats.vertices_skinned += (u64) model.vertices_count * model.instances.size();
+    }
+    for(u32 binding = 0; binding < 4; ++binding)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+    glUseProgram(0);
+    if(b_time_this_frame)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        b_gpu_timer_pending[query_index] = true;
+    }
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    ++stats.frames;
+    if(benchmark_frames_left > 0 && --benchmark_frames_left == 0)
+    {
+        skinned_print_benchmark();
+    }
+}
+
+void skinned_mesh_render(shader_t& shader, const mesh_view_t& view)
+{
+    if(instances.empty())
+    {
+        return;
+    }
+
+    // Skinned vertices are float model space positions and normals
+    i32 model_location = shader.get_cached_uniform_location(UNIFORM("matrix_model"));
+    i32 position_scale_location = shader.get_cached_uniform_location(UNIFORM("mesh_position_scale"));
+    i32 position_offset_location = shader.get_cached_uniform_location(UNIFORM("mesh_position_offset"));
+    i32 octahedral_normal_location = shader.get_cached_uniform_location(UNIFORM("b_mesh_octahedral_normal"));
+    i32 uv_rect_location = shader.get_cached_uniform_location(UNIFORM("mesh_uv_rect"));
+    i32 texture_array_location = shader.get_cached_uniform_location(UNIFORM("b_texture_array"));
+    texture_feedback_uniforms_t feedback_uniforms = texture_streaming_feedback_uniforms(shader);
+    if(position_scale_location >= 0)
+    {
+        glUniform3f(position_scale_location, 1.f, 1.f, 1.f);
+        glUniform3f(position_offset_location, 0.f, 0.f, 0.f);
+    }
+    if(octahedral_normal_location >= 0)
+    {
+        glUniform1i(octahedral_normal_location, 0);
+    }
+    if(uv_rect_location >= 0)
+    {
+        glUniform4f(uv_rect_location, 0.f, 0.f, 0.f, 0.f);
+    }
+    if(texture_array_location >= 0)
+    {
+        glUniform1i(texture_array_location, 0); // skinned models bind 2D textures
+    }
+
+    for(skinned_model_t& model : models)
+    {
+        if(model.instances.empty())
+        {
+            continue;
+        }
+        glBindVertexArray(view.b_depth_only ? model.id_depth_vao : model.id_vao);
+        GLsizei stride = 3 * sizeof(float);
+        for(u32 slot = 0; slot < model.instances.size(); ++slot)
+        {
+            const skinned_instance_t& instance = instances[model.instances[slot]];
+            glUniformMatrix4fv(model_location, 1, GL_FALSE, instance.transform.ptr());
+            GLintptr offset = (GLintptr) slot * model.vertices_count * stride;
+            glBindVertexBuffer(0, model.id_position_vbo, offset, stride);
+            if(!view.b_depth_only)
+            {
+                glBindVertexBuffer(2, model.id_normal_vbo, offset, stride);
+            }
+            for(const skinned_submesh_t& submesh : model.submeshes)
+            {
+                if(!view.b_depth_only && submesh.material_index < model.textures.size()
+                   && model.textures[submesh.material_index].texture_id != 0)
+                {
+                    model.textures[submesh.material_index].gl_use_texture();
+                    texture_streaming_set_feedback(feedback_uniforms, &model.textures[submesh.material_index]);
+                }
+                glDrawElements(GL_TRIANGLES, submesh.indices_count, GL_UNSIGNED_INT, (void*) ((size_t) submesh.first_index * sizeof(u32)));
+            }
+        }
+        stats.vertices_drawn += (u64) model.vertices_count * model.instances.size();
+    }
+    glBindVertexArray(0);
+}
+
+void skinned_mesh_clean_up()
+{
+    for(skinned_model_t& model : models)
+    {
+        glDeleteVertexArrays(1, &model.id_vao);
+        glDeleteVertexArrays(1, &model.id_depth_vao);
+        glDeleteBuffers(1, &model.id_source_buffer);
+        glDeleteBuffers(1, &model.id_texcoord_vbo);
+        glDeleteBuffers(1, &model.id_ibo);
+        glDeleteBuffers(1, &model.id_bone_buffer);
+        glDeleteBuffers(1, &model.id_position_vbo);
+        glDeleteBuffers(1, &model.id_normal_vbo);
+        for(texture_t& texture : model.textures)
+        {
+            if(texture.texture_id != 0)
+            {
+                texture_t::gl_delete(texture);
+            }
+        }
+    }
+    models.clear();
+    instances.clear();
+    if(gpu_timer_queries[0] != 0)
+    {
+        glDeleteQueries(SKINNED_GPU_TIMER_QUERIES, gpu_timer_queries);
+        memset(gpu_timer_queries, 0, sizeof(gpu_timer_queries));
+    }
+    shader_t::gl_delete_shader(skin_shader);
+}
+
+void skinned_mesh_load_command(std::string file_name)
+{
+    i32 model = skinned_mesh_load(file_name.c_str());
+    if(model >= 0)
+    {
+        skinned_mesh_add_instance(model, identity_mat4());
+    }
+}
+
+void skinned_mesh_benchmark(int count)
+{
+    if(models.empty())
+    {
+        console_printf("Load a rigged model with skinned_load first\n");
+        return;
+    }
+    if(count <= 0)
+    {
+        console_printf("skinned_benchmark <instances to add>\n");
+        return;
+    }
+
+    i32 model = (i32) models.size() - 1;
+    vec3 size = models[model].bounds_max - models[model].bounds_min;
+    float spacing = max(max(size.x, size.z), 0.001f) * 1.25f;
+    u32 columns = (u32) ceilf(sqrtf((float) count));
+    u32 first = (u32) models[model].instances.size();
+    for(u32 i = 0; i < (u32) count; ++i)
+    {
+        u32 n = first + i;
+        mat4 transform = translation_matrix((float) (n % columns) * spacing, 0.f, (float) (n / columns) * spacing);
+        // Different clips and phases, so no two instances share a pose
+        skinned_mesh_add_instance(model, transform, n, (float) n * 0.37f);
+    }
+    stats = skinned_stats_t();
+    benchmark_frames_left = SKINNED_MESH_BENCHMARK_FRAMES;
+    console_printf("Measuring skinning of %u instances of '%s' over %d frames...\n",
+                   (u32) models[model].instances.size(), models[model].file_name.c_str(), SKINNED_MESH_BENCHMARK_FRAMES);
+}
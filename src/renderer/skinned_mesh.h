@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include "../gamedefine.h"
+#include "../core/kc_math.h"
+
+struct shader_t;
+struct mesh_view_t;
+
+/**
+    SKINNED MESH - rigged models animated on the GPU with a pre-skinned vertex cache
+
+    Rigged models (Assimp meshes with mBones) are loaded with their skeleton, bones, and
+    animation clips (see animation.h), which are compressed on load and sampled from the
+    compressed form (see animation_compressed.h). Every instance of a model plays a clip.
+
+    Instead of skinning in the vertex shader of every pass that draws an instance (the G-buffer
+    pass, the directional shadow pass, and every omni shadow pass), skinned_mesh_update skins
+    every instance once per frame with a compute shader:
+        1.  The pose of every instance is sampled and turned into bone matrices on the worker
+            pool in batches of instances, and uploaded for the whole model in one buffer.
+        2.  One dispatch per model (x over vertices, y over instances) reads the bind pose
+            vertices with up to SKINNED_MESH_BONES_PER_VERTEX weighted bones each and writes
+            skinned positions and normals into a position and a normal buffer that hold every
+            instance back to back.
+        3.  Each pass draws the instances from those buffers through a VAO per model (position,
+            the unchanging uvs, and normal at locations 0 1 2 like every other mesh) or a
+            position only VAO for depth only passes. Each instance binds its own range of the
+            skinned buffers (uvs are shared, so base vertex can't be used), so the regular
+            geometry and shadow shaders draw skinned meshes as they are.
+    Models are loaded synchronously on the main thread and textures are shared with the rest
+    of the renderer (texture_t::gl_create_from_file). Instances aren't culled.
+
+    skinned_benchmark spawns a grid of instances and prints the CPU pose time, the GPU skinning
+    time, and how many vertices the cache kept the passes from skinning again.
+*/
+
+#define SKINNED_MESH_BONES_PER_VERTEX 4
+#define SKINNED_MESH_MAX_BONES 256
+#define SKINNED_MESH_WORKGROUP_SIZE 64      // local_size_x of skinned_mesh_skin.comp
+#define SKINNED_MESH_BENCHMARK_FRAMES 240   // frames skinned_benchmark measures before it reports
+
+/** Loads the compute shader. Needs a GL 4.3 context. */
+void skinned_mesh_initialize();
+
+/** Imports the rigged model at file_name. Returns the model id, or -1 if it has no bones or
+    failed to load. */
+i32 skinned_mesh_load(const char* file_name);
+
+/** Adds an instance of model playing clip (wrapped around the clips of the model) from time
+    seconds in. Returns the instance id. */
+u32 skinned_mesh_add_instance(i32 model, const mat4& transform, u32 clip = 0, float time = 0.f);
+
+/** Once per frame before anything is drawn. Advances every instance by delta_time seconds
+    and skins them into the vertex cache. */
+void skinned_mesh_update(float delta_time);
+
+/** Draws every instance with shader, which must already be in use and take matrix_model.
+    Depth only views draw positions only. */
+void skinned_mesh_render(shader_t& shader, const mesh_view_t& view);
+
+/** Deletes every instance and model. */
+void skinned_mesh_clean_up();
+
+/** Console commands. Loads a rigged model and puts an instance of it at the origin, and
+    spawns count more instances of the last loaded model in a grid to measure skinning. */
+void skinned_mesh_load_command(std::string file_name);
+void skinned_mesh_benchmark(int count);
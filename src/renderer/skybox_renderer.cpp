@@ -41,14 +41,10 @@ void skybox_renderer::init()
     load_shader();
 }
 
-void skybox_renderer::render(const camera_t& camera)
+void skybox_renderer::render()
 {
     shader_t::gl_use_shader(skybox_shader);
 
-    mat4 skybox_view_matrix = make_mat4(make_mat3(camera.matrix_view));
-    skybox_shader.gl_bind_matrix4fv("matrix_view", 1, skybox_view_matrix.ptr());
-    skybox_shader.gl_bind_matrix4fv("matrix_proj_perspective", 1, camera.matrix_perspective.ptr());
-
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_cubemap.texture_id);
 
@@ -3,13 +3,13 @@
 #include "texture.h"
 #include "mesh.h"
 #include "shader.h"
-#include "camera.h"
 
 struct skybox_renderer
 {
     void init();
 
-    void render(const camera_t& camera);
+    /** Drawn with the view in frame_constants.h, without its translation */
+    void render();
 
     cubemap_t   skybox_cubemap;
 
@@ -1,10 +1,172 @@
-#include <unordered_map>
 #include "texture.h"
+#include "texture_upload.h"
+#include "texture_residency.h"
+#include "texture_streaming.h"
+#include "gpu_upload.h"
 #include "../runtime/memory_handle.h"
+#include "../core/hash.h"
 #include "../core/file_system.h"
+#include "../core/worker_pool.h"
 #include "../debugging/console.h"
+#include "../stb/stb_image.h"
 
-internal std::unordered_map<std::string, texture_t> gpu_loaded_textures;
+internal texture_compression_t texture_compression = TEXTURE_COMPRESSION_BC1_BC3;
+
+internal u32 texture_source_channels(GLenum source_format)
+{
+    switch(source_format)
+    {
+        case GL_RED: return 1;
+        case GL_RG: return 2;
+        case GL_RGB: return 3;
+        default: return 4;
+    }
+}
+
+/** Content hash for texture_residency_find_content: the hash of the texel data mixed with the
+    size and format, so identical bytes describing different images don't match. */
+internal u64 texture_content_key(u64 data_hash, u32 width, u32 height, GLenum format)
+{
+    u32 description[3] = { width, height, (u32) format };
+    return hash_fnv1a64(description, sizeof(description), data_hash);
+}
+
+internal u32 texture_full_mips_count(u32 width, u32 height)
+{
+    u32 mips_count = 1;
+    while((width >> mips_count) > 0 || (height >> mips_count) > 0)
+    {
+        ++mips_count;
+    }
+    return mips_count;
+}
+
+/** Sized internal format for the unsized ones gl_create_from_bitmap is called with, which
+    glTexStorage doesn't take */
+internal GLenum texture_sized_format(GLenum format)
+{
+    switch(format)
+    {
+        case GL_RED: return GL_R8;
+        case GL_RG: return GL_RG8;
+        case GL_RGB: return GL_RGB8;
+        case GL_RGBA: return GL_RGBA8;
+        default: return format;
+    }
+}
+
+/** read_image with the vertical flip set for the calling thread. stb_image keeps the flip per
+    thread once it's set, and workers decode for loaders with either setting. */
+internal void texture_read_image(bitmap_handle_t& image, const char* image_file_path, bool b_flip)
+{
+    stbi_set_flip_vertically_on_load_thread(b_flip ? 1 : 0);
+    read_image(image, image_file_path);
+}
+
+/** Texture object for a bitmap with its mips generated. b_staged uploads through the upload ring,
+    which only the main thread may use; anywhere else the pixels are read from bitmap. */
+internal GLuint texture_create_bitmap_object(const unsigned char* bitmap,
+                                             u32                  bitmap_width,
+                                             u32                  bitmap_height,
+                                             GLenum               target_format,
+                                             GLenum               source_format,
+                                             bool                 b_staged)
+{
+    // Immutable storage for the whole mip chain, edited through the texture name (GL 4.5 DSA)
+    GLuint gl_id;
+    glCreateTextures(GL_TEXTURE_2D, 1, &gl_id);
+    glTextureStorage2D(gl_id, texture_full_mips_count(bitmap_width, bitmap_height),
+                       texture_sized_format(target_format), bitmap_width, bitmap_height);
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_S, GL_REPEAT);       // wrapping
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);   // filtering (e.g. GL_NEAREST)
+    glTextureParameteri(gl_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if(bitmap == nullptr)
+    {
+        return gl_id;
+    }
+    u64 bitmap_size = (u64) bitmap_width * bitmap_height * texture_source_channels(source_format);
+    const void* pixels = b_staged ? texture_upload_stage(bitmap, bitmap_size) : bitmap;    // ring offset or bitmap
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);                              // rows are tightly packed
+    glTextureSubImage2D(
+            gl_id,
+            0,                                                              // level-of-detail number n = n-th mipmap reduction image
+            0, 0,                                                           // offset
+            bitmap_width,                                                   // texture width
+            bitmap_height,                                                  // texture height
+            source_format,                                                  // format of data being loaded (source)
+            GL_UNSIGNED_BYTE,                                               // data type of the texture data
+            pixels);                                                        // data
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if(b_staged)
+    {
+        texture_upload_submit();
+    }
+    glGenerateTextureMipmap(gl_id);                                     // generate mip maps automatically
+    return gl_id;
+}
+
+/** Texture object for cooked from top_mip down, staged like texture_create_bitmap_object */
+internal GLuint texture_create_cooked_object(const texture_cooked_t& cooked, u32 top_mip, bool b_staged)
+{
+    GLenum block_format = texture_block_gl_format(cooked.format);
+    GLuint gl_id;
+    glCreateTextures(GL_TEXTURE_2D, 1, &gl_id);
+    glTextureStorage2D(gl_id, cooked.mips_count - top_mip, block_format, cooked.mips[top_mip].width, cooked.mips[top_mip].height);
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);  // the mips are cooked, so use them
+    glTextureParameteri(gl_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if(cooked.format == TEXTURE_BLOCK_BC5)
+    {
+        // Grey + alpha in red + green, sampled as grey RGB + alpha like the image it came from
+        const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTextureParameteriv(gl_id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    const texture_cache_mip_t& last_mip = cooked.mips[cooked.mips_count - 1];
+    u64 first_offset = cooked.mips[top_mip].offset;
+    const u8* blocks = cooked.blocks + first_offset;
+    if(b_staged)
+    {
+        blocks = (const u8*) texture_upload_stage(blocks, last_mip.offset + last_mip.size - first_offset);  // every mip at once
+    }
+    for(u32 level = top_mip; level < cooked.mips_count; ++level)
+    {
+        const texture_cache_mip_t& mip = cooked.mips[level];
+        glCompressedTextureSubImage2D(gl_id, level - top_mip, 0, 0, mip.width, mip.height, block_format,
+                                      mip.size, blocks + (mip.offset - first_offset));
+    }
+    if(b_staged)
+    {
+        texture_upload_submit();
+    }
+    return gl_id;
+}
+
+/** Makes texture the texture object gl_id of an image and hands it to the residency manager */
+internal void texture_adopt_image(texture_t& texture, const char* texture_file_path, const bitmap_handle_t& image, u64 content_hash, GLuint gl_id)
+{
+    texture.texture_id = gl_id;
+    texture.width = image.width;
+    texture.height = image.height;
+    texture.format = image.bit_depth == 3 ? GL_RGB : GL_RGBA;
+    texture_residency_add(texture, texture_file_path, content_hash, GL_RGBA8, 0, texture_full_mips_count(image.width, image.height), 0);
+}
+
+/** Same for the texture object gl_id made from cooked, starting at top_mip */
+internal void texture_adopt_cooked(texture_t& texture, const char* texture_file_path, const texture_cooked_t& cooked, u64 content_hash, GLuint gl_id, u32 top_mip)
+{
+    GLenum block_format = texture_block_gl_format(cooked.format);
+    texture.texture_id = gl_id;
+    texture.width = cooked.width;
+    texture.height = cooked.height;
+    texture.format = block_format;
+    texture_residency_add(texture, texture_file_path, content_hash, block_format, texture_block_size(cooked.format), cooked.mips_count, top_mip);
+    if(cooked.b_cached)
+    {
+        texture_residency_set_streamable(texture.residency_id, cooked.compression, cooked.b_flipped);
+    }
+}
 
 void texture_t::gl_create_from_bitmap(texture_t&        texture,
                                       unsigned char*    bitmap,
@@ -23,43 +185,242 @@ void texture_t::gl_create_from_bitmap(texture_t&        texture,
     texture.height = bitmap_height;
     texture.format = source_format;
 
-    glGenTextures(1, &texture.texture_id);                                  // generate texture and grab texture id
-    glBindTexture(GL_TEXTURE_2D, texture.texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);       // wrapping
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);   // filtering (e.g. GL_NEAREST)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(
-            GL_TEXTURE_2D,                                                  // texture target type
-            0,                                                              // level-of-detail number n = n-th mipmap reduction image
-            target_format,                                                  // format of data to store (target): num of color components
-            bitmap_width,                                                   // texture width
-            bitmap_height,                                                  // texture height
-            0,                                                              // must be 0 (legacy)
-            source_format,                                                  // format of data being loaded (source)
-            GL_UNSIGNED_BYTE,                                               // data type of the texture data
-            bitmap);                                                        // data
-    glGenerateMipmap(GL_TEXTURE_2D);                                    // generate mip maps automatically
-    glBindTexture(GL_TEXTURE_2D, 0);
+    texture.texture_id = texture_create_bitmap_object(bitmap, bitmap_width, bitmap_height, target_format, source_format, true);
 }
 
 void texture_t::gl_create_from_file(texture_t&    texture,
                                     const char*   texture_file_path)
 {
-    auto texture_already_loaded = gpu_loaded_textures.find(std::string(texture_file_path));
-    if(texture_already_loaded != gpu_loaded_textures.end())
+    if(texture_residency_find(texture, texture_file_path))
     {
-        texture = texture_already_loaded->second;
         return;
     }
 
+    if(texture_compression != TEXTURE_COMPRESSION_NONE)
+    {
+        texture_cooked_t cooked;
+        if(texture_cache_load(cooked, texture_file_path, true, texture_compression))
+        {
+            gl_create_from_cooked(texture, texture_file_path, cooked);
+            texture_cooked_free(cooked);
+            return;
+        }
+    }
+
     bitmap_handle_t texture_handle;
-    read_image(texture_handle, texture_file_path);
-    gl_create_from_bitmap(texture, (unsigned char*)texture_handle.memory, texture_handle.width,
-                          texture_handle.height, GL_RGBA, (texture_handle.bit_depth == 3 ? GL_RGB : GL_RGBA));
+    texture_read_image(texture_handle, texture_file_path, true);
+    gl_create_from_image(texture, texture_file_path, texture_handle);
     free_image(texture_handle); // texture data has been copied to GPU memory, so we can free image from memory
+}
+
+void texture_t::gl_create_from_file_list(std::vector<texture_t>&          textures,
+                                         const std::vector<std::string>&  texture_file_paths)
+{
+    // Every texture that isn't resident yet is decoded (or cooked) on the worker pool, then
+    // they're uploaded one after another on this thread
+    textures.resize(texture_file_paths.size());
+    std::vector<u8> b_found(texture_file_paths.size(), 0);
+    std::vector<std::string> load_paths;
+    for(size_t i = 0; i < texture_file_paths.size(); ++i)
+    {
+        const std::string& path = texture_file_paths[i];
+        b_found[i] = !path.empty() && texture_residency_find(textures[i], path.c_str());
+        bool b_skip = path.empty() || b_found[i];
+        for(const std::string& load_path : load_paths)
+        {
+            b_skip |= load_path == path;
+        }
+        if(!b_skip)
+        {
+            load_paths.push_back(path);
+        }
+    }
+
+    u32 load_count = (u32) load_paths.size();
+    std::vector<bitmap_handle_t> images(load_count);
+    std::vector<texture_cooked_t> cooked(load_count);
+    std::vector<u8> b_cooked(load_count, 0);
+    texture_compression_t compression = texture_compression;
+    worker_pool_parallel_for(load_count, [&](u32 i)
+    {
+        if(compression != TEXTURE_COMPRESSION_NONE && texture_cache_load(cooked[i], load_paths[i].c_str(), true, compression))
+        {
+            b_cooked[i] = 1;
+            return;
+        }
+        texture_read_image(images[i], load_paths[i].c_str(), true);
+    });
 
-    gpu_loaded_textures[std::string(texture_file_path)] = texture;
+    std::vector<texture_t> loaded(load_count);
+    for(u32 i = 0; i < load_count; ++i)
+    {
+        if(b_cooked[i])
+        {
+            gl_create_from_cooked(loaded[i], load_paths[i].c_str(), cooked[i]);
+            texture_cooked_free(cooked[i]);
+        }
+        else if(images[i].memory)
+        {
+            gl_create_from_image(loaded[i], load_paths[i].c_str(), images[i]);
+            free_image(images[i]);
+        }
+    }
+
+    // Every slot takes its own reference, then the ones taken while loading are given back
+    for(size_t i = 0; i < texture_file_paths.size(); ++i)
+    {
+        if(!texture_file_paths[i].empty() && !b_found[i])
+        {
+            texture_residency_find(textures[i], texture_file_paths[i].c_str());
+        }
+    }
+    for(texture_t& texture : loaded)
+    {
+        if(texture.texture_id != 0)
+        {
+            gl_delete(texture);
+        }
+    }
+}
+
+void texture_t::gl_create_from_image(texture_t&              texture,
+                                     const char*             texture_file_path,
+                                     const bitmap_handle_t&  image)
+{
+    if(texture_residency_find(texture, texture_file_path))
+    {
+        return;
+    }
+
+    GLenum source_format = image.bit_depth == 3 ? GL_RGB : GL_RGBA;
+    u64 content_hash = image.memory ? texture_content_key(hash_fnv1a64(image.memory, image.size), image.width, image.height, source_format) : 0;
+    if(texture_residency_find_content(texture, content_hash, texture_file_path))
+    {
+        return;
+    }
+
+    if(texture.texture_id != 0)
+    {
+        console_printf("WARNING: Trying to load a texture_t when there is already a texture loaded! Clearing texture first...\n");
+        texture_t::gl_delete(texture);
+    }
+    GLuint gl_id = texture_create_bitmap_object((const unsigned char*) image.memory, image.width, image.height, GL_RGBA, source_format, true);
+    texture_adopt_image(texture, texture_file_path, image, content_hash, gl_id);
+}
+
+void texture_t::gl_create_from_cooked(texture_t&              texture,
+                                      const char*             texture_file_path,
+                                      const texture_cooked_t& cooked)
+{
+    if(texture_residency_find(texture, texture_file_path))
+    {
+        return;
+    }
+
+    GLenum block_format = texture_block_gl_format(cooked.format);
+    u64 content_hash = texture_content_key(cooked.content_hash, cooked.width, cooked.height, block_format);
+    if(texture_residency_find_content(texture, content_hash, texture_file_path))
+    {
+        return;
+    }
+
+    if(texture.texture_id != 0)
+    {
+        console_printf("WARNING: Trying to load a texture_t when there is already a texture loaded! Clearing texture first...\n");
+        texture_t::gl_delete(texture);
+    }
+
+    // Streamed textures start from a small mip, the larger ones come in once they're seen
+    u32 top_mip = cooked.b_cached && texture_streaming_is_enabled() ? texture_streaming_start_mip(cooked) : 0;
+    GLuint gl_id = texture_create_cooked_object(cooked, top_mip, true);
+    texture_adopt_cooked(texture, texture_file_path, cooked, content_hash, gl_id, top_mip);
+}
+
+void texture_t::gl_create_from_image_async(const char*            texture_file_path,
+                                           const bitmap_handle_t& image,
+                                           u64                    image_hash,
+                                           const texture_ready_t& on_ready)
+{
+    texture_t texture;
+    GLenum source_format = image.bit_depth == 3 ? GL_RGB : GL_RGBA;
+    u64 content_hash = texture_content_key(image_hash, image.width, image.height, source_format);
+    if(texture_residency_find(texture, texture_file_path) || texture_residency_find_content(texture, content_hash, texture_file_path))
+    {
+        bitmap_handle_t owned_image = image;
+        free_image(owned_image);
+        on_ready(texture);
+        return;
+    }
+
+    bool b_staged = !gpu_upload_is_enabled(); // only if the job runs right here on the main thread
+    std::string path = texture_file_path;
+    gpu_upload_submit([image, source_format, b_staged]()
+    {
+        return (u32) texture_create_bitmap_object((const unsigned char*) image.memory, image.width, image.height, GL_RGBA, source_format, b_staged);
+    },
+    [image, content_hash, path, on_ready](u32 gl_id)
+    {
+        // Another load of the same texture may have finished while this one was uploading
+        texture_t texture;
+        if(texture_residency_find(texture, path.c_str()) || texture_residency_find_content(texture, content_hash, path.c_str()))
+        {
+            glDeleteTextures(1, &gl_id);
+        }
+        else
+        {
+            texture_adopt_image(texture, path.c_str(), image, content_hash, gl_id);
+        }
+        bitmap_handle_t owned_image = image;
+        free_image(owned_image);
+        on_ready(texture);
+    });
+}
+
+void texture_t::gl_create_from_cooked_async(const char*            texture_file_path,
+                                            texture_cooked_t*      cooked,
+                                            const texture_ready_t& on_ready)
+{
+    texture_t texture;
+    u64 content_hash = texture_content_key(cooked->content_hash, cooked->width, cooked->height, texture_block_gl_format(cooked->format));
+    if(texture_residency_find(texture, texture_file_path) || texture_residency_find_content(texture, content_hash, texture_file_path))
+    {
+        texture_cooked_free(*cooked);
+        delete cooked;
+        on_ready(texture);
+        return;
+    }
+
+    u32 top_mip = cooked->b_cached && texture_streaming_is_enabled() ? texture_streaming_start_mip(*cooked) : 0;
+    bool b_staged = !gpu_upload_is_enabled();
+    std::string path = texture_file_path;
+    gpu_upload_submit([cooked, top_mip, b_staged]()
+    {
+        return (u32) texture_create_cooked_object(*cooked, top_mip, b_staged);
+    },
+    [cooked, top_mip, content_hash, path, on_ready](u32 gl_id)
+    {
+        texture_t texture;
+        if(texture_residency_find(texture, path.c_str()) || texture_residency_find_content(texture, content_hash, path.c_str()))
+        {
+            glDeleteTextures(1, &gl_id);
+        }
+        else
+        {
+            texture_adopt_cooked(texture, path.c_str(), *cooked, content_hash, gl_id, top_mip);
+        }
+        texture_cooked_free(*cooked);
+        delete cooked;
+        on_ready(texture);
+    });
+}
+
+void texture_t::gl_share(texture_t& texture, const texture_t& shared)
+{
+    texture = shared;
+    if(shared.residency_id != 0)
+    {
+        texture_residency_acquire(shared.residency_id);
+    }
 }
 
 void texture_t::gl_delete(texture_t& texture)
@@ -69,10 +430,16 @@ void texture_t::gl_delete(texture_t& texture)
         console_printf("WARNING: Attempting to clear a texture with id: 0. This means this texture hasn't been loaded!\n");
         return;
     }
-    glDeleteTextures(1, &texture.texture_id);
-
-    // TODO find texture from loaded textures and delete
+    if(texture.residency_id != 0)
+    {
+        texture_residency_release(texture.residency_id);
+    }
+    else
+    {
+        glDeleteTextures(1, &texture.texture_id);
+    }
 
+    texture.residency_id = 0;
     texture.texture_id = 0;
     texture.width = 0;
     texture.height = 0;
@@ -82,30 +449,72 @@ void texture_t::gl_delete(texture_t& texture)
 void texture_t::gl_use_texture() const
 {
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBindTexture(GL_TEXTURE_2D, residency_id != 0 ? texture_residency_use(residency_id) : texture_id);
 }
 
 
 
+void texture_set_compression(int compression)
+{
+    if(compression < TEXTURE_COMPRESSION_NONE || compression > TEXTURE_COMPRESSION_BC7)
+    {
+        console_printf("Texture compression: 0 off (RGBA8), 1 BC1 opaque / BC3 alpha, 2 BC7\n");
+        return;
+    }
+    texture_compression = (texture_compression_t) compression;
+    console_printf("Textures loaded from now on are %s\n",
+                   compression == TEXTURE_COMPRESSION_NONE ? "uncompressed RGBA8" : compression == TEXTURE_COMPRESSION_BC1_BC3 ? "BC1 / BC3" : "BC7");
+}
+
+texture_compression_t texture_get_compression()
+{
+    return texture_compression;
+}
+
 void cubemap_t::gl_create_from_files(cubemap_t& cubemap, const std::vector<std::string>& faces_paths)
 {
-    glGenTextures(1, &cubemap.texture_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.texture_id);
+    // Faces decode in parallel (cubemap faces are never flipped), then go through the upload ring
+    bitmap_handle_t face_handles[6];
+    worker_pool_parallel_for(6, [&](u32 i)
+    {
+        texture_read_image(face_handles[i], faces_paths[i].c_str(), false);
+    });
 
+    // Every face has the same size, storage is allocated once from whichever face loaded
+    u32 face_width = 0;
+    u32 face_height = 0;
+    for(const bitmap_handle_t& face_handle : face_handles)
+    {
+        if(face_handle.memory && face_width == 0)
+        {
+            face_width = face_handle.width;
+            face_height = face_handle.height;
+        }
+    }
+    glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &cubemap.texture_id);
+    if(face_width > 0)
+    {
+        glTextureStorage2D(cubemap.texture_id, 1, GL_RGB8, face_width, face_height);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for(size_t i = 0; i < 6; ++i)
     {
-        bitmap_handle_t face_handle;
-        read_image(face_handle, faces_paths[i].c_str());
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, face_handle.width, face_handle.height,
-                     0,(face_handle.bit_depth == 3 ? GL_RGB : GL_RGBA), GL_UNSIGNED_BYTE, face_handle.memory);
+        bitmap_handle_t& face_handle = face_handles[i];
+        if(face_handle.memory && face_handle.width == face_width && face_handle.height == face_height)
+        {
+            const void* pixels = texture_upload_stage(face_handle.memory, face_handle.size);
+            glTextureSubImage3D(cubemap.texture_id, 0, 0, 0, (GLint) i, face_width, face_height, 1,
+                                (face_handle.bit_depth == 3 ? GL_RGB : GL_RGBA), GL_UNSIGNED_BYTE, pixels);
+            texture_upload_submit();
+        }
         free_image(face_handle);
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glTextureParameteri(cubemap.texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cubemap.texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cubemap.texture_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cubemap.texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(cubemap.texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
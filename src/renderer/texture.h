@@ -2,8 +2,16 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 #include "../gamedefine.h"
 #include "GL/glew.h"
+#include "texture_cache.h"
+
+struct bitmap_handle_t;
+struct texture_t;
+
+/** Gets a texture that finished loading, and holds its reference from then on */
+typedef std::function<void(texture_t&)> texture_ready_t;
 
 /** Handle for texture stored in GPU memory */
 struct texture_t
@@ -12,10 +20,12 @@ struct texture_t
     i32     width       = 0;        // Width of the texture
     i32     height      = 0;        // Height of the texture
     GLenum  format      = GL_NONE;  // format / bitdepth of texture (GL_RGB would be 3 byte bit depth)
+    u32     residency_id = 0;       // 0 unless the texture is shared through texture_residency.h
 
     /** Loads texture from bitmap; generates a new texture object in GPU mem; store the id
-    of the new texture object into texture.texture_id; sets texture parameters; copies texture data
-    into the texture object in GPU mem; and generates mip maps automatically. */
+    of the new texture object into texture.texture_id; allocates immutable storage for every mip;
+    sets texture parameters; copies texture data into the texture object in GPU mem; and generates
+    mip maps automatically. The storage can't be resized, only written into. */
     static void gl_create_from_bitmap(texture_t&        texture,
                                       unsigned char*    bitmap,
                                       u32               bitmap_width,
@@ -25,11 +35,56 @@ struct texture_t
 
     /** Loads texture at file_path; generates a new texture object in GPU mem; stores the id
     of the new texture object into texture.texture_id; sets texture parameters; copies
-    texture data into the texture object in GPU mem; and generates mip maps automatically. */
+    texture data into the texture object in GPU mem; and generates mip maps automatically.
+    Unless texture compression is off the texture is cooked (or read from its .texcache) and
+    uploaded with gl_create_from_cooked instead. */
     static void gl_create_from_file(texture_t&    texture,
                                     const char* texture_file_path);
 
-    /** Deletes texture object from GPU memory; resets texture_id, width, height, bit_depth to 0. */
+    /** gl_create_from_file for every path in texture_file_paths into the texture at the same
+    index of textures (resized to match). Images are decoded (or cooked) in parallel on the
+    worker pool before they're uploaded. Empty paths and images that fail to load are left as
+    empty textures. */
+    static void gl_create_from_file_list(std::vector<texture_t>&          textures,
+                                         const std::vector<std::string>&  texture_file_paths);
+
+    /** Like gl_create_from_file but for an image that was already read (e.g. decoded on a worker
+    thread). The texture is shared with later gl_create_from_file calls for texture_file_path, and
+    if texture_file_path was already loaded that texture is used and image is ignored. Doesn't
+    free image. */
+    static void gl_create_from_image(texture_t&              texture,
+                                     const char*             texture_file_path,
+                                     const bitmap_handle_t&  image);
+
+    /** Like gl_create_from_image but for a cooked texture (texture_cache.h): uploads the blocks
+    of every mip with glCompressedTextureSubImage2D, so nothing is generated on the GPU. Doesn't free
+    cooked. */
+    static void gl_create_from_cooked(texture_t&              texture,
+                                      const char*             texture_file_path,
+                                      const texture_cooked_t& cooked);
+
+    /** Like gl_create_from_image, but the texture is created and filled on the upload thread
+    (gpu_upload.h). on_ready gets it on the main thread once the GPU has it, or right away if the
+    texture was already loaded. image must have decoded, it gets freed. image_hash is
+    hash_fnv1a64 of its memory, worked out by whoever decoded it so the main thread doesn't
+    have to read the whole image. */
+    static void gl_create_from_image_async(const char*            texture_file_path,
+                                           const bitmap_handle_t& image,
+                                           u64                    image_hash,
+                                           const texture_ready_t& on_ready);
+
+    /** Like gl_create_from_image_async for a cooked texture. Takes cooked and deletes it. */
+    static void gl_create_from_cooked_async(const char*            texture_file_path,
+                                            texture_cooked_t*      cooked,
+                                            const texture_ready_t& on_ready);
+
+    /** Points texture at the same texture as shared with another reference, so both have to be
+    deleted. Only for textures loaded from a file, image, or cooked texture. */
+    static void gl_share(texture_t& texture, const texture_t& shared);
+
+    /** Deletes texture object from GPU memory; resets texture_id, width, height, bit_depth to 0.
+    Textures loaded from a file, image, or cooked texture are shared, so this only gives back
+    the reference texture held (see texture_residency.h). */
     static void gl_delete(texture_t& texture);
 
     // Binds this texture to texture_t Unit 1
@@ -41,6 +96,11 @@ struct texture_t
     void gl_use_texture() const;
 };
 
+/** Sets how textures loaded from now on are compressed (texture_compression_t). */
+void texture_set_compression(int compression);
+
+texture_compression_t texture_get_compression();
+
 /** Handle for cubemap stored in GPU memory */
 struct cubemap_t : public texture_t
 {
@@ -0,0 +1,138 @@
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cmath>
+#include <GL/glew.h>
+
+#include "texture_array.h"
+#include "texture.h"
+#include "texture_residency.h"
+#include "../core/kc_math.h"
+#include "../debugging/console.h"
+
+/** One array being built: the texture objects that become its layers, in layer order */
+struct texture_array_group_t
+{
+    texture_residency_info_t    info;
+    std::string                 first_path;                 // of layer 0, what texture_report lists the array as
+    std::vector<GLuint>         sources;
+};
+
+internal bool b_texture_arrays = true;
+
+internal bool texture_array_same_shape(const texture_residency_info_t& a, const texture_residency_info_t& b)
+{
+    return a.internal_format == b.internal_format && a.width == b.width && a.height == b.height && a.mips_count == b.mips_count;
+}
+
+internal GLuint texture_array_create(const texture_array_group_t& group)
+{
+    const texture_residency_info_t& info = group.info;
+    GLuint gl_id;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &gl_id);
+    glTextureStorage3D(gl_id, info.mips_count, info.internal_format, info.width, info.height, (GLsizei) group.sources.size());
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_MIN_FILTER, info.mips_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTextureParameteri(gl_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLint swizzle[4];   // layers of one format share it (BC5 is swizzled to grey + alpha)
+    glGetTextureParameteriv(group.sources[0], GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTextureParameteriv(gl_id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+    for(size_t layer = 0; layer < group.sources.size(); ++layer)
+    {
+        for(u32 level = 0; level < info.mips_count; ++level)
+        {
+            glCopyImageSubData(group.sources[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+                               gl_id, GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint) layer,
+                               max(info.width >> level, 1u), max(info.height >> level, 1u), 1);
+        }
+    }
+    return gl_id;
+}
+
+bool texture_array_build(std::vector<u32>& arrays,
+                         std::vector<texture_array_layer_t>& layers,
+                         const std::vector<texture_t>& textures)
+{
+    for(const texture_t& texture : textures)
+    {
+        if(texture.texture_id != 0 && texture.residency_id == 0)
+        {
+            return false;
+        }
+    }
+
+    GLint max_layers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+    std::vector<texture_array_group_t> groups;
+    std::unordered_map<u32, texture_array_layer_t> layers_by_residency_id;
+    layers.assign(textures.size(), texture_array_layer_t());
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        u32 residency_id = textures[i].residency_id;
+        if(textures[i].texture_id == 0)
+        {
+            continue;
+        }
+        auto found = layers_by_residency_id.find(residency_id);
+        if(found != layers_by_residency_id.end())
+        {
+            layers[i] = found->second;
+            continue;
+        }
+
+        texture_residency_info_t info = texture_residency_describe(residency_id);
+        size_t group_index = 0;
+        while(group_index < groups.size()
+              && !(texture_array_same_shape(groups[group_index].info, info) && groups[group_index].sources.size() < (size_t) max_layers))
+        {
+            ++group_index;
+        }
+        if(group_index == groups.size())
+        {
+            groups.emplace_back();
+            groups.back().info = info;
+            groups.back().first_path = info.path;
+        }
+        texture_array_layer_t layer;
+        layer.array_index = (u16) group_index;
+        layer.layer = (u16) groups[group_index].sources.size();
+        groups[group_index].sources.push_back(info.gl_id);
+        layers[i] = layer;
+        layers_by_residency_id[residency_id] = layer;
+    }
+
+    arrays.clear();
+    for(const texture_array_group_t& group : groups)
+    {
+        arrays.push_back(texture_array_create(group));
+        texture_residency_add_array(arrays.back(), group.info, (u32) group.sources.size(), group.first_path.c_str());
+    }
+    return true;
+}
+
+void texture_array_delete(std::vector<u32>& arrays)
+{
+    for(u32 gl_id : arrays)
+    {
+        texture_residency_remove_array(gl_id);
+    }
+    if(!arrays.empty())
+    {
+        glDeleteTextures((GLsizei) arrays.size(), arrays.data());
+    }
+    arrays.clear();
+}
+
+void texture_array_set_enabled(int enabled)
+{
+    b_texture_arrays = enabled != 0;
+    console_printf("Texture arrays %s for models loaded from now on\n", b_texture_arrays ? "on" : "off");
+}
+
+bool texture_array_is_enabled()
+{
+    return b_texture_arrays;
+}
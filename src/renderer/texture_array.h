@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "../gamedefine.h"
+
+struct texture_t;
+
+/**
+    TEXTURE ARRAYS - the material textures of a model as a few GL_TEXTURE_2D_ARRAY objects
+
+    Drawing a model with one 2D texture per material means binding a texture before every mesh,
+    so meshes can't be drawn together. texture_array_build groups the textures of a model by
+    internal format, size, and mip count, and copies each group into the layers of one
+    GL_TEXTURE_2D_ARRAY on the GPU (glCopyImageSubData, nothing is read back or decoded again).
+    Every material then only needs an array index and a layer: a model whose textures are all
+    the same size and format draws with a single texture binding, and the layer is a uniform
+    (or could be a vertex attribute or draw id).
+
+    Sources are the textures of the residency manager (texture_residency.h) as they are right
+    now, so mips it already dropped stay dropped. The arrays are copies owned by whoever built
+    them; the textures they were built from can be released afterwards. They're registered with
+    the residency manager so they count against the texture budget, and have to be deleted with
+    texture_array_delete. Main thread only.
+*/
+
+#define TEXTURE_ARRAY_NONE 0xFFFF   // material without a texture
+
+struct texture_array_layer_t
+{
+    u16 array_index = TEXTURE_ARRAY_NONE;
+    u16 layer = 0;
+};
+
+/** Builds the arrays for textures (indexed by material) into arrays, and the layer of every
+    material into layers. Materials sharing a texture share a layer. Returns false and builds
+    nothing if one of the textures isn't managed by the residency manager. */
+bool texture_array_build(std::vector<u32>& arrays,
+                         std::vector<texture_array_layer_t>& layers,
+                         const std::vector<texture_t>& textures);
+
+/** Deletes arrays built by texture_array_build and takes them off the texture budget */
+void texture_array_delete(std::vector<u32>& arrays);
+
+/** Console command. Takes effect for models loaded afterwards. */
+void texture_array_set_enabled(int enabled);
+
+bool texture_array_is_enabled();
@@ -0,0 +1,297 @@
+#include <cmath>
+#include <cstring>
+
+#include "texture_cache.h"
+#include "../core/hash.h"
+#include "../core/timer.h"
+#include "../core/kc_math.h"
+#include "../core/file_system.h"
+#include "../debugging/console.h"
+#include "../stb/stb_image.h"
+
+std::string texture_cache_path(const char* source_path)
+{
+    return std::string(source_path) + TEXTURE_CACHE_FILE_EXTENSION;
+}
+
+texture_block_format_t texture_choose_block_format(texture_compression_t compression, u32 channels, bool b_has_alpha)
+{
+    if(channels == 2)
+    {
+        return TEXTURE_BLOCK_BC5;
+    }
+    if(compression == TEXTURE_COMPRESSION_BC7)
+    {
+        return TEXTURE_BLOCK_BC7;
+    }
+    return b_has_alpha ? TEXTURE_BLOCK_BC3 : TEXTURE_BLOCK_BC1;
+}
+
+/** Halves an RGBA8 image with a 2x2 box filter. The last row / column of odd sized images is
+    averaged with itself. */
+internal void texture_downsample(const u8* source, u32 width, u32 height, u8* out, u32 out_width, u32 out_height)
+{
+    for(u32 y = 0; y < out_height; ++y)
+    {
+        const u8* row0 = source + (size_t) min(y * 2, height - 1) * width * 4;
+        const u8* row1 = source + (size_t) min(y * 2 + 1, height - 1) * width * 4;
+        for(u32 x = 0; x < out_width; ++x)
+        {
+            u32 x0 = min(x * 2, width - 1) * 4;
+            u32 x1 = min(x * 2 + 1, width - 1) * 4;
+            u8* texel = out + ((size_t) y * out_width + x) * 4;
+            for(u32 c = 0; c < 4; ++c)
+            {
+                texel[c] = (u8) ((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+void texture_cook(texture_cooked_t& cooked, const bitmap_handle_t& image, texture_compression_t compression)
+{
+    u32 width = image.width;
+    u32 height = image.height;
+    u32 channels = image.bit_depth;
+    const u8* source = (const u8*) image.memory;
+
+    // Expand to RGBA8, grey images to grey RGB. Grey + alpha images keep their alpha in green,
+    // they are cooked to BC5 and swizzled back to grey RGB + alpha when sampled
+    std::vector<u8> level((size_t) width * height * 4);
+    bool b_has_alpha = false;
+    for(size_t i = 0; i < (size_t) width * height; ++i)
+    {
+        const u8* in = source + i * channels;
+        u8* texel = &level[i * 4];
+        texel[0] = in[0];
+        texel[1] = channels >= 2 ? in[1] : in[0];
+        texel[2] = channels >= 3 ? in[2] : in[0];
+        texel[3] = channels == 4 ? in[3] : 255;
+        b_has_alpha |= texel[3] != 255;
+    }
+
+    cooked.format = texture_choose_block_format(compression, channels, b_has_alpha);
+    cooked.compression = compression;
+    cooked.width = width;
+    cooked.height = height;
+    cooked.mips_count = 0;
+    cooked.uncompressed_size = 0;
+
+    u64 blocks_size = 0;
+    for(u32 mip_width = width, mip_height = height; cooked.mips_count < TEXTURE_MAX_MIPS; )
+    {
+        texture_cache_mip_t& mip = cooked.mips[cooked.mips_count++];
+        mip.offset = blocks_size;
+        mip.size = texture_compressed_size(cooked.format, mip_width, mip_height);
+        mip.width = mip_width;
+        mip.height = mip_height;
+        blocks_size += mip.size;
+        cooked.uncompressed_size += (u64) mip_width * mip_height * 4;
+        if(mip_width == 1 && mip_height == 1)
+        {
+            break;
+        }
+        mip_width = max(mip_width / 2, 1u);
+        mip_height = max(mip_height / 2, 1u);
+    }
+
+    cooked.storage.resize(blocks_size);
+    std::vector<u8> next_level;
+    for(u32 i = 0; i < cooked.mips_count; ++i)
+    {
+        const texture_cache_mip_t& mip = cooked.mips[i];
+        texture_compress_image(cooked.format, level.data(), mip.width, mip.height, cooked.storage.data() + mip.offset);
+        if(i + 1 < cooked.mips_count)
+        {
+            const texture_cache_mip_t& next_mip = cooked.mips[i + 1];
+            next_level.resize((size_t) next_mip.width * next_mip.height * 4);
+            texture_downsample(level.data(), mip.width, mip.height, next_level.data(), next_mip.width, next_mip.height);
+            level.swap(next_level);
+        }
+    }
+    cooked.blocks = cooked.storage.data();
+    cooked.content_hash = hash_fnv1a64(cooked.blocks, blocks_size);
+}
+
+/** The mips of the cache go to glCompressedTextureSubImage2D straight from the mapping, so a
+    truncated or corrupt file must not describe blocks outside it. */
+internal bool texture_cache_is_layout_valid(const texture_cache_header_t* header)
+{
+    if(header->blocks_offset < sizeof(texture_cache_header_t)
+        || header->blocks_offset > header->file_size
+        || header->format > TEXTURE_BLOCK_BC7
+        || header->width == 0
+        || header->height == 0)
+    {
+        return false;
+    }
+
+    texture_block_format_t format = (texture_block_format_t) header->format;
+    u64 blocks_size = header->file_size - header->blocks_offset;
+    u32 mip_width = header->width;
+    u32 mip_height = header->height;
+    for(u32 i = 0; i < header->mips_count; ++i)
+    {
+        const texture_cache_mip_t& mip = header->mips[i];
+        if(mip.width != mip_width
+            || mip.height != mip_height
+            || mip.size != texture_compressed_size(format, mip.width, mip.height)
+            || mip.offset > blocks_size
+            || mip.size > blocks_size - mip.offset)
+        {
+            return false;
+        }
+        mip_width = max(mip_width / 2, 1u);
+        mip_height = max(mip_height / 2, 1u);
+    }
+    return true;
+}
+
+texture_cache_status_t texture_cache_open(texture_cooked_t& cooked,
+                                          const char* source_path,
+                                          u64 source_hash,
+                                          texture_compression_t compression,
+                                          bool b_flipped)
+{
+    if(source_hash == 0)
+    {
+        return TEXTURE_CACHE_MISSING;
+    }
+
+    std::string cache_path = texture_cache_path(source_path);
+    map_file_readonly(cooked.file, cache_path.c_str());
+    if(cooked.file.memory == nullptr)
+    {
+        return TEXTURE_CACHE_MISSING;
+    }
+
+    const u8* base = (const u8*) cooked.file.memory;
+    const texture_cache_header_t* header = (const texture_cache_header_t*) base;
+    if(cooked.file.size < sizeof(texture_cache_header_t)
+        || header->magic != TEXTURE_CACHE_MAGIC
+        || header->version != TEXTURE_CACHE_VERSION
+        || header->source_hash != source_hash
+        || header->compression != (u32) compression
+        || (header->flags & TEXTURE_CACHE_FLIPPED) != (b_flipped ? (u32) TEXTURE_CACHE_FLIPPED : 0u)
+        || header->mips_count == 0
+        || header->mips_count > TEXTURE_MAX_MIPS
+        || header->file_size != cooked.file.size
+        || !texture_cache_is_layout_valid(header))
+    {
+        unmap_file(cooked.file);
+        return TEXTURE_CACHE_STALE;
+    }
+
+    cooked.blocks = base + header->blocks_offset;
+    cooked.format = (texture_block_format_t) header->format;
+    cooked.width = header->width;
+    cooked.height = header->height;
+    cooked.mips_count = header->mips_count;
+    cooked.content_hash = header->content_hash;
+    cooked.compression = compression;
+    cooked.b_flipped = b_flipped;
+    cooked.b_cached = true;
+    cooked.uncompressed_size = 0;
+    for(u32 i = 0; i < header->mips_count; ++i)
+    {
+        cooked.mips[i] = header->mips[i];
+        cooked.uncompressed_size += (u64) header->mips[i].width * header->mips[i].height * 4;
+    }
+    return TEXTURE_CACHE_OK;
+}
+
+u64 texture_cache_write(const char* source_path,
+                        u64 source_hash,
+                        texture_compression_t compression,
+                        bool b_flipped,
+                        const texture_cooked_t& cooked)
+{
+    if(source_hash == 0 || cooked.mips_count == 0)
+    {
+        return 0;
+    }
+
+    texture_cache_header_t header = {};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.source_hash = source_hash;
+    header.content_hash = cooked.content_hash;
+    header.compression = (u32) compression;
+    header.format = (u32) cooked.format;
+    header.flags = b_flipped ? TEXTURE_CACHE_FLIPPED : 0;
+    header.width = cooked.width;
+    header.height = cooked.height;
+    header.mips_count = cooked.mips_count;
+    header.blocks_offset = sizeof(texture_cache_header_t);
+    memcpy(header.mips, cooked.mips, sizeof(texture_cache_mip_t) * cooked.mips_count);
+    const texture_cache_mip_t& last_mip = cooked.mips[cooked.mips_count - 1];
+    u64 blocks_size = last_mip.offset + last_mip.size;
+    header.file_size = header.blocks_offset + blocks_size;
+
+    u8* file_memory = (u8*) malloc(header.file_size);
+    if(file_memory == nullptr)
+    {
+        return 0;
+    }
+    memcpy(file_memory, &header, sizeof(header));
+    memcpy(file_memory + header.blocks_offset, cooked.blocks, blocks_size);
+
+    std::string cache_path = texture_cache_path(source_path);
+    bool b_written = write_file_binary(cache_path.c_str(), file_memory, header.file_size);
+    free(file_memory);
+    return b_written ? header.file_size : 0;
+}
+
+bool texture_cache_load(texture_cooked_t& cooked, const char* source_path, bool b_flip, texture_compression_t compression)
+{
+    // The source is hashed and decoded from one mapping so it's only read once
+    mapped_file_handle_t source_file;
+    map_file_readonly(source_file, source_path);
+    if(source_file.memory == nullptr)
+    {
+        return false;
+    }
+    u64 source_hash = hash_fnv1a64(source_file.memory, source_file.size);
+    if(texture_cache_open(cooked, source_path, source_hash, compression, b_flip) == TEXTURE_CACHE_OK)
+    {
+        unmap_file(source_file);
+        return true;
+    }
+
+    i64 cook_ticks = timer::get_ticks();
+    bitmap_handle_t image;
+    int width, height, bit_depth;
+    stbi_set_flip_vertically_on_load_thread(b_flip ? 1 : 0);
+    image.memory = stbi_load_from_memory((const stbi_uc*) source_file.memory, (int) source_file.size, &width, &height, &bit_depth, 0);
+    unmap_file(source_file);
+    if(image.memory == nullptr)
+    {
+        return false;
+    }
+    image.width = (u32) width;
+    image.height = (u32) height;
+    image.bit_depth = (u8) bit_depth;
+    image.size = image.width * image.height * image.bit_depth;
+
+    texture_cook(cooked, image, compression);
+    free_image(image);
+    u64 cache_size = texture_cache_write(source_path, source_hash, compression, b_flip, cooked);
+    cooked.b_flipped = b_flip;
+    cooked.b_cached = cache_size > 0;
+
+    console_printf("Cooked '%s': %ux%u %s, %u mips, %llu KB (%llu KB as RGBA8) in %.1f ms%s\n",
+                   source_path, cooked.width, cooked.height, texture_block_format_name(cooked.format), cooked.mips_count,
+                   (unsigned long long) (cooked.storage.size() / 1024), (unsigned long long) (cooked.uncompressed_size / 1024),
+                   1000.f * (float) (timer::get_ticks() - cook_ticks) / (float) timer::counter_frequency(),
+                   cache_size ? "" : " (couldn't write the cache)");
+    return true;
+}
+
+void texture_cooked_free(texture_cooked_t& cooked)
+{
+    if(cooked.file.memory)
+    {
+        unmap_file(cooked.file);
+    }
+    cooked = texture_cooked_t();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "../gamedefine.h"
+#include "texture_compress.h"
+#include "../runtime/memory_handle.h"
+
+/**
+    COOKED TEXTURE CACHE
+
+    Textures are cooked once into GPU block compressed formats (texture_compress.h) with their
+    whole mip chain and written next to the source image as <source path>.texcache. On later
+    runs the cache file is memory mapped and every mip goes straight to glCompressedTextureSubImage2D
+    (texture_t::gl_create_from_cooked), so there is no decoding, mip generation, or
+    glGenerateMipmap at load.
+
+    The cache is invalidated when the hash of the source image, the compression mode, whether
+    the image was flipped on load, or TEXTURE_CACHE_VERSION changes. Bump
+    TEXTURE_CACHE_VERSION whenever the layout of the file or the encoders change. A cache whose
+    mip table doesn't match its size or points outside the file is treated as stale.
+
+    File layout (all offsets are in bytes from the start of the file):
+        texture_cache_header_t (with the mip table)
+        blocks of every mip, largest first
+*/
+
+#define TEXTURE_CACHE_MAGIC 0x58455458 // 'XTEX'
+#define TEXTURE_CACHE_VERSION 3
+#define TEXTURE_CACHE_FILE_EXTENSION ".texcache"
+#define TEXTURE_MAX_MIPS 16
+
+/** Two channel (grey + alpha) images are cooked to BC5 with either compression */
+enum texture_compression_t
+{
+    TEXTURE_COMPRESSION_NONE = 0,   // RGBA8 with glGenerateMipmap, nothing is cooked
+    TEXTURE_COMPRESSION_BC1_BC3 = 1,// BC1 for opaque images, BC3 if any texel has alpha
+    TEXTURE_COMPRESSION_BC7 = 2     // BC7 for every image
+};
+
+enum texture_cache_flags_t
+{
+    TEXTURE_CACHE_FLIPPED = 1       // the source was flipped vertically on load
+};
+
+struct texture_cache_mip_t
+{
+    u64 offset;     // in bytes from the start of the blocks
+    u32 size;       // in bytes
+    u32 width;
+    u32 height;
+    u32 pad;
+};
+
+struct texture_cache_header_t
+{
+    u32 magic;
+    u32 version;
+    u64 source_hash;
+    u64 content_hash;               // of the blocks, identical images have the same one
+    u32 compression;                // texture_compression_t the texture was cooked with
+    u32 format;                     // texture_block_format_t
+    u32 flags;                      // texture_cache_flags_t
+    u32 width;
+    u32 height;
+    u32 mips_count;
+    u64 blocks_offset;
+    u64 file_size;
+    texture_cache_mip_t mips[TEXTURE_MAX_MIPS];
+};
+
+/** A cooked texture, either mapped from a cache file or cooked into memory. blocks points to
+    the blocks of every mip back to back and stays valid until texture_cooked_free. */
+struct texture_cooked_t
+{
+    mapped_file_handle_t    file;           // mapped cache file, if it came from one
+    std::vector<u8>         storage;        // blocks, if it was cooked in memory
+    const u8*               blocks = nullptr;
+    texture_block_format_t  format = TEXTURE_BLOCK_BC1;
+    u32                     width = 0;
+    u32                     height = 0;
+    u32                     mips_count = 0;
+    texture_cache_mip_t     mips[TEXTURE_MAX_MIPS] = {};
+    u64                     uncompressed_size = 0;  // RGBA8 size of the same mip chain
+    u64                     content_hash = 0;       // of the blocks, identical images have the same one
+    texture_compression_t   compression = TEXTURE_COMPRESSION_BC1_BC3;
+    bool                    b_flipped = false;
+    bool                    b_cached = false;       // there's a valid .texcache of it, so its mips can be read again later
+};
+
+enum texture_cache_status_t
+{
+    TEXTURE_CACHE_OK,
+    TEXTURE_CACHE_MISSING,
+    TEXTURE_CACHE_STALE
+};
+
+std::string texture_cache_path(const char* source_path);
+
+/** Block format compression picks for an image with channels channels */
+texture_block_format_t texture_choose_block_format(texture_compression_t compression, u32 channels, bool b_has_alpha);
+
+/** Builds the mip chain of image (any number of channels) and compresses every mip in the
+    format compression picks for it. compression must not be TEXTURE_COMPRESSION_NONE.
+    Blocks are encoded on the worker pool; safe to call from a worker thread. */
+void texture_cook(texture_cooked_t& cooked, const bitmap_handle_t& image, texture_compression_t compression);
+
+/** Maps the cache of source_path if there is a valid one. Nothing is mapped unless
+    TEXTURE_CACHE_OK is returned. Doesn't touch GL or the console, so it can run on a
+    worker thread. */
+texture_cache_status_t texture_cache_open(texture_cooked_t& cooked,
+                                          const char* source_path,
+                                          u64 source_hash,
+                                          texture_compression_t compression,
+                                          bool b_flipped);
+
+/** Writes the cache file of source_path. Returns the size of the file written, or 0 if it
+    couldn't be written. Can run on a worker thread. */
+u64 texture_cache_write(const char* source_path,
+                        u64 source_hash,
+                        texture_compression_t compression,
+                        bool b_flipped,
+                        const texture_cooked_t& cooked);
+
+/** Opens the cache of the image at source_path, or decodes the image (flipped if b_flip),
+    cooks it, and writes the cache. Returns false if the image couldn't be read. Can run on a
+    worker thread. */
+bool texture_cache_load(texture_cooked_t& cooked, const char* source_path, bool b_flip, texture_compression_t compression);
+
+void texture_cooked_free(texture_cooked_t& cooked);
@@ -0,0 +1,588 @@
+#include <cmath>
+#include <cstring>
+#include <GL/glew.h>
+
+#include "texture_compress.h"
+#include "../core/kc_math.h"
+#include "../core/worker_pool.h"
+
+#define TEXTURE_BLOCK_TEXELS 16
+#define TEXTURE_PCA_ITERATIONS 8
+
+u32 texture_block_size(texture_block_format_t format)
+{
+    return format == TEXTURE_BLOCK_BC1 ? 8 : 16;
+}
+
+u32 texture_compressed_size(texture_block_format_t format, u32 width, u32 height)
+{
+    return ((width + 3) / 4) * ((height + 3) / 4) * texture_block_size(format);
+}
+
+u32 texture_block_gl_format(texture_block_format_t format)
+{
+    switch(format)
+    {
+        case TEXTURE_BLOCK_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TEXTURE_BLOCK_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TEXTURE_BLOCK_BC5: return GL_COMPRESSED_RG_RGTC2;
+        case TEXTURE_BLOCK_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+const char* texture_block_format_name(texture_block_format_t format)
+{
+    switch(format)
+    {
+        case TEXTURE_BLOCK_BC1: return "BC1";
+        case TEXTURE_BLOCK_BC3: return "BC3";
+        case TEXTURE_BLOCK_BC5: return "BC5";
+        case TEXTURE_BLOCK_BC7: return "BC7";
+    }
+    return "?";
+}
+
+/** Line through a block's texels in a space of channels_count channels: the mean and the
+    principal axis, plus the extent of the texels along it. */
+struct texture_block_line_t
+{
+    float   mean[4];
+    float   axis[4];
+    float   t_min;
+    float   t_max;
+};
+
+internal texture_block_line_t texture_block_principal_line(const float texels[TEXTURE_BLOCK_TEXELS][4], u32 channels_count)
+{
+    texture_block_line_t line = {};
+
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        for(u32 c = 0; c < channels_count; ++c)
+        {
+            line.mean[c] += texels[i][c];
+        }
+    }
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        line.mean[c] /= (float) TEXTURE_BLOCK_TEXELS;
+    }
+
+    float covariance[4][4] = {};
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        float d[4] = {};
+        for(u32 c = 0; c < channels_count; ++c)
+        {
+            d[c] = texels[i][c] - line.mean[c];
+        }
+        for(u32 a = 0; a < channels_count; ++a)
+        {
+            for(u32 b = 0; b < channels_count; ++b)
+            {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    // Power iteration, starting from the diagonal of the covariance (the variance per channel)
+    // which is never orthogonal to the principal axis unless the block is flat.
+    float axis[4] = {};
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        axis[c] = covariance[c][c];
+    }
+    for(u32 iteration = 0; iteration < TEXTURE_PCA_ITERATIONS; ++iteration)
+    {
+        float next[4] = {};
+        float largest = 0.f;
+        for(u32 a = 0; a < channels_count; ++a)
+        {
+            for(u32 b = 0; b < channels_count; ++b)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            largest = max(largest, fabsf(next[a]));
+        }
+        if(largest < 1e-6f)
+        {
+            break;
+        }
+        for(u32 c = 0; c < channels_count; ++c)
+        {
+            axis[c] = next[c] / largest;
+        }
+    }
+
+    float length_squared = 0.f;
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        length_squared += axis[c] * axis[c];
+    }
+    if(length_squared < 1e-12f)
+    {
+        return line; // flat block, both endpoints are the mean
+    }
+    float inverse_length = 1.f / sqrtf(length_squared);
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        line.axis[c] = axis[c] * inverse_length;
+    }
+
+    line.t_min = 1e30f;
+    line.t_max = -1e30f;
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        float t = 0.f;
+        for(u32 c = 0; c < channels_count; ++c)
+        {
+            t += (texels[i][c] - line.mean[c]) * line.axis[c];
+        }
+        line.t_min = min(line.t_min, t);
+        line.t_max = max(line.t_max, t);
+    }
+    return line;
+}
+
+internal void texture_block_line_endpoints(const texture_block_line_t& line, u32 channels_count, float out_start[4], float out_end[4])
+{
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        out_start[c] = clamp(line.mean[c] + line.axis[c] * line.t_max, 0.f, 255.f);
+        out_end[c] = clamp(line.mean[c] + line.axis[c] * line.t_min, 0.f, 255.f);
+    }
+}
+
+/** Least squares endpoints for texels with fixed indices, where texel i is
+    start * (1 - weights[indices[i]]) + end * weights[indices[i]]. Returns false if every
+    texel uses the same weight, in which case the endpoints can't be solved for. */
+internal bool texture_block_refit(const float texels[TEXTURE_BLOCK_TEXELS][4],
+                                  u32 channels_count,
+                                  const u8 indices[TEXTURE_BLOCK_TEXELS],
+                                  const float* weights,
+                                  float out_start[4],
+                                  float out_end[4])
+{
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ax[4] = {}, bx[4] = {};
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        float b = weights[indices[i]];
+        float a = 1.f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(u32 c = 0; c < channels_count; ++c)
+        {
+            ax[c] += a * texels[i][c];
+            bx[c] += b * texels[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if(fabsf(determinant) < 1e-6f)
+    {
+        return false;
+    }
+    float inverse_determinant = 1.f / determinant;
+    for(u32 c = 0; c < channels_count; ++c)
+    {
+        out_start[c] = clamp((bb * ax[c] - ab * bx[c]) * inverse_determinant, 0.f, 255.f);
+        out_end[c] = clamp((aa * bx[c] - ab * ax[c]) * inverse_determinant, 0.f, 255.f);
+    }
+    return true;
+}
+
+/** Picks the closest of palette_count palette colors for every texel into out_indices and
+    returns the total squared error. */
+internal float texture_block_choose_indices(const float texels[TEXTURE_BLOCK_TEXELS][4],
+                                            u32 channels_count,
+                                            const float palette[][4],
+                                            u32 palette_count,
+                                            u8 out_indices[TEXTURE_BLOCK_TEXELS])
+{
+    float total_error = 0.f;
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        float best_error = 1e30f;
+        u8 best_index = 0;
+        for(u32 p = 0; p < palette_count; ++p)
+        {
+            float error = 0.f;
+            for(u32 c = 0; c < channels_count; ++c)
+            {
+                float d = texels[i][c] - palette[p][c];
+                error += d * d;
+            }
+            if(error < best_error)
+            {
+                best_error = error;
+                best_index = (u8) p;
+            }
+        }
+        out_indices[i] = best_index;
+        total_error += best_error;
+    }
+    return total_error;
+}
+
+// BC1 ----------------------------------------------------------------------------------------
+
+internal u16 texture_bc1_pack_565(const float color[4])
+{
+    u32 r = (u32) (color[0] * (31.f / 255.f) + 0.5f);
+    u32 g = (u32) (color[1] * (63.f / 255.f) + 0.5f);
+    u32 b = (u32) (color[2] * (31.f / 255.f) + 0.5f);
+    return (u16) ((r << 11) | (g << 5) | b);
+}
+
+internal void texture_bc1_unpack_565(u16 packed, float out_color[4])
+{
+    u32 r = (packed >> 11) & 31;
+    u32 g = (packed >> 5) & 63;
+    u32 b = packed & 31;
+    out_color[0] = (float) ((r << 3) | (r >> 2));
+    out_color[1] = (float) ((g << 2) | (g >> 4));
+    out_color[2] = (float) ((b << 3) | (b >> 2));
+    out_color[3] = 255.f;
+}
+
+/** Four color palette of a pair of 565 endpoints, in BC1 index order. */
+internal void texture_bc1_palette(u16 color0, u16 color1, float out_palette[4][4])
+{
+    texture_bc1_unpack_565(color0, out_palette[0]);
+    texture_bc1_unpack_565(color1, out_palette[1]);
+    for(u32 c = 0; c < 4; ++c)
+    {
+        out_palette[2][c] = (2.f * out_palette[0][c] + out_palette[1][c]) / 3.f;
+        out_palette[3][c] = (out_palette[0][c] + 2.f * out_palette[1][c]) / 3.f;
+    }
+}
+
+/** Opaque BC1 block, always in four color mode so it's also a valid BC3 color block. */
+internal void texture_encode_bc1(const float texels[TEXTURE_BLOCK_TEXELS][4], u8* out_block)
+{
+    local_persist const float bc1_weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+    texture_block_line_t line = texture_block_principal_line(texels, 3);
+    float start[4] = {}, end[4] = {};
+    texture_block_line_endpoints(line, 3, start, end);
+
+    u16 color0 = texture_bc1_pack_565(start);
+    u16 color1 = texture_bc1_pack_565(end);
+    float palette[4][4];
+    u8 indices[TEXTURE_BLOCK_TEXELS];
+    texture_bc1_palette(color0, color1, palette);
+    float error = texture_block_choose_indices(texels, 3, palette, 4, indices);
+
+    float refit_start[4] = {}, refit_end[4] = {};
+    if(texture_block_refit(texels, 3, indices, bc1_weights, refit_start, refit_end))
+    {
+        u16 refit_color0 = texture_bc1_pack_565(refit_start);
+        u16 refit_color1 = texture_bc1_pack_565(refit_end);
+        u8 refit_indices[TEXTURE_BLOCK_TEXELS];
+        texture_bc1_palette(refit_color0, refit_color1, palette);
+        float refit_error = texture_block_choose_indices(texels, 3, palette, 4, refit_indices);
+        if(refit_error < error)
+        {
+            color0 = refit_color0;
+            color1 = refit_color1;
+            memcpy(indices, refit_indices, sizeof(indices));
+        }
+    }
+
+    // Four color mode needs color0 > color1. Swapping the endpoints swaps indices 0 <-> 1 and 2 <-> 3.
+    if(color0 < color1)
+    {
+        u16 swap = color0;
+        color0 = color1;
+        color1 = swap;
+        for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+        {
+            indices[i] ^= 1;
+        }
+    }
+    else if(color0 == color1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    u32 index_bits = 0;
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        index_bits |= (u32) indices[i] << (2 * i);
+    }
+    out_block[0] = (u8) (color0 & 0xFF);
+    out_block[1] = (u8) (color0 >> 8);
+    out_block[2] = (u8) (color1 & 0xFF);
+    out_block[3] = (u8) (color1 >> 8);
+    out_block[4] = (u8) (index_bits & 0xFF);
+    out_block[5] = (u8) ((index_bits >> 8) & 0xFF);
+    out_block[6] = (u8) ((index_bits >> 16) & 0xFF);
+    out_block[7] = (u8) (index_bits >> 24);
+}
+
+// BC4 ----------------------------------------------------------------------------------------
+
+/** Single channel BC4 block (8 bytes) of channel of texels. Used for BC3 alpha and BC5. */
+internal void texture_encode_bc4(const float texels[TEXTURE_BLOCK_TEXELS][4], u32 channel, u8* out_block)
+{
+    u8 lowest = 255;
+    u8 highest = 0;
+    u8 values[TEXTURE_BLOCK_TEXELS];
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        values[i] = (u8) texels[i][channel];
+        lowest = min(lowest, values[i]);
+        highest = max(highest, values[i]);
+    }
+
+    // Eight value mode (value0 > value1): index 0 is value0, 1 is value1, 2..7 go from value0 to value1
+    u64 index_bits = 0;
+    if(highest != lowest)
+    {
+        float palette[8];
+        palette[0] = (float) highest;
+        palette[1] = (float) lowest;
+        for(u32 p = 2; p < 8; ++p)
+        {
+            palette[p] = ((8 - p) * (float) highest + (p - 1) * (float) lowest) / 7.f;
+        }
+        for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+        {
+            float best_error = 1e30f;
+            u64 best_index = 0;
+            for(u32 p = 0; p < 8; ++p)
+            {
+                float error = fabsf((float) values[i] - palette[p]);
+                if(error < best_error)
+                {
+                    best_error = error;
+                    best_index = p;
+                }
+            }
+            index_bits |= best_index << (3 * i);
+        }
+    }
+
+    out_block[0] = highest;
+    out_block[1] = lowest;
+    for(u32 b = 0; b < 6; ++b)
+    {
+        out_block[2 + b] = (u8) ((index_bits >> (8 * b)) & 0xFF);
+    }
+}
+
+// BC7 ----------------------------------------------------------------------------------------
+
+/** Writes bits into a 128 bit BC7 block from the least significant bit of byte 0 upwards. */
+struct texture_bc7_writer_t
+{
+    u8*     block;
+    u32     bit;
+};
+
+internal void texture_bc7_write(texture_bc7_writer_t& writer, u32 value, u32 bits_count)
+{
+    for(u32 b = 0; b < bits_count; ++b)
+    {
+        if(value & (1u << b))
+        {
+            writer.block[writer.bit >> 3] |= (u8) (1u << (writer.bit & 7));
+        }
+        ++writer.bit;
+    }
+}
+
+/** Mode 6 endpoints: 7 bits per channel plus one p-bit per endpoint shared by its channels. */
+struct texture_bc7_endpoints_t
+{
+    u8      start[4];
+    u8      end[4];
+    u8      start_p;
+    u8      end_p;
+};
+
+internal u8 texture_bc7_quantize(float value, u8 p_bit)
+{
+    int quantized = (int) floorf((value - (float) p_bit) * 0.5f + 0.5f);
+    return (u8) clamp(quantized, 0, 127);
+}
+
+internal void texture_bc7_palette(const texture_bc7_endpoints_t& endpoints, float out_palette[16][4])
+{
+    local_persist const u32 bc7_weights_4bit[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    for(u32 c = 0; c < 4; ++c)
+    {
+        u32 start = ((u32) endpoints.start[c] << 1) | endpoints.start_p;
+        u32 end = ((u32) endpoints.end[c] << 1) | endpoints.end_p;
+        for(u32 p = 0; p < 16; ++p)
+        {
+            u32 w = bc7_weights_4bit[p];
+            out_palette[p][c] = (float) (((64 - w) * start + w * end + 32) >> 6);
+        }
+    }
+}
+
+/** Quantizes a pair of float endpoints with the p-bits that fit the block best. Returns the
+    error of the block with those endpoints and writes their indices. */
+internal float texture_bc7_fit_endpoints(const float texels[TEXTURE_BLOCK_TEXELS][4],
+                                         const float start[4],
+                                         const float end[4],
+                                         texture_bc7_endpoints_t& out_endpoints,
+                                         u8 out_indices[TEXTURE_BLOCK_TEXELS])
+{
+    float best_error = 1e30f;
+    for(u8 p_bits = 0; p_bits < 4; ++p_bits)
+    {
+        texture_bc7_endpoints_t endpoints;
+        endpoints.start_p = p_bits & 1;
+        endpoints.end_p = p_bits >> 1;
+        for(u32 c = 0; c < 4; ++c)
+        {
+            endpoints.start[c] = texture_bc7_quantize(start[c], endpoints.start_p);
+            endpoints.end[c] = texture_bc7_quantize(end[c], endpoints.end_p);
+        }
+        float palette[16][4];
+        u8 indices[TEXTURE_BLOCK_TEXELS];
+        texture_bc7_palette(endpoints, palette);
+        float error = texture_block_choose_indices(texels, 4, palette, 16, indices);
+        if(error < best_error)
+        {
+            best_error = error;
+            out_endpoints = endpoints;
+            memcpy(out_indices, indices, TEXTURE_BLOCK_TEXELS);
+        }
+    }
+    return best_error;
+}
+
+/** BC7 mode 6 block: one subset, RGBA endpoints, 4 bit indices. */
+internal void texture_encode_bc7(const float texels[TEXTURE_BLOCK_TEXELS][4], u8* out_block)
+{
+    local_persist const float bc7_weights[16] = {
+        0.f/64.f, 4.f/64.f, 9.f/64.f, 13.f/64.f, 17.f/64.f, 21.f/64.f, 26.f/64.f, 30.f/64.f,
+        34.f/64.f, 38.f/64.f, 43.f/64.f, 47.f/64.f, 51.f/64.f, 55.f/64.f, 60.f/64.f, 64.f/64.f };
+
+    texture_block_line_t line = texture_block_principal_line(texels, 4);
+    float start[4] = {}, end[4] = {};
+    texture_block_line_endpoints(line, 4, start, end);
+
+    texture_bc7_endpoints_t endpoints;
+    u8 indices[TEXTURE_BLOCK_TEXELS];
+    float error = texture_bc7_fit_endpoints(texels, start, end, endpoints, indices);
+
+    float refit_start[4] = {}, refit_end[4] = {};
+    if(texture_block_refit(texels, 4, indices, bc7_weights, refit_start, refit_end))
+    {
+        texture_bc7_endpoints_t refit_endpoints;
+        u8 refit_indices[TEXTURE_BLOCK_TEXELS];
+        float refit_error = texture_bc7_fit_endpoints(texels, refit_start, refit_end, refit_endpoints, refit_indices);
+        if(refit_error < error)
+        {
+            endpoints = refit_endpoints;
+            memcpy(indices, refit_indices, sizeof(indices));
+        }
+    }
+
+    // The most significant index bit of texel 0 (the anchor) isn't stored and must be 0
+    if(indices[0] & 8)
+    {
+        texture_bc7_endpoints_t swapped;
+        memcpy(swapped.start, endpoints.end, 4);
+        memcpy(swapped.end, endpoints.start, 4);
+        swapped.start_p = endpoints.end_p;
+        swapped.end_p = endpoints.start_p;
+        endpoints = swapped;
+        for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out_block, 0, 16);
+    texture_bc7_writer_t writer = { out_block, 0 };
+    texture_bc7_write(writer, 1 << 6, 7);  // mode 6
+    for(u32 c = 0; c < 4; ++c)
+    {
+        texture_bc7_write(writer, endpoints.start[c], 7);
+        texture_bc7_write(writer, endpoints.end[c], 7);
+    }
+    texture_bc7_write(writer, endpoints.start_p, 1);
+    texture_bc7_write(writer, endpoints.end_p, 1);
+    texture_bc7_write(writer, indices[0], 3);
+    for(u32 i = 1; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        texture_bc7_write(writer, indices[i], 4);
+    }
+}
+
+// --------------------------------------------------------------------------------------------
+
+internal void texture_encode_texels(texture_block_format_t format, const float texels[TEXTURE_BLOCK_TEXELS][4], u8* out_block)
+{
+    switch(format)
+    {
+        case TEXTURE_BLOCK_BC1:
+        {
+            texture_encode_bc1(texels, out_block);
+        } break;
+        case TEXTURE_BLOCK_BC3:
+        {
+            texture_encode_bc4(texels, 3, out_block);
+            texture_encode_bc1(texels, out_block + 8);
+        } break;
+        case TEXTURE_BLOCK_BC5:
+        {
+            texture_encode_bc4(texels, 0, out_block);
+            texture_encode_bc4(texels, 1, out_block + 8);
+        } break;
+        case TEXTURE_BLOCK_BC7:
+        {
+            texture_encode_bc7(texels, out_block);
+        } break;
+    }
+}
+
+void texture_encode_block(texture_block_format_t format, const u8* rgba, u8* out_block)
+{
+    float texels[TEXTURE_BLOCK_TEXELS][4];
+    for(u32 i = 0; i < TEXTURE_BLOCK_TEXELS; ++i)
+    {
+        for(u32 c = 0; c < 4; ++c)
+        {
+            texels[i][c] = (float) rgba[i * 4 + c];
+        }
+    }
+    texture_encode_texels(format, texels, out_block);
+}
+
+void texture_compress_image(texture_block_format_t format, const u8* rgba, u32 width, u32 height, u8* out_blocks)
+{
+    u32 blocks_x = (width + 3) / 4;
+    u32 blocks_y = (height + 3) / 4;
+    u32 block_size = texture_block_size(format);
+
+    worker_pool_parallel_for(blocks_y, [=](u32 block_y)
+    {
+        float texels[TEXTURE_BLOCK_TEXELS][4];
+        for(u32 block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            for(u32 y = 0; y < 4; ++y)
+            {
+                u32 source_y = min(block_y * 4 + y, height - 1);
+                for(u32 x = 0; x < 4; ++x)
+                {
+                    u32 source_x = min(block_x * 4 + x, width - 1);
+                    const u8* texel = rgba + ((size_t) source_y * width + source_x) * 4;
+                    for(u32 c = 0; c < 4; ++c)
+                    {
+                        texels[y * 4 + x][c] = (float) texel[c];
+                    }
+                }
+            }
+            texture_encode_texels(format, texels, out_blocks + ((size_t) block_y * blocks_x + block_x) * block_size);
+        }
+    });
+}
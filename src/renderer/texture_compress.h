@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../gamedefine.h"
+
+/**
+    TEXTURE COMPRESS - CPU encoders for GPU block compressed formats
+
+    Every format stores 4x4 texel blocks:
+        BC1     8 bytes     RGB, two 565 endpoints and 2 bit indices. Opaque textures.
+        BC3     16 bytes    BC1 color block plus a BC4 alpha block. Textures with alpha.
+        BC5     16 bytes    Two BC4 blocks for red and green. Two channel data like normal maps.
+        BC7     16 bytes    RGBA. Only mode 6 is encoded: one subset, 7 bit endpoints with a
+                            p-bit each, 4 bit indices. Higher quality than BC1/BC3 for both
+                            opaque and alpha textures, at twice the size of BC1.
+    Endpoints come from the principal axis of the block's colors and get one least squares
+    refit against the chosen indices. This is a fast encoder for cooking on load, not an
+    exhaustive one.
+
+    Input is always RGBA8. Blocks at the right and bottom edges of images whose size isn't a
+    multiple of 4 repeat the last column / row.
+*/
+
+enum texture_block_format_t
+{
+    TEXTURE_BLOCK_BC1 = 0,
+    TEXTURE_BLOCK_BC3 = 1,
+    TEXTURE_BLOCK_BC5 = 2,
+    TEXTURE_BLOCK_BC7 = 3
+};
+
+/** Bytes per 4x4 block */
+u32 texture_block_size(texture_block_format_t format);
+
+/** Bytes of an image of width x height in format */
+u32 texture_compressed_size(texture_block_format_t format, u32 width, u32 height);
+
+/** GL internal format for glCompressedTexImage2D */
+u32 texture_block_gl_format(texture_block_format_t format);
+
+const char* texture_block_format_name(texture_block_format_t format);
+
+/** Encodes a 4x4 block of RGBA8 texels (row by row, 64 bytes) into out_block. */
+void texture_encode_block(texture_block_format_t format, const u8* rgba, u8* out_block);
+
+/** Encodes a width x height RGBA8 image into out_blocks, which must have
+    texture_compressed_size bytes. Rows of blocks are spread over the worker pool. */
+void texture_compress_image(texture_block_format_t format, const u8* rgba, u32 width, u32 height, u8* out_blocks);
@@ -0,0 +1,513 @@
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "texture_residency.h"
+#include "texture.h"
+#include "texture_upload.h"
+#include "../core/kc_math.h"
+#include "../debugging/console.h"
+
+struct texture_resident_t
+{
+    texture_t                   texture;                    // what's handed out, texture_id is the one at load
+    GLuint                      gl_id = 0;                  // current texture object
+    GLenum                      internal_format = GL_RGBA8;
+    u32                         block_bytes = 0;            // 0 for RGBA8
+    u32                         mips_count = 1;             // of the whole chain
+    u32                         top_mip = 0;                // largest resident mip, the ones above were dropped
+    u32                         refs = 0;
+    u64                         content_hash = 0;
+    u64                         size = 0;                   // bytes of the resident mips
+    u64                         last_used_frame = 0;
+    std::vector<std::string>    paths;                      // every name it was loaded by
+    bool                        b_live = false;
+    bool                        b_streamable = false;       // dropped mips can be read back from the .texcache of paths[0]
+    bool                        b_flipped = false;          // of the .texcache
+    texture_compression_t       compression = TEXTURE_COMPRESSION_NONE;
+};
+
+/** A texture array registered with texture_residency_add_array */
+struct texture_resident_array_t
+{
+    GLuint                      gl_id = 0;
+    GLenum                      internal_format = GL_NONE;
+    u32                         width = 0;
+    u32                         height = 0;
+    u32                         mips_count = 0;
+    u32                         layers_count = 0;
+    u64                         size = 0;
+    std::string                 name;
+};
+
+internal std::vector<texture_resident_t> residents;        // by residency id - 1
+internal std::vector<texture_resident_array_t> resident_arrays;
+internal std::vector<u32> free_residency_ids;
+internal std::unordered_map<std::string, u32> residents_by_path;
+internal std::unordered_map<u64, u32> residents_by_content;
+internal u64 resident_size = 0;                            // textures and arrays
+internal u64 residency_budget = (u64) (TEXTURE_RESIDENCY_DEFAULT_BUDGET_MB * 1024.f * 1024.f);
+internal u64 residency_frame = 0;
+
+internal u32 texture_residency_level_width(const texture_resident_t& resident, u32 level)
+{
+    return max((u32) resident.texture.width >> level, 1u);
+}
+
+internal u32 texture_residency_level_height(const texture_resident_t& resident, u32 level)
+{
+    return max((u32) resident.texture.height >> level, 1u);
+}
+
+internal u64 texture_residency_level_size(const texture_resident_t& resident, u32 level)
+{
+    u64 width = texture_residency_level_width(resident, level);
+    u64 height = texture_residency_level_height(resident, level);
+    if(resident.block_bytes)
+    {
+        return ((width + 3) / 4) * ((height + 3) / 4) * resident.block_bytes;
+    }
+    return width * height * 4;
+}
+
+internal u64 texture_residency_resident_size(const texture_resident_t& resident)
+{
+    u64 size = 0;
+    for(u32 level = resident.top_mip; level < resident.mips_count; ++level)
+    {
+        size += texture_residency_level_size(resident, level);
+    }
+    return size;
+}
+
+internal const char* texture_residency_format_name(GLenum internal_format)
+{
+    switch(internal_format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+        case GL_COMPRESSED_RG_RGTC2: return "BC5";
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+        default: return "RGBA8";
+    }
+}
+
+internal texture_resident_t& texture_residency_get(u32 residency_id)
+{
+    return residents[residency_id - 1];
+}
+
+internal void texture_residency_hand_out(texture_t& texture, texture_resident_t& resident)
+{
+    ++resident.refs;
+    texture = resident.texture;
+}
+
+bool texture_residency_find(texture_t& texture, const char* path)
+{
+    auto found = residents_by_path.find(std::string(path));
+    if(found == residents_by_path.end())
+    {
+        return false;
+    }
+    texture_residency_hand_out(texture, texture_residency_get(found->second));
+    return true;
+}
+
+bool texture_residency_find_content(texture_t& texture, u64 content_hash, const char* path)
+{
+    auto found = residents_by_content.find(content_hash);
+    if(content_hash == 0 || found == residents_by_content.end())
+    {
+        return false;
+    }
+    texture_resident_t& resident = texture_residency_get(found->second);
+    resident.paths.push_back(std::string(path));
+    residents_by_path[resident.paths.back()] = found->second;
+    texture_residency_hand_out(texture, resident);
+    return true;
+}
+
+void texture_residency_add(texture_t& texture,
+                           const char* path,
+                           u64 content_hash,
+                           GLenum internal_format,
+                           u32 block_bytes,
+                           u32 mips_count,
+                           u32 top_mip)
+{
+    u32 residency_id;
+    if(!free_residency_ids.empty())
+    {
+        residency_id = free_residency_ids.back();
+        free_residency_ids.pop_back();
+    }
+    else
+    {
+        residents.emplace_back();
+        residency_id = (u32) residents.size();
+    }
+
+    texture.residency_id = residency_id;
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    resident = texture_resident_t();
+    resident.texture = texture;
+    resident.gl_id = texture.texture_id;
+    resident.internal_format = internal_format;
+    resident.block_bytes = block_bytes;
+    resident.mips_count = max(mips_count, 1u);
+    resident.top_mip = min(top_mip, resident.mips_count - 1);
+    resident.refs = 1;
+    resident.content_hash = content_hash;
+    resident.size = texture_residency_resident_size(resident);
+    resident.last_used_frame = residency_frame;
+    resident.paths.push_back(std::string(path));
+    resident.b_live = true;
+
+    residents_by_path[resident.paths.back()] = residency_id;
+    if(content_hash)
+    {
+        residents_by_content[content_hash] = residency_id;
+    }
+    resident_size += resident.size;
+}
+
+void texture_residency_set_streamable(u32 residency_id, texture_compression_t compression, bool b_flipped)
+{
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    resident.b_streamable = resident.block_bytes != 0;
+    resident.compression = compression;
+    resident.b_flipped = b_flipped;
+}
+
+void texture_residency_acquire(u32 residency_id)
+{
+    ++texture_residency_get(residency_id).refs;
+}
+
+void texture_residency_release(u32 residency_id)
+{
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    if(!resident.b_live || resident.refs == 0)
+    {
+        console_printf("WARNING: Releasing texture %u, which isn't referenced!\n", residency_id);
+        return;
+    }
+    --resident.refs; // stays resident until the budget needs it
+}
+
+GLuint texture_residency_use(u32 residency_id)
+{
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    resident.last_used_frame = residency_frame;
+    return resident.gl_id;
+}
+
+texture_residency_info_t texture_residency_describe(u32 residency_id)
+{
+    texture_residency_info_t info;
+    if(residency_id == 0 || residency_id > residents.size())
+    {
+        return info;
+    }
+    const texture_resident_t& resident = texture_residency_get(residency_id);
+    info.gl_id = resident.gl_id;
+    info.internal_format = resident.internal_format;
+    info.width = texture_residency_level_width(resident, resident.top_mip);
+    info.height = texture_residency_level_height(resident, resident.top_mip);
+    info.mips_count = resident.mips_count - resident.top_mip;
+    info.top_mip = resident.top_mip;
+    info.size = resident.size;
+    info.b_live = resident.b_live;
+    info.b_streamable = resident.b_streamable;
+    info.b_flipped = resident.b_flipped;
+    info.compression = resident.compression;
+    info.path = resident.b_live ? resident.paths[0].c_str() : "";
+    return info;
+}
+
+void texture_residency_add_array(GLuint gl_id, const texture_residency_info_t& layer, u32 layers_count, const char* name)
+{
+    texture_resident_array_t array;
+    array.gl_id = gl_id;
+    array.internal_format = layer.internal_format;
+    array.width = layer.width;
+    array.height = layer.height;
+    array.mips_count = layer.mips_count;
+    array.layers_count = layers_count;
+    array.size = layer.size * layers_count;
+    array.name = name;
+    resident_size += array.size;
+    resident_arrays.push_back(array);
+}
+
+void texture_residency_remove_array(GLuint gl_id)
+{
+    for(size_t i = 0; i < resident_arrays.size(); ++i)
+    {
+        if(resident_arrays[i].gl_id == gl_id)
+        {
+            resident_size -= resident_arrays[i].size;
+            resident_arrays.erase(resident_arrays.begin() + i);
+            return;
+        }
+    }
+}
+
+internal void texture_residency_evict(u32 residency_id)
+{
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    glDeleteTextures(1, &resident.gl_id);
+    for(const std::string& path : resident.paths)
+    {
+        auto found = residents_by_path.find(path);
+        if(found != residents_by_path.end() && found->second == residency_id)
+        {
+            residents_by_path.erase(found);
+        }
+    }
+    auto found = residents_by_content.find(resident.content_hash);
+    if(found != residents_by_content.end() && found->second == residency_id)
+    {
+        residents_by_content.erase(found);
+    }
+    resident_size -= resident.size;
+    resident = texture_resident_t();
+    free_residency_ids.push_back(residency_id);
+}
+
+internal bool texture_residency_can_drop_mip(const texture_resident_t& resident)
+{
+    u32 level = resident.top_mip + 1;
+    return level < resident.mips_count
+        && texture_residency_level_width(resident, level) >= TEXTURE_RESIDENCY_MIN_DIMENSION
+        && texture_residency_level_height(resident, level) >= TEXTURE_RESIDENCY_MIN_DIMENSION;
+}
+
+/** Immutable texture object for the mips of resident from top_mip down, with the sampling
+    parameters of its current texture object */
+internal GLuint texture_residency_create_storage(const texture_resident_t& resident, u32 top_mip)
+{
+    GLint min_filter = GL_LINEAR;
+    GLint swizzle[4];
+    glGetTextureParameteriv(resident.gl_id, GL_TEXTURE_MIN_FILTER, &min_filter);
+    glGetTextureParameteriv(resident.gl_id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+    GLuint gl_id;
+    glCreateTextures(GL_TEXTURE_2D, 1, &gl_id);
+    glTextureStorage2D(gl_id, resident.mips_count - top_mip, resident.internal_format,
+                       texture_residency_level_width(resident, top_mip), texture_residency_level_height(resident, top_mip));
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(gl_id, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTextureParameteri(gl_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteriv(gl_id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    return gl_id;
+}
+
+/** Copies the mips of resident that are in both its current texture object and gl_id, which
+    starts at top_mip, then makes gl_id the current one */
+internal void texture_residency_replace(texture_resident_t& resident, GLuint gl_id, u32 top_mip)
+{
+    for(u32 level = max(top_mip, resident.top_mip); level < resident.mips_count; ++level)
+    {
+        glCopyImageSubData(resident.gl_id, GL_TEXTURE_2D, level - resident.top_mip, 0, 0, 0,
+                           gl_id, GL_TEXTURE_2D, level - top_mip, 0, 0, 0,
+                           texture_residency_level_width(resident, level), texture_residency_level_height(resident, level), 1);
+    }
+    glDeleteTextures(1, &resident.gl_id);
+
+    resident.gl_id = gl_id;
+    resident.top_mip = top_mip;
+    resident_size -= resident.size;
+    resident.size = texture_residency_resident_size(resident);
+    resident_size += resident.size;
+}
+
+/** Moves every mip but the largest resident one into a new texture object on the GPU */
+internal void texture_residency_drop_mip(texture_resident_t& resident)
+{
+    u32 top_mip = resident.top_mip + 1;
+    texture_residency_replace(resident, texture_residency_create_storage(resident, top_mip), top_mip);
+}
+
+bool texture_residency_restore_mips(u32 residency_id, u32 top_mip, const texture_cooked_t& cooked)
+{
+    texture_resident_t& resident = texture_residency_get(residency_id);
+    if(!resident.b_live
+       || top_mip >= resident.top_mip
+       || cooked.width != (u32) resident.texture.width
+       || cooked.height != (u32) resident.texture.height
+       || cooked.mips_count != resident.mips_count
+       || texture_block_gl_format(cooked.format) != resident.internal_format)
+    {
+        return false; // the texture changed since it was loaded
+    }
+
+    GLuint gl_id = texture_residency_create_storage(resident, top_mip);
+
+    // Mips are stored largest first, so the missing ones are one range of the blocks
+    u64 first_offset = cooked.mips[top_mip].offset;
+    const texture_cache_mip_t& last_mip = cooked.mips[resident.top_mip - 1];
+    const u8* blocks = (const u8*) texture_upload_stage(cooked.blocks + first_offset, last_mip.offset + last_mip.size - first_offset);
+    for(u32 level = top_mip; level < resident.top_mip; ++level)
+    {
+        const texture_cache_mip_t& mip = cooked.mips[level];
+        glCompressedTextureSubImage2D(gl_id, level - top_mip, 0, 0, mip.width, mip.height,
+                                      resident.internal_format, mip.size, blocks + (mip.offset - first_offset));
+    }
+    texture_upload_submit();
+
+    texture_residency_replace(resident, gl_id, top_mip);
+    resident.last_used_frame = residency_frame;
+    return true;
+}
+
+/** Evicts the least recently used unreferenced texture, or else drops the largest mip of the
+    least recently used referenced one. Only textures last used before used_before_frame are
+    considered. Returns false if there was nothing to do. */
+internal bool texture_residency_shrink(u64 used_before_frame)
+{
+    u32 unreferenced_id = 0;
+    u32 droppable_id = 0;
+    for(u32 i = 0; i < residents.size(); ++i)
+    {
+        const texture_resident_t& resident = residents[i];
+        if(!resident.b_live || resident.last_used_frame >= used_before_frame)
+        {
+            continue;
+        }
+        if(resident.refs == 0)
+        {
+            if(unreferenced_id == 0 || resident.last_used_frame < residents[unreferenced_id - 1].last_used_frame)
+            {
+                unreferenced_id = i + 1;
+            }
+        }
+        else if(texture_residency_can_drop_mip(resident))
+        {
+            if(droppable_id == 0 || resident.last_used_frame < residents[droppable_id - 1].last_used_frame)
+            {
+                droppable_id = i + 1;
+            }
+        }
+    }
+
+    if(unreferenced_id)
+    {
+        texture_residency_evict(unreferenced_id);
+    }
+    else if(droppable_id)
+    {
+        texture_residency_drop_mip(texture_residency_get(droppable_id));
+    }
+    return unreferenced_id || droppable_id;
+}
+
+bool texture_residency_make_room(u64 bytes)
+{
+    for(u32 change = 0; change < TEXTURE_RESIDENCY_MAX_CHANGES_PER_FRAME && resident_size + bytes > residency_budget; ++change)
+    {
+        // What was drawn last frame stays, or streaming would undo itself
+        if(!texture_residency_shrink(residency_frame - 1))
+        {
+            break;
+        }
+    }
+    return resident_size + bytes <= residency_budget;
+}
+
+void texture_residency_update()
+{
+    ++residency_frame;
+
+    // Unreferenced textures go first, then referenced ones lose their largest mip
+    for(u32 change = 0; change < TEXTURE_RESIDENCY_MAX_CHANGES_PER_FRAME && resident_size > residency_budget; ++change)
+    {
+        if(!texture_residency_shrink(UINT64_MAX))
+        {
+            break; // everything left is referenced and as small as it goes
+        }
+    }
+}
+
+void texture_residency_set_budget(float megabytes)
+{
+    residency_budget = (u64) (max(megabytes, 0.f) * 1024.f * 1024.f);
+    console_printf("Texture budget is %.1f MB (%.1f MB resident)\n",
+                   (float) residency_budget / (1024.f * 1024.f), (float) resident_size / (1024.f * 1024.f));
+}
+
+void texture_residency_report()
+{
+    std::vector<u32> live_ids;
+    u64 unreferenced_size = 0;
+    u32 unreferenced_count = 0;
+    u32 dropped_count = 0;
+    u32 aliases_count = 0;
+    for(u32 i = 0; i < residents.size(); ++i)
+    {
+        const texture_resident_t& resident = residents[i];
+        if(!resident.b_live)
+        {
+            continue;
+        }
+        live_ids.push_back(i + 1);
+        unreferenced_size += resident.refs == 0 ? resident.size : 0;
+        unreferenced_count += resident.refs == 0 ? 1 : 0;
+        dropped_count += resident.top_mip > 0 ? 1 : 0;
+        aliases_count += (u32) resident.paths.size() - 1;
+    }
+    std::sort(live_ids.begin(), live_ids.end(), [](u32 a, u32 b)
+    {
+        return residents[a - 1].size > residents[b - 1].size;
+    });
+
+    for(u32 residency_id : live_ids)
+    {
+        const texture_resident_t& resident = texture_residency_get(residency_id);
+        console_printf("  %7.2f MB  %4ux%-4u %-5s mips %2u/%-2u refs %-3u used %llu frames ago  %s",
+                       (float) resident.size / (1024.f * 1024.f),
+                       texture_residency_level_width(resident, resident.top_mip), texture_residency_level_height(resident, resident.top_mip),
+                       texture_residency_format_name(resident.internal_format),
+                       resident.mips_count - resident.top_mip, resident.mips_count, resident.refs,
+                       (unsigned long long) (residency_frame - resident.last_used_frame), resident.paths[0].c_str());
+        if(resident.paths.size() > 1)
+        {
+            console_printf(" (+%u identical)", (u32) resident.paths.size() - 1);
+        }
+        console_printf("\n");
+    }
+    u64 arrays_size = 0;
+    for(const texture_resident_array_t& array : resident_arrays)
+    {
+        console_printf("  %7.2f MB  %4ux%-4u %-5s mips %2u    layers %-3u array of %s\n",
+                       (float) array.size / (1024.f * 1024.f), array.width, array.height,
+                       texture_residency_format_name(array.internal_format), array.mips_count, array.layers_count, array.name.c_str());
+        arrays_size += array.size;
+    }
+    console_printf("Textures: %u resident, %u arrays (%.1f MB), %.1f / %.1f MB, %u unreferenced (%.1f MB), %u with dropped mips, %u paths deduplicated\n",
+                   (u32) live_ids.size(), (u32) resident_arrays.size(), (float) arrays_size / (1024.f * 1024.f),
+                   (float) resident_size / (1024.f * 1024.f), (float) residency_budget / (1024.f * 1024.f),
+                   unreferenced_count, (float) unreferenced_size / (1024.f * 1024.f), dropped_count, aliases_count);
+}
+
+void texture_residency_clean_up()
+{
+    for(texture_resident_t& resident : residents)
+    {
+        if(resident.b_live)
+        {
+            glDeleteTextures(1, &resident.gl_id);
+        }
+    }
+    residents.clear();
+    resident_arrays.clear(); // their owners delete them
+    free_residency_ids.clear();
+    residents_by_path.clear();
+    residents_by_content.clear();
+    resident_size = 0;
+}
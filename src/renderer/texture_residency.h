@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "GL/glew.h"
+#include "texture_cache.h"
+
+struct texture_t;
+
+/**
+    TEXTURE RESIDENCY - reference counted 2D textures under a VRAM budget
+
+    Every texture loaded through texture_t::gl_create_from_file / _image / _cooked is owned by
+    the residency manager and shared:
+        -   by path: loading a path that's already resident returns the same texture
+        -   by content hash: a different path with identical texel data (same hash, size, and
+            format) returns that texture too, and the path is remembered as another name for it
+    Each texture_t handed out holds one reference (texture_t::gl_share adds one more for a copy)
+    and texture_t::gl_delete gives it back. Textures nothing references anymore stay resident,
+    so loading the same model again is free, until the budget needs their memory.
+
+    Once a frame texture_residency_update brings the resident size under the budget:
+        1.  Unreferenced textures are deleted, least recently used first.
+        2.  Then referenced textures drop their largest mip, least recently used first. The
+            smaller mips are copied into a new texture object on the GPU (glCopyImageSubData),
+            so nothing is read back. Textures don't go below TEXTURE_RESIDENCY_MIN_DIMENSION.
+    Block compressed textures with a .texcache can also be streamed (texture_streaming.h): they
+    start resident from a smaller mip (texture_residency_add with top_mip > 0), and the mips
+    above it are read from the cache again and uploaded once they're needed
+    (texture_residency_restore_mips), making room under the budget from textures that weren't
+    drawn last frame (texture_residency_make_room).
+    Because the GL texture object can change, texture_t::gl_use_texture binds through the
+    manager (which also marks the texture as used for the LRU order) and the texture_id of a
+    shared texture_t is only good to test whether it holds a texture.
+
+    Texture arrays (texture_array.h) are owned by the mesh group that built them, not by the
+    manager, but they're registered with texture_residency_add_array so their VRAM counts
+    against the budget and shows in texture_report. They're never evicted, so the 2D textures
+    make room for them.
+
+    Main thread only.
+*/
+
+#define TEXTURE_RESIDENCY_DEFAULT_BUDGET_MB 512.f
+#define TEXTURE_RESIDENCY_MIN_DIMENSION 64          // mips aren't dropped past this width or height
+#define TEXTURE_RESIDENCY_MAX_CHANGES_PER_FRAME 4   // evictions and mip drops per texture_residency_update
+
+/** If path is resident, points texture at it with a new reference and returns true. */
+bool texture_residency_find(texture_t& texture, const char* path);
+
+/** If a texture with the same content_hash (which covers the texel data, size, and format) is
+    resident, points texture at it with a new reference, adds path as another name for it, and
+    returns true. */
+bool texture_residency_find_content(texture_t& texture, u64 content_hash, const char* path);
+
+/** Hands the GL texture just created into texture over to the manager, with one reference held
+    by texture. block_bytes is the size of a 4x4 block of internal_format, or 0 for RGBA8.
+    mips_count is of the whole chain, and the GL texture holds the ones from top_mip down (level
+    0 of the GL texture is mip top_mip). */
+void texture_residency_add(texture_t& texture,
+                           const char* path,
+                           u64 content_hash,
+                           GLenum internal_format,
+                           u32 block_bytes,
+                           u32 mips_count,
+                           u32 top_mip);
+
+/** Marks a block compressed texture as one whose mips can be read again from the .texcache of
+    the path it was first loaded by, cooked with compression and flipped if b_flipped. */
+void texture_residency_set_streamable(u32 residency_id, texture_compression_t compression, bool b_flipped);
+
+void texture_residency_acquire(u32 residency_id);
+
+void texture_residency_release(u32 residency_id);
+
+/** Current GL texture object of residency_id. Marks it as used this frame. */
+GLuint texture_residency_use(u32 residency_id);
+
+/** What the current texture object of a resident texture holds: only the mips that weren't
+    dropped, so width and height are those of its largest resident mip. */
+struct texture_residency_info_t
+{
+    GLuint  gl_id = 0;
+    GLenum  internal_format = GL_NONE;
+    u32     width = 0;
+    u32     height = 0;
+    u32     mips_count = 0;
+    u32     top_mip = 0;                    // mips_count + top_mip is the length of the whole chain
+    u64     size = 0;                       // bytes of the resident mips
+    bool    b_live = false;                 // false if the texture was evicted
+    bool    b_streamable = false;
+    bool    b_flipped = false;
+    texture_compression_t compression = TEXTURE_COMPRESSION_NONE;
+    const char* path = "";                  // first one it was loaded by, good until the next call into the manager
+};
+
+/** b_live is false for an id that was never handed out. */
+texture_residency_info_t texture_residency_describe(u32 residency_id);
+
+/** Counts the texture array gl_id, layers_count layers shaped like layer, against the budget
+    until texture_residency_remove_array. name is what texture_report lists it as. */
+void texture_residency_add_array(GLuint gl_id, const texture_residency_info_t& layer, u32 layers_count, const char* name);
+
+void texture_residency_remove_array(GLuint gl_id);
+
+/** Uploads the mips from top_mip down to the current top mip of residency_id from cooked, the
+    texture read again from its .texcache. Returns false if residency_id already has those mips
+    or cooked doesn't match it anymore. */
+bool texture_residency_restore_mips(u32 residency_id, u32 top_mip, const texture_cooked_t& cooked);
+
+/** Evicts and drops mips, like texture_residency_update does, of textures that weren't used
+    last frame until bytes more fit under the budget. Returns whether they fit. */
+bool texture_residency_make_room(u64 bytes);
+
+/** Enforces the budget. Call once a frame. */
+void texture_residency_update();
+
+void texture_residency_set_budget(float megabytes);
+
+/** Prints the resident textures, largest first, and the totals to the console. */
+void texture_residency_report();
+
+/** Deletes every texture, referenced or not. */
+void texture_residency_clean_up();
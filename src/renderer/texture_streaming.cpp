@@ -0,0 +1,340 @@
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <GL/glew.h>
+
+#include "texture_streaming.h"
+#include "texture_residency.h"
+#include "texture.h"
+#include "shader.h"
+#include "../core/kc_math.h"
+#include "../core/worker_pool.h"
+#include "../debugging/console.h"
+
+/** Feedback read back into pbo, done once sync signals */
+struct texture_streaming_readback_t
+{
+    GLuint  pbo = 0;
+    GLsync  sync = nullptr;
+};
+
+/** Mips from top_mip down of a texture, read from its .texcache on a worker thread */
+struct texture_streaming_load_t
+{
+    u32                     residency_id = 0;
+    u32                     top_mip = 0;
+    std::string             path;
+    texture_compression_t   compression = TEXTURE_COMPRESSION_BC1_BC3;
+    bool                    b_flipped = false;
+    texture_cooked_t*       cooked = nullptr;   // nullptr if the cache couldn't be read
+};
+
+internal bool b_texture_streaming = false;
+
+internal GLuint feedback_fbo = 0;
+internal GLuint feedback_texture = 0;
+internal u32 feedback_width = 0;
+internal u32 feedback_height = 0;
+internal u64 feedback_frame = 0;
+internal texture_streaming_readback_t readbacks[TEXTURE_STREAMING_READBACKS];
+internal u32 readbacks_oldest = 0;
+internal u32 readbacks_pending = 0;
+
+internal std::unordered_map<u32, u32> wanted_mips;     // residency id to the finest mip the last feedback asked for
+internal std::unordered_set<u32> loading_ids;
+internal std::atomic<u32> loads_running(0);
+internal std::mutex loaded_mutex;
+internal std::vector<texture_streaming_load_t> loaded_loads;   // oldest first
+
+void texture_streaming_set_enabled(int enabled)
+{
+    b_texture_streaming = enabled != 0;
+    console_printf("Texture streaming %s\n", b_texture_streaming ? "on for textures loaded from now on" : "off");
+}
+
+bool texture_streaming_is_enabled()
+{
+    return b_texture_streaming;
+}
+
+u32 texture_streaming_start_mip(const texture_cooked_t& cooked)
+{
+    for(u32 level = 0; level < cooked.mips_count; ++level)
+    {
+        if(cooked.mips[level].width <= TEXTURE_STREAMING_START_DIMENSION && cooked.mips[level].height <= TEXTURE_STREAMING_START_DIMENSION)
+        {
+            return level;
+        }
+    }
+    return cooked.mips_count - 1;
+}
+
+texture_feedback_uniforms_t texture_streaming_feedback_uniforms(shader_t& shader)
+{
+    texture_feedback_uniforms_t uniforms;
+    uniforms.id_location = shader.get_cached_uniform_location(UNIFORM("texture_feedback_id"));
+    uniforms.size_location = shader.get_cached_uniform_location(UNIFORM("texture_feedback_size"));
+    return uniforms;
+}
+
+void texture_streaming_set_feedback(const texture_feedback_uniforms_t& uniforms, const texture_t* texture)
+{
+    if(uniforms.id_location < 0)
+    {
+        return;
+    }
+    // The feedback target holds 16 bit ids
+    u32 residency_id = texture && texture->residency_id <= 0xFFFF ? texture->residency_id : 0;
+    glUniform1ui(uniforms.id_location, residency_id);
+    if(residency_id)
+    {
+        glUniform2f(uniforms.size_location, (float) texture->width, (float) texture->height);
+    }
+}
+
+void texture_streaming_initialize(u32 width, u32 height)
+{
+    feedback_width = max(width / TEXTURE_STREAMING_FEEDBACK_DIVISOR, 1u);
+    feedback_height = max(height / TEXTURE_STREAMING_FEEDBACK_DIVISOR, 1u);
+
+    glGenTextures(1, &feedback_texture);
+    glBindTexture(GL_TEXTURE_2D, feedback_texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16UI, feedback_width, feedback_height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &feedback_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, feedback_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedback_texture, 0);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        console_printf("Texture feedback framebuffer is incomplete\n");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for(texture_streaming_readback_t& readback : readbacks)
+    {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) feedback_width * feedback_height * 2 * sizeof(u16), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void texture_streaming_capture(u32 g_buffer_fbo, u32 feedback_attachment, u32 width, u32 height)
+{
+    if(!b_texture_streaming || feedback_fbo == 0 || ++feedback_frame % TEXTURE_STREAMING_FEEDBACK_INTERVAL != 0)
+    {
+        return;
+    }
+    if(readbacks_pending == TEXTURE_STREAMING_READBACKS)
+    {
+        return; // the GPU is behind, skip this one
+    }
+
+    texture_streaming_readback_t& readback = readbacks[(readbacks_oldest + readbacks_pending) % TEXTURE_STREAMING_READBACKS];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, g_buffer_fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + feedback_attachment);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, feedback_fbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, feedback_width, feedback_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, feedback_fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glReadPixels(0, 0, feedback_width, feedback_height, GL_RG_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    readback.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++readbacks_pending;
+}
+
+/** Reads the readbacks that are done into wanted_mips. Returns false if none were. */
+internal bool texture_streaming_read_feedback()
+{
+    bool b_read_any = false;
+    while(readbacks_pending > 0)
+    {
+        texture_streaming_readback_t& readback = readbacks[readbacks_oldest];
+        GLenum result = glClientWaitSync(readback.sync, 0, 0);
+        if(result == GL_TIMEOUT_EXPIRED)
+        {
+            break;
+        }
+        glDeleteSync(readback.sync);
+        readback.sync = nullptr;
+        readbacks_oldest = (readbacks_oldest + 1) % TEXTURE_STREAMING_READBACKS;
+        --readbacks_pending;
+
+        GLsizeiptr size = (GLsizeiptr) feedback_width * feedback_height * 2 * sizeof(u16);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        const u16* texels = (const u16*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if(texels)
+        {
+            wanted_mips.clear();
+            for(u32 i = 0; i < feedback_width * feedback_height; ++i)
+            {
+                u32 residency_id = texels[2 * i];
+                u32 mip = texels[2 * i + 1];
+                if(residency_id == 0)
+                {
+                    continue;
+                }
+                auto found = wanted_mips.find(residency_id);
+                if(found == wanted_mips.end())
+                {
+                    wanted_mips[residency_id] = mip;
+                }
+                else
+                {
+                    found->second = min(found->second, mip);
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            b_read_any = true;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    return b_read_any;
+}
+
+internal void texture_streaming_start_loads()
+{
+    for(auto& wanted : wanted_mips)
+    {
+        if(loading_ids.size() >= TEXTURE_STREAMING_MAX_LOADS)
+        {
+            break;
+        }
+        u32 residency_id = wanted.first;
+        if(loading_ids.count(residency_id))
+        {
+            continue;
+        }
+        texture_residency_info_t info = texture_residency_describe(residency_id);
+        if(!info.b_live || !info.b_streamable || wanted.second >= info.top_mip)
+        {
+            continue;
+        }
+
+        texture_streaming_load_t load;
+        load.residency_id = residency_id;
+        load.top_mip = wanted.second;
+        load.path = info.path;
+        load.compression = info.compression;
+        load.b_flipped = info.b_flipped;
+        loading_ids.insert(residency_id);
+        ++loads_running;
+        worker_pool_submit([load]() mutable
+        {
+            load.cooked = new texture_cooked_t;
+            if(!texture_cache_load(*load.cooked, load.path.c_str(), load.b_flipped, load.compression))
+            {
+                delete load.cooked;
+                load.cooked = nullptr;
+            }
+            {
+                std::lock_guard<std::mutex> lock(loaded_mutex);
+                loaded_loads.push_back(load);
+            }
+            --loads_running;
+        });
+    }
+}
+
+/** Uploads the finest mips of load that fit under the budget */
+internal void texture_streaming_upload(const texture_streaming_load_t& load)
+{
+    texture_residency_info_t info = texture_residency_describe(load.residency_id);
+    if(!load.cooked || !info.b_live || load.path != info.path || load.top_mip >= info.top_mip)
+    {
+        return;
+    }
+    u32 resident_top_mip = info.top_mip;
+    for(u32 top_mip = load.top_mip; top_mip < resident_top_mip; ++top_mip)
+    {
+        u64 size = 0;
+        for(u32 level = top_mip; level < resident_top_mip; ++level)
+        {
+            size += load.cooked->mips[level].size;
+        }
+        if(texture_residency_make_room(size))
+        {
+            texture_residency_restore_mips(load.residency_id, top_mip, *load.cooked);
+            return;
+        }
+    }
+}
+
+void texture_streaming_update()
+{
+    if(b_texture_streaming && texture_streaming_read_feedback())
+    {
+        texture_streaming_start_loads();
+    }
+
+    std::vector<texture_streaming_load_t> uploads;
+    {
+        std::lock_guard<std::mutex> lock(loaded_mutex);
+        size_t count = min(loaded_loads.size(), (size_t) TEXTURE_STREAMING_MAX_UPLOADS_PER_FRAME);
+        uploads.assign(loaded_loads.begin(), loaded_loads.begin() + count);
+        loaded_loads.erase(loaded_loads.begin(), loaded_loads.begin() + count);
+    }
+    for(texture_streaming_load_t& load : uploads)
+    {
+        texture_streaming_upload(load);
+        loading_ids.erase(load.residency_id);
+        if(load.cooked)
+        {
+            texture_cooked_free(*load.cooked);
+            delete load.cooked;
+        }
+    }
+}
+
+void texture_streaming_clean_up()
+{
+    while(loads_running > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for(texture_streaming_load_t& load : loaded_loads)
+    {
+        if(load.cooked)
+        {
+            texture_cooked_free(*load.cooked);
+            delete load.cooked;
+        }
+    }
+    loaded_loads.clear();
+    loading_ids.clear();
+    wanted_mips.clear();
+
+    for(texture_streaming_readback_t& readback : readbacks)
+    {
+        if(readback.sync)
+        {
+            glDeleteSync(readback.sync);
+        }
+        if(readback.pbo)
+        {
+            glDeleteBuffers(1, &readback.pbo);
+        }
+        readback = texture_streaming_readback_t();
+    }
+    readbacks_oldest = 0;
+    readbacks_pending = 0;
+    if(feedback_fbo)
+    {
+        glDeleteFramebuffers(1, &feedback_fbo);
+        glDeleteTextures(1, &feedback_texture);
+    }
+    feedback_fbo = 0;
+    feedback_texture = 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../gamedefine.h"
+#include "texture_cache.h"
+
+struct texture_t;
+struct shader_t;
+
+/**
+    TEXTURE STREAMING - feedback driven mip streaming
+
+    With streaming on, block compressed textures that have a .texcache are loaded with only their
+    mips of TEXTURE_STREAMING_START_DIMENSION and smaller, so models come up quickly and cheaply.
+    The larger mips are only loaded for textures that get seen close enough to need them:
+
+        1.  The G-buffer pass writes the residency id of the texture each pixel samples, and the
+            mip level its uv gradients ask for, into an RG16UI feedback attachment.
+        2.  Every TEXTURE_STREAMING_FEEDBACK_INTERVAL frames texture_streaming_capture scales that
+            down by TEXTURE_STREAMING_FEEDBACK_DIVISOR (nearest, so ids stay ids) and reads it
+            back into a pixel buffer with a fence. Nothing waits for the readback.
+        3.  texture_streaming_update takes the finest mip asked for of each texture out of the
+            last readback that finished, and maps the .texcache of the ones that need more mips
+            on the worker pool.
+        4.  The main thread then uploads the missing mips through the residency manager
+            (texture_residency_restore_mips), up to TEXTURE_STREAMING_MAX_UPLOADS_PER_FRAME a
+            frame and within the texture budget. Room is made from textures that weren't drawn
+            last frame; if there's none the texture stays at the mips it has.
+
+    Textures that stop being seen lose their mips again through the budget (texture_residency.h).
+    Texture arrays (texture_array.h) hold fixed copies, so models aren't put into arrays while
+    streaming is on. Main thread only, besides the cache reads.
+*/
+
+#define TEXTURE_STREAMING_START_DIMENSION 128       // streamed textures start with the mips no larger than this
+#define TEXTURE_STREAMING_FEEDBACK_DIVISOR 8        // feedback is read back at 1/8 of the G-buffer size
+#define TEXTURE_STREAMING_FEEDBACK_INTERVAL 4       // frames between feedback captures
+#define TEXTURE_STREAMING_READBACKS 3               // captures in flight at once
+#define TEXTURE_STREAMING_MAX_LOADS 4               // .texcache reads in flight on the worker pool
+#define TEXTURE_STREAMING_MAX_UPLOADS_PER_FRAME 2
+
+/** Locations of the feedback uniforms of a shader, -1 if it doesn't write feedback */
+struct texture_feedback_uniforms_t
+{
+    i32 id_location = -1;       // uint texture_feedback_id, 0 for a texture that isn't streamed
+    i32 size_location = -1;     // vec2 texture_feedback_size, of mip 0 of the whole chain
+};
+
+/** Console command. Textures loaded afterwards start at a small mip. Off, the feedback isn't
+    captured anymore and every texture keeps the mips it has. */
+void texture_streaming_set_enabled(int enabled);
+
+bool texture_streaming_is_enabled();
+
+/** First mip of cooked a streamed texture starts from */
+u32 texture_streaming_start_mip(const texture_cooked_t& cooked);
+
+texture_feedback_uniforms_t texture_streaming_feedback_uniforms(shader_t& shader);
+
+/** Tells the shader which texture the next draws sample. texture can be nullptr. */
+void texture_streaming_set_feedback(const texture_feedback_uniforms_t& uniforms, const texture_t* texture);
+
+/** Creates the downscaled feedback target for a G-buffer of width x height. */
+void texture_streaming_initialize(u32 width, u32 height);
+
+/** Call after the G-buffer pass: starts reading back feedback_attachment of g_buffer_fbo every
+    TEXTURE_STREAMING_FEEDBACK_INTERVAL frames. */
+void texture_streaming_capture(u32 g_buffer_fbo, u32 feedback_attachment, u32 width, u32 height);
+
+/** Once a frame: reads the feedback that came back, starts loading the mips it asks for, and
+    uploads the mips that finished loading. */
+void texture_streaming_update();
+
+/** Waits for the loads in flight and deletes the feedback target. */
+void texture_streaming_clean_up();
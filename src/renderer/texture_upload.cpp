@@ -0,0 +1,151 @@
+#include <vector>
+#include <deque>
+#include <cstring>
+#include <cstdint>
+#include <GL/glew.h>
+
+#include "texture_upload.h"
+#include "../debugging/console.h"
+
+#define TEXTURE_UPLOAD_ALIGNMENT 256                    // start of every staged range
+#define TEXTURE_UPLOAD_WAIT_NANOSECONDS 1000000000ull   // per glClientWaitSync call
+
+/** Range of the ring [begin, end) in flight until sync signals */
+struct texture_upload_range_t
+{
+    GLsync  sync = nullptr;
+    u64     begin = 0;
+    u64     end = 0;
+};
+
+internal GLuint ring_buffer = 0;
+internal u8* ring_memory = nullptr;
+internal u64 ring_head = 0;
+internal std::vector<texture_upload_range_t> staged_ranges;    // since the last submit, no fence yet
+internal std::deque<texture_upload_range_t> fenced_ranges;     // oldest first
+
+internal bool texture_upload_overlaps(const texture_upload_range_t& range, u64 begin, u64 end)
+{
+    return range.begin < end && begin < range.end;
+}
+
+internal void texture_upload_wait(GLsync sync)
+{
+    for(;;)
+    {
+        GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, TEXTURE_UPLOAD_WAIT_NANOSECONDS);
+        if(result != GL_TIMEOUT_EXPIRED)
+        {
+            return;
+        }
+    }
+}
+
+void texture_upload_initialize()
+{
+    if(ring_memory)
+    {
+        return;
+    }
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &ring_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEXTURE_UPLOAD_RING_SIZE, nullptr, flags);
+    ring_memory = (u8*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEXTURE_UPLOAD_RING_SIZE, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if(ring_memory == nullptr)
+    {
+        console_printf("WARNING: Couldn't map the texture upload ring, textures upload straight from client memory\n");
+        glDeleteBuffers(1, &ring_buffer);
+        ring_buffer = 0;
+    }
+    ring_head = 0;
+}
+
+void texture_upload_clean_up()
+{
+    texture_upload_submit();
+    for(texture_upload_range_t& range : fenced_ranges)
+    {
+        texture_upload_wait(range.sync);
+        glDeleteSync(range.sync);
+    }
+    fenced_ranges.clear();
+    if(ring_buffer)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &ring_buffer);
+    }
+    ring_buffer = 0;
+    ring_memory = nullptr;
+}
+
+const void* texture_upload_stage(const void* memory, u64 size)
+{
+    if(ring_memory == nullptr || size == 0 || size > TEXTURE_UPLOAD_RING_SIZE)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return memory;
+    }
+
+    // The tail of the ring that's too small for this upload is skipped
+    u64 begin = ring_head + size > TEXTURE_UPLOAD_RING_SIZE ? 0 : ring_head;
+    u64 end = begin + size;
+
+    // Ranges staged since the last submit have no fence to wait on yet. Running into one means
+    // the uploads between two submits don't fit in the ring together.
+    for(const texture_upload_range_t& range : staged_ranges)
+    {
+        if(texture_upload_overlaps(range, begin, end))
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return memory;
+        }
+    }
+
+    // Fences signal in order, so waiting on the newest overlapping one frees everything before it
+    size_t retired_count = 0;
+    for(size_t i = 0; i < fenced_ranges.size(); ++i)
+    {
+        if(texture_upload_overlaps(fenced_ranges[i], begin, end))
+        {
+            retired_count = i + 1;
+        }
+    }
+    if(retired_count > 0)
+    {
+        texture_upload_wait(fenced_ranges[retired_count - 1].sync);
+        for(size_t i = 0; i < retired_count; ++i)
+        {
+            glDeleteSync(fenced_ranges.front().sync);
+            fenced_ranges.pop_front();
+        }
+    }
+
+    memcpy(ring_memory + begin, memory, size);
+    texture_upload_range_t range;
+    range.begin = begin;
+    range.end = end;
+    staged_ranges.push_back(range);
+    ring_head = (end + TEXTURE_UPLOAD_ALIGNMENT - 1) & ~((u64) TEXTURE_UPLOAD_ALIGNMENT - 1);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+    return (const void*) (uintptr_t) begin;
+}
+
+void texture_upload_submit()
+{
+    if(ring_memory == nullptr)
+    {
+        return;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for(texture_upload_range_t& range : staged_ranges)
+    {
+        range.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fenced_ranges.push_back(range);
+    }
+    staged_ranges.clear();
+}
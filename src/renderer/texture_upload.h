@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../gamedefine.h"
+
+/**
+    TEXTURE UPLOAD - persistently mapped staging ring for asynchronous texture uploads
+
+    One GL_PIXEL_UNPACK_BUFFER of TEXTURE_UPLOAD_RING_SIZE bytes is created with
+    glBufferStorage and stays mapped for the lifetime of the renderer. texture_upload_stage
+    copies texel data into the next free range of the ring and leaves the ring bound, so the
+    glTextureSubImage2D / glCompressedTextureSubImage2D call that follows sources from the buffer and returns
+    without the driver copying client memory; the transfer runs on the GPU timeline.
+    texture_upload_submit fences the ranges staged since the last submit. A range is only
+    written again once its fence has signaled, so the ring never makes the GPU wait, and the
+    CPU only waits when everything in the ring is still in flight.
+
+    If the ring couldn't be mapped, or for data larger than the ring, nothing is staged and
+    the upload reads client memory as before. Main thread only.
+
+    Usage:
+        const void* pixels = texture_upload_stage(bitmap, size);
+        glTextureSubImage2D(..., pixels);
+        texture_upload_submit();
+*/
+
+#define TEXTURE_UPLOAD_RING_SIZE (64 * 1024 * 1024)
+
+void texture_upload_initialize();
+
+/** Waits for every upload in flight and deletes the ring. */
+void texture_upload_clean_up();
+
+/** Copies size bytes of memory into the ring and binds it to GL_PIXEL_UNPACK_BUFFER. Returns
+    what to pass as the data pointer of the next texture upload call: an offset into the ring,
+    or memory itself (with no unpack buffer bound) if it couldn't be staged. */
+const void* texture_upload_stage(const void* memory, u64 size);
+
+/** Unbinds the ring and fences the uploads staged since the last submit. */
+void texture_upload_submit();
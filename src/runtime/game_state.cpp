@@ -1,5 +1,6 @@
 #include "game_state.h"
 #include "../debugging/debug_drawer.h"
+#include "../renderer/model_streamer.h"
 
 
 void game_state::temp_initialize()
@@ -8,7 +9,7 @@ void game_state::temp_initialize()
     loaded_map.directionallight.ambient_intensity = 0.35f;
     loaded_map.directionallight.diffuse_intensity = 0.8f;
     loaded_map.directionallight.colour = { 1.f, 1.f, 1.f };
-    loaded_map.mainobject.model.assimp_load("data/models/vokselia_spawn/vokselia_spawn.obj");
+    model_streamer_load(loaded_map.mainobject.model, "data/models/vokselia_spawn/vokselia_spawn.obj");
     loaded_map.mainobject.pos = make_vec3(0.f, -6.f, 0.f);
     //loaded_map.mainobject.scale = make_vec3(0.04f, 0.04f, 0.04f);
     //loaded_map.mainobject.scale = make_vec3(0.25f, 0.25f, 0.25f);
@@ -20,3 +20,11 @@ struct bitmap_handle_t : binary_file_handle_t
     u32  height = 0;     // image height
     u8   bit_depth = 0;  // bit depth of bitmap in bytes (e.g. bit depth = 3 means there are 3 bytes in the bitmap per pixel)
 };
+
+/** Handle for a read-only view of a file mapped into memory. memory points straight into the
+    mapping, so it must not be freed or written to; use unmap_file instead. */
+struct mapped_file_handle_t : binary_file_handle_t
+{
+    void*   os_file     = nullptr;  // platform specific handle of the opened file
+    void*   os_mapping  = nullptr;  // platform specific handle of the file mapping object
+};
\ No newline at end of file